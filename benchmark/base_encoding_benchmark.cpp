@@ -0,0 +1,170 @@
+/**
+ * @brief measures the conversion of bases between ASCII and the 4-bit encoding of BAM records: the
+ * element-wise loops ReadBases::to_string() and SamBuilder::set_bases() used before (a map lookup and a
+ * stringstream per base, a read-modify-write of a nibble per base) against utils::decode_bases() and
+ * utils::encode_bases(), the conversions between Base values and the 4-bit encoding (one nibble per base against
+ * the bulk kernels), and the same conversions through ReadBases and SamBuilder.
+ *
+ * usage: base_encoding_benchmark [read_length] [reads]
+ *
+ * Configure with -DGAMGEE_NATIVE_ARCH=ON (or -march flags) for the SSSE3/AVX2 versions of the kernels.
+ */
+#include "sam/sam_builder.h"
+#include "utils/base_encoding.h"
+#include "utils/hts_memory.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace gamgee;
+
+namespace {
+
+string element_wise_decode(const uint8_t* packed, const uint32_t num_bases) {
+  static const auto base_to_string_map = map<Base, const char*>{ {Base::A, "A"}, {Base::C, "C"}, {Base::G, "G"}, {Base::T, "T"}, {Base::N, "N"} };
+  stringstream ss;
+  for (auto i = 0u; i < num_bases; ++i)
+    ss << base_to_string_map.at(static_cast<Base>(bam_seqi(packed, i)));
+  return ss.str();
+}
+
+void element_wise_encode(const string& bases, uint8_t* packed) {
+  memset(packed, 0, (bases.size() + 1) >> 1);
+  for (auto i = 0u; i < bases.size(); ++i)
+    packed[i >> 1] |= seq_nt16_table[uint8_t(bases[i])] << ((~i & 1) << 2);
+}
+
+template<class FUNCTION>
+void run(const string& name, const uint64_t bases, FUNCTION loop) {
+  const auto start = chrono::steady_clock::now();
+  const auto checksum = loop();
+  const auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << name << ": checksum " << checksum << " in " << seconds << "s (" << bases / seconds / 1e6 << " Mbases/s)" << endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 3) {
+    cerr << "usage: " << argv[0] << " [read_length] [reads]" << endl;
+    return 1;
+  }
+  const auto read_length = argc > 1 ? uint32_t(stoul(argv[1])) : 151u;
+  const auto num_reads = argc > 2 ? uint32_t(stoul(argv[2])) : 1000000u;
+  cout << "kernels compiled for " << utils::base_encoding_instruction_set() << ", " << num_reads << " reads of " << read_length << " bases" << endl;
+
+  auto random = mt19937{42};
+  auto reads = vector<string>(1024);
+  for (auto& read : reads) {
+    read.resize(read_length);
+    for (auto& base : read)
+      base = "ACGTACGTACGTACGTN"[random() % 17];
+  }
+  auto packed_reads = vector<vector<uint8_t>>{};
+  for (const auto& read : reads) {
+    packed_reads.emplace_back((read_length + 1) / 2);
+    utils::encode_bases(read.data(), read_length, packed_reads.back().data());
+  }
+  const auto bases = uint64_t{num_reads} * read_length;
+  auto packed = vector<uint8_t>((read_length + 1) / 2);
+  auto ascii = string(read_length, '\0');
+
+  run("element-wise encode     ", bases, [&] {
+    auto checksum = uint64_t{0};
+    for (auto i = 0u; i != num_reads; ++i) {
+      element_wise_encode(reads[i % reads.size()], packed.data());
+      checksum += packed[i % packed.size()];
+    }
+    return checksum;
+  });
+  run("encode_bases            ", bases, [&] {
+    auto checksum = uint64_t{0};
+    for (auto i = 0u; i != num_reads; ++i) {
+      utils::encode_bases(reads[i % reads.size()].data(), read_length, packed.data());
+      checksum += packed[i % packed.size()];
+    }
+    return checksum;
+  });
+  run("element-wise decode     ", bases, [&] {
+    auto checksum = uint64_t{0};
+    for (auto i = 0u; i != num_reads; ++i)
+      checksum += uint8_t(element_wise_decode(packed_reads[i % reads.size()].data(), read_length)[i % read_length]);
+    return checksum;
+  });
+  run("decode_bases            ", bases, [&] {
+    auto checksum = uint64_t{0};
+    for (auto i = 0u; i != num_reads; ++i) {
+      utils::decode_bases(packed_reads[i % reads.size()].data(), read_length, &ascii[0]);
+      checksum += uint8_t(ascii[i % read_length]);
+    }
+    return checksum;
+  });
+
+  // Base values: one nibble at a time (as set_bases(vector<Base>) and a loop on ReadBases::operator[] did) against
+  // the bulk kernels
+  auto base_reads = vector<vector<Base>>{};
+  for (const auto& read : packed_reads) {
+    base_reads.emplace_back(read_length);
+    for (auto i = 0u; i != read_length; ++i)
+      base_reads.back()[i] = static_cast<Base>(bam_seqi(read.data(), i));
+  }
+  auto base_values = vector<Base>(read_length);
+  run("element-wise Base encode", bases, [&] {
+    auto checksum = uint64_t{0};
+    for (auto i = 0u; i != num_reads; ++i) {
+      const auto& read = base_reads[i % reads.size()];
+      memset(packed.data(), 0, packed.size());
+      for (auto j = 0u; j != read_length; ++j)
+        packed[j >> 1] |= static_cast<uint8_t>(read[j]) << ((~j & 1) << 2);
+      checksum += packed[i % packed.size()];
+    }
+    return checksum;
+  });
+  run("encode_bases (Base)     ", bases, [&] {
+    auto checksum = uint64_t{0};
+    for (auto i = 0u; i != num_reads; ++i) {
+      utils::encode_bases(base_reads[i % reads.size()].data(), read_length, packed.data());
+      checksum += packed[i % packed.size()];
+    }
+    return checksum;
+  });
+  run("element-wise Base decode", bases, [&] {
+    auto checksum = uint64_t{0};
+    for (auto i = 0u; i != num_reads; ++i) {
+      const auto read = packed_reads[i % reads.size()].data();
+      for (auto j = 0u; j != read_length; ++j)
+        base_values[j] = static_cast<Base>(bam_seqi(read, j));
+      checksum += uint8_t(base_values[i % read_length]);
+    }
+    return checksum;
+  });
+  run("decode_bases (Base)     ", bases, [&] {
+    auto checksum = uint64_t{0};
+    for (auto i = 0u; i != num_reads; ++i) {
+      utils::decode_bases(packed_reads[i % reads.size()].data(), read_length, base_values.data());
+      checksum += uint8_t(base_values[i % read_length]);
+    }
+    return checksum;
+  });
+
+  // the same conversions through the builder and the read: set_bases(), build_into() and bases().to_string()
+  auto builder = SamBuilder{SamHeader{utils::make_shared_sam_header(bam_hdr_init())}, false};
+  builder.set_name("read").set_base_quals_phred33(string(read_length, 'I')).set_unmapped();
+  auto read = Sam{};
+  run("set_bases + to_string   ", bases, [&] {
+    auto checksum = uint64_t{0};
+    for (auto i = 0u; i != num_reads; ++i) {
+      builder.set_bases(reads[i % reads.size()]).build_into(read);
+      checksum += uint8_t(read.bases().to_string()[i % read_length]);
+    }
+    return checksum;
+  });
+  return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * @brief measures the parsing throughput of FastA/FastQ input: the stream based parser FastqIterator used before
+ * (one get/peek/>>/getline/ignore call per character or token, sequences built with +=) against the
+ * block-buffered FastqParser, through the FastqReader, the PairedFastqReader parsing the input as both mates
+ * (throughput per input, which should be that of the FastqReader given two cores) and the FastqBatchReader parsing
+ * chunks of the input on all cores.
+ *
+ * The input is read into memory first so that only the parsing is timed. Without a file, a FastQ with 151 base
+ * reads is generated.
+ *
+ * usage: fastq_parser_benchmark [fasta/fastq file] [repetitions]
+ */
+#include "fastq_batch_reader.h"
+#include "fastq_reader.h"
+#include "paired_fastq_reader.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+using namespace std;
+using namespace gamgee;
+
+namespace {
+
+/**
+ * @brief the parsing code of the stream based FastqIterator
+ */
+class StreamFastqParser {
+ public:
+  explicit StreamFastqParser(istream& input) : m_input {input} {
+    m_is_fastq = m_input.get() == '@';
+    m_bor_delim = m_is_fastq ? '@' : '>';
+    m_eos_delim = m_is_fastq ? '+' : '>';
+  }
+
+  bool next(Fastq& record) {
+    auto name = string{};
+    if (!(m_input >> name))
+      return false;
+    const auto comment = parse_comment();
+    const auto seq     = parse_seq();
+    const auto quals   = parse_quals(seq.length());
+    record = Fastq {move(name), move(comment), move(seq), move(quals)};
+    return true;
+  }
+
+ private:
+  istream& m_input;
+  bool m_is_fastq;
+  char m_eos_delim;
+  char m_bor_delim;
+
+  const string parse_multiline() {
+    auto s = string{};
+    m_input >> s;
+    while (m_input.peek() == '\n')
+      m_input.ignore(numeric_limits<streamsize>::max(), '\n');
+    return s;
+  }
+
+  string parse_comment() {
+    auto comment = string{};
+    while (m_input.peek() == ' ')
+      m_input.ignore();
+    getline(m_input, comment);
+    return comment;
+  }
+
+  string parse_seq() {
+    auto seq = string{};
+    while (m_input.good() && m_input.peek() != m_eos_delim)
+      seq += parse_multiline();
+    return seq;
+  }
+
+  string parse_quals(uint32_t seq_length) {
+    auto qual = string{};
+    if (m_is_fastq) {
+      m_input.ignore(numeric_limits<streamsize>::max(), '\n');
+      while (m_input.good() && qual.length() < seq_length)
+        qual += parse_multiline();
+    }
+    m_input.ignore(numeric_limits<streamsize>::max(), m_bor_delim);
+    return qual;
+  }
+};
+
+string generate_fastq(const uint32_t num_reads) {
+  auto random = mt19937{42};
+  auto contents = string{};
+  auto bases = string(151, 'A');
+  auto quals = string(151, 'I');
+  for (auto i = 0u; i != num_reads; ++i) {
+    for (auto j = 0u; j != bases.size(); ++j) {
+      bases[j] = "ACGT"[random() & 3];
+      quals[j] = char('#' + random() % 40);
+    }
+    contents += "@read" + to_string(i) + " 1:N:0:ACGTACGT\n" + bases + "\n+\n" + quals + "\n";
+  }
+  return contents;
+}
+
+template<class FUNCTION>
+void run(const string& name, const string& contents, const uint32_t repetitions, FUNCTION parse) {
+  auto records = uint64_t{0};
+  auto bases = uint64_t{0};
+  auto seconds = 0.0;
+  for (auto i = 0u; i != repetitions; ++i) {
+    auto input = new istringstream{contents};   // copying the input into the streams is not timed
+    auto mate_input = new istringstream{contents};
+    const auto start = chrono::steady_clock::now();
+    parse(input, mate_input, records, bases);
+    seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  }
+  cout << name << ": " << records << " records, " << bases << " bases in " << seconds << "s ("
+       << double(contents.size()) * repetitions / seconds / 1e9 << " GB/s)" << endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 3) {
+    cerr << "usage: " << argv[0] << " [fasta/fastq file] [repetitions]" << endl;
+    return 1;
+  }
+  auto contents = string{};
+  if (argc > 1) {
+    auto file = ifstream{argv[1]};
+    contents.assign(istreambuf_iterator<char>{file}, istreambuf_iterator<char>{});
+  }
+  else
+    contents = generate_fastq(1000000);
+  const auto repetitions = argc > 2 ? uint32_t(stoul(argv[2])) : 3u;
+  cout << contents.size() / 1e6 << " MB of input, parsed " << repetitions << " times" << endl;
+
+  run("istream parser   ", contents, repetitions, [](istream* input, istream* mate_input, uint64_t& records, uint64_t& bases) {
+    auto parser = StreamFastqParser{*input};
+    for (auto record = Fastq{}; parser.next(record); ++records)
+      bases += record.sequence().size();
+    delete input;
+    delete mate_input;
+  });
+  run("FastqReader      ", contents, repetitions, [](istream* input, istream* mate_input, uint64_t& records, uint64_t& bases) {
+    for (const auto& record : FastqReader{input}) {
+      bases += record.sequence().size();
+      ++records;
+    }
+    delete mate_input;
+  });
+  run("PairedFastqReader", contents, repetitions, [](istream* input, istream* mate_input, uint64_t& records, uint64_t& bases) {
+    for (const auto& mates : PairedFastqReader{input, mate_input}) {
+      bases += mates.first.sequence().size();
+      ++records;
+    }
+  });
+  run("FastqBatchReader ", contents, repetitions, [](istream* input, istream* mate_input, uint64_t& records, uint64_t& bases) {
+    for (const auto& batch : FastqBatchReader{input}) {
+      for (const auto& record : batch)
+        bases += record.sequence().size();
+      records += batch.size();
+    }
+    delete mate_input;
+  });
+  return 0;
+}
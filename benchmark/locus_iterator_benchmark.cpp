@@ -0,0 +1,122 @@
+/**
+ * @brief compares the LocusIterator against the straightforward way of piling up reads with the Sam API
+ * (keeping a deep copy of every overlapping read and walking its cigar from the start at every position).
+ *
+ * usage: locus_iterator_benchmark <coordinate sorted bam> (e.g. a slice of a 30x whole genome)
+ */
+#include "sam/locus_reader.h"
+#include "sam/sam_reader.h"
+
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <limits>
+
+using namespace std;
+using namespace gamgee;
+
+namespace {
+
+struct Totals {
+  uint64_t positions {0};
+  uint64_t elements {0};
+  uint64_t quality_sum {0};
+};
+
+bool excluded(const Sam& read) {
+  return read.unmapped() || read.secondary() || read.fail() || read.duplicate();
+}
+
+/**
+ * @brief returns the read offset aligned to position, -1 if the read is deleted there or -2 if it doesn't cover it
+ */
+int64_t offset_at(const Sam& read, const uint32_t position) {
+  const auto cigar = read.cigar();
+  auto ref = read.alignment_start();
+  auto offset = 0u;
+  for (auto i = 0u; i < cigar.size(); ++i) {
+    const auto op = Cigar::cigar_op(cigar[i]);
+    const auto length = Cigar::cigar_oplen(cigar[i]);
+    const auto ref_bases = Cigar::consumes_reference_bases(op);
+    if (ref_bases && position < ref + length)
+      return op == CigarOperator::D ? -1 : (op == CigarOperator::N ? -2 : int64_t(offset + position - ref));
+    if (ref_bases)
+      ref += length;
+    if (Cigar::consumes_read_bases(op))
+      offset += length;
+  }
+  return -2;
+}
+
+void pileup_column(const deque<Sam>& reads, const uint32_t position, Totals& totals) {
+  auto depth = 0u;
+  for (const auto& read : reads) {
+    const auto offset = offset_at(read, position);
+    if (offset == -2)
+      continue;
+    totals.quality_sum += offset >= 0 ? read.base_quals()[uint32_t(offset)] : 0;
+    ++depth;
+  }
+  totals.elements += depth;
+  totals.positions += depth != 0;
+}
+
+Totals sam_api_pileup(const string& filename) {
+  auto totals = Totals{};
+  auto reads = deque<Sam>{};
+  auto chromosome = 0u;
+  auto position = 0u;
+  const auto flush_until = [&](const uint32_t stop) {
+    for (; position < stop && !reads.empty(); ++position) {
+      while (!reads.empty() && reads.front().alignment_stop() < position)
+        reads.pop_front();
+      pileup_column(reads, position, totals);
+    }
+  };
+  for (const auto& read : SingleSamReader{filename}) {
+    if (excluded(read))
+      continue;
+    if (read.chromosome() != chromosome || reads.empty()) {
+      flush_until(numeric_limits<uint32_t>::max());
+      reads.clear();
+      chromosome = read.chromosome();
+      position = read.alignment_start();
+    }
+    flush_until(read.alignment_start());
+    reads.push_back(read); // deep copy, as the iterator re-uses its record
+  }
+  flush_until(numeric_limits<uint32_t>::max());
+  return totals;
+}
+
+Totals locus_iterator_pileup(const string& filename) {
+  auto totals = Totals{};
+  for (const auto& pileup : LocusReader{filename}) {
+    ++totals.positions;
+    totals.elements += pileup.size();
+    for (const auto qual : pileup.base_quals())
+      totals.quality_sum += qual;
+  }
+  return totals;
+}
+
+template<class FUNCTION>
+void run(const string& name, const string& filename, FUNCTION pileup) {
+  const auto start = chrono::steady_clock::now();
+  const auto totals = pileup(filename);
+  const auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << name << ": " << totals.positions << " positions, " << totals.elements << " pileup elements, quality sum " << totals.quality_sum
+       << " in " << seconds << "s (" << totals.positions / seconds / 1e6 << " Mpositions/s, " << totals.elements / seconds / 1e6 << " Melements/s)" << endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    cerr << "usage: " << argv[0] << " <coordinate sorted bam>" << endl;
+    return 1;
+  }
+  run("Sam API pileup", argv[1], sam_api_pileup);
+  run("LocusIterator ", argv[1], locus_iterator_pileup);
+  return 0;
+}
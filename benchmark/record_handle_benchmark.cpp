@@ -0,0 +1,132 @@
+/**
+ * @brief measures what the record handles cost in field access heavy loops: every cigar(), bases() and
+ * base_quals() call on a Sam copies its handle, as do Sam copies. Runs the same loops with shared_ptr copies
+ * (what Sam and its views used before) and with raw pointers (no reference counting at all) for comparison.
+ *
+ * usage: record_handle_benchmark <bam> [passes]
+ *
+ * Build with -DGAMGEE_NONATOMIC_REFCOUNT=ON to measure the non-atomic reference counts.
+ */
+#include "sam/sam.h"
+#include "utils/hts_memory.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace std;
+using namespace gamgee;
+
+namespace {
+
+struct Totals {
+  uint64_t cigar_elements {0};
+  uint64_t bases {0};
+  uint64_t quality_sum {0};
+};
+
+/**
+ * @brief the loop body shared by all variants: a few fields of the record through a pointer obtained per access
+ */
+template<class ACCESS>
+void visit(ACCESS access, Totals& totals) {
+  totals.cigar_elements += access()->core.n_cigar;
+  const auto* record = access();
+  totals.bases += record->core.l_qseq;
+  const auto* quals = bam_get_qual(access());
+  for (auto i = 0; i < record->core.l_qseq; ++i)
+    totals.quality_sum += quals[i];
+}
+
+Totals sam_views(const vector<Sam>& reads, const uint32_t passes) {
+  auto totals = Totals{};
+  for (auto pass = 0u; pass != passes; ++pass) {
+    for (const auto& read : reads) {
+      const auto copy = read;                  // a value copy (copy-on-write), then three views
+      const auto cigar = copy.cigar();
+      const auto bases = copy.bases();
+      const auto quals = copy.base_quals();
+      totals.cigar_elements += cigar.size();
+      totals.bases += bases.size();
+      for (auto i = 0u; i < quals.size(); ++i)
+        totals.quality_sum += quals[i];
+    }
+  }
+  return totals;
+}
+
+Totals shared_ptr_copies(const vector<shared_ptr<bam1_t>>& records, const uint32_t passes) {
+  auto totals = Totals{};
+  for (auto pass = 0u; pass != passes; ++pass) {
+    for (const auto& record : records) {
+      const auto copy = record;
+      shared_ptr<bam1_t> views[3];  // kept alive until the end of the record, like the views of a Sam
+      auto next = 0u;
+      visit([&] { views[next] = copy; return views[next++].get(); }, totals);
+    }
+  }
+  return totals;
+}
+
+Totals record_handle_copies(const vector<utils::SamHandle>& records, const uint32_t passes) {
+  auto totals = Totals{};
+  for (auto pass = 0u; pass != passes; ++pass) {
+    for (const auto& record : records) {
+      const auto copy = record;
+      utils::SamHandle views[3];  // kept alive until the end of the record, like the views of a Sam
+      auto next = 0u;
+      visit([&] { views[next] = copy; return views[next++].get(); }, totals);
+    }
+  }
+  return totals;
+}
+
+Totals raw_pointers(const vector<bam1_t*>& records, const uint32_t passes) {
+  auto totals = Totals{};
+  for (auto pass = 0u; pass != passes; ++pass)
+    for (const auto record : records)
+      visit([&] { return record; }, totals);
+  return totals;
+}
+
+template<class FUNCTION>
+void run(const string& name, const uint64_t records, FUNCTION loop) {
+  const auto start = chrono::steady_clock::now();
+  const auto totals = loop();
+  const auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << name << ": " << totals.cigar_elements << " cigar elements, " << totals.bases << " bases, quality sum " << totals.quality_sum
+       << " in " << seconds << "s (" << records / seconds / 1e6 << " Mrecords/s)" << endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 2 && argc != 3) {
+    cerr << "usage: " << argv[0] << " <bam> [passes]" << endl;
+    return 1;
+  }
+  const auto passes = argc == 3 ? uint32_t(stoul(argv[2])) : 10u;
+  auto file = utils::make_unique_hts_file(sam_open(argv[1], "r"));
+  if (file == nullptr) {
+    cerr << "could not open " << argv[1] << endl;
+    return 1;
+  }
+  const auto header = utils::make_shared_sam_header(sam_hdr_read(file.get()));
+  auto reads = vector<Sam>{};
+  auto handles = vector<utils::SamHandle>{};
+  auto shared = vector<shared_ptr<bam1_t>>{};
+  auto raw = vector<bam1_t*>{};
+  for (auto record = utils::SamHandle::create(); sam_read1(file.get(), header.get(), record.get()) >= 0; record = utils::SamHandle::create()) {
+    reads.emplace_back(header, record);
+    handles.push_back(record);
+    shared.emplace_back(utils::sam_deep_copy(record.get()), utils::SamBodyDeleter{});
+    raw.push_back(record.get());
+  }
+  const auto records = uint64_t{passes} * reads.size();
+  run("Sam views           ", records, [&] { return sam_views(reads, passes); });
+  run("record handle copies", records, [&] { return record_handle_copies(handles, passes); });
+  run("shared_ptr copies   ", records, [&] { return shared_ptr_copies(shared, passes); });
+  run("raw pointers        ", records, [&] { return raw_pointers(raw, passes); });
+  return 0;
+}
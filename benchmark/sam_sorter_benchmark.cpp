@@ -0,0 +1,54 @@
+/**
+ * @brief measures how SamSorter scales with its threads: sorts the same file (by coordinate, then by read name)
+ * with each number of threads, with the default memory limit and with a 64MiB one (which spills and merges runs on
+ * any sizeable file).
+ *
+ * usage: sam_sorter_benchmark <bam> [threads...]   (default: 1 2 4 8)
+ */
+#include "sam/sam_sorter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace gamgee;
+
+namespace {
+
+void run(const string& name, const string& input, const SamSorterOptions& options) {
+  const auto output = string{"sam_sorter_benchmark_output.bam"};
+  const auto start = chrono::steady_clock::now();
+  SamSorter::sort(input, output, options);
+  const auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << name << ", " << options.num_threads << " threads: " << seconds << "s" << endl;
+  remove(output.c_str());
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    cerr << "usage: " << argv[0] << " <bam> [threads...]" << endl;
+    return 1;
+  }
+  auto thread_counts = vector<uint32_t>{};
+  for (auto i = 2; i < argc; ++i)
+    thread_counts.push_back(uint32_t(stoul(argv[i])));
+  if (thread_counts.empty())
+    thread_counts = {1, 2, 4, 8};
+  for (const auto order : {SamSortOrder::coordinate, SamSortOrder::queryname}) {
+    const auto order_name = string{order == SamSortOrder::coordinate ? "coordinate" : "queryname "};
+    for (const auto threads : thread_counts) {
+      auto options = SamSorterOptions{};
+      options.order = order;
+      options.num_threads = threads;
+      run(order_name + " default limit ", argv[1], options);
+      options.memory_limit = uint64_t{64} << 20;
+      run(order_name + " 64MiB limit   ", argv[1], options);
+    }
+  }
+  return 0;
+}
@@ -80,6 +80,51 @@ class ChromosomeSizeException : public std::runtime_error {
     std::runtime_error{(boost::format("Error: chromosome %s is of size %d but location %d was requested") % chrom_name % chrom_size % desired_location).str()} { }
 };
 
+/**
+ * @brief an exception class for references that can't be indexed (e.g. malformed FastA, or a stale index)
+ */
+class ReferenceIndexException : public std::runtime_error {
+ public:
+  ReferenceIndexException(const std::string& filename, const std::string& reason) :
+    std::runtime_error{std::string{"Error: could not index the reference "} + filename + ": " + reason} { }
+};
+
+/**
+ * @brief an exception class for the case where an input file is expected to be coordinate sorted but isn't
+ */
+class UnsortedInputException : public std::runtime_error {
+ public:
+  UnsortedInputException(const std::string& record_name, const int32_t chromosome, const int32_t position) :
+    std::runtime_error{(boost::format("Error: input is not coordinate sorted. Record %s at chromosome index %d position %d comes after a record with a larger coordinate") % record_name % chromosome % (position+1)).str()} { }
+};
+
+/**
+ * @brief an exception class for compressed input that is corrupted or truncated
+ */
+class DecompressionException : public std::runtime_error {
+ public:
+  DecompressionException(const std::string& reason) :
+    std::runtime_error{std::string{"Error: could not decompress the input: "} + reason} { }
+};
+
+/**
+ * @brief an exception class for output that cannot be compressed or written
+ */
+class OutputException : public std::runtime_error {
+ public:
+  OutputException(const std::string& reason) :
+    std::runtime_error{std::string{"Error: could not write the output: "} + reason} { }
+};
+
+/**
+ * @brief an exception class for paired inputs whose mates don't match (different names or numbers of records)
+ */
+class MateMismatchException : public std::runtime_error {
+ public:
+  MateMismatchException(const std::string& reason) :
+    std::runtime_error{std::string{"Error: the mates of the paired inputs don't match: "} + reason} { }
+};
+
 } // end of namespace gamgee
 
 #endif // end of gamgee__exceptions__guard
@@ -2,6 +2,7 @@
 #define gamgee__fastq__guard
 
 #include <string>
+#include <utility>
 
 namespace gamgee {
 
@@ -24,7 +25,7 @@ class Fastq {
         std::string sequence,  ///< sequence bases
         std::string quals = "" ///< optional quality scores (leave it out for FastA)
         ) :
-      m_name {name}, m_comment {comment}, m_sequence{sequence}, m_quals{quals} 
+      m_name {std::move(name)}, m_comment {std::move(comment)}, m_sequence{std::move(sequence)}, m_quals{std::move(quals)}
   {}
 
   Fastq(const Fastq&) = default;
@@ -55,10 +56,19 @@ class Fastq {
   }
 
 
-  std::string name() const                       { return m_name;         }
-  std::string comment() const                    { return m_comment;      }
-  std::string sequence() const                   { return m_sequence;     }
-  std::string quals() const                      { return m_quals;        } 
+  /**
+   * @brief the fields of the record, without copying them
+   * @note on a temporary (or std::move'd) record the field is moved out instead, so e.g.
+   * std::move(record).sequence() takes the sequence of a record that is not needed anymore without duplicating it
+   */
+  const std::string& name() const &              { return m_name;         }
+  const std::string& comment() const &           { return m_comment;      } ///< @copydoc name()
+  const std::string& sequence() const &          { return m_sequence;     } ///< @copydoc name()
+  const std::string& quals() const &             { return m_quals;        } ///< @copydoc name()
+  std::string name() &&                          { return std::move(m_name);     } ///< @copydoc name()
+  std::string comment() &&                       { return std::move(m_comment);  } ///< @copydoc name()
+  std::string sequence() &&                      { return std::move(m_sequence); } ///< @copydoc name()
+  std::string quals() &&                         { return std::move(m_quals);    } ///< @copydoc name()
   void set_name(const std::string& name)         { m_name = name;         }
   void set_comment(const std::string& comment)   { m_comment = comment;   }
   void set_sequence(const std::string& sequence) { m_sequence = sequence; }
@@ -75,6 +85,7 @@ class Fastq {
   std::string m_sequence; ///< sequence bases
   std::string m_quals;    ///< optional quality scores
 
+  friend class FastqParser;         ///< the parser reuses the memory of the strings from record to record
 };
 
 }  // end of namespace
@@ -0,0 +1,20 @@
+#include "fastq_batch.h"
+
+#include "fastq_parser.h"
+
+using namespace std;
+
+namespace gamgee {
+
+FastqBatch::FastqBatch(string data) :
+  m_buffer {},
+  m_records {}
+{
+  auto buffer = make_shared<string>(move(data));   // the records point into it from now on: it doesn't move anymore
+  auto parser = FastqParser{&(*buffer)[0], buffer->size()};
+  for (auto record = FastqView{}; parser.next(record); )
+    m_records.push_back(record);
+  m_buffer = move(buffer);
+}
+
+}  // end namespace gamgee
@@ -0,0 +1,53 @@
+#ifndef gamgee__fastq_batch__guard
+#define gamgee__fastq_batch__guard
+
+#include "fastq_view.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gamgee {
+
+/**
+ * @brief a batch of consecutive FastA or FastQ records (e.g. a chunk of a file parsed by the FastqBatchReader)
+ *
+ * The batch owns a single buffer with the text of its records, and the records are FastqViews into it: parsing a
+ * batch doesn't copy the records, and doesn't allocate anything per record. Copies of a batch share the buffer,
+ * so the records of a batch (and of its copies) are valid as long as any of them is alive. Use
+ * FastqView::to_fastq() to keep a record independently of its batch.
+ */
+class FastqBatch {
+ public:
+  using const_iterator = std::vector<FastqView>::const_iterator;
+  using iterator = const_iterator;   ///< the records are read-only
+
+  /** @brief creates an empty batch */
+  FastqBatch() : m_buffer {}, m_records {} {}
+
+  /**
+   * @brief parses all the records of a buffer (e.g. a chunk of a FastA/FastQ file with complete records)
+   * @param data the records in FastA or FastQ format, which become the buffer of the batch
+   */
+  explicit FastqBatch(std::string data);
+
+  FastqBatch(const FastqBatch&) = default;
+  FastqBatch& operator=(const FastqBatch&) = default;
+  FastqBatch(FastqBatch&&) = default;
+  FastqBatch& operator=(FastqBatch&&) = default;
+
+  std::size_t size() const { return m_records.size(); }                                      ///< @brief number of records in the batch
+  bool empty() const { return m_records.empty(); }                                           ///< @brief whether or not the batch has no records
+  const FastqView& operator[](const std::size_t index) const { return m_records[index]; }    ///< @brief the index-th record of the batch (not bounds checked)
+  const_iterator begin() const { return m_records.begin(); }
+  const_iterator end() const { return m_records.end(); }
+
+ private:
+  std::shared_ptr<const std::string> m_buffer;  ///< the text of the records (shared by the copies of the batch)
+  std::vector<FastqView> m_records;             ///< views of the records in m_buffer, in input order
+};
+
+}  // end namespace gamgee
+
+#endif // gamgee__fastq_batch__guard
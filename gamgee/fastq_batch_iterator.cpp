@@ -0,0 +1,165 @@
+#include "fastq_batch_iterator.h"
+
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace gamgee {
+
+/**
+ * @brief whether the line at start is the header of a FastQ record: it starts with '@' and the line after its
+ * sequence starts with '+' (a quality line starting with '@' is followed by a header and a sequence instead)
+ */
+static bool is_fastq_record_start(const string_view chunk, const size_t start) {
+  const auto header_end = chunk.find('\n', start);
+  if (header_end == string_view::npos)
+    return false;
+  const auto sequence_end = chunk.find('\n', header_end + 1);
+  return sequence_end != string_view::npos && sequence_end + 1 < chunk.size() && chunk[sequence_end + 1] == '+';
+}
+
+/**
+ * @brief the start of the last record of a chunk that can be told apart from the rest of the chunk (0 if there
+ * is none after the first byte)
+ */
+static size_t last_record_start(const string_view chunk, const bool is_fastq) {
+  const auto pattern = is_fastq ? string_view{"\n@"} : string_view{"\n>"};
+  for (auto newline = chunk.rfind(pattern); newline != string_view::npos; newline = chunk.rfind(pattern, newline - 1)) {
+    if (!is_fastq || is_fastq_record_start(chunk, newline + 1))
+      return newline + 1;
+    if (newline == 0)
+      break;
+  }
+  return 0;
+}
+
+/**
+ * @brief the input, the chunks being parsed (in input order) and the threads parsing them
+ */
+struct FastqBatchIterator::State {
+  State(const shared_ptr<utils::BlockReader>& input, const uint32_t num_threads, const size_t chunk_size) :
+    input {input},
+    chunk_size {max(chunk_size, size_t{1})},
+    carry {},
+    end_of_input {false},
+    format_known {false},
+    is_fastq {false},
+    batch {},
+    pending {},
+    max_pending {2 * size_t{max(num_threads, 1u)}},
+    pool {num_threads}
+  {}
+
+  /**
+   * @brief reads chunks and queues them for parsing until enough of them are in flight
+   */
+  void queue_chunks() {
+    for (auto chunk = string{}; pending.size() < max_pending && read_chunk(chunk); )
+      pending.push_back(pool.submit([chunk = move(chunk)]() mutable { return FastqBatch{move(chunk)}; }));
+  }
+
+  /**
+   * @brief reads the next chunk: the records left over from the previous chunk, and at least chunk_size more bytes
+   * up to the start of the last record in them
+   * @return false if there is no input left
+   */
+  bool read_chunk(string& chunk) {
+    if (end_of_input && carry.empty())
+      return false;
+    chunk = move(carry);
+    carry = string{};
+    for (auto bytes_wanted = chunk_size; ; bytes_wanted = max(chunk_size, chunk.size())) {  // grows geometrically if records are large
+      if (!end_of_input) {
+        const auto offset = chunk.size();
+        chunk.resize(offset + bytes_wanted);
+        const auto bytes_read = input->read(&chunk[offset], bytes_wanted);
+        chunk.resize(offset + bytes_read);
+        end_of_input = bytes_read != bytes_wanted;
+      }
+      if (!format_known && !chunk.empty()) {
+        is_fastq = chunk.front() == '@';   // the same rule as the FastqParser
+        format_known = true;
+      }
+      if (end_of_input)
+        return !chunk.empty();
+      const auto start = last_record_start(chunk, is_fastq);
+      if (start != 0) {
+        carry.assign(chunk, start, string::npos);
+        chunk.resize(start);
+        return true;
+      }
+    }
+  }
+
+  shared_ptr<utils::BlockReader> input;   ///< the input being parsed
+  size_t chunk_size;                      ///< bytes of input per chunk
+  string carry;                           ///< the records at the end of the last chunk read (they go in the next one)
+  bool end_of_input;                      ///< whether or not the input has been read to the end
+  bool format_known;                      ///< whether or not the first character of the input has been looked at
+  bool is_fastq;                          ///< whether we are parsing fastq's or fasta's
+  FastqBatch batch;                       ///< the current batch
+  deque<future<FastqBatch>> pending;      ///< the chunks being parsed, in input order
+  size_t max_pending;                     ///< number of chunks parsed ahead of the current batch
+  utils::ThreadPool pool;                 ///< the threads parsing the chunks (destroyed first, so the chunks being parsed are finished)
+};
+
+FastqBatchIterator::FastqBatchIterator() :
+  m_state {},
+  m_end {}
+{}
+
+FastqBatchIterator::FastqBatchIterator(const shared_ptr<utils::BlockReader>& input, const uint32_t num_threads, const size_t chunk_size) :
+  m_state {input ? make_unique<State>(input, num_threads, chunk_size) : nullptr},
+  m_end {}
+{
+  if (m_state)
+    next_batch();
+}
+
+FastqBatchIterator::FastqBatchIterator(FastqBatchIterator&&) = default;
+FastqBatchIterator& FastqBatchIterator::operator=(FastqBatchIterator&&) = default;
+FastqBatchIterator::~FastqBatchIterator() = default;
+
+FastqBatch& FastqBatchIterator::operator*() {
+  return m_state ? m_state->batch : m_end;
+}
+
+FastqBatch& FastqBatchIterator::operator++() {
+  if (m_state)
+    next_batch();
+  return operator*();
+}
+
+bool FastqBatchIterator::operator==(const FastqBatchIterator& rhs) const {
+  return m_state == rhs.m_state;
+}
+
+bool FastqBatchIterator::operator!=(const FastqBatchIterator& rhs) const {
+  return !operator==(rhs);
+}
+
+/**
+ * @brief waits for the next non-empty batch, keeping the pool busy with the chunks after it
+ */
+void FastqBatchIterator::next_batch() {
+  auto& state = *m_state;
+  do {
+    state.queue_chunks();
+    if (state.pending.empty()) {
+      m_state.reset();
+      return;
+    }
+    auto next = move(state.pending.front());
+    state.pending.pop_front();
+    state.queue_chunks();
+    state.batch = next.get();
+  } while (state.batch.empty());
+}
+
+}  // end namespace gamgee
@@ -0,0 +1,89 @@
+#ifndef gamgee__fastq_batch_iterator__guard
+#define gamgee__fastq_batch_iterator__guard
+
+#include "fastq_batch.h"
+#include "utils/block_reader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace gamgee {
+
+/**
+ * @brief Utility class to enable for-each style iteration in the FastqBatchReader class
+ *
+ * The input is read in chunks of about chunk_size bytes, each one cut at the start of the last record it has (the
+ * rest of the record goes to the next chunk). Chunks are parsed into FastqBatches by a pool of threads and come out
+ * in input order, while the following chunks are being parsed. Each chunk becomes the buffer of its batch, the
+ * records are views into it (see FastqBatch): copy (or move) a batch to keep it after the iterator moves on.
+ *
+ * Record starts are found by looking at the end of the chunk for a line starting with '>' (FastA) or for a line
+ * starting with '@' followed, two lines down, by a line starting with '+' (FastQ). FastA records can span any
+ * number of lines, but FastQ records must have their sequence and qualities on a single line each (as every
+ * sequencer writes them): multi-line FastQ should be read with the FastqReader.
+ */
+class FastqBatchIterator {
+ public:
+  static constexpr std::size_t default_chunk_size = 4 << 20;   ///< bytes of input per batch
+
+  /**
+    * @brief creates an empty iterator (used for the end() method)
+    */
+  FastqBatchIterator();
+
+  /**
+    * @brief initializes a new iterator based on an input
+    *
+    * @param input the (decompressed) input
+    * @param num_threads number of threads parsing chunks
+    * @param chunk_size bytes of input per batch (chunks are larger if a record doesn't fit)
+    */
+  FastqBatchIterator(const std::shared_ptr<utils::BlockReader>& input, const uint32_t num_threads, const std::size_t chunk_size = default_chunk_size);
+
+  /**
+    * @brief a FastqBatchIterator should never be copied as the underlying input can only be
+    * manipulated by one object.
+    */
+  FastqBatchIterator(const FastqBatchIterator&) = delete;
+  FastqBatchIterator& operator=(const FastqBatchIterator&) = delete;
+
+  /**
+    * @brief a FastqBatchIterator move constructor guarantees all objects will have the same state.
+    */
+  FastqBatchIterator(FastqBatchIterator&&);
+  FastqBatchIterator& operator=(FastqBatchIterator&&);
+
+  /**
+    * @brief waits for the chunks being parsed before destroying the iterator
+    */
+  ~FastqBatchIterator();
+
+  bool operator==(const FastqBatchIterator& rhs) const;  ///< @brief whether or not the two iterators are the same (both at the end, or the same iteration)
+  bool operator!=(const FastqBatchIterator& rhs) const;  ///< @brief inequality operator (needed by for-each loop)
+
+  /**
+    * @brief dereference operator (needed by for-each loop)
+    *
+    * @return a reference to the current batch
+    */
+  FastqBatch& operator*();
+
+  /**
+    * @brief increment operator (needed by for-each loop)
+    *
+    * @return the next batch (an empty batch at the end of the input)
+    */
+  FastqBatch& operator++();
+
+ private:
+  struct State;
+  std::unique_ptr<State> m_state;   ///< input, chunks being parsed and threads (null at the end of the input)
+  FastqBatch m_end;                 ///< what the iterator points to at the end of the input
+
+  void next_batch();
+};
+
+}  // end namespace gamgee
+
+#endif // gamgee__fastq_batch_iterator__guard
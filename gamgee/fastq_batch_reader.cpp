@@ -0,0 +1,35 @@
+#include "fastq_batch_reader.h"
+
+#include "exceptions.h"
+#include "utils/file_utils.h"
+
+using namespace std;
+
+namespace gamgee {
+
+FastqBatchReader::FastqBatchReader(const string& filename, const uint32_t num_threads, const size_t chunk_size) :
+  m_input {},
+  m_num_threads {num_threads},
+  m_chunk_size {chunk_size}
+{
+  auto input_stream = utils::make_shared_ifstream(filename);
+  if (input_stream->fail())
+    throw FileOpenException{filename};
+  m_input = utils::make_block_reader(input_stream, num_threads);
+}
+
+FastqBatchReader::FastqBatchReader(istream* const input, const uint32_t num_threads, const size_t chunk_size) :
+  m_input {utils::make_block_reader(shared_ptr<istream>(input), num_threads)},
+  m_num_threads {num_threads},
+  m_chunk_size {chunk_size}
+{}
+
+FastqBatchIterator FastqBatchReader::begin() {
+  return FastqBatchIterator{m_input, m_num_threads, m_chunk_size};
+}
+
+FastqBatchIterator FastqBatchReader::end() {
+  return FastqBatchIterator{};
+}
+
+}  // end of namespace
@@ -0,0 +1,88 @@
+#ifndef gamgee__fastq_batch_reader__guard
+#define gamgee__fastq_batch_reader__guard
+
+#include "fastq_batch_iterator.h"
+#include "utils/block_reader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace gamgee {
+
+/**
+ * @brief Utility class to read FastA/FastQ records in batches parsed by several threads
+ *
+ * The input is cut in chunks at record boundaries and the chunks are parsed in parallel (see FastqBatchIterator).
+ * Batches come out in input order, so this is a drop-in replacement for the FastqReader in pipelines that process
+ * records in bulk:
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * for (auto& batch : FastqBatchReader{filename, 8})
+ *   for (auto& record : batch)
+ *     do_something_with_fastq(record);
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * BGZF compressed input is decompressed in parallel before being cut in chunks, gzip input on a background thread
+ * (see utils::GzipBlockReader).
+ */
+class FastqBatchReader {
+ public:
+
+  /**
+    * @brief reads through all records in a file (fasta or fastq) parsing them into batches
+    *
+    * @param filename the name of the fasta/fastq file (optionally gzip or BGZF compressed)
+    * @param num_threads number of threads parsing the chunks (and decompressing BGZF input)
+    * @param chunk_size bytes of input per batch
+    */
+  explicit FastqBatchReader(const std::string& filename, const uint32_t num_threads = std::thread::hardware_concurrency(), const std::size_t chunk_size = FastqBatchIterator::default_chunk_size);
+
+  /**
+    * @brief reads through all records in a stream (e.g. stdin) parsing them into batches
+    *
+    * @param input a reference to the input stream (owned by the reader from now on)
+    * @param num_threads number of threads parsing the chunks (and decompressing BGZF input)
+    * @param chunk_size bytes of input per batch
+    */
+  explicit FastqBatchReader(std::istream* const input, const uint32_t num_threads = std::thread::hardware_concurrency(), const std::size_t chunk_size = FastqBatchIterator::default_chunk_size);
+
+  /**
+    * @brief move constructor for the FastqBatchReader class simply transfers all objects with the state
+    * maintained.
+    */
+  FastqBatchReader(FastqBatchReader&&) = default;
+  FastqBatchReader& operator=(FastqBatchReader&&) = default;
+
+  /**
+    * @brief a FastqBatchReader cannot be copied safely, as it is iterating over a stream.
+    */
+  FastqBatchReader(const FastqBatchReader&) = delete;
+  FastqBatchReader& operator=(const FastqBatchReader&) = delete;
+
+  /**
+    * @brief creates a FastqBatchIterator pointing at the start of the input (needed by for-each loop)
+    *
+    * @return a FastqBatchIterator ready to start parsing the file
+    */
+  FastqBatchIterator begin();
+
+  /**
+    * @brief creates a FastqBatchIterator with no input (needed by for-each loop)
+    *
+    * @return a FastqBatchIterator that will match the end status of the iterator at the end of the input
+    */
+  FastqBatchIterator end();
+
+ private:
+  std::shared_ptr<utils::BlockReader> m_input;  ///< the (decompressed) input stream
+  uint32_t m_num_threads;                       ///< number of threads parsing the chunks
+  std::size_t m_chunk_size;                     ///< bytes of input per batch
+};
+
+}  // end of namespace
+
+#endif // gamgee__fastq_batch_reader__guard
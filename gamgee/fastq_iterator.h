@@ -2,6 +2,7 @@
 #define gamgee__fastq_iterator__guard
 
 #include "fastq.h"
+#include "fastq_parser.h"
 
 #include <memory>
 #include <istream>
@@ -10,6 +11,9 @@ namespace gamgee {
 
 /**
  * @brief Utility class to enable for-each style iteration in the FastqReader class
+ *
+ * Records are parsed by a FastqParser into the iterator's record, which is reused from one record to the next
+ * (copy it if you need to keep it).
  */
 class FastqIterator {
  public:
@@ -26,6 +30,13 @@ class FastqIterator {
     */
   explicit FastqIterator(std::shared_ptr<std::istream>& in);
 
+  /**
+    * @brief initializes a new iterator based on a block reader (e.g. decompressing a gzipped fastq file)
+    *
+    * @param in the input
+    */
+  explicit FastqIterator(const std::shared_ptr<utils::BlockReader>& in);
+
   /**
     * @brief a FastqIterator should never be copied as the underlying stream can only be
     * manipulated by one object.
@@ -74,18 +85,10 @@ class FastqIterator {
   Fastq& operator++();
   
  private:
-  std::shared_ptr<std::istream> m_input_stream;         ///< a pointer to the input stream
-  Fastq m_element;              ///< the current parsed fastq/fasta element
-  bool m_is_fastq;              ///< whether we are parsing fastq's or fasta's from the input stream
-  char m_eos_delim;             ///< delimits the end of the sequence field in the fastq/fasta file
-  char m_bor_delim;             ///< delimits the beginning of the record in the fastq/fasta file
-  
-  Fastq fetch_next_element();
-  std::string parse_comment();
-  std::string parse_seq();
-  std::string parse_quals(uint32_t seq_length);
-  const std::string parse_multiline();
-  void skip_new_lines();
+  std::unique_ptr<FastqParser> m_parser;  ///< the parser of the input stream (null at the end of the stream)
+  Fastq m_element;                        ///< the current parsed fastq/fasta element
+
+  void fetch_next_element();
 };
 
 }  // end namespace gamgee
@@ -0,0 +1,353 @@
+#include "fastq_parser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace gamgee {
+
+/**
+ * @brief the characters std::isspace matches in the C locale (the ones operator>> stops at)
+ */
+static inline bool is_space(const char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/**
+ * @brief the first whitespace character between begin and end (or end if there is none)
+ */
+static const char* find_whitespace(const char* begin, const char* end) {
+#if defined(__SSE2__)
+  // every whitespace character is at most ' ', so only those bytes are checked one at a time
+  const auto space = _mm_set1_epi8(' ');
+  for (; end - begin >= 16; begin += 16) {
+    const auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    auto candidates = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(chars, space), chars)));
+    for (; candidates != 0; candidates &= candidates - 1) {
+      const auto candidate = begin + __builtin_ctz(candidates);
+      if (is_space(*candidate))
+        return candidate;
+    }
+  }
+#endif
+  while (begin != end && !is_space(*begin))
+    ++begin;
+  return begin;
+}
+
+/**
+ * @brief appends the characters between begin and end that are not whitespace (the tokens operator>> would read)
+ */
+static void append_without_whitespace(string& destination, const char* begin, const char* end) {
+  while (begin != end) {
+    const auto space = find_whitespace(begin, end);
+    destination.append(begin, space);
+    begin = space == end ? end : space + 1;
+  }
+}
+
+/**
+ * @brief the fields of a record parsed into the strings of a Fastq
+ */
+class StringFields {
+ public:
+  StringFields(string& name, string& comment, string& sequence, string& quals) :
+    m_name {name}, m_comment {comment}, m_sequence {sequence}, m_quals {quals}
+  {
+    m_name.clear();
+    m_comment.clear();
+    m_sequence.clear();
+    m_quals.clear();
+  }
+
+  void set_header(const char* name, const char* name_end, const char* comment, const char* comment_end) {
+    m_name.assign(name, name_end);
+    m_comment.assign(comment, comment_end);
+  }
+  void append_sequence(const char* begin, const char* end) { append_without_whitespace(m_sequence, begin, end); }
+  void append_quals(const char* begin, const char* end) { m_quals.append(begin, end); }
+  size_t sequence_size() const { return m_sequence.size(); }
+  size_t quals_size() const { return m_quals.size(); }
+  bool empty() const { return m_name.empty(); }
+
+ private:
+  string& m_name;
+  string& m_comment;
+  string& m_sequence;
+  string& m_quals;
+};
+
+/**
+ * @brief the fields of a record parsed as views into the buffer being parsed
+ *
+ * Single line fields are used where they are. The other lines of multi-line fields are moved back to follow the
+ * first one, over the line breaks: the data written never goes past the data being parsed, and the parser never
+ * reads the data behind its position again.
+ */
+class ViewFields {
+ public:
+  explicit ViewFields(char* data) :
+    m_data {data}, m_name {}, m_comment {}, m_sequence {}, m_quals {}
+  {}
+
+  void set_header(const char* name, const char* name_end, const char* comment, const char* comment_end) {
+    m_name = string_view{name, size_t(name_end - name)};
+    m_comment = string_view{comment, size_t(comment_end - comment)};
+  }
+  void append_sequence(const char* begin, const char* end) {
+    while (begin != end) {
+      const auto space = find_whitespace(begin, end);
+      append(m_sequence, begin, space);
+      begin = space == end ? end : space + 1;
+    }
+  }
+  void append_quals(const char* begin, const char* end) { append(m_quals, begin, end); }
+  size_t sequence_size() const { return m_sequence.size(); }
+  size_t quals_size() const { return m_quals.size(); }
+  bool empty() const { return m_name.empty(); }
+  FastqView view() const { return FastqView{m_name, m_comment, m_sequence, m_quals}; }
+
+ private:
+  char* m_data;            ///< the (writable) buffer being parsed
+  string_view m_name;
+  string_view m_comment;
+  string_view m_sequence;
+  string_view m_quals;
+
+  void append(string_view& field, const char* begin, const char* end) {
+    if (begin == end)
+      return;
+    if (field.empty()) {
+      field = string_view{begin, size_t(end - begin)};
+      return;
+    }
+    const auto destination = m_data + (field.data() + field.size() - m_data);
+    if (destination != begin)
+      memmove(destination, begin, size_t(end - begin));
+    field = string_view{field.data(), field.size() + size_t(end - begin)};
+  }
+};
+
+FastqParser::FastqParser(shared_ptr<utils::BlockReader> input, const size_t block_size) :
+  m_input {move(input)},
+  m_buffer {new char[max(block_size, size_t{1})]},
+  m_data {m_buffer.get()},
+  m_in_place_data {nullptr},
+  m_capacity {max(block_size, size_t{1})},
+  m_position {0},
+  m_end {0},
+  m_end_of_input {false},
+  m_format_known {false},
+  m_is_fastq {false},
+  m_eos_delim {'>'},
+  m_bor_delim {'>'}
+{}
+
+FastqParser::FastqParser(char* data, const size_t size) :
+  m_input {},
+  m_buffer {},
+  m_data {data},
+  m_in_place_data {data},
+  m_capacity {size},
+  m_position {0},
+  m_end {size},
+  m_end_of_input {true},
+  m_format_known {false},
+  m_is_fastq {false},
+  m_eos_delim {'>'},
+  m_bor_delim {'>'}
+{}
+
+FastqParser::FastqParser(shared_ptr<istream> input, const size_t block_size) :
+  FastqParser {shared_ptr<utils::BlockReader>{utils::make_block_reader(move(input))}, block_size}
+{}
+
+bool FastqParser::next(Fastq& record) {
+  auto fields = StringFields{record.m_name, record.m_comment, record.m_sequence, record.m_quals};
+  if (!m_format_known && !detect_format())
+    return false;
+  auto stage = Stage::header;
+  while (!parse(fields, stage))
+    fill();
+  return !fields.empty();  // names are never empty: the header stage only finds none at the end of the input
+}
+
+bool FastqParser::next(FastqView& record) {
+  if (m_in_place_data == nullptr)
+    throw logic_error{"only the records of a buffer can be parsed as views"};
+  record = FastqView{};
+  if (!m_format_known && !detect_format())
+    return false;
+  auto fields = ViewFields{m_in_place_data};
+  auto stage = Stage::header;
+  parse(fields, stage);   // the whole buffer is there: the record is always complete
+  record = fields.view();
+  return !fields.empty();
+}
+
+/**
+ * @brief reads the next block from the input, keeping the data that hasn't been parsed yet
+ * @return false if there was nothing left to read
+ */
+bool FastqParser::fill() {
+  if (m_end_of_input)
+    return false;
+  if (m_position != 0) {
+    memmove(m_buffer.get(), m_buffer.get() + m_position, m_end - m_position);
+    m_end -= m_position;
+    m_position = 0;
+  }
+  if (m_end == m_capacity) {  // a line longer than the buffer
+    auto larger = unique_ptr<char[]>{new char[2 * m_capacity]};
+    memcpy(larger.get(), m_buffer.get(), m_end);
+    m_buffer = move(larger);
+    m_data = m_buffer.get();
+    m_capacity *= 2;
+  }
+  const auto bytes_read = m_input->read(m_buffer.get() + m_end, m_capacity - m_end);
+  if (bytes_read != m_capacity - m_end)
+    m_end_of_input = true;
+  m_end += bytes_read;
+  return bytes_read != 0;
+}
+
+/**
+ * @brief consumes the first character of the input, which decides whether we are parsing FastQ or FastA
+ * @return false if the input is empty
+ */
+bool FastqParser::detect_format() {
+  while (m_position == m_end && fill()) {}
+  if (m_position == m_end)
+    return false;
+  m_is_fastq = m_data[m_position++] == '@';
+  m_bor_delim = m_is_fastq ? '@' : '>';
+  m_eos_delim = m_is_fastq ? '+' : '>';
+  m_format_known = true;
+  return true;
+}
+
+/**
+ * @brief parses the buffered data, from the stage the record is in
+ * @return false if the data ran out before the end of the record (stage tells where to resume after fill())
+ */
+template<class FIELDS>
+bool FastqParser::parse(FIELDS& fields, Stage& stage) {
+  switch (stage) {
+    case Stage::header:
+      if (!parse_header(fields))
+        return false;
+      stage = Stage::sequence;
+      [[fallthrough]];
+    case Stage::sequence:
+      if (!parse_sequence(fields))
+        return false;
+      stage = Stage::separator;
+      [[fallthrough]];
+    case Stage::separator:
+      if (m_is_fastq && !skip_past('\n'))  // the line with the second record name
+        return false;
+      stage = Stage::quals;
+      [[fallthrough]];
+    case Stage::quals:
+      if (m_is_fastq && !parse_quals(fields))
+        return false;
+      stage = Stage::next_record;
+      [[fallthrough]];
+    case Stage::next_record:
+      return skip_past(m_bor_delim);  // skip everything (even if the record is malformed and has extra quals) until the next record
+  }
+  return true;
+}
+
+template<class FIELDS>
+bool FastqParser::parse_header(FIELDS& fields) {
+  while (m_position != m_end && is_space(m_data[m_position]))
+    ++m_position;
+  if (m_position == m_end)
+    return m_end_of_input;
+  const auto end = line_end();
+  if (end == nullptr)
+    return false;
+  const char* begin = m_data + m_position;
+  const auto name_end = find_whitespace(begin, end);
+  auto comment = name_end;
+  while (comment != end && *comment == ' ')
+    ++comment;
+  fields.set_header(begin, name_end, comment, end);
+  m_position = min(size_t(end - m_data) + 1, m_end);
+  return true;
+}
+
+template<class FIELDS>
+bool FastqParser::parse_sequence(FIELDS& fields) {
+  while (m_position != m_end && m_data[m_position] != m_eos_delim) {
+    const auto end = line_end();
+    if (end == nullptr)
+      return false;
+    fields.append_sequence(m_data + m_position, end);
+    m_position = min(size_t(end - m_data) + 1, m_end);
+  }
+  return m_position != m_end || m_end_of_input;
+}
+
+template<class FIELDS>
+bool FastqParser::parse_quals(FIELDS& fields) {
+  const auto num_bases = fields.sequence_size();
+  while (fields.quals_size() < num_bases) {
+    if (m_position == m_end)
+      return m_end_of_input;
+    const auto end = line_end();
+    if (end == nullptr)
+      return false;
+    for (const char* token = m_data + m_position; ; ) {  // token by token: the record ends as soon as it has enough qualities
+      while (token != end && is_space(*token))
+        ++token;
+      if (token == end)
+        break;
+      const auto token_end = find_whitespace(token, end);
+      fields.append_quals(token, token_end);
+      if (fields.quals_size() >= num_bases) {
+        m_position = size_t(token_end - m_data);
+        return true;
+      }
+      token = token_end;
+    }
+    m_position = min(size_t(end - m_data) + 1, m_end);
+  }
+  return true;
+}
+
+/**
+ * @brief consumes the buffered data up to and including the next occurrence of delimiter
+ * @return false if the delimiter wasn't found and there is more data to read
+ */
+bool FastqParser::skip_past(const char delimiter) {
+  const auto found = static_cast<const char*>(memchr(m_data + m_position, delimiter, m_end - m_position));
+  if (found == nullptr) {
+    m_position = m_end;
+    return m_end_of_input;
+  }
+  m_position = size_t(found - m_data) + 1;
+  return true;
+}
+
+/**
+ * @brief the end of the line starting at the current position: its newline, the end of the data if there is
+ * nothing left to read or nullptr if the rest of the line hasn't been read yet
+ */
+const char* FastqParser::line_end() {
+  const auto begin = m_data + m_position;
+  const auto newline = static_cast<const char*>(memchr(begin, '\n', m_end - m_position));
+  if (newline != nullptr)
+    return newline;
+  return m_end_of_input ? m_data + m_end : nullptr;
+}
+
+}  // end namespace gamgee
@@ -0,0 +1,116 @@
+#ifndef gamgee__fastq_parser__guard
+#define gamgee__fastq_parser__guard
+
+#include "fastq.h"
+#include "fastq_view.h"
+#include "utils/block_reader.h"
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+
+namespace gamgee {
+
+/**
+ * @brief Block-buffered parser of FastA and FastQ records (the engine behind FastqIterator)
+ *
+ * Reads the input in large blocks and finds lines, record delimiters and whitespace with memchr and vectorized
+ * scans instead of one stream operation per character or token. Parsing follows the semantics the stream based
+ * iterator always had:
+ *
+ *   - the first character of the input decides the format: '@' is FastQ, anything else is FastA
+ *   - the name is the first whitespace delimited token of the header line, the comment is the rest of the line
+ *     (leading spaces removed)
+ *   - sequences span any number of lines (whitespace is removed) until a line starts with '+' (FastQ) or '>'
+ *     (FastA)
+ *   - qualities span as many lines as necessary to get as many qualities as bases, so they can start with '@'
+ *   - anything after that (e.g. extra qualities in a malformed record) is skipped until the next record delimiter
+ *
+ * The input comes from a utils::BlockReader, so gzip and BGZF compressed input is decompressed by background
+ * threads while the records are parsed (see utils::make_block_reader()).
+ *
+ * Records are parsed into an existing Fastq object, reusing the memory of its strings, so the steady state of a
+ * loop over a file doesn't allocate. Records of a buffer in memory can also be parsed as views into the buffer,
+ * without copying them at all. Only the line being parsed needs to fit in a block; the buffer grows for
+ * longer lines (e.g. unwrapped chromosomes).
+ */
+class FastqParser {
+ public:
+  static constexpr std::size_t default_block_size = 1 << 20;   ///< bytes read from the input at a time
+
+  /**
+   * @brief creates a parser reading from a block reader
+   * @param input the (decompressed) input to parse
+   * @param block_size number of bytes to read from the input at a time
+   */
+  explicit FastqParser(std::shared_ptr<utils::BlockReader> input, const std::size_t block_size = default_block_size);
+
+  /**
+   * @brief creates a parser reading from an input stream (e.g. fastq/a file, stdin, ...), decompressing it if it
+   * is gzip or BGZF compressed
+   * @param input the stream to parse
+   * @param block_size number of bytes to read from the stream at a time
+   */
+  explicit FastqParser(std::shared_ptr<std::istream> input, const std::size_t block_size = default_block_size);
+
+  /**
+   * @brief creates a parser of the records in a buffer (e.g. a chunk of a file with complete records)
+   * @param data the records (not copied: they must outlive the parser). Parsing views rearranges the bytes of
+   * the records in place (see next(FastqView&)).
+   * @param size number of bytes in data
+   */
+  FastqParser(char* data, const std::size_t size);
+
+  FastqParser(const FastqParser&) = delete;
+  FastqParser& operator=(const FastqParser&) = delete;
+  FastqParser(FastqParser&&) = default;
+  FastqParser& operator=(FastqParser&&) = default;
+
+  /**
+   * @brief parses the next record of the input
+   * @param record where the record goes (its previous contents are replaced)
+   * @return false if there are no more records in the input (record is left empty)
+   */
+  bool next(Fastq& record);
+
+  /**
+   * @brief parses the next record of a buffer without copying it: the fields of the record point into the buffer
+   *
+   * Fields that span several lines (or have whitespace in them) are joined in place, overwriting the line breaks
+   * of the record, so the buffer can't be parsed again afterwards. Only for parsers of a buffer.
+   *
+   * @param record where the view of the record goes
+   * @return false if there are no more records in the buffer (record is left empty)
+   * @throw std::logic_error if the parser reads from an input instead of a buffer
+   */
+  bool next(FastqView& record);
+
+ private:
+  enum class Stage { header, sequence, separator, quals, next_record };
+
+  std::shared_ptr<utils::BlockReader> m_input;  ///< the input being parsed
+  std::unique_ptr<char[]> m_buffer;             ///< the block being parsed (and the incomplete line of the previous block)
+  const char* m_data;                           ///< the data being parsed: m_buffer, or the buffer given to the parser
+  char* m_in_place_data;                        ///< the buffer given to the parser (null when reading from an input)
+  std::size_t m_capacity;                       ///< size of m_buffer
+  std::size_t m_position;                       ///< the first byte of m_data that hasn't been parsed
+  std::size_t m_end;                            ///< the end of the data in m_data
+  bool m_end_of_input;                          ///< whether or not the input has been read to the end
+  bool m_format_known;                          ///< whether or not the first character of the input has been looked at
+  bool m_is_fastq;                              ///< whether we are parsing fastq's or fasta's from the input stream
+  char m_eos_delim;                             ///< delimits the end of the sequence field in the fastq/fasta file
+  char m_bor_delim;                             ///< delimits the beginning of the record in the fastq/fasta file
+
+  bool fill();
+  bool detect_format();
+  template<class FIELDS> bool parse(FIELDS& fields, Stage& stage);
+  template<class FIELDS> bool parse_header(FIELDS& fields);
+  template<class FIELDS> bool parse_sequence(FIELDS& fields);
+  template<class FIELDS> bool parse_quals(FIELDS& fields);
+  bool skip_past(const char delimiter);
+  const char* line_end();
+};
+
+}  // end namespace gamgee
+
+#endif // gamgee__fastq_parser__guard
@@ -14,41 +14,42 @@ using namespace std;
 
 namespace gamgee {
 
-FastqReader::FastqReader(const std::string& filename) :
-  m_input_stream {}
+FastqReader::FastqReader(const std::string& filename, const uint32_t num_threads) :
+  m_input {}
 {
   if (!filename.empty()) {
-    init_reader(filename);
+    init_reader(filename, num_threads);
   }
 }
 
-FastqReader::FastqReader(const std::vector<std::string>& filenames) :
-  m_input_stream {}
+FastqReader::FastqReader(const std::vector<std::string>& filenames, const uint32_t num_threads) :
+  m_input {}
 {
   if (filenames.size() > 1)
     throw SingleInputException{"filenames", filenames.size()};
   if (!filenames.empty()) {
-    init_reader(filenames.front());
+    init_reader(filenames.front(), num_threads);
   }
 }
 
-FastqReader::FastqReader(std::istream* const input) : 
-  m_input_stream{shared_ptr<std::istream>(input)}
+FastqReader::FastqReader(std::istream* const input, const uint32_t num_threads) :
+  m_input {utils::make_block_reader(shared_ptr<std::istream>(input), num_threads)}
 {}
 
 FastqIterator FastqReader::begin() {
-  return FastqIterator{m_input_stream};
+  return FastqIterator{m_input};
 }
 
 FastqIterator FastqReader::end() {
   return FastqIterator{};
 }
 
-void FastqReader::init_reader(const std::string& filename) {
-  m_input_stream = utils::make_shared_ifstream(filename);
-  if ( m_input_stream->fail() ) {
+void FastqReader::init_reader(const std::string& filename, const uint32_t num_threads) {
+  auto input_stream = utils::make_shared_ifstream(filename);
+  if ( input_stream->fail() ) {
     throw FileOpenException{filename};
   }
+  m_input = utils::make_block_reader(input_stream, num_threads);
 }
 
 
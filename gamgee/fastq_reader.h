@@ -2,6 +2,7 @@
 #define gamgee__fastq_reader__guard
 
 #include "fastq_iterator.h"
+#include "utils/block_reader.h"
 
 #include <string>
 #include <iostream>
@@ -30,6 +31,9 @@ namespace gamgee {
  *   do_something_with_fastq(record);
  * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
  *
+ * Gzip and BGZF compressed input (files or streams) is detected and decompressed on background threads, see
+ * utils::GzipBlockReader.
+ *
  * Although one could use it as an iterator, if your goal is to do so, you should use the FastqIterator
  * class
  */
@@ -40,25 +44,28 @@ class FastqReader {
     * @brief reads through all records in a file (fasta or fastq) parsing them into Fastq
     * objects
     *
-    * @param filename the name of the fasta/fastq file
+    * @param filename the name of the fasta/fastq file (optionally gzip or BGZF compressed)
+    * @param num_threads number of threads decompressing BGZF input
     */
-  explicit FastqReader(const std::string& filename);
+  explicit FastqReader(const std::string& filename, const uint32_t num_threads = 1);
 
   /**
     * @brief reads through all records in a file (fasta or fastq) parsing them into Fastq
     * objects
     *
     * @param filenames a vector containing a single element: the name of the fasta/fastq file
+    * @param num_threads number of threads decompressing BGZF input
     */
-  explicit FastqReader(const std::vector<std::string>& filenames);
+  explicit FastqReader(const std::vector<std::string>& filenames, const uint32_t num_threads = 1);
 
   /**
     * @brief reads through all records in a stream (e.g. stdin) parsing them into Fastq
     * objects
     *
     * @param input a reference to the input stream (e.g. &std::cin)
+    * @param num_threads number of threads decompressing BGZF input
     */
-  explicit FastqReader(std::istream* const input);
+  explicit FastqReader(std::istream* const input, const uint32_t num_threads = 1);
 
   /**
     * @brief move constructor for the FastqReader class simply transfers all objects with the state
@@ -89,9 +96,9 @@ class FastqReader {
   FastqIterator end();
 
 private:
-  std::shared_ptr<std::istream> m_input_stream; ///< a pointer to the input stream
+  std::shared_ptr<utils::BlockReader> m_input; ///< the (decompressed) input stream
 
-  void init_reader(const std::string& filename);
+  void init_reader(const std::string& filename, const uint32_t num_threads);
 };
 
 }  // end of namespace
@@ -0,0 +1,84 @@
+#ifndef gamgee__fastq_view__guard
+#define gamgee__fastq_view__guard
+
+#include "fastq.h"
+
+#include <string>
+#include <string_view>
+
+namespace gamgee {
+
+/**
+ * @brief Read-only view of one FastA or FastQ record whose fields live somewhere else (e.g. in the buffer of a
+ * FastqBatch, or in a Fastq object)
+ *
+ * Views are as cheap to copy as four pointers and sizes. They are only valid as long as the memory they point to is
+ * alive and unmodified: copy the record with to_fastq() to keep it around.
+ */
+class FastqView {
+ public:
+
+  /** @brief creates an empty record */
+  FastqView() :
+      m_name {}, m_comment {}, m_sequence {}, m_quals {} {}
+
+  /** @brief creates a view of the given fields */
+  FastqView(const std::string_view name,      ///< sequence name
+            const std::string_view comment,   ///< optional comment
+            const std::string_view sequence,  ///< sequence bases
+            const std::string_view quals = {} ///< optional quality scores (leave it out for FastA)
+            ) :
+      m_name {name}, m_comment {comment}, m_sequence {sequence}, m_quals {quals}
+  {}
+
+  /** @brief creates a view of the fields of a record (valid until the record is modified or destroyed) */
+  FastqView(const Fastq& record) :
+      m_name {record.name()}, m_comment {record.comment()}, m_sequence {record.sequence()}, m_quals {record.quals()}
+  {}
+
+  FastqView(const FastqView&) = default;
+  FastqView& operator=(const FastqView&) = default;
+
+  /**
+    * @brief equality comparison of all fields in the record
+    *
+    * @return true only if every field is the same (string comparison)
+    */
+  bool operator==(const FastqView& other) const {
+      return m_name     == other.m_name     &&
+             m_comment  == other.m_comment  &&
+             m_sequence == other.m_sequence &&
+             m_quals    == other.m_quals;
+  }
+
+  /**
+    * @brief inequality comparison of all fields in the record
+    *
+    * @return true if any field differs (string comparison)
+    */
+  bool operator!=(const FastqView& other) const {
+      return !(*this == other);
+  }
+
+  std::string_view name() const     { return m_name;     }
+  std::string_view comment() const  { return m_comment;  }
+  std::string_view sequence() const { return m_sequence; }
+  std::string_view quals() const    { return m_quals;    }
+  bool is_fastq() const             { return !m_quals.empty(); } ///< @brief true if the record has a quals in it's qual field
+
+  /** @brief copies the record into a Fastq object that owns its fields */
+  Fastq to_fastq() const {
+    return Fastq{std::string{m_name}, std::string{m_comment}, std::string{m_sequence}, std::string{m_quals}};
+  }
+
+ private:
+
+  std::string_view m_name;     ///< sequence name
+  std::string_view m_comment;  ///< optional comment
+  std::string_view m_sequence; ///< sequence bases
+  std::string_view m_quals;    ///< optional quality scores
+};
+
+}  // end of namespace
+
+#endif // gamgee__fastq_view__guard
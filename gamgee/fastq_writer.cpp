@@ -0,0 +1,98 @@
+#include "fastq_writer.h"
+
+#include "exceptions.h"
+
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+namespace gamgee {
+
+static shared_ptr<ostream> open_output(const string& filename) {
+  if (filename == "-")
+    return shared_ptr<ostream>{&cout, [](ostream*){}};   // not ours to delete
+  auto output = make_shared<ofstream>(filename, ios::binary);
+  if (output->fail())
+    throw FileOpenException{filename};
+  return output;
+}
+
+FastqWriter::FastqWriter(const string& filename, const utils::Compression compression, const uint32_t num_threads) :
+  FastqWriter {open_output(filename), compression, num_threads}
+{}
+
+FastqWriter::FastqWriter(shared_ptr<ostream> output, const utils::Compression compression, const uint32_t num_threads) :
+  m_output {utils::make_block_writer(move(output), compression, num_threads)},
+  m_buffer {}
+{
+  m_buffer.reserve(block_size);
+}
+
+FastqWriter::~FastqWriter() {
+  try {
+    close();
+  }
+  catch (...) {}   // destructors can't throw
+}
+
+FastqWriter& FastqWriter::operator=(FastqWriter&& other) {
+  if (this != &other) {
+    close();
+    m_output = move(other.m_output);
+    m_buffer = move(other.m_buffer);
+  }
+  return *this;
+}
+
+void FastqWriter::add_record(const FastqView& record) {
+  const auto fastq = record.is_fastq();
+  m_buffer += fastq ? '@' : '>';
+  m_buffer += record.name();
+  if (!record.comment().empty()) {
+    m_buffer += ' ';
+    m_buffer += record.comment();
+  }
+  m_buffer += '\n';
+  m_buffer += record.sequence();
+  if (fastq) {
+    m_buffer += "\n+\n";
+    m_buffer += record.quals();
+  }
+  m_buffer += '\n';
+  if (m_buffer.size() >= block_size)
+    write_buffer();
+}
+
+void FastqWriter::add_batch(const FastqBatch& batch) {
+  for (const auto& record : batch)
+    add_record(record);
+}
+
+void FastqWriter::flush() {
+  write_buffer();
+  m_output->flush();
+}
+
+/**
+ * @brief hands the formatted records to the output (which compresses them in the background)
+ */
+void FastqWriter::write_buffer() {
+  if (m_buffer.empty())
+    return;
+  m_output->write(move(m_buffer));
+  m_buffer = string{};
+  m_buffer.reserve(block_size);
+}
+
+void FastqWriter::close() {
+  if (!m_output)   // moved from, or closed already
+    return;
+  const auto output = move(m_output);   // lets go of the output even if ending it fails
+  if (!m_buffer.empty())
+    output->write(move(m_buffer));
+  m_buffer = string{};
+  output->finish();
+}
+
+}  // end of namespace
@@ -0,0 +1,104 @@
+#ifndef gamgee__fastq_writer__guard
+#define gamgee__fastq_writer__guard
+
+#include "fastq_batch.h"
+#include "fastq_view.h"
+#include "utils/block_writer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace gamgee {
+
+/**
+ * @brief Utility class to write FastA/FastQ records to a file or stream, optionally compressed
+ *
+ * Records are formatted into large blocks, which are compressed (BGZF or gzip) by a pool of threads while the next
+ * records are formatted, and written out in order: the output is the same whatever the number of threads.
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * auto writer = FastqWriter{"trimmed.fq.gz", utils::Compression::bgzf, 4};
+ * for (auto& record : FastqReader{filename}) {
+ *   record.chop(10);
+ *   writer.add_record(record);
+ * }
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Records with qualities are written in FastQ format, the others in FastA format. The comment is separated from
+ * the name by a space (records without a comment have no trailing space). Sequences and qualities are written on
+ * a single line.
+ */
+class FastqWriter {
+ public:
+  static constexpr std::size_t block_size = 1 << 20;   ///< bytes of formatted records compressed (and written) at a time
+
+  /**
+   * @brief creates a writer to a file
+   * @param filename the file to write to ("-" is stdout)
+   * @param compression the compression of the output
+   * @param num_threads number of threads compressing the output
+   */
+  explicit FastqWriter(const std::string& filename = "-", const utils::Compression compression = utils::Compression::none, const uint32_t num_threads = 1);
+
+  /**
+   * @brief creates a writer to a stream
+   * @param output the stream to write to
+   * @param compression the compression of the output
+   * @param num_threads number of threads compressing the output
+   */
+  explicit FastqWriter(std::shared_ptr<std::ostream> output, const utils::Compression compression = utils::Compression::none, const uint32_t num_threads = 1);
+
+  /**
+   * @brief writes out the records that are left, and finishes the compressed stream, unless close() was called
+   * (errors are ignored: call close() to get them)
+   */
+  ~FastqWriter();
+
+  /**
+   * @brief a FastqWriter cannot be copied safely, as it is writing to a stream.
+   */
+  FastqWriter(const FastqWriter&) = delete;
+  FastqWriter& operator=(const FastqWriter&) = delete;
+
+  /**
+   * @brief a FastqWriter can be moved (moving into a writer closes it first)
+   */
+  FastqWriter(FastqWriter&&) = default;
+  FastqWriter& operator=(FastqWriter&& other);
+
+  /**
+   * @brief adds a record (a Fastq object, or a view of a record) to the output
+   */
+  void add_record(const FastqView& record);
+
+  /**
+   * @brief adds all the records of a batch to the output, in order
+   */
+  void add_batch(const FastqBatch& batch);
+
+  /**
+   * @brief writes out (and compresses) all the records added so far, and flushes the output
+   */
+  void flush();
+
+  /**
+   * @brief writes out (and compresses) the records that are left, finishes the compressed stream and flushes the
+   * output. The writer can't be used afterwards.
+   * @throws OutputException if the output fails, e.g. on a full disk (call this rather than relying on the
+   * destructor when a truncated output matters)
+   */
+  void close();
+
+ private:
+  std::unique_ptr<utils::BlockWriter> m_output;  ///< the (compressed) output
+  std::string m_buffer;                          ///< the formatted records not yet handed to the output
+
+  void write_buffer();
+};
+
+}  // end of namespace
+
+#endif // gamgee__fastq_writer__guard
@@ -3,27 +3,51 @@
 
 #include "exceptions.h"
 #include "fastq.h"
+#include "fastq_batch.h"
+#include "fastq_batch_iterator.h"
+#include "fastq_batch_reader.h"
 #include "fastq_iterator.h"
+#include "fastq_parser.h"
 #include "fastq_reader.h"
+#include "fastq_view.h"
+#include "fastq_writer.h"
+#include "indexed_reference.h"
 #include "interval.h"
 #include "missing.h"
+#include "packed_reference.h"
+#include "paired_fastq_iterator.h"
+#include "paired_fastq_reader.h"
 #include "reference_iterator.h"
 #include "reference_map.h"
 #include "zip.h"
 
+#include "utils/base_encoding.h"
+#include "utils/block_reader.h"
+#include "utils/block_writer.h"
 #include "utils/file_utils.h"
 #include "utils/genotype_utils.h"
+#include "utils/gzip_block_reader.h"
+#include "utils/gzip_block_writer.h"
 #include "utils/hts_memory.h"
+#include "utils/memory_mapped_file.h"
 #include "utils/merged_vcf_lut.h"
+#include "utils/record_handle.h"
 #include "utils/short_value_optimized_storage.h"
+#include "utils/thread_pool.h"
 #include "utils/utils.h"
 #include "utils/variant_field_type.h"
 #include "utils/variant_utils.h"
 
 #include "sam/base_quals.h"
 #include "sam/cigar.h"
+#include "sam/coverage_engine.h"
+#include "sam/duplicate_marker.h"
 #include "sam/indexed_sam_iterator.h"
 #include "sam/indexed_sam_reader.h"
+#include "sam/locus_iterator.h"
+#include "sam/locus_reader.h"
+#include "sam/name_pair_sam_reader.h"
+#include "sam/pileup.h"
 #include "sam/read_bases.h"
 #include "sam/sam.h"
 #include "sam/sam_builder.h"
@@ -32,6 +56,7 @@
 #include "sam/sam_iterator.h"
 #include "sam/sam_pair_iterator.h"
 #include "sam/sam_reader.h"
+#include "sam/sam_sorter.h"
 #include "sam/sam_tag.h"
 #include "sam/sam_writer.h"
 
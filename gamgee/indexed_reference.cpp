@@ -0,0 +1,219 @@
+#include "indexed_reference.h"
+
+#include "exceptions.h"
+#include "utils/base_encoding.h"
+
+#include <unistd.h>
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+using namespace std;
+
+namespace gamgee {
+
+/**
+ * @brief the end of the line starting at position (the position of its line break, or the end of the data)
+ */
+static size_t line_end(const char* data, const size_t size, const size_t position) {
+  const auto newline = static_cast<const char*>(memchr(data + position, '\n', size - position));
+  return newline == nullptr ? size : size_t(newline - data);
+}
+
+/**
+ * @brief the bases of a line (without the carriage return of Windows line breaks)
+ */
+static size_t line_bases(const char* data, const size_t position, const size_t end) {
+  return end > position && data[end - 1] == '\r' ? end - position - 1 : end - position;
+}
+
+/**
+ * @brief the size in the file of the bases of a regular contig
+ */
+static uint64_t contig_size_in_file(const IndexedReference::Contig& contig) {
+  if (contig.length == 0)
+    return 0;
+  return (contig.length - 1) / contig.line_bases * contig.line_width + (contig.length - 1) % contig.line_bases + 1;
+}
+
+pair<uint64_t, uint64_t> IndexedReference::Contig::locate(const uint64_t base) const {
+  if (lines.empty())
+    return {offset + base / line_bases * line_width + base % line_bases, (base / line_bases + 1) * line_bases};
+  const auto next = upper_bound(lines.begin(), lines.end(), base, [](const uint64_t position, const pair<uint64_t, uint64_t>& line) { return position < line.first; });
+  const auto line = prev(next);  // the last line starting at or before the base
+  return {line->second + (base - line->first), next != lines.end() ? next->first : length};
+}
+
+IndexedReference::IndexedReference(const string& filename, const bool save_index) :
+  m_file {make_shared<const utils::MemoryMappedFile>(filename)},
+  m_index {}
+{
+  if (m_file->size() >= 2 && m_file->data()[0] == '\x1f' && m_file->data()[1] == '\x8b')
+    throw ReferenceIndexException{filename, "compressed references can't be memory-mapped (decompress it first)"};
+  const auto index_filename = filename + ".fai";
+  if (ifstream{index_filename}.good()) {
+    m_index = make_shared<const Index>(read_index(index_filename, filename, *m_file));
+    return;
+  }
+  auto index = build_index(filename, *m_file);
+  const auto samtools_compatible = all_of(index.contigs.begin(), index.contigs.end(), [](const Contig& contig) { return contig.lines.empty(); });
+  if (save_index && samtools_compatible)
+    IndexedReference::save_index(index_filename, index);
+  m_index = make_shared<const Index>(move(index));
+}
+
+string IndexedReference::get_sequence(const Interval& interval, const bool reverse_strand) const {
+  auto buffer = string{};
+  const auto bases = get_sequence_view(interval, buffer);
+  if (!reverse_strand)
+    return string{bases};
+  auto sequence = string(bases.size(), '\0');
+  utils::complement_bases(bases.data(), bases.size(), &sequence[0]);
+  return sequence;
+}
+
+string_view IndexedReference::get_sequence_view(const Interval& interval, string& buffer) const {
+  const auto& contig = this->contig(interval.chr());
+  if (interval.start() == 0 || interval.start() > contig.length)
+    throw ChromosomeSizeException{contig.name, contig.length, int(interval.start())};
+  const auto begin = uint64_t{interval.start()} - 1;
+  const auto end = max(begin, min(uint64_t{interval.stop()}, contig.length));
+  auto view = string_view{};
+  auto num_spans = 0u;
+  contig.for_each_span(m_file->data(), begin, end, [&](const char* bases, const size_t size) {
+    if (++num_spans == 1) {
+      view = string_view{bases, size};
+      return;
+    }
+    if (num_spans == 2)
+      buffer.assign(view.data(), view.size());
+    buffer.append(bases, size);
+  });
+  return num_spans > 1 ? string_view{buffer} : view;
+}
+
+char IndexedReference::base(const string& chromosome, const uint32_t one_based_location) const {
+  const auto& contig = this->contig(chromosome);
+  if (one_based_location == 0 || one_based_location > contig.length)
+    throw ChromosomeSizeException{chromosome, contig.length, int(one_based_location)};
+  return m_file->data()[contig.locate(one_based_location - 1).first];
+}
+
+bool IndexedReference::contains(const string& chromosome) const {
+  return m_index->positions.count(chromosome) != 0;
+}
+
+const IndexedReference::Contig& IndexedReference::contig(const string& chromosome) const {
+  const auto position = m_index->positions.find(chromosome);
+  if (position == m_index->positions.end())
+    throw ChromosomeNotFoundException{chromosome};
+  return m_index->contigs[position->second];
+}
+
+/**
+ * @brief reads a samtools .fai index, checking that it fits the FastA file
+ */
+IndexedReference::Index IndexedReference::read_index(const string& index_filename, const string& filename, const utils::MemoryMappedFile& file) {
+  auto input = ifstream{index_filename};
+  auto index = Index{};
+  for (auto line = string{}; getline(input, line); ) {
+    if (line.empty())
+      continue;
+    auto fields = istringstream{line};
+    auto contig = Contig{};
+    getline(fields, contig.name, '\t');
+    if (!(fields >> contig.length >> contig.offset >> contig.line_bases >> contig.line_width) ||
+        (contig.length != 0 && (contig.line_bases == 0 || contig.line_width < contig.line_bases)) ||
+        contig.offset + contig_size_in_file(contig) > file.size())
+      throw ReferenceIndexException{filename, "the index " + index_filename + " doesn't match the file"};
+    if (!index.positions.emplace(contig.name, index.contigs.size()).second)
+      throw ReferenceIndexException{filename, "the index " + index_filename + " has contig " + contig.name + " more than once"};
+    index.contigs.push_back(move(contig));
+  }
+  return index;
+}
+
+/**
+ * @brief indexes a FastA file by scanning it once (twice for the contigs with irregular lines)
+ *
+ * Contigs are regular (can be indexed by samtools) if all their lines but the last have the same number of bases
+ * and bytes, the last line is not longer and empty lines only come at the end.
+ */
+IndexedReference::Index IndexedReference::build_index(const string& filename, const utils::MemoryMappedFile& file) {
+  const auto data = file.data();
+  const auto size = file.size();
+  auto index = Index{};
+  for (auto position = size_t{0}; position < size; ) {
+    auto end = line_end(data, size, position);
+    if (data[position] != '>') {
+      if (line_bases(data, position, end) != 0)
+        throw ReferenceIndexException{filename, "sequence without a header at byte " + to_string(position)};
+      position = end + 1;
+      continue;
+    }
+    const auto name = data + position + 1;
+    const auto name_end = find_if(name, data + end, [](const char c) { return isspace(static_cast<unsigned char>(c)); });
+    auto contig = Contig{string{name, name_end}, 0, min(end + 1, size), 0, 0, {}};
+    if (contig.name.empty())
+      throw ReferenceIndexException{filename, "header without a name at byte " + to_string(position)};
+    auto regular = true;
+    auto last_line_seen = false;   // a line shorter than the others (or empty): the next ones must be empty
+    for (position = contig.offset; position < size && data[position] != '>'; position = end + 1) {
+      end = line_end(data, size, position);
+      const auto bases = line_bases(data, position, end);
+      const auto width = min(end + 1, size) - position;
+      if (bases == 0) {
+        last_line_seen = true;
+        continue;
+      }
+      if (contig.length == 0) {
+        contig.line_bases = uint32_t(bases);
+        contig.line_width = uint32_t(end + 1 - position);
+        regular = position == contig.offset;   // no empty lines before the first one
+      }
+      else if (last_line_seen || bases > contig.line_bases)
+        regular = false;
+      if (bases != contig.line_bases || width != contig.line_width)
+        last_line_seen = true;
+      contig.length += bases;
+    }
+    if (!regular) {   // every line is in the index instead
+      auto first_base = uint64_t{0};
+      for (auto line = contig.offset; line < position; line = line_end(data, size, line) + 1) {
+        const auto bases = line_bases(data, line, line_end(data, size, line));
+        if (bases != 0)
+          contig.lines.emplace_back(first_base, line);
+        first_base += bases;
+      }
+    }
+    if (!index.positions.emplace(contig.name, index.contigs.size()).second)
+      throw ReferenceIndexException{filename, "contig " + contig.name + " is in the file more than once"};
+    index.contigs.push_back(move(contig));
+  }
+  return index;
+}
+
+/**
+ * @brief saves an index in the samtools .fai format, if possible (e.g. it can't be if the reference is in a read-only
+ * directory, and that's fine)
+ */
+void IndexedReference::save_index(const string& index_filename, const Index& index) {
+  const auto temporary_filename = index_filename + "." + to_string(getpid());  // so that other processes never see a partial index
+  {
+    auto output = ofstream{temporary_filename};
+    for (const auto& contig : index.contigs)
+      output << contig.name << '\t' << contig.length << '\t' << contig.offset << '\t' << contig.line_bases << '\t' << contig.line_width << '\n';
+    if (!output.good()) {
+      output.close();
+      remove(temporary_filename.c_str());
+      return;
+    }
+  }
+  if (rename(temporary_filename.c_str(), index_filename.c_str()) != 0)
+    remove(temporary_filename.c_str());
+}
+
+}  // end namespace gamgee
@@ -0,0 +1,138 @@
+#ifndef gamgee__indexed_reference__guard
+#define gamgee__indexed_reference__guard
+
+#include "interval.h"
+#include "utils/memory_mapped_file.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace gamgee {
+
+/**
+ * @brief Random access to the sequences of a FastA reference through its .fai index, without loading it
+ *
+ * The FastA file is memory-mapped: opening a reference is immediate whatever its size, only the pages holding the
+ * sequences asked for are ever read, and they are shared by all the processes using the same reference. The
+ * samtools .fai index (filename + ".fai") is used if there is one, otherwise it is built by scanning the file once
+ * (and saved next to it when possible). Contigs whose lines don't all have the same length (which samtools can't
+ * index) are supported too, with an in-memory table of their lines.
+ *
+ * It is a drop-in replacement for ReferenceMap::get_sequence(), and can also return sequences without copying
+ * them:
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * auto reference = IndexedReference{"hg38.fa"};
+ * auto buffer = std::string{};
+ * for (const auto& interval : intervals)
+ *   do_something_with(reference.get_sequence_view(interval, buffer));  // copied to buffer only if it spans lines
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Copies share the mapping and the index. All the const methods are safe to use from several threads.
+ */
+class IndexedReference {
+ public:
+
+  /**
+   * @brief where the bases of a contig are in the FastA file (one line of the .fai index)
+   */
+  struct Contig {
+    std::string name;              ///< name of the contig (the first word of its header)
+    uint64_t length;               ///< number of bases
+    uint64_t offset;               ///< file offset of the first base
+    uint32_t line_bases;           ///< number of bases per line
+    uint32_t line_width;           ///< number of bytes per line (including the line break)
+    std::vector<std::pair<uint64_t, uint64_t>> lines;   ///< for contigs with irregular lines only: first base and file offset of each line
+
+    /**
+     * @brief where a base is
+     * @param base 0-based position of the base in the contig
+     * @return the file offset of the base, and the position of the first base of the next line
+     */
+    std::pair<uint64_t, uint64_t> locate(const uint64_t base) const;
+
+    /**
+     * @brief calls function(bases, size) for each line of the bases in [begin, end) (0-based)
+     */
+    template<class FUNCTION>
+    void for_each_span(const char* data, uint64_t begin, const uint64_t end, FUNCTION&& function) const;
+  };
+
+  /**
+   * @brief opens a FastA reference, using (or building) its .fai index
+   *
+   * @param filename the (uncompressed) FastA file
+   * @param save_index whether to save the index next to the FastA file if it had to be built (by default it is
+   * only built in memory, and nothing is written next to the reference)
+   * @throw FileOpenException if the file can't be opened
+   * @throw ReferenceIndexException if the file is compressed or malformed, or if the index doesn't match it
+   */
+  explicit IndexedReference(const std::string& filename, const bool save_index = false);
+
+  /**
+    * @brief locates the DNA sequence for a given Interval (see ReferenceMap::get_sequence())
+    *
+    * @return DNA sequence for the requested Interval (cut at the end of the contig)
+    * @throw ChromosomeNotFoundException if the contig is not in the reference
+    * @throw ChromosomeSizeException if the interval starts past the end of the contig
+    */
+  std::string get_sequence(const Interval& interval,          ///< location in the genome
+                           const bool reverse_strand = false  ///< which strand, relative to the reference genome, to produce the sequence for (the complement of the forward strand)
+      ) const;
+
+  /**
+    * @brief locates the DNA sequence for a given Interval without copying it, if possible
+    *
+    * @param interval location in the genome
+    * @param buffer where the sequence is copied if it spans several lines of the FastA file (its memory is reused)
+    * @return view of the forward strand sequence: in the mapped file, or in buffer
+    * @throw ChromosomeNotFoundException if the contig is not in the reference
+    * @throw ChromosomeSizeException if the interval starts past the end of the contig
+    */
+  std::string_view get_sequence_view(const Interval& interval, std::string& buffer) const;
+
+  /**
+   * @brief the base at a one-based location
+   * @throw ChromosomeNotFoundException if the contig is not in the reference
+   * @throw ChromosomeSizeException if the location is past the end of the contig
+   */
+  char base(const std::string& chromosome, const uint32_t one_based_location) const;
+
+  bool contains(const std::string& chromosome) const;             ///< @brief whether or not the contig is in the reference
+  const Contig& contig(const std::string& chromosome) const;      ///< @brief the index of a contig @throw ChromosomeNotFoundException if the contig is not in the reference
+  const std::vector<Contig>& contigs() const { return m_index->contigs; }  ///< @brief the index of all contigs, in file order
+  const char* data() const { return m_file->data(); }             ///< @brief the mapped FastA file
+
+ private:
+  struct Index {
+    std::vector<Contig> contigs;                                  ///< in file order
+    std::unordered_map<std::string, std::size_t> positions;       ///< contig name -> position in contigs
+  };
+
+  std::shared_ptr<const utils::MemoryMappedFile> m_file;  ///< the FastA file
+  std::shared_ptr<const Index> m_index;                   ///< where the contigs are in the file
+
+  static Index read_index(const std::string& index_filename, const std::string& filename, const utils::MemoryMappedFile& file);
+  static Index build_index(const std::string& filename, const utils::MemoryMappedFile& file);
+  static void save_index(const std::string& index_filename, const Index& index);
+};
+
+template<class FUNCTION>
+void IndexedReference::Contig::for_each_span(const char* data, uint64_t begin, const uint64_t end, FUNCTION&& function) const {
+  while (begin < end) {
+    const auto location = locate(begin);
+    const auto span_end = std::min(end, location.second);
+    function(data + location.first, std::size_t(span_end - begin));
+    begin = span_end;
+  }
+}
+
+}  // end namespace gamgee
+
+#endif // gamgee__indexed_reference__guard
@@ -81,9 +81,9 @@ class Interval {
   /**
     * @brief calculates the number of loci in the Intervals
     *
-    * @return stop() - start() + 1
+    * @return stop() - start() + 1, or 0 for intervals that stop before they start
     */
-  inline uint32_t size() const { return m_stop - m_start + 1; }
+  inline uint32_t size() const { return m_stop < m_start ? 0 : m_stop - m_start + 1; }
 
   /**
     * @brief Tiles an Interval with smaller Intervals anchoring (starting) on the left side (start)
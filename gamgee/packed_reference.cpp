@@ -0,0 +1,299 @@
+#include "packed_reference.h"
+
+#include "exceptions.h"
+#include "fastq_reader.h"
+#include "utils/base_encoding.h"
+#include "utils/memory_mapped_file.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+using namespace std;
+
+namespace gamgee {
+
+/**
+ * @brief start of a packed reference file
+ */
+struct PackedReferenceHeader {
+  char magic[8];           ///< "GMGPACK\0"
+  uint64_t version;        ///< 1 (also tells the byte order of the file)
+  uint64_t num_contigs;
+  uint64_t soft_masked;    ///< whether the file has the soft-mask bitmaps
+};
+
+/**
+ * @brief where the parts of a contig are in a packed reference file (the header is followed by one per contig)
+ */
+struct PackedReferenceEntry {
+  uint64_t name_offset;
+  uint64_t name_length;
+  uint64_t length;
+  uint64_t packed_offset;
+  uint64_t exceptions_offset;
+  uint64_t num_exceptions;
+  uint64_t soft_mask_offset;
+};
+
+/**
+ * @brief a contig being packed
+ */
+struct PackedContig {
+  string name;
+  uint64_t length;
+  vector<uint8_t> packed;
+  vector<PackedReference::ExceptionRun> exceptions;
+  vector<uint64_t> soft_mask;
+};
+
+static const auto packed_reference_magic = array<char, 8>{'G', 'M', 'G', 'P', 'A', 'C', 'K', '\0'};
+static constexpr auto packed_padding = uint64_t{8};   // bytes after the bases, so that windows can always read 9 bytes
+
+static uint64_t padded_size(const uint64_t size) { return (size + 7) & ~uint64_t{7}; }   // every part starts 8-byte aligned
+static uint64_t packed_size(const uint64_t length) { return (length + 3) / 4 + packed_padding; }
+static uint64_t soft_mask_words(const uint64_t length) { return (length + 63) / 64; }
+
+/**
+ * @brief 2-bit code of every character (4 for the ones that are exceptions)
+ */
+static const array<uint8_t, 256> build_code_table() {
+  auto table = array<uint8_t, 256>{};
+  table.fill(4);
+  for (auto code = 0u; code != 4; ++code) {
+    table[uint8_t("ACGT"[code])] = uint8_t(code);
+    table[uint8_t("acgt"[code])] = uint8_t(code);
+  }
+  return table;
+}
+
+static PackedContig pack_contig(string name, const string& sequence, const bool soft_mask) {
+  static const auto codes = build_code_table();
+  auto contig = PackedContig{move(name), sequence.size(), vector<uint8_t>(packed_size(sequence.size())), {}, {}};
+  if (soft_mask)
+    contig.soft_mask.resize(soft_mask_words(sequence.size()));
+  for (auto i = uint64_t{0}; i != sequence.size(); ++i) {
+    const auto letter = sequence[i];
+    const auto code = codes[uint8_t(letter)];
+    if (code < 4)
+      contig.packed[i / 4] |= uint8_t(code << (6 - 2 * (i % 4)));
+    else {
+      const auto base = char(toupper(static_cast<unsigned char>(letter)));
+      auto& runs = contig.exceptions;
+      if (!runs.empty() && runs.back().base == base && runs.back().start + runs.back().length == i && runs.back().length != numeric_limits<uint32_t>::max())
+        ++runs.back().length;
+      else
+        runs.push_back(PackedReference::ExceptionRun{i, 1, base, {}});
+    }
+    if (soft_mask && letter >= 'a' && letter <= 'z')
+      contig.soft_mask[i / 64] |= uint64_t{1} << (i % 64);
+  }
+  return contig;
+}
+
+/**
+ * @brief lays out packed contigs in the file format (in 64 bit words, so that every part is aligned)
+ */
+static vector<uint64_t> build_image(const vector<PackedContig>& contigs, const bool soft_mask) {
+  auto size = padded_size(sizeof(PackedReferenceHeader) + contigs.size() * sizeof(PackedReferenceEntry));
+  auto entries = vector<PackedReferenceEntry>{};
+  for (const auto& contig : contigs) {
+    auto entry = PackedReferenceEntry{size, contig.name.size(), contig.length, 0, 0, contig.exceptions.size(), 0};
+    entry.packed_offset = size += padded_size(contig.name.size());
+    entry.exceptions_offset = size += padded_size(contig.packed.size());
+    size += contig.exceptions.size() * sizeof(PackedReference::ExceptionRun);
+    if (soft_mask) {
+      entry.soft_mask_offset = size;
+      size += contig.soft_mask.size() * sizeof(uint64_t);
+    }
+    entries.push_back(entry);
+  }
+  auto image = vector<uint64_t>(size / sizeof(uint64_t));
+  const auto bytes = reinterpret_cast<char*>(image.data());
+  auto header = PackedReferenceHeader{{}, 1, contigs.size(), soft_mask};
+  copy(packed_reference_magic.begin(), packed_reference_magic.end(), header.magic);
+  memcpy(bytes, &header, sizeof(header));
+  memcpy(bytes + sizeof(header), entries.data(), entries.size() * sizeof(PackedReferenceEntry));
+  for (auto i = 0u; i != contigs.size(); ++i) {
+    const auto& contig = contigs[i];
+    memcpy(bytes + entries[i].name_offset, contig.name.data(), contig.name.size());
+    memcpy(bytes + entries[i].packed_offset, contig.packed.data(), contig.packed.size());
+    memcpy(bytes + entries[i].exceptions_offset, contig.exceptions.data(), contig.exceptions.size() * sizeof(PackedReference::ExceptionRun));
+    if (soft_mask)
+      memcpy(bytes + entries[i].soft_mask_offset, contig.soft_mask.data(), contig.soft_mask.size() * sizeof(uint64_t));
+  }
+  return image;
+}
+
+void PackedReference::Contig::unpack(uint64_t begin, const uint64_t end, char* destination) const {
+  const auto first = begin;
+  for (; begin != end && begin % 4 != 0; ++begin)   // up to the first base of a byte
+    *destination++ = "ACGT"[packed[begin / 4] >> (6 - 2 * (begin % 4)) & 3];
+  while (begin != end) {   // in chunks the size of the decoding functions
+    const auto chunk = uint32_t(min(end - begin, uint64_t{1} << 30));
+    utils::decode_2bit_bases(packed + begin / 4, chunk, destination);
+    begin += chunk;
+    destination += chunk;
+  }
+  destination -= end - first;
+  const auto run_ends_after = [](const uint64_t position, const ExceptionRun& run) { return position < run.start + run.length; };
+  for (auto run = upper_bound(exceptions, exceptions + num_exceptions, first, run_ends_after); run != exceptions + num_exceptions && run->start < end; ++run) {
+    const auto run_begin = max(run->start, first);
+    fill_n(destination + (run_begin - first), min(run->start + run->length, end) - run_begin, run->base);
+  }
+  if (soft_mask == nullptr)
+    return;
+  for (auto position = first; position < end; ) {
+    const auto word = soft_mask[position / 64] >> (position % 64);
+    if (word == 0) {
+      position += 64 - position % 64;
+      continue;
+    }
+    position += __builtin_ctzll(word);
+    if (position < end)
+      destination[position - first] |= 0x20;   // lower case
+    ++position;
+  }
+}
+
+uint64_t PackedReference::Contig::window(const uint64_t position, const uint32_t k) const {
+  const auto bytes = packed + position / 4;
+  auto codes = uint64_t{};
+  memcpy(&codes, bytes, sizeof(codes));
+  codes = __builtin_bswap64(codes);   // the first base in the highest bits
+  const auto shift = 2 * (position % 4);
+  if (shift != 0)
+    codes = codes << shift | bytes[8] >> (8 - shift);
+  return k == 0 ? 0 : codes >> (64 - 2 * k);
+}
+
+bool PackedReference::Contig::has_exceptions(const uint64_t begin, const uint64_t end) const {
+  const auto run_ends_after = [](const uint64_t position, const ExceptionRun& run) { return position < run.start + run.length; };
+  const auto run = upper_bound(exceptions, exceptions + num_exceptions, begin, run_ends_after);
+  return begin < end && run != exceptions + num_exceptions && run->start < end;
+}
+
+char PackedReference::Contig::base(const uint64_t position) const {
+  auto letter = char{};
+  unpack(position, position + 1, &letter);
+  return letter;
+}
+
+PackedReference::PackedReference(const string& filename, const bool soft_mask) {
+  auto contigs = vector<PackedContig>{};
+  for (auto& record : FastqReader{filename})
+    contigs.push_back(pack_contig(record.name(), record.sequence(), soft_mask));
+  auto image = make_shared<const vector<uint64_t>>(build_image(contigs, soft_mask));
+  contigs.clear();
+  const auto image_view = string_view{reinterpret_cast<const char*>(image->data()), image->size() * sizeof(uint64_t)};
+  *this = PackedReference{move(image), image_view, filename};
+}
+
+PackedReference PackedReference::load(const string& filename) {
+  auto file = make_shared<const utils::MemoryMappedFile>(filename);
+  const auto image = file->contents();
+  return PackedReference{move(file), image, filename};
+}
+
+/**
+ * @brief finds the contigs of a packed reference, checking that it is one
+ */
+PackedReference::PackedReference(shared_ptr<const void> storage, const string_view image, const string& filename) :
+  m_storage {move(storage)},
+  m_image {image},
+  m_index {}
+{
+  const auto not_packed = [&filename]() { return ReferenceIndexException{filename, "not a packed reference (or from a machine with another byte order)"}; };
+  auto header = PackedReferenceHeader{};
+  if (image.size() < sizeof(header))
+    throw not_packed();
+  memcpy(&header, image.data(), sizeof(header));
+  if (!equal(packed_reference_magic.begin(), packed_reference_magic.end(), header.magic) || header.version != 1 ||
+      header.num_contigs > (image.size() - sizeof(header)) / sizeof(PackedReferenceEntry))
+    throw not_packed();
+  const auto data = reinterpret_cast<const uint8_t*>(image.data());
+  const auto fits = [&image](const uint64_t offset, const uint64_t size) { return offset % 8 == 0 && offset <= image.size() && size <= image.size() - offset; };
+  auto index = Index{};
+  for (auto i = uint64_t{0}; i != header.num_contigs; ++i) {
+    auto entry = PackedReferenceEntry{};
+    memcpy(&entry, data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+    if (!fits(entry.name_offset, entry.name_length) || !fits(entry.packed_offset, packed_size(entry.length)) ||
+        entry.num_exceptions > image.size() / sizeof(ExceptionRun) || !fits(entry.exceptions_offset, entry.num_exceptions * sizeof(ExceptionRun)) ||
+        (header.soft_masked && !fits(entry.soft_mask_offset, soft_mask_words(entry.length) * sizeof(uint64_t))))
+      throw ReferenceIndexException{filename, "the packed reference is truncated or corrupt"};
+    const auto contig = Contig{
+      string_view{image.data() + entry.name_offset, entry.name_length},
+      entry.length,
+      data + entry.packed_offset,
+      reinterpret_cast<const ExceptionRun*>(data + entry.exceptions_offset),
+      entry.num_exceptions,
+      header.soft_masked ? reinterpret_cast<const uint64_t*>(data + entry.soft_mask_offset) : nullptr
+    };
+    if (!index.positions.emplace(string{contig.name}, index.contigs.size()).second)
+      throw ReferenceIndexException{filename, "contig " + string{contig.name} + " is in the file more than once"};
+    index.contigs.push_back(contig);
+  }
+  m_index = make_shared<const Index>(move(index));
+}
+
+void PackedReference::save(const string& filename) const {
+  const auto temporary_filename = filename + "." + to_string(getpid());  // so that other processes never map a partial file
+  {
+    auto output = ofstream{temporary_filename, ios::binary};
+    output.write(m_image.data(), m_image.size());
+    if (!output.good()) {
+      output.close();
+      remove(temporary_filename.c_str());
+      throw OutputException{"failed writing the packed reference " + filename};
+    }
+  }
+  if (rename(temporary_filename.c_str(), filename.c_str()) != 0) {
+    remove(temporary_filename.c_str());
+    throw OutputException{"failed writing the packed reference " + filename};
+  }
+}
+
+string PackedReference::get_sequence(const Interval& interval, const bool reverse_strand) const {
+  const auto& contig = this->contig(interval.chr());
+  if (interval.start() == 0 || interval.start() > contig.length)
+    throw ChromosomeSizeException{string{contig.name}, contig.length, int(interval.start())};
+  const auto begin = uint64_t{interval.start()} - 1;
+  const auto end = max(begin, min(uint64_t{interval.stop()}, contig.length));
+  auto sequence = string(end - begin, '\0');
+  contig.unpack(begin, end, &sequence[0]);
+  if (reverse_strand)
+    utils::complement_bases(sequence.data(), sequence.size(), &sequence[0]);
+  return sequence;
+}
+
+char PackedReference::base(const string& chromosome, const uint32_t one_based_location) const {
+  const auto& contig = this->contig(chromosome);
+  if (one_based_location == 0 || one_based_location > contig.length)
+    throw ChromosomeSizeException{chromosome, contig.length, int(one_based_location)};
+  return contig.base(one_based_location - 1);
+}
+
+bool PackedReference::contains(const string& chromosome) const {
+  return m_index->positions.count(chromosome) != 0;
+}
+
+const PackedReference::Contig& PackedReference::contig(const string& chromosome) const {
+  const auto position = m_index->positions.find(chromosome);
+  if (position == m_index->positions.end())
+    throw ChromosomeNotFoundException{chromosome};
+  return m_index->contigs[position->second];
+}
+
+bool PackedReference::soft_masked() const {
+  auto header = PackedReferenceHeader{};
+  memcpy(&header, m_image.data(), sizeof(header));
+  return header.soft_masked != 0;
+}
+
+}  // end namespace gamgee
@@ -0,0 +1,146 @@
+#ifndef gamgee__packed_reference__guard
+#define gamgee__packed_reference__guard
+
+#include "interval.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace gamgee {
+
+/**
+ * @brief A whole reference in memory, at 2 bits per base
+ *
+ * Bases are stored as 2-bit codes (A=0, C=1, G=2, T=3, four per byte, first base in the high bits), a quarter of
+ * the memory (and cache) of ReferenceMap. Anything else (N, the other IUPAC codes...) goes in a run-length
+ * encoded list of exceptions, and lower case (soft-masked) bases are marked in an optional bitmap, so that
+ * get_sequence() returns exactly the bases of the FastA file.
+ *
+ * A packed reference can be saved to a file, which is then memory-mapped instead of being loaded: all the
+ * processes using the same file share one copy of it, and opening it is immediate.
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * PackedReference{"hg38.fa"}.save("hg38.2bit");   // once
+ * const auto reference = PackedReference::load("hg38.2bit");   // in every worker
+ * const auto& contig = reference.contig("chr1");
+ * for (auto position = 0ul; position + 31 <= contig.length; ++position)
+ *   if (!contig.has_exceptions(position, position + 31))
+ *     count_kmer(contig.window(position, 31));   // the 2-bit codes of the 31 bases, without unpacking them
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * The file format is the in-memory one (in the byte order of the machine that wrote it). Copies share the
+ * bases. All the const methods are safe to use from several threads.
+ */
+class PackedReference {
+ public:
+
+  /**
+   * @brief a run of identical bases that are not A, C, G or T (stored upper case)
+   */
+  struct ExceptionRun {
+    uint64_t start;            ///< 0-based position of the first base
+    uint32_t length;           ///< number of bases
+    char base;                 ///< the base (e.g. 'N')
+    char unused[3];
+  };
+
+  /**
+   * @brief the packed bases of a contig
+   */
+  struct Contig {
+    std::string_view name;             ///< name of the contig (the first word of its header)
+    uint64_t length;                   ///< number of bases
+    const uint8_t* packed;             ///< 2-bit codes of the bases (exceptions are A), followed by 8 bytes of padding
+    const ExceptionRun* exceptions;    ///< runs of bases that are not A, C, G or T, in order
+    uint64_t num_exceptions;           ///< number of runs of exceptions
+    const uint64_t* soft_mask;         ///< bit (i % 64) of word (i / 64) is set for lower case bases (null without soft-masking)
+
+    /**
+     * @brief the letters of the bases in [begin, end) (0-based, end <= length)
+     * @param destination where the end - begin letters go (no terminator is written)
+     */
+    void unpack(const uint64_t begin, const uint64_t end, char* destination) const;
+
+    /**
+     * @brief the 2-bit codes of the k bases from position (0-based, k <= 32 and position + k <= length), the
+     * first base in the highest bits of the 2k low bits
+     *
+     * Exceptions are read as A (see has_exceptions()) and soft-masking is ignored.
+     */
+    uint64_t window(const uint64_t position, const uint32_t k) const;
+
+    /**
+     * @brief whether any of the bases in [begin, end) (0-based) is not A, C, G or T
+     */
+    bool has_exceptions(const uint64_t begin, const uint64_t end) const;
+
+    char base(const uint64_t position) const;   ///< @brief the letter of a base (0-based)
+  };
+
+  /**
+   * @brief packs a FastA reference (possibly gzipped)
+   *
+   * @param filename the FastA file
+   * @param soft_mask whether to keep the case of the bases (otherwise they are all upper case)
+   * @throw FileOpenException if the file can't be opened
+   */
+  explicit PackedReference(const std::string& filename, const bool soft_mask = true);
+
+  /**
+   * @brief memory-maps a packed reference written by save()
+   *
+   * @throw FileOpenException if the file can't be opened
+   * @throw ReferenceIndexException if the file is not a packed reference (or was written on a machine with another byte order)
+   */
+  static PackedReference load(const std::string& filename);
+
+  /**
+   * @brief writes the packed reference to a file, to load() it
+   * @throw OutputException if the file can't be written
+   */
+  void save(const std::string& filename) const;
+
+  /**
+    * @brief locates the DNA sequence for a given Interval (see ReferenceMap::get_sequence())
+    *
+    * @return DNA sequence for the requested Interval (cut at the end of the contig)
+    * @throw ChromosomeNotFoundException if the contig is not in the reference
+    * @throw ChromosomeSizeException if the interval starts past the end of the contig
+    */
+  std::string get_sequence(const Interval& interval,          ///< location in the genome
+                           const bool reverse_strand = false  ///< which strand, relative to the reference genome, to produce the sequence for (the complement of the forward strand)
+      ) const;
+
+  /**
+   * @brief the base at a one-based location
+   * @throw ChromosomeNotFoundException if the contig is not in the reference
+   * @throw ChromosomeSizeException if the location is past the end of the contig
+   */
+  char base(const std::string& chromosome, const uint32_t one_based_location) const;
+
+  bool contains(const std::string& chromosome) const;             ///< @brief whether or not the contig is in the reference
+  const Contig& contig(const std::string& chromosome) const;      ///< @brief the bases of a contig @throw ChromosomeNotFoundException if the contig is not in the reference
+  const std::vector<Contig>& contigs() const { return m_index->contigs; }  ///< @brief the bases of all contigs, in file order
+  bool soft_masked() const;                                       ///< @brief whether the case of the bases was kept
+
+ private:
+  struct Index {
+    std::vector<Contig> contigs;                                  ///< in file order
+    std::unordered_map<std::string, std::size_t> positions;       ///< contig name -> position in contigs
+  };
+
+  std::shared_ptr<const void> m_storage;   ///< what holds the packed reference: a buffer, or the mapped file
+  std::string_view m_image;                ///< the packed reference, in the file format
+  std::shared_ptr<const Index> m_index;    ///< the contigs in m_image
+
+  PackedReference(std::shared_ptr<const void> storage, const std::string_view image, const std::string& filename);
+};
+
+}  // end namespace gamgee
+
+#endif // gamgee__packed_reference__guard
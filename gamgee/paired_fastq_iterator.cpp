@@ -0,0 +1,135 @@
+#include "paired_fastq_iterator.h"
+
+#include "exceptions.h"
+#include "utils/thread_pool.h"
+
+#include <cstring>
+#include <future>
+#include <vector>
+
+using namespace std;
+
+namespace gamgee {
+
+bool mate_names_match(const string& first, const string& second) {
+  const auto size = first.size();
+  if (size != second.size())
+    return false;
+  if (size >= 2 && first[size - 2] == '/' && second[size - 2] == '/')
+    return memcmp(first.data(), second.data(), size - 1) == 0;
+  return first == second;
+}
+
+/**
+ * @brief the parsers of both inputs, the batch being used, the batch being parsed and the threads parsing it
+ */
+struct PairedFastqIterator::State {
+  State(const shared_ptr<utils::BlockReader>& first, const shared_ptr<utils::BlockReader>& second, const bool check_names) :
+    first_parser {first},
+    second_parser {second},
+    batches {vector<pair<Fastq, Fastq>>(batch_size), vector<pair<Fastq, Fastq>>(batch_size)},
+    current {1},
+    size {0},
+    position {0},
+    last_batch {false},
+    check_names {check_names},
+    first_parsed {},
+    second_parsed {},
+    pool {2}
+  {}
+
+  /**
+   * @brief starts parsing the batch that isn't being used, each input on its own thread
+   */
+  void parse_next_batch() {
+    const auto records = batches[current ^ 1].data();
+    first_parsed = pool.submit([this, records]{ return parse(first_parser, records, &pair<Fastq, Fastq>::first); });
+    second_parsed = pool.submit([this, records]{ return parse(second_parser, records, &pair<Fastq, Fastq>::second); });
+  }
+
+  static uint32_t parse(FastqParser& parser, pair<Fastq, Fastq>* records, Fastq pair<Fastq, Fastq>::* mate) {
+    auto parsed = 0u;
+    while (parsed != batch_size && parser.next(records[parsed].*mate))
+      ++parsed;
+    return parsed;
+  }
+
+  FastqParser first_parser;                    ///< parser of the first mates
+  FastqParser second_parser;                   ///< parser of the second mates
+  vector<pair<Fastq, Fastq>> batches[2];       ///< the batch being used and the batch being parsed
+  uint32_t current;                            ///< index of the batch being used
+  uint32_t size;                               ///< number of pairs in the batch being used
+  uint32_t position;                           ///< the current pair in the batch being used
+  bool last_batch;                             ///< whether or not the inputs end with the batch being used
+  bool check_names;                            ///< whether or not to check the names of the mates
+  future<uint32_t> first_parsed;               ///< number of first mates in the batch being parsed
+  future<uint32_t> second_parsed;              ///< number of second mates in the batch being parsed
+  utils::ThreadPool pool;                      ///< the threads parsing the inputs (destroyed first, so the batch being parsed is finished)
+};
+
+PairedFastqIterator::PairedFastqIterator() :
+  m_state {},
+  m_end {}
+{}
+
+PairedFastqIterator::PairedFastqIterator(const shared_ptr<utils::BlockReader>& first, const shared_ptr<utils::BlockReader>& second, const bool check_names) :
+  m_state {make_unique<State>(first, second, check_names)},
+  m_end {}
+{
+  m_state->parse_next_batch();
+  next_batch();
+}
+
+PairedFastqIterator::PairedFastqIterator(PairedFastqIterator&&) = default;
+PairedFastqIterator& PairedFastqIterator::operator=(PairedFastqIterator&&) = default;
+PairedFastqIterator::~PairedFastqIterator() = default;
+
+pair<Fastq, Fastq>& PairedFastqIterator::operator*() {
+  return m_state ? m_state->batches[m_state->current][m_state->position] : m_end;
+}
+
+pair<Fastq, Fastq>& PairedFastqIterator::operator++() {
+  if (m_state && ++m_state->position == m_state->size)
+    next_batch();
+  return operator*();
+}
+
+bool PairedFastqIterator::operator==(const PairedFastqIterator& rhs) const {
+  return m_state == rhs.m_state;
+}
+
+bool PairedFastqIterator::operator!=(const PairedFastqIterator& rhs) const {
+  return !operator==(rhs);
+}
+
+/**
+ * @brief switches to the batch being parsed (checking it) and starts parsing the following one
+ */
+void PairedFastqIterator::next_batch() {
+  auto& state = *m_state;
+  if (state.last_batch) {
+    m_state.reset();
+    return;
+  }
+  const auto first_parsed = state.first_parsed.get();
+  const auto second_parsed = state.second_parsed.get();
+  state.current ^= 1;
+  state.size = min(first_parsed, second_parsed);
+  state.position = 0;
+  state.last_batch = state.size != batch_size;
+  if (!state.last_batch)
+    state.parse_next_batch();
+  if (first_parsed != second_parsed)
+    throw MateMismatchException{string{first_parsed > second_parsed ? "first" : "second"} + " input has more records"};
+  if (state.check_names) {
+    for (auto i = 0u; i != state.size; ++i) {
+      const auto& mates = state.batches[state.current][i];
+      if (!mate_names_match(mates.first.name(), mates.second.name()))
+        throw MateMismatchException{mates.first.name() + " is paired with " + mates.second.name()};
+    }
+  }
+  if (state.size == 0)
+    m_state.reset();
+}
+
+}  // end namespace gamgee
@@ -0,0 +1,96 @@
+#ifndef gamgee__paired_fastq_iterator__guard
+#define gamgee__paired_fastq_iterator__guard
+
+#include "fastq.h"
+#include "fastq_parser.h"
+#include "utils/block_reader.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace gamgee {
+
+/**
+ * @brief Utility class to enable for-each style iteration in the PairedFastqReader class
+ *
+ * The two inputs are parsed concurrently, each one by its own thread, into batches of pairs: the thread parsing
+ * the first mates fills the first element of each pair, the other one the second. While the records of one batch
+ * are being used, the next batch is being parsed. Pairs are only valid until the iterator moves past their batch
+ * (copy them if you need to keep them).
+ *
+ * Unless disabled, the names of the mates are checked as each batch comes in: they must be the same, or differ
+ * only by a /1 and /2 suffix. Mismatched names, or inputs with a different number of records, throw a
+ * MateMismatchException.
+ */
+class PairedFastqIterator {
+ public:
+  static constexpr uint32_t batch_size = 1024;   ///< number of pairs parsed at a time
+
+  /**
+    * @brief creates an empty iterator (used for the end() method)
+    */
+  PairedFastqIterator();
+
+  /**
+    * @brief initializes a new iterator based on the inputs of the first and second mates
+    *
+    * @param first the input of the first mates
+    * @param second the input of the second mates
+    * @param check_names whether or not to check that the names of the mates match
+    */
+  PairedFastqIterator(const std::shared_ptr<utils::BlockReader>& first, const std::shared_ptr<utils::BlockReader>& second, const bool check_names = true);
+
+  /**
+    * @brief a PairedFastqIterator should never be copied as the underlying inputs can only be
+    * manipulated by one object.
+    */
+  PairedFastqIterator(const PairedFastqIterator&) = delete;
+  PairedFastqIterator& operator=(const PairedFastqIterator&) = delete;
+
+  /**
+    * @brief a PairedFastqIterator move constructor guarantees all objects will have the same state.
+    */
+  PairedFastqIterator(PairedFastqIterator&&);
+  PairedFastqIterator& operator=(PairedFastqIterator&&);
+
+  /**
+    * @brief waits for the batch being parsed before destroying the iterator
+    */
+  ~PairedFastqIterator();
+
+  bool operator==(const PairedFastqIterator& rhs) const;  ///< @brief whether or not the two iterators are the same (both at the end, or the same iteration)
+  bool operator!=(const PairedFastqIterator& rhs) const;  ///< @brief inequality operator (needed by for-each loop)
+
+  /**
+    * @brief dereference operator (needed by for-each loop)
+    *
+    * @return a reference to the current pair of mates
+    */
+  std::pair<Fastq, Fastq>& operator*();
+
+  /**
+    * @brief increment operator (needed by for-each loop)
+    *
+    * @return the next pair of mates (an empty pair at the end of the inputs)
+    */
+  std::pair<Fastq, Fastq>& operator++();
+
+ private:
+  struct State;
+  std::unique_ptr<State> m_state;   ///< parsers, batches and threads (null at the end of the inputs)
+  std::pair<Fastq, Fastq> m_end;     ///< what the iterator points to at the end of the inputs
+
+  void next_batch();
+};
+
+/**
+ * @brief whether or not two read names are the names of mates: the same name, or the same name with a /1 and /2
+ * (or any other) suffix
+ */
+bool mate_names_match(const std::string& first, const std::string& second);
+
+}  // end namespace gamgee
+
+#endif // gamgee__paired_fastq_iterator__guard
@@ -0,0 +1,37 @@
+#include "paired_fastq_reader.h"
+
+#include "exceptions.h"
+#include "utils/file_utils.h"
+
+using namespace std;
+
+namespace gamgee {
+
+static shared_ptr<utils::BlockReader> open_input(const string& filename, const uint32_t num_threads) {
+  auto input_stream = utils::make_shared_ifstream(filename);
+  if (input_stream->fail())
+    throw FileOpenException{filename};
+  return utils::make_block_reader(input_stream, num_threads);
+}
+
+PairedFastqReader::PairedFastqReader(const string& first_filename, const string& second_filename, const uint32_t num_threads, const bool check_names) :
+  m_first {open_input(first_filename, num_threads)},
+  m_second {open_input(second_filename, num_threads)},
+  m_check_names {check_names}
+{}
+
+PairedFastqReader::PairedFastqReader(istream* const first, istream* const second, const uint32_t num_threads, const bool check_names) :
+  m_first {utils::make_block_reader(shared_ptr<istream>(first), num_threads)},
+  m_second {utils::make_block_reader(shared_ptr<istream>(second), num_threads)},
+  m_check_names {check_names}
+{}
+
+PairedFastqIterator PairedFastqReader::begin() {
+  return PairedFastqIterator{m_first, m_second, m_check_names};
+}
+
+PairedFastqIterator PairedFastqReader::end() {
+  return PairedFastqIterator{};
+}
+
+}  // end of namespace
@@ -0,0 +1,86 @@
+#ifndef gamgee__paired_fastq_reader__guard
+#define gamgee__paired_fastq_reader__guard
+
+#include "paired_fastq_iterator.h"
+#include "utils/block_reader.h"
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+
+namespace gamgee {
+
+/**
+ * @brief Utility class to read the mates of paired-end reads from two Fastq files (e.g. R1 and R2) in a for-each
+ * loop
+ *
+ * Both files are parsed at the same time, each one by its own thread (see PairedFastqIterator), and the mates come
+ * out together:
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * for (auto& mates : PairedFastqReader{"sample_R1.fastq.gz", "sample_R2.fastq.gz"})
+ *   do_something_with_pair(mates.first, mates.second);
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Like the FastqReader, gzip and BGZF compressed inputs are decompressed on background threads.
+ */
+class PairedFastqReader {
+ public:
+
+  /**
+    * @brief reads through the records of two files (fasta or fastq) parsing them into pairs of Fastq objects
+    *
+    * @param first_filename the name of the file with the first mates
+    * @param second_filename the name of the file with the second mates
+    * @param num_threads number of threads decompressing each BGZF input
+    * @param check_names whether or not to check that the names of the mates match
+    */
+  PairedFastqReader(const std::string& first_filename, const std::string& second_filename, const uint32_t num_threads = 1, const bool check_names = true);
+
+  /**
+    * @brief reads through the records of two streams parsing them into pairs of Fastq objects
+    *
+    * @param first the stream with the first mates (owned by the reader from now on)
+    * @param second the stream with the second mates (owned by the reader from now on)
+    * @param num_threads number of threads decompressing each BGZF input
+    * @param check_names whether or not to check that the names of the mates match
+    */
+  PairedFastqReader(std::istream* const first, std::istream* const second, const uint32_t num_threads = 1, const bool check_names = true);
+
+  /**
+    * @brief move constructor for the PairedFastqReader class simply transfers all objects with the state
+    * maintained.
+    */
+  PairedFastqReader(PairedFastqReader&&) = default;
+  PairedFastqReader& operator=(PairedFastqReader&&) = default;
+
+  /**
+    * @brief a PairedFastqReader cannot be copied safely, as it is iterating over streams.
+    */
+  PairedFastqReader(const PairedFastqReader&) = delete;
+  PairedFastqReader& operator=(const PairedFastqReader&) = delete;
+
+  /**
+    * @brief creates a PairedFastqIterator pointing at the start of the inputs (needed by for-each loop)
+    *
+    * @return a PairedFastqIterator ready to start parsing the files
+    */
+  PairedFastqIterator begin();
+
+  /**
+    * @brief creates a PairedFastqIterator with no inputs (needed by for-each loop)
+    *
+    * @return a PairedFastqIterator that will match the end status of the iterator at the end of the inputs
+    */
+  PairedFastqIterator end();
+
+ private:
+  std::shared_ptr<utils::BlockReader> m_first;   ///< the (decompressed) input of the first mates
+  std::shared_ptr<utils::BlockReader> m_second;  ///< the (decompressed) input of the second mates
+  bool m_check_names;                            ///< whether or not to check that the names of the mates match
+};
+
+}  // end of namespace
+
+#endif // gamgee__paired_fastq_reader__guard
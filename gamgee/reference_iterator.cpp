@@ -1,22 +1,47 @@
 #include "reference_iterator.h"
 
 #include "exceptions.h"
-#include "fastq_iterator.h"
+#include "interval.h"
 
-namespace gamgee {
+#include <algorithm>
+#include <utility>
 
-const char ReferenceIterator::ref_base(const std::string& chromosome, const int one_based_location) {
-  while (m_iterator != FastqIterator{} && chromosome != m_sequence.name())
-    m_sequence = ++m_iterator;
+using namespace std;
 
-  if (m_iterator == FastqIterator{})
-    throw new ChromosomeNotFoundException{chromosome};
+namespace gamgee {
 
-  if (one_based_location > static_cast<const int>(m_sequence.sequence().size()))
-    throw new ChromosomeSizeException{chromosome, m_sequence.sequence().size(), one_based_location};
+ReferenceIterator::ReferenceIterator(const string& filename, const bool save_index) :
+  ReferenceIterator{IndexedReference{filename, save_index}}
+{}
+
+ReferenceIterator::ReferenceIterator(IndexedReference reference) :
+  m_reference {move(reference)},
+  m_contig {nullptr},
+  m_window_start {0},
+  m_window {}
+{}
+
+const char ReferenceIterator::ref_base(const string& chromosome, const int one_based_location) {
+  const auto position = uint64_t(one_based_location) - 1;   // locations before the start wrap around, out of the window
+  if (m_contig == nullptr || position - m_window_start >= m_window.size() || chromosome != m_contig->name)
+    move_window(chromosome, one_based_location);
+  return m_window[position - m_window_start];
+}
 
-  return m_sequence.sequence()[one_based_location-1];
+/**
+ * @brief reads the window of bases holding a location, checking that it is in the reference
+ */
+void ReferenceIterator::move_window(const string& chromosome, const int one_based_location) {
+  const auto& contig = m_reference.contig(chromosome);
+  if (one_based_location < 1 || uint64_t(one_based_location) > contig.length)
+    throw ChromosomeSizeException{chromosome, contig.length, one_based_location};
+  const auto window_start = (uint64_t(one_based_location) - 1) / window_size * window_size;
+  const auto window_end = min(window_start + window_size, contig.length);
+  const auto bases = m_reference.get_sequence_view(Interval{chromosome, uint32_t(window_start + 1), uint32_t(window_end)}, m_window);
+  if (bases.data() != m_window.data())   // on a single line of the file, not copied to m_window yet
+    m_window.assign(bases);
+  m_window_start = window_start;
+  m_contig = &contig;
 }
 
 } // namespace gamgee
-
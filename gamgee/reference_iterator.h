@@ -1,33 +1,55 @@
 #ifndef gamgee__reference_iterator__guard
 #define gamgee__reference_iterator__guard
 
-#include "fastq_iterator.h"
-#include "fastq_reader.h"
+#include "indexed_reference.h"
+
+#include <cstdint>
+#include <string>
 
 namespace gamgee {
 
 /**
  * @brief Utility class to access reference bases in a FastA-formatted reference genome
  *
- * @warn the chromosomes in this reference must be accessed in order, or an exception will be thrown
+ * The reference is memory-mapped and indexed (see IndexedReference), so bases can be asked for in any order: any
+ * base of any chromosome is found in constant time. The bases around the last one asked for are copied to a window
+ * of window_size bases, so walking along a chromosome reads the reference only once per window.
  */
 class ReferenceIterator {
  public:
-  ReferenceIterator(const std::string& filename) :
-    m_iterator {FastqReader{filename}.begin()},
-    m_sequence {*m_iterator}
-  {}
+  static constexpr uint32_t window_size = 4096;   ///< number of bases read from the reference at a time
+
+  /**
+   * @brief opens a FastA reference (see IndexedReference)
+   * @param filename the (uncompressed) FastA file
+   * @param save_index whether to save the .fai index next to the FastA file if it has to be built (by default it
+   * is only built in memory, and nothing is written next to the reference)
+   * @throw FileOpenException if the file can't be opened
+   * @throw ReferenceIndexException if the file is compressed or malformed, or if its index doesn't match it
+   */
+  ReferenceIterator(const std::string& filename, const bool save_index = false);
+
+  /**
+   * @brief accesses the bases of a reference already opened (sharing its mapping and index)
+   */
+  explicit ReferenceIterator(IndexedReference reference);
 
   /**
    * @brief return the reference base character at the desired location
    * @param chromosome the chromosome of the desired base
    * @param one_based_location the one-based genomic location of the base
+   * @throw ChromosomeNotFoundException if the chromosome is not in the reference
+   * @throw ChromosomeSizeException if the location is not in the chromosome
    */
   const char ref_base(const std::string& chromosome, const int one_based_location);
 
  private:
-  FastqIterator m_iterator;     ///< @brief the current state of the iterator through the FastA input file
-  Fastq& m_sequence;            ///< @brief a reference to the iterator's current sequence
+  IndexedReference m_reference;                  ///< @brief the indexed reference
+  const IndexedReference::Contig* m_contig;      ///< @brief the chromosome of the window (null before the first base is asked for)
+  uint64_t m_window_start;                       ///< @brief 0-based position of the first base of the window
+  std::string m_window;                          ///< @brief the bases of the window
+
+  void move_window(const std::string& chromosome, const int one_based_location);
 };
 
 } // namespace gamgee
@@ -2,10 +2,11 @@
 
 #include "fastq_reader.h"
 #include "interval.h"
-#include "utils/utils.h"
+#include "utils/base_encoding.h"
 
 #include <unordered_map>
 #include <string>
+#include <string_view>
 
 using namespace gamgee;
 using namespace std;
@@ -18,14 +19,18 @@ ReferenceMap::ReferenceMap(const std::string& filename) {
 }
 
 void ReferenceMap::read_fastq(FastqReader& reader) {
-  for (auto& fq : reader)  
-    this->insert({fq.name(), fq.sequence()});
+  for (auto& fq : reader)   // the records are not needed after this: their sequences are moved in, not copied
+    this->emplace(fq.name(), move(fq).sequence());
 }
 
 string ReferenceMap::get_sequence(const Interval& interval, const bool reverse_strand) const {
   const auto& seq = this->at(interval.chr());
-  auto result = seq.substr(interval.start()-1, interval.size());
-  return reverse_strand ? utils::complement(result) : result;
+  const auto bases = string_view{seq}.substr(interval.start()-1, interval.size());
+  if (!reverse_strand)
+    return string{bases};
+  auto result = string(bases.size(), '\0');
+  utils::complement_bases(bases.data(), bases.size(), &result[0]);   // straight from the contig, without an intermediate copy
+  return result;
 }
 
 }  // namespace gamgee
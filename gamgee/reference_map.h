@@ -14,6 +14,9 @@ namespace gamgee {
  * @brief Utility class to create a reference object for all reference operations in Foghorn.
  *
  * It hash table stores chr -> sequence as strings internally.
+ *
+ * @note the whole reference is loaded in memory: for large references, IndexedReference gives the same
+ * get_sequence() from a memory-mapped file instead.
  */
 class ReferenceMap : public std::unordered_map<std::string, std::string> {
  public:
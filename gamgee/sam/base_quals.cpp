@@ -1,37 +1,74 @@
 #include "base_quals.h"
+#include "sam.h"
 
+#include "../utils/base_encoding.h"
 #include "../utils/hts_memory.h"
 #include "../utils/utils.h"
 
+#include <algorithm>
 #include <string>
 #include <stdexcept>
-#include <sstream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
 namespace gamgee {
 
+QualityBinning::QualityBinning(const vector<pair<uint8_t, uint8_t>>& bins) {
+  for ( auto i = 1u; i < bins.size(); ++i ) {
+    if ( bins[i].first <= bins[i - 1].first )
+      throw invalid_argument{"Quality bins must be in increasing order of their lowest quality"};
+  }
+  for ( auto quality = 0u; quality != m_table.size(); ++quality )
+    m_table[quality] = uint8_t(quality);
+  for ( auto i = 0u; i < bins.size(); ++i ) {
+    const auto bin_end = i + 1 < bins.size() ? bins[i + 1].first : 256u;
+    fill(m_table.begin() + bins[i].first, m_table.begin() + bin_end, bins[i].second);
+  }
+  m_table_end = m_table.size();
+  while ( m_table_end > 1 && m_table[m_table_end - 2] == m_table.back() )
+    --m_table_end;
+}
+
+QualityBinning QualityBinning::illumina_8_level() {
+  return QualityBinning{{{2, 6}, {10, 15}, {20, 22}, {25, 27}, {30, 33}, {35, 37}, {40, 40}}};
+}
+
 /**
   * @brief creates a BaseQuals object that points to htslib memory already allocated
   *
   * @note the resulting BaseQuals object shares ownership of the pre-allocated memory via
   *       shared_ptr reference counting
   */
-BaseQuals::BaseQuals(const std::shared_ptr<bam1_t>& sam_record) :
+BaseQuals::BaseQuals(const utils::SamHandle& sam_record) :
   m_sam_record { sam_record },
   m_quals { bam_get_qual(sam_record.get()) },
-  m_num_quals { uint32_t((sam_record.get())->core.l_qseq) }
+  m_num_quals { uint32_t((sam_record.get())->core.l_qseq) },
+  m_record { nullptr }
 {}
 
+/**
+  * @brief a view of the base qualities of a record, that writes go to (see Sam::base_quals())
+  */
+BaseQuals::BaseQuals(const utils::SamHandle& sam_record, Sam* record) :
+  BaseQuals { sam_record }
+{
+  m_record = record;
+}
+
 /**
   * @brief creates a deep copy of a BaseQuals object
   *
   * @note the copy will have exclusive ownership over the newly-allocated htslib memory
   */
 BaseQuals::BaseQuals(const BaseQuals& other) :
-  m_sam_record { utils::make_shared_sam(utils::sam_deep_copy(other.m_sam_record.get())) },
+  m_sam_record { utils::SamRecordPool::thread_local_pool().deep_copy(other.m_sam_record.get()) },
   m_quals { bam_get_qual(m_sam_record.get()) },
-  m_num_quals { other.m_num_quals }
+  m_num_quals { other.m_num_quals },
+  m_record { nullptr }
 {}
 
 /**
@@ -42,9 +79,10 @@ BaseQuals::BaseQuals(const BaseQuals& other) :
 BaseQuals& BaseQuals::operator=(const BaseQuals& other) {
   if ( &other == this )  
     return *this;
-  m_sam_record = utils::make_shared_sam(utils::sam_deep_copy(other.m_sam_record.get())); ///< shared_ptr assignment will take care of deallocating old sam record if necessary
+  utils::SamRecordPool::thread_local_pool().assign(m_sam_record, other.m_sam_record.get()); ///< copies in place if this object is the only user of its record
   m_quals = bam_get_qual(m_sam_record.get()); 
   m_num_quals = other.m_num_quals;
+  m_record = nullptr;
   return *this;
 }
 
@@ -65,22 +103,20 @@ uint8_t BaseQuals::operator[](const uint32_t index) const {
  */
 uint8_t& BaseQuals::operator[](const uint32_t index) {
   utils::check_max_boundary(index, m_num_quals);
+  prepare_write();
   return m_quals[index];
 }
 
+void BaseQuals::prepare_write() {
+  if (Sam::prepare_view_write(m_record, m_sam_record))
+    m_quals = bam_get_qual(m_sam_record.get());
+}
+
 /**
  * @brief check whether this object contains the same base qualities as another BaseQuals object
  */
 bool BaseQuals::operator==(const BaseQuals& other) const {
-  if ( m_num_quals != other.m_num_quals )
-    return false;
-
-  for ( auto i = 0u; i < m_num_quals; ++i ) {
-    if ( m_quals[i] != other.m_quals[i] )
-      return false;
-  }
-
-  return true;
+  return m_num_quals == other.m_num_quals && equal(m_quals, m_quals + m_num_quals, other.m_quals);
 }
 
 /**
@@ -94,14 +130,135 @@ bool BaseQuals::operator!=(const BaseQuals& other) const {
  * @brief produce a string representation of the base qualities in this object
  */
 std::string BaseQuals::to_string() const {
-  stringstream stream;
-
+  auto result = string{};
+  result.reserve(4 * m_num_quals);   // up to three digits and a space per quality
   for ( auto i = 0u; i < m_num_quals; ++i ) {
-    stream << int(m_quals[i]);
-    if ( i < m_num_quals - 1 )
-      stream << " ";
+    const auto quality = m_quals[i];
+    if ( quality >= 100 )
+      result.push_back(char('0' + quality / 100));
+    if ( quality >= 10 )
+      result.push_back(char('0' + quality / 10 % 10));
+    result.push_back(char('0' + quality % 10));
+    result.push_back(' ');
   }
-  return stream.str();
+  if ( !result.empty() )
+    result.pop_back();
+  return result;
+}
+
+/**
+ * @brief the qualities in the Phred+33 ASCII encoding (eg., "II?5"), the way they are written to FASTQ and SAM files
+ */
+std::string BaseQuals::to_phred33() const {
+  auto result = string(m_num_quals, '\0');
+  utils::encode_phred33(m_quals, m_num_quals, &result[0]);
+  return result;
+}
+
+// The statistics below work on 16 qualities at a time with SSE2 (which every x86-64 CPU has) and finish the
+// last few qualities one by one.
+
+#if defined(__SSE2__)
+static uint64_t horizontal_sum(const __m128i sums) {   ///< adds up the two 64 bit lanes of a register
+  uint64_t lanes[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), sums);
+  return lanes[0] + lanes[1];
+}
+#endif
+
+uint64_t BaseQuals::sum() const {
+  auto total = uint64_t{0};
+  auto i = 0u;
+#if defined(__SSE2__)
+  auto sums = _mm_setzero_si128();
+  for ( ; i + 16 <= m_num_quals; i += 16 )   // psadbw adds up each half of the 16 bytes into a 64 bit lane
+    sums = _mm_add_epi64(sums, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(m_quals + i)), _mm_setzero_si128()));
+  total = horizontal_sum(sums);
+#endif
+  for ( ; i < m_num_quals; ++i )
+    total += m_quals[i];
+  return total;
+}
+
+double BaseQuals::mean() const {
+  return m_num_quals == 0 ? 0.0 : double(sum()) / m_num_quals;
+}
+
+uint8_t BaseQuals::min() const {
+  auto lowest = uint8_t{255};
+  auto i = 0u;
+#if defined(__SSE2__)
+  if ( m_num_quals >= 16 ) {
+    auto minimums = _mm_set1_epi8(char(255));
+    for ( ; i + 16 <= m_num_quals; i += 16 )
+      minimums = _mm_min_epu8(minimums, _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_quals + i)));
+    uint8_t lanes[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), minimums);
+    lowest = *min_element(lanes, lanes + 16);
+  }
+#endif
+  for ( ; i < m_num_quals; ++i )
+    lowest = std::min(lowest, m_quals[i]);
+  return lowest;
+}
+
+uint32_t BaseQuals::count_below(const uint8_t threshold) const {
+  if ( threshold == 0 )
+    return 0;
+  auto count = uint32_t{0};
+  auto i = 0u;
+#if defined(__SSE2__)
+  const auto highest_below = _mm_set1_epi8(char(threshold - 1));
+  auto counts = _mm_setzero_si128();
+  for ( ; i + 16 <= m_num_quals; i += 16 ) {
+    const auto qualities = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_quals + i));
+    const auto below = _mm_cmpeq_epi8(_mm_min_epu8(qualities, highest_below), qualities);   // quality <= threshold - 1 (unsigned)
+    counts = _mm_add_epi64(counts, _mm_sad_epu8(_mm_and_si128(below, _mm_set1_epi8(1)), _mm_setzero_si128()));
+  }
+  count = uint32_t(horizontal_sum(counts));
+#endif
+  for ( ; i < m_num_quals; ++i )
+    count += m_quals[i] < threshold;
+  return count;
+}
+
+/**
+ * @brief where to trim the 3' end of the read with a sliding window (as in Trimmomatic's SLIDINGWINDOW)
+ *
+ * Slides a window of window_size qualities from the start of the read and stops at the first window whose mean
+ * quality is below min_mean_quality. Reads shorter than the window are checked as a single window.
+ *
+ * @return the position of the first base of that window, ie. the number of bases to keep (size() if no window falls below the threshold)
+ * @throw std::invalid_argument if window_size is 0
+ */
+uint32_t BaseQuals::sliding_window_trim_position(const uint32_t window_size, const double min_mean_quality) const {
+  if ( window_size == 0 )
+    throw invalid_argument{"The sliding window must have at least one base"};
+  const auto window = std::min(window_size, m_num_quals);
+  if ( window == 0 )
+    return 0;
+  const auto min_window_sum = min_mean_quality * window;
+  auto window_sum = uint64_t{0};
+  for ( auto i = 0u; i < window; ++i )
+    window_sum += m_quals[i];
+  for ( auto start = 0u; ; ++start ) {
+    if ( double(window_sum) < min_window_sum )
+      return start;
+    if ( start + window == m_num_quals )
+      return m_num_quals;
+    window_sum += m_quals[start + window];
+    window_sum -= m_quals[start];
+  }
+}
+
+/**
+ * @brief maps every quality to its bin in place (see utils::lookup_quals())
+ *
+ * @note like operator[], this modifies the record the qualities belong to
+ */
+void BaseQuals::bin(const QualityBinning& binning) {
+  prepare_write();
+  utils::lookup_quals(binning.m_table.data(), binning.m_table_end, m_quals, m_num_quals, m_quals);
 }
 
 } // end of namespace gamgee
@@ -1,18 +1,62 @@
 #ifndef gamgee__base_quals__guard
 #define gamgee__base_quals__guard
 
+#include "../utils/record_handle.h"
+
 #include "htslib/sam.h"
 
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace gamgee {
 
+class Sam;
+
+/**
+ * @brief a mapping of base qualities to fewer quality levels (eg., the 8 levels of Illumina's binning), applied with BaseQuals::bin()
+ *
+ * Built once from a list of bins and kept as a lookup table, so that it can be applied to any number of reads (with
+ * the vectorized utils::lookup_quals()).
+ */
+class QualityBinning {
+ public:
+  /**
+   * @param bins pairs of (lowest quality of the bin, quality the bin is mapped to) in increasing order of lowest
+   *        quality. Each bin extends up to the next one (the last one up to 255). Qualities below the first bin are
+   *        left unchanged.
+   * @throw std::invalid_argument if the bins are not in strictly increasing order
+   */
+  explicit QualityBinning(const std::vector<std::pair<uint8_t, uint8_t>>& bins);
+
+  uint8_t operator()(const uint8_t quality) const { return m_table[quality]; }  ///< @brief the binned value of a quality
+
+  /**
+   * @brief Illumina's 8 level binning: 2-9 to 6, 10-19 to 15, 20-24 to 22, 25-29 to 27, 30-34 to 33, 35-39 to 37 and 40 and above to 40
+   * @note qualities 0 and 1 (eg., no-calls) are left unchanged. Missing qualities (255) are binned to 40, so don't bin reads without qualities.
+   */
+  static QualityBinning illumina_8_level();
+
+ private:
+  std::array<uint8_t, 256> m_table;   ///< binned value of every quality
+  uint32_t m_table_end;               ///< qualities from this one on are all binned like 255 (only the entries below it are looked up)
+
+  friend class BaseQuals;
+};
+
 /**
  * @brief Utility class to handle the memory management of the sam record object for a read base qualities
+ *
+ * @note writing through a view obtained from a non-const Sam modifies that record (after it stops sharing its
+ *       memory with its copies, see Sam), which must still be alive. Writing through any other view first gives
+ *       the view its own copy of the qualities if anything else shares them.
  */
 class BaseQuals {
  public:
-  explicit BaseQuals(const std::shared_ptr<bam1_t>& sam_record);
+  explicit BaseQuals(const utils::SamHandle& sam_record);
   BaseQuals(const BaseQuals& other);
   BaseQuals(BaseQuals&& other) = default;
   BaseQuals& operator=(const BaseQuals& other);
@@ -25,13 +69,35 @@ class BaseQuals {
   bool operator==(const BaseQuals& other) const;  ///< check for equality with another BaseQuals object
   bool operator!=(const BaseQuals& other) const;  ///< check for inequality with another BaseQuals object
   std::string to_string() const;                  ///< produce a string representation of the base qualities in this object
+  std::string to_phred33() const;                 ///< the qualities in the Phred+33 ASCII encoding of FASTQ and SAM files (capped at 93, see utils::encode_phred33())
+
+  // Unchecked contiguous access to the qualities, for loops and kernels that don't need bounds checks on every access
+  const uint8_t* data() const { return m_quals; }                  ///< @brief the size() qualities, valid as long as the record is alive and not modified
+  uint8_t* data() { prepare_write(); return m_quals; }             ///< @brief the size() qualities, to modify them in place
+  const uint8_t* begin() const { return m_quals; }                 ///< @brief unchecked iteration (eg., with standard algorithms)
+  const uint8_t* end() const { return m_quals + m_num_quals; }
+  uint8_t* begin() { prepare_write(); return m_quals; }
+  uint8_t* end() { prepare_write(); return m_quals + m_num_quals; }
+
+  // Vectorized whole-read statistics
+  uint64_t sum() const;                                            ///< @brief sum of the qualities
+  double mean() const;                                             ///< @brief mean quality (0 for reads without bases)
+  uint8_t min() const;                                             ///< @brief lowest quality (255 for reads without bases)
+  uint32_t count_below(const uint8_t threshold) const;             ///< @brief number of qualities lower than threshold
+  uint32_t sliding_window_trim_position(const uint32_t window_size, const double min_mean_quality) const;  ///< @brief number of bases to keep when trimming the 3' end with a sliding window of mean quality
+  void bin(const QualityBinning& binning);                         ///< @brief maps every quality to its bin in place (eg., to reduce the size of compressed BAM files)
 
  private:
-  std::shared_ptr<bam1_t> m_sam_record; ///< sam record containing our base qualities, potentially co-owned by multiple other objects
+  utils::SamHandle m_sam_record; ///< sam record containing our base qualities, potentially co-owned by multiple other objects
   uint8_t* m_quals;                     ///< Pointer to the start of the base qualities in m_sam_record, cached for efficiency
   uint32_t m_num_quals;                 ///< Number of quality scores in our sam record
+  Sam* m_record;                        ///< record the view was obtained from, that writes go to (null if none)
+
+  BaseQuals(const utils::SamHandle& sam_record, Sam* record);
+  void prepare_write();                 ///< @brief makes sure nothing but m_record (if any) shares the qualities before they are modified
 
   friend class SamBuilder; ///< builder needs access to the internals in order to build efficiently
+  friend class Sam;
 };
 
 }
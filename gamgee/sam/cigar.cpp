@@ -1,4 +1,5 @@
 #include "cigar.h"
+#include "sam.h"
 
 #include "../utils/hts_memory.h"
 #include "../utils/utils.h"
@@ -23,21 +24,32 @@ const std::vector<int8_t> Cigar::cigar_op_parse_table = {-1,-1,-1,-1,-1,-1,-1,-1
   * @note the resulting Cigar object shares ownership of the pre-allocated memory via
   *       shared_ptr reference counting
   */
-Cigar::Cigar(const std::shared_ptr<bam1_t>& sam_record) :
+Cigar::Cigar(const utils::SamHandle& sam_record) :
   m_sam_record { sam_record },
   m_cigar { bam_get_cigar(sam_record.get()) },
-  m_num_cigar_elements { (sam_record.get())->core.n_cigar }
+  m_num_cigar_elements { (sam_record.get())->core.n_cigar },
+  m_record { nullptr }
 {}
 
+/**
+  * @brief a view of the cigar of a record, that writes go to (see Sam::cigar())
+  */
+Cigar::Cigar(const utils::SamHandle& sam_record, Sam* record) :
+  Cigar { sam_record }
+{
+  m_record = record;
+}
+
 /**
   * @brief creates a deep copy of a Cigar object
   *
   * @note the copy will have exclusive ownership over the newly-allocated htslib memory
   */
 Cigar::Cigar(const Cigar& other) :
-  m_sam_record { utils::make_shared_sam(utils::sam_deep_copy(other.m_sam_record.get())) },
+  m_sam_record { utils::SamRecordPool::thread_local_pool().deep_copy(other.m_sam_record.get()) },
   m_cigar { bam_get_cigar(m_sam_record.get()) },
-  m_num_cigar_elements { other.m_num_cigar_elements }
+  m_num_cigar_elements { other.m_num_cigar_elements },
+  m_record { nullptr }
 {}
 
 /**
@@ -48,9 +60,10 @@ Cigar::Cigar(const Cigar& other) :
 Cigar& Cigar::operator=(const Cigar& other) {
   if (&other == this) ///< check for self assignment
     return *this; 
-  m_sam_record = utils::make_shared_sam(utils::sam_deep_copy(other.m_sam_record.get())); ///< shared_ptr assignment will take care of deallocating old sam record if necessary
+  utils::SamRecordPool::thread_local_pool().assign(m_sam_record, other.m_sam_record.get()); ///< copies in place if this object is the only user of its record
   m_cigar = bam_get_cigar(m_sam_record.get());
   m_num_cigar_elements = other.m_num_cigar_elements;
+  m_record = nullptr;
   return *this;
 }
 
@@ -73,9 +86,15 @@ CigarElement Cigar::operator[](const uint32_t index) const {
   */
 CigarElement& Cigar::operator[](const uint32_t index) {
   utils::check_max_boundary(index, m_num_cigar_elements);
+  prepare_write();
   return m_cigar[index];
 }
 
+void Cigar::prepare_write() {
+  if (Sam::prepare_view_write(m_record, m_sam_record))
+    m_cigar = bam_get_cigar(m_sam_record.get());
+}
+
 bool Cigar::operator==(const Cigar& other) const {
   if ( m_num_cigar_elements != other.m_num_cigar_elements )
     return false;
@@ -119,5 +138,23 @@ CigarElement Cigar::parse_next_cigar_element (stringstream& cigar_stream) {
   return make_cigar_element(element_length, static_cast<CigarOperator>(encoded_op));
 }
 
+CigarElement Cigar::parse_next_cigar_element (string_view& cigar) {
+  auto element_length = uint32_t{0};
+  auto position = size_t{0};
+  for ( ; position < cigar.size() && uint8_t(cigar[position] - '0') < 10; ++position ) {
+    element_length = element_length * 10 + uint32_t(cigar[position] - '0');
+    if ( element_length > (UINT32_MAX >> BAM_CIGAR_SHIFT) )
+      throw invalid_argument(string("Cigar operation too long in cigar string: ") + string{cigar});
+  }
+  if ( position == 0 || position == cigar.size() )
+    throw invalid_argument(string("Error parsing cigar string: ") + string{cigar});
+  const auto element_op = uint8_t(cigar[position]);
+  const auto encoded_op = element_op < 128 ? cigar_op_parse_table[element_op] : -1;
+  if ( encoded_op < 0 )
+    throw invalid_argument(string("Unrecognized operator ") + char(element_op) + " in cigar string: " + string{cigar});
+  cigar.remove_prefix(position + 1);
+  return make_cigar_element(element_length, static_cast<CigarOperator>(encoded_op));
+}
+
 
 }
@@ -1,10 +1,13 @@
 #ifndef gamgee__cigar__guard
 #define gamgee__cigar__guard
 
+#include "../utils/record_handle.h"
+
 #include "htslib/sam.h"
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
 
@@ -18,12 +21,18 @@ enum class CigarOperator { M, I, D, N, S, H, P, EQ, X, B };
 
 using CigarElement = uint32_t;
 
+class Sam;
+
 /**
  * @brief Utility class to manage the memory of the cigar structure
+ *
+ * @note writing through a view obtained from a non-const Sam modifies that record (after it stops sharing its
+ *       memory with its copies, see Sam), which must still be alive. Writing through any other view first gives
+ *       the view its own copy of the cigar if anything else shares it.
  */
 class Cigar {
  public:
-  explicit Cigar(const std::shared_ptr<bam1_t>& sam_record);
+  explicit Cigar(const utils::SamHandle& sam_record);
   Cigar(const Cigar& other);
   Cigar(Cigar&& other) = default;
   Cigar& operator=(const Cigar& other);
@@ -83,18 +92,38 @@ class Cigar {
    */
   static CigarElement parse_next_cigar_element (std::stringstream& cigar_stream);
 
+  /**
+   * @brief parses the first element of a cigar string without copying it, advancing the view past that element
+   *
+   * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   * auto cigar = std::string_view{cigar_string};
+   * while (!cigar.empty()) {
+   *   const auto element = parse_next_cigar_element(cigar);
+   *   do_something_with(Cigar::cigar_op(element), Cigar::cigar_oplen(element));
+   * }
+   * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   *
+   * @throw std::invalid_argument if the view doesn't start with a length followed by a valid operator
+   */
+  static CigarElement parse_next_cigar_element (std::string_view& cigar);
+
   inline static bool consumes_read_bases(const CigarOperator op) {return bam_cigar_type(static_cast<int8_t>(op))&1;}      ///< returns true if operator is one of the following: Match (M), Insertion (I), Soft-Clip (S), Equal (=) or Different (X)
   inline static bool consumes_reference_bases(const CigarOperator op) {return bam_cigar_type(static_cast<int8_t>(op))&2;} ///< returns true if operator is one of the following: Match (M), Deletion (D), Reference-Skip (N), Equal (=) or Different (X)
 
 
 
  private:
-  std::shared_ptr<bam1_t> m_sam_record;   ///< sam record containing our cigar, potentially co-owned by multiple other objects
+  utils::SamHandle m_sam_record;   ///< sam record containing our cigar, potentially co-owned by multiple other objects
   uint32_t* m_cigar;                      ///< pointer to the start of the cigar in m_sam_record, cached for efficiency
   uint32_t m_num_cigar_elements;          ///< number of elements in our cigar
+  Sam* m_record;                          ///< record the view was obtained from, that writes go to (null if none)
 
   static const char cigar_ops_as_chars[]; ///< static lookup table to convert CigarOperator enum values to chars.
 
+  Cigar(const utils::SamHandle& sam_record, Sam* record);
+  void prepare_write();                   ///< @brief makes sure nothing but m_record (if any) shares the cigar before it is modified
+
+  friend class Sam;
   friend class SamBuilder; ///< builder needs access to the internals in order to build efficiently
 };
 
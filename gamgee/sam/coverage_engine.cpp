@@ -0,0 +1,216 @@
+#include "coverage_engine.h"
+
+#include "../exceptions.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <future>
+#include <stdexcept>
+
+using namespace std;
+
+namespace gamgee {
+
+double CoverageSummary::fraction_at_least(const uint32_t threshold) const {
+  const auto it = find(m_thresholds.cbegin(), m_thresholds.cend(), threshold);
+  if (it == m_thresholds.cend())
+    throw invalid_argument{"coverage threshold was not requested when summarizing"};
+  return m_fractions[it - m_thresholds.cbegin()];
+}
+
+CoverageEngine::CoverageEngine(const std::string& filename, const CoverageOptions& options) :
+  m_filename {filename},
+  m_options {options},
+  m_sam_file_ptr {},
+  m_sam_header_ptr {},
+  m_sam_index_ptr {},
+  m_file_mutex {},
+  m_idle_files {},
+  m_pool {options.num_threads}
+{
+  auto* file_ptr = sam_open(filename.c_str(), "r");
+  if (file_ptr == nullptr)
+    throw FileOpenException{filename};
+  m_sam_file_ptr = utils::make_shared_hts_file(file_ptr);
+  auto* header_ptr = sam_hdr_read(file_ptr);
+  if (header_ptr == nullptr)
+    throw HeaderReadException{filename};
+  m_sam_header_ptr = utils::make_shared_sam_header(header_ptr);
+  auto* index_ptr = sam_index_load(file_ptr, filename.c_str());
+  if (index_ptr == nullptr)
+    throw IndexLoadException{filename};
+  m_sam_index_ptr = utils::make_shared_hts_index(index_ptr);
+  m_options.tile_size = max(m_options.tile_size, 1u);
+}
+
+void CoverageEngine::for_each_tile(const std::function<void(const CoverageTile&)>& callback) {
+  auto contigs = vector<Interval>{};
+  for (auto i = 0; i < m_sam_header_ptr->n_targets; ++i)
+    contigs.emplace_back(m_sam_header_ptr->target_name[i], 1, m_sam_header_ptr->target_len[i]);
+  for_each_tile(contigs, callback);
+}
+
+void CoverageEngine::for_each_tile(const std::vector<Interval>& intervals, const std::function<void(const CoverageTile&)>& callback) {
+  run(make_tiles(intervals), [&callback](const TileRequest&, const CoverageTile& tile) { callback(tile); });
+}
+
+/**
+ * @brief accumulates a histogram of depths per interval as the tiles come in, so the summaries don't need
+ * to hold on to the per-base depths
+ */
+vector<CoverageSummary> CoverageEngine::summarize(const std::vector<Interval>& intervals, const std::vector<uint32_t>& thresholds) {
+  auto histograms = vector<vector<uint64_t>>(intervals.size());
+  run(make_tiles(intervals), [&histograms](const TileRequest& request, const CoverageTile& tile) {
+    auto& histogram = histograms[request.interval];
+    for (const auto depth : tile.depths()) {
+      if (depth >= histogram.size())
+        histogram.resize(depth + 1);
+      ++histogram[depth];
+    }
+  });
+  auto result = vector<CoverageSummary>{};
+  result.reserve(intervals.size());
+  for (auto i = 0u; i != intervals.size(); ++i) {
+    const auto& histogram = histograms[i];
+    const auto positions = intervals[i].size();
+    auto total = 0.0;
+    auto median = 0u;
+    auto cumulative = uint64_t{0};
+    auto median_found = false;
+    for (auto depth = 0u; depth != histogram.size(); ++depth) {
+      total += double(depth) * histogram[depth];
+      cumulative += histogram[depth];
+      if (!median_found && cumulative >= (positions + 1) / 2) {
+        median = depth;
+        median_found = true;
+      }
+    }
+    auto fractions = vector<double>{};
+    fractions.reserve(thresholds.size());
+    for (const auto threshold : thresholds) {
+      auto at_least = uint64_t{0};
+      for (auto depth = size_t{threshold}; depth < histogram.size(); ++depth)
+        at_least += histogram[depth];
+      fractions.push_back(positions == 0 ? 0.0 : double(at_least) / positions);
+    }
+    result.emplace_back(intervals[i], positions == 0 ? 0.0 : total / positions, median, thresholds, move(fractions));
+  }
+  return result;
+}
+
+vector<CoverageEngine::TileRequest> CoverageEngine::make_tiles(const std::vector<Interval>& intervals) const {
+  auto tiles = vector<TileRequest>{};
+  for (auto i = 0u; i != intervals.size(); ++i) {
+    const auto& interval = intervals[i];
+    const auto chromosome = bam_name2id(m_sam_header_ptr.get(), interval.chr().c_str());
+    if (chromosome < 0)
+      throw ChromosomeNotFoundException{interval.chr()};
+    for (auto start = interval.start() - 1; start < interval.stop(); start += min(m_options.tile_size, interval.stop() - start))
+      tiles.push_back(TileRequest{chromosome, start, start + min(m_options.tile_size, interval.stop() - start), i});
+  }
+  return tiles;
+}
+
+/**
+ * @brief keeps up to two tiles per worker in flight and hands them to the callback in order
+ */
+void CoverageEngine::run(const std::vector<TileRequest>& tiles, const std::function<void(const TileRequest&, const CoverageTile&)>& callback) {
+  const auto max_in_flight = size_t{2} * m_pool.size();
+  auto in_flight = deque<future<CoverageTile>>{};
+  auto next = 0u;
+  for (auto done = 0u; done != tiles.size(); ++done) {
+    for (; next != tiles.size() && in_flight.size() < max_in_flight; ++next) {
+      const auto request = tiles[next];
+      in_flight.push_back(m_pool.submit([this, request]{ return compute_tile(request); }));
+    }
+    const auto tile = in_flight.front().get();
+    in_flight.pop_front();
+    callback(tiles[done], tile);
+  }
+}
+
+/**
+ * @brief adds every reference block of every read overlapping the tile to a difference array (clipped to the
+ * tile) and prefix sums it into per-base depths
+ */
+CoverageTile CoverageEngine::compute_tile(const TileRequest& tile) {
+  auto difference = vector<int32_t>(tile.stop - tile.start + 1, 0);
+  const auto file = FileLease{*this};
+  auto* iterator_ptr = sam_itr_queryi(m_sam_index_ptr.get(), tile.chromosome, int(tile.start), int(tile.stop));
+  if (iterator_ptr == nullptr)
+    throw HtslibException{-1};
+  auto iterator = utils::make_unique_hts_itr(iterator_ptr);
+  auto record = unique_ptr<bam1_t, utils::SamBodyDeleter>{bam_init1()};
+  const auto tile_start = int64_t{tile.start};
+  const auto tile_stop = int64_t{tile.stop};
+  auto status = 0;
+  while ((status = sam_itr_next(file.get(), iterator.get(), record.get())) >= 0) {
+    const auto& core = record->core;
+    if ((core.flag & m_options.excluded_flags) || core.qual < m_options.min_mapping_qual)
+      continue;
+    const auto cigar = bam_get_cigar(record.get());
+    auto reference = int64_t{core.pos};
+    for (auto i = 0u; i != core.n_cigar && reference < tile_stop; ++i) {
+      const auto op = bam_cigar_op(cigar[i]);
+      const auto length = int64_t{bam_cigar_oplen(cigar[i])};
+      if (!(bam_cigar_type(op) & 2))
+        continue;
+      const auto counted = op == BAM_CMATCH || op == BAM_CEQUAL || op == BAM_CDIFF || (op == BAM_CDEL && m_options.count_deletions);
+      const auto block_start = max(reference, tile_start);
+      const auto block_stop = min(reference + length, tile_stop);
+      if (counted && block_start < block_stop) {
+        ++difference[block_start - tile_start];
+        --difference[block_stop - tile_start];
+      }
+      reference += length;
+    }
+  }
+  if (status < -1)   // -1 is the end of the tile, anything below a read error (e.g. a truncated file)
+    throw HtslibException{status};
+  auto depths = vector<uint32_t>(tile.stop - tile.start);
+  auto depth = 0;
+  for (auto i = 0u; i != depths.size(); ++i) {
+    depth += difference[i];
+    depths[i] = uint32_t(depth);
+  }
+  return CoverageTile{uint32_t(tile.chromosome), tile.start + 1, move(depths)};
+}
+
+CoverageEngine::FileLease::FileLease(CoverageEngine& engine) :
+  m_engine {engine},
+  m_file {engine.acquire_file()},
+  m_uncaught_exceptions {uncaught_exceptions()}
+{}
+
+CoverageEngine::FileLease::~FileLease() {
+  if (uncaught_exceptions() == m_uncaught_exceptions)
+    m_engine.release_file(move(m_file));
+}
+
+unique_ptr<htsFile, utils::HtsFileDeleter> CoverageEngine::acquire_file() {
+  {
+    lock_guard<mutex> lock {m_file_mutex};
+    if (!m_idle_files.empty()) {
+      auto file = move(m_idle_files.back());
+      m_idle_files.pop_back();
+      return file;
+    }
+  }
+  auto* file_ptr = sam_open(m_filename.c_str(), "r");
+  if (file_ptr == nullptr)
+    throw FileOpenException{m_filename};
+  auto file = utils::make_unique_hts_file(file_ptr);
+  // readers set up their state from the header (e.g. CRAM), even though the workers use the engine's copy of it
+  const auto header = unique_ptr<bam_hdr_t, utils::SamHeaderDeleter>{sam_hdr_read(file_ptr)};
+  if (header == nullptr)
+    throw HeaderReadException{m_filename};
+  return file;
+}
+
+void CoverageEngine::release_file(std::unique_ptr<htsFile, utils::HtsFileDeleter>&& file) {
+  lock_guard<mutex> lock {m_file_mutex};
+  m_idle_files.push_back(move(file));
+}
+
+}
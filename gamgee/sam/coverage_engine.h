@@ -0,0 +1,182 @@
+#ifndef gamgee__coverage_engine__guard
+#define gamgee__coverage_engine__guard
+
+#include "sam_header.h"
+
+#include "../interval.h"
+#include "../utils/hts_memory.h"
+#include "../utils/thread_pool.h"
+
+#include "htslib/sam.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gamgee {
+
+/**
+ * @brief read filters and parallelism settings of the CoverageEngine
+ */
+struct CoverageOptions {
+  uint32_t num_threads {1};                                                      ///< number of worker threads computing tiles
+  uint32_t tile_size {1u << 20};                                                 ///< number of reference positions per tile (memory use is proportional to num_threads * tile_size)
+  uint16_t excluded_flags {BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP}; ///< reads with any of these flags set are not counted
+  uint8_t min_mapping_qual {0};                                                  ///< reads with a mapping quality below this value are not counted
+  bool count_deletions {false};                                                  ///< whether or not deleted bases (D) count towards depth
+};
+
+/**
+ * @brief per-base depth of a contiguous stretch of the reference
+ */
+class CoverageTile {
+ public:
+  CoverageTile() = default;
+  CoverageTile(const uint32_t chromosome, const uint32_t start, std::vector<uint32_t>&& depths) :
+    m_chromosome {chromosome}, m_start {start}, m_depths {std::move(depths)} {}
+
+  uint32_t chromosome() const { return m_chromosome; }                                      ///< @brief chromosome index (0-based, as in the sam header)
+  uint32_t start() const { return m_start; }                                                ///< @brief first position of the tile (1-based, inclusive)
+  uint32_t stop() const { return m_start + uint32_t(m_depths.size()) - 1; }                 ///< @brief last position of the tile (1-based, inclusive)
+  uint32_t size() const { return uint32_t(m_depths.size()); }                               ///< @brief number of positions in the tile
+  uint32_t depth(const uint32_t position) const { return m_depths[position - m_start]; }    ///< @brief depth at a (1-based) position of the tile. @warning no bounds checking
+  const std::vector<uint32_t>& depths() const { return m_depths; }                          ///< @brief depth of every position of the tile, starting at start()
+
+ private:
+  uint32_t m_chromosome {0};
+  uint32_t m_start {0};
+  std::vector<uint32_t> m_depths {};
+};
+
+/**
+ * @brief depth of coverage statistics of an Interval
+ */
+class CoverageSummary {
+ public:
+  CoverageSummary(const Interval& interval, const double mean, const uint32_t median, const std::vector<uint32_t>& thresholds, std::vector<double>&& fractions) :
+    m_interval {interval}, m_mean {mean}, m_median {median}, m_thresholds {thresholds}, m_fractions {std::move(fractions)} {}
+
+  const Interval& interval() const { return m_interval; } ///< @brief the summarized interval
+  double mean() const { return m_mean; }                  ///< @brief mean depth over all positions of the interval
+  uint32_t median() const { return m_median; }            ///< @brief median depth over all positions of the interval (lower median for an even number of positions)
+
+  /**
+   * @brief fraction of the positions of the interval with depth greater or equal to threshold
+   * @throw std::invalid_argument if threshold was not one of the thresholds requested in CoverageEngine::summarize()
+   */
+  double fraction_at_least(const uint32_t threshold) const;
+
+ private:
+  Interval m_interval;
+  double m_mean;
+  uint32_t m_median;
+  std::vector<uint32_t> m_thresholds;
+  std::vector<double> m_fractions;
+};
+
+/**
+ * @brief Computes depth of coverage of an indexed SAM/BAM/CRAM file in parallel
+ *
+ * The reference is cut in tiles (of CoverageOptions::tile_size positions) that are computed independently
+ * by a pool of worker threads, each one querying the index for the reads overlapping its tile. Within a
+ * tile, each reference block of a read's cigar adds one entry at its start and removes one at its end in a
+ * difference array, so a read costs one pass over its cigar regardless of its length, and the per-base
+ * depths come out of a single prefix sum.
+ *
+ * Tiles are delivered in reference order and only a couple of tiles per thread are in flight at any given
+ * time, so memory is bounded by the tile size and not by the contig length:
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * auto options = CoverageOptions{};
+ * options.num_threads = 8;
+ * CoverageEngine engine {"file.bam", options};
+ * engine.for_each_tile([](const CoverageTile& tile) {
+ *   for (auto position = tile.start(); position <= tile.stop(); ++position)
+ *     cout << tile.chromosome() << "\t" << position << "\t" << tile.depth(position) << "\n";
+ * });
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ */
+class CoverageEngine {
+ public:
+  /**
+   * @brief opens an indexed sam/bam/cram file for coverage computation
+   * @throw FileOpenException, HeaderReadException or IndexLoadException if the file cannot be used
+   */
+  explicit CoverageEngine(const std::string& filename, const CoverageOptions& options = CoverageOptions{});
+
+  /**
+   * @brief no copy or move construction/assignment allowed (the engine owns a thread pool)
+   */
+  CoverageEngine(const CoverageEngine&) = delete;
+  CoverageEngine& operator=(const CoverageEngine&) = delete;
+
+  /**
+   * @brief streams the per-base depth of every contig in the header, in order, one tile at a time
+   */
+  void for_each_tile(const std::function<void(const CoverageTile&)>& callback);
+
+  /**
+   * @brief streams the per-base depth of each interval, in the order given, one tile at a time
+   * @throw ChromosomeNotFoundException if an interval is on a contig that is not in the header
+   */
+  void for_each_tile(const std::vector<Interval>& intervals, const std::function<void(const CoverageTile&)>& callback);
+
+  /**
+   * @brief computes mean, median and fraction of positions at or above each threshold for each interval
+   * @throw ChromosomeNotFoundException if an interval is on a contig that is not in the header
+   */
+  std::vector<CoverageSummary> summarize(const std::vector<Interval>& intervals, const std::vector<uint32_t>& thresholds = {1, 10, 20, 30});
+
+  SamHeader header() const { return SamHeader{m_sam_header_ptr}; }
+
+ private:
+  /**
+   * @brief a stretch of reference to be computed by one task, [start, stop) 0-based
+   */
+  struct TileRequest {
+    int32_t chromosome;
+    uint32_t start;
+    uint32_t stop;
+    uint32_t interval;  ///< index of the interval this tile belongs to
+  };
+
+  /**
+   * @brief a file handle borrowed from the idle ones by a worker, and given back when it goes out of scope
+   *
+   * If an exception is being thrown, the handle is closed instead (a failed read may leave it in an error state).
+   */
+  class FileLease {
+   public:
+    explicit FileLease(CoverageEngine& engine);
+    ~FileLease();
+    FileLease(const FileLease&) = delete;
+    FileLease& operator=(const FileLease&) = delete;
+    htsFile* get() const { return m_file.get(); }
+
+   private:
+    CoverageEngine& m_engine;
+    std::unique_ptr<htsFile, utils::HtsFileDeleter> m_file;
+    int m_uncaught_exceptions;   ///< number of exceptions being thrown when the lease was taken
+  };
+
+  std::string m_filename;                                                    ///< name of the file, re-opened by each worker
+  CoverageOptions m_options;                                                 ///< filters, tile size and number of threads
+  std::shared_ptr<htsFile> m_sam_file_ptr;                                   ///< file used to read the header and the index
+  std::shared_ptr<bam_hdr_t> m_sam_header_ptr;                               ///< header, shared (read only) by all workers
+  std::shared_ptr<hts_idx_t> m_sam_index_ptr;                                ///< index, shared (read only) by all workers
+  std::mutex m_file_mutex;                                                   ///< protects m_idle_files
+  std::vector<std::unique_ptr<htsFile, utils::HtsFileDeleter>> m_idle_files; ///< file handles not currently used by a worker
+  utils::ThreadPool m_pool;                                                  ///< workers (declared last so they are joined before anything else is destroyed)
+
+  std::vector<TileRequest> make_tiles(const std::vector<Interval>& intervals) const;
+  void run(const std::vector<TileRequest>& tiles, const std::function<void(const TileRequest&, const CoverageTile&)>& callback);
+  CoverageTile compute_tile(const TileRequest& tile);
+  std::unique_ptr<htsFile, utils::HtsFileDeleter> acquire_file();
+  void release_file(std::unique_ptr<htsFile, utils::HtsFileDeleter>&& file);
+};
+
+}  // end of namespace gamgee
+
+#endif // gamgee__coverage_engine__guard
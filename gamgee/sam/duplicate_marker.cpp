@@ -0,0 +1,413 @@
+#include "duplicate_marker.h"
+#include "sam_reader.h"
+#include "sam_writer.h"
+
+#include "../exceptions.h"
+
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace gamgee {
+
+constexpr auto MIN_SCORED_BASE_QUAL = 15;  ///< base qualities below this value don't count towards the score of a read (as in Picard)
+
+bool DuplicateMarker::Signature::operator==(const Signature& other) const {
+  return chromosome1 == other.chromosome1 && position1 == other.position1 && chromosome2 == other.chromosome2 &&
+    position2 == other.position2 && library == other.library && orientation == other.orientation && paired == other.paired;
+}
+
+size_t DuplicateMarker::SignatureHash::operator()(const Signature& signature) const {
+  auto hash = uint64_t(uint32_t(signature.chromosome1)) << 32 | uint32_t(signature.position1);
+  hash ^= (uint64_t(uint32_t(signature.chromosome2)) << 32 | uint32_t(signature.position2)) * 0x9E3779B97F4A7C15ull;
+  hash ^= (uint64_t(signature.library) << 16 | uint64_t(signature.orientation) << 8 | signature.paired) * 0xC2B2AE3D27D4EB4Full;
+  return size_t(hash ^ (hash >> 29));
+}
+
+bool DuplicateMarker::ReadyEntry::operator>(const ReadyEntry& other) const {
+  return tie(chromosome, position) > tie(other.chromosome, other.position);
+}
+
+DuplicateMarker::DuplicateMarker(const DuplicateMarkerOptions& options) :
+  m_options {options},
+  m_pool {options.num_threads}
+{
+  m_options.batch_size = max(m_options.batch_size, 1u);
+  reset();
+}
+
+/**
+ * @brief the first pass only records the duplicate flag of every record (by input position), since the records
+ * of undecided templates come out of order; the second pass writes the records in input order
+ */
+DuplicateMetrics DuplicateMarker::mark(const std::string& input_filename, const std::string& output_filename) {
+  struct stat input_status;
+  if (stat(input_filename.c_str(), &input_status) != 0 || !S_ISREG(input_status.st_mode))
+    throw invalid_argument{input_filename + " is not a regular file: its duplicates are marked by reading it twice"};
+  auto duplicates = vector<bool>{};
+  auto metrics = DuplicateMetrics{};
+  {
+    auto reader = SingleSamReader{input_filename};
+    auto libraries = unordered_map<string, uint16_t>{};
+    auto library_of_read_group = unordered_map<string, uint16_t>{};
+    for (const auto& read_group : reader.header().read_groups()) {
+      const auto library = libraries.emplace(read_group.library, uint16_t(libraries.size() + 1)).first->second;
+      library_of_read_group.emplace(read_group.id, library);
+    }
+    auto iterator = reader.begin();
+    const auto end = reader.end();
+    metrics = mark([&iterator, &end](Sam& record) {
+                     if (!(iterator != end))
+                       return false;
+                     record = *iterator;    // copy-on-write: the iterator moves on to a new record
+                     ++iterator;
+                     return true;
+                   },
+                   [&duplicates](Sam& record, const uint64_t index) {
+                     if (index >= duplicates.size())
+                       duplicates.resize(index + 1);
+                     duplicates[index] = record.duplicate();
+                   },
+                   library_of_read_group);
+  }
+  auto reader = SingleSamReader{input_filename};
+  auto writer = SamWriter{reader.header(), output_filename, m_options.binary_output};
+  auto index = size_t{0};
+  for (auto& record : reader) {
+    if (index == duplicates.size())
+      throw OutputException{input_filename + " changed while its duplicates were being marked"};
+    if (duplicates[index++])
+      record.set_duplicate();
+    else
+      record.set_not_duplicate();
+    writer.add_record(record);
+  }
+  if (index != duplicates.size())
+    throw OutputException{input_filename + " changed while its duplicates were being marked"};
+  return metrics;
+}
+
+/**
+ * @brief reads the input in batches; each batch is analyzed in parallel (signatures and scores) and then
+ * grouped sequentially, in input order.
+ */
+DuplicateMetrics DuplicateMarker::mark(const std::function<bool(Sam&)>& input, const std::function<void(Sam&, uint64_t)>& output,
+                                       const std::unordered_map<std::string, uint16_t>& library_of_read_group) {
+  reset();
+  auto batch = vector<Sam>{};
+  auto infos = vector<ReadInfo>{};
+  auto end_of_input = false;
+  while (!end_of_input) {
+    batch.clear();
+    for (auto i = 0u; i != m_options.batch_size; ++i) {
+      auto record = Sam{};
+      if (!input(record)) {
+        end_of_input = true;
+        break;
+      }
+      batch.push_back(move(record));
+    }
+    infos.resize(batch.size());
+    const auto chunk_size = (batch.size() + m_pool.size() - 1) / m_pool.size();
+    auto chunks = vector<future<void>>{};
+    for (auto start = size_t{0}; start < batch.size(); start += chunk_size) {
+      const auto stop = min(start + chunk_size, batch.size());
+      chunks.push_back(m_pool.submit([this, start, stop, &batch, &infos, &library_of_read_group] {
+        for (auto i = start; i != stop; ++i)
+          infos[i] = analyze(batch[i], library_of_read_group);
+      }));
+    }
+    for (auto& chunk : chunks)
+      chunk.get();
+    for (auto i = 0u; i != batch.size(); ++i) {
+      process(move(batch[i]), infos[i]);
+      finalize_ready_groups(false);
+      emit(output, false);
+    }
+  }
+  finalize_ready_groups(true);
+  emit(output, true);
+  const auto metrics = m_metrics;
+  reset();
+  return metrics;
+}
+
+void DuplicateMarker::reset() {
+  m_ready.clear();
+  m_templates.clear();
+  m_undecided.clear();
+  m_open_pairs.clear();
+  m_pending_records = 0;
+  m_next_index = 0;
+  m_pair_groups.clear();
+  m_fragment_groups.clear();
+  m_ready_queue = decltype(m_ready_queue){};
+  m_next_template_id = 1;
+  m_max_footprint = 0;
+  m_chromosome = -1;
+  m_position = 0;
+  m_metrics = DuplicateMetrics{};
+}
+
+DuplicateMarker::ReadInfo DuplicateMarker::analyze(const Sam& record, const std::unordered_map<std::string, uint16_t>& library_of_read_group) const {
+  auto info = ReadInfo{};
+  info.examined = !record.unmapped() && !record.secondary() && !record.supplementary();
+  if (!info.examined)
+    return info;
+  const auto unclipped_start = int32_t(record.unclipped_start());
+  const auto unclipped_stop = int32_t(record.unclipped_stop());
+  info.reverse = record.reverse();
+  info.chromosome = int32_t(record.chromosome());
+  info.five_prime = info.reverse ? unclipped_stop : unclipped_start;
+  info.alignment_start = int32_t(record.alignment_start());
+  info.footprint = unclipped_stop - unclipped_start + 1;
+  const auto read_group = record.string_tag("RG");
+  if (!read_group.missing()) {
+    const auto library = library_of_read_group.find(string{read_group.value()});
+    info.library = library == library_of_read_group.end() ? 0 : library->second;
+  }
+  const auto quals = record.base_quals();
+  for (auto i = 0u; i != quals.size(); ++i)
+    info.score += quals[i] >= MIN_SCORED_BASE_QUAL ? quals[i] : 0;
+  info.pair_end = record.paired() && !record.mate_unmapped();
+  if (info.pair_end) {
+    info.mate_chromosome = int32_t(record.mate_chromosome());
+    info.mate_alignment_start = int32_t(record.mate_alignment_start());
+    info.mate_reverse = record.mate_reverse();
+    info.name_hash = record.name_hash();
+    const auto mate_cigar = record.string_tag("MC");
+    info.has_mate_end = !mate_cigar.missing();
+    if (info.has_mate_end) {
+      const auto mate = record.mate_coordinates(mate_cigar);
+      info.mate_five_prime = int32_t(info.mate_reverse ? mate.unclipped_stop : mate.unclipped_start);
+    }
+  }
+  return info;
+}
+
+void DuplicateMarker::process(Sam&& record, const ReadInfo& info) {
+  if (record.unmapped() && int32_t(record.chromosome()) < 0)
+    m_chromosome = numeric_limits<int32_t>::max();       // unplaced unmapped reads are at the end of a sorted file
+  else {
+    const auto chromosome = int32_t(record.chromosome());
+    const auto position = int32_t(record.alignment_start());
+    if (chromosome < m_chromosome || (chromosome == m_chromosome && position < m_position))
+      throw UnsortedInputException{record.name(), chromosome, position - 1};
+    m_chromosome = chromosome;
+    m_position = position;
+  }
+  auto pending = PendingRecord{move(record), m_next_index++};
+  if (!info.examined) {
+    m_ready.push_back(move(pending));
+    return;
+  }
+  m_max_footprint = max(m_max_footprint, info.footprint);
+  const auto fragment_key = Signature{info.chromosome, info.five_prime, -1, 0, info.library, uint8_t(info.reverse << 1), 0};
+  if (!info.pair_end) {
+    ++m_metrics.unpaired_reads_examined;
+    const auto id = add_template(false, info, fragment_key);
+    hold(m_templates.at(id), move(pending));
+    add_to_group(id, fragment_key, false);
+    return;
+  }
+  group(fragment_key, false).has_pair_end = true;
+  const auto open_pair = find_first_mate(info);
+  if (open_pair != m_open_pairs.end()) {                 // second mate: the pair is complete
+    const auto id = open_pair->second;
+    m_open_pairs.erase(open_pair);
+    auto& t = m_templates.at(id);
+    t.complete = true;
+    t.score += info.score;
+    if (t.duplicate >= 0) {                              // decided without waiting for this mate
+      release(t, move(pending));
+      m_templates.erase(id);
+      return;
+    }
+    hold(t, move(pending));
+    if (!t.registered)
+      add_to_group(id, pair_signature(info.library, t.first_chromosome, t.first_five_prime, t.first_reverse, info.chromosome, info.five_prime, info.reverse), true);
+    return;
+  }
+  ++m_metrics.read_pairs_examined;                       // first mate: joins its group right away if the mate cigar tells us where the mate ends
+  const auto id = add_template(true, info, Signature{});
+  hold(m_templates.at(id), move(pending));
+  m_open_pairs.emplace(info.name_hash, id);
+  if (info.has_mate_end)
+    add_to_group(id, pair_signature(info.library, info.chromosome, info.five_prime, info.reverse, info.mate_chromosome, info.mate_five_prime, info.mate_reverse), true);
+}
+
+uint64_t DuplicateMarker::add_template(const bool pair, const ReadInfo& info, const Signature& key) {
+  const auto id = m_next_template_id++;
+  m_templates.emplace(id, Template{pair, !pair, false, -1, info.score, key, info.chromosome, info.five_prime, info.reverse,
+                                   info.alignment_start, info.mate_chromosome, info.mate_alignment_start, {}});
+  m_undecided.insert(m_undecided.end(), id);
+  return id;
+}
+
+/**
+ * @brief the pair waiting for this read: the names are not kept, so a pair with the same name hash is only taken
+ * for the first mate if the two reads point at each other
+ */
+std::unordered_multimap<uint64_t, uint64_t, DuplicateMarker::NameHashIdentity>::iterator DuplicateMarker::find_first_mate(const ReadInfo& info) {
+  const auto candidates = m_open_pairs.equal_range(info.name_hash);
+  for (auto it = candidates.first; it != candidates.second; ++it) {
+    const auto& t = m_templates.at(it->second);
+    if (t.first_chromosome == info.mate_chromosome && t.first_alignment_start == info.mate_alignment_start &&
+        t.first_mate_chromosome == info.chromosome && t.first_mate_alignment_start == info.alignment_start)
+      return it;
+  }
+  return m_open_pairs.end();
+}
+
+void DuplicateMarker::hold(Template& t, PendingRecord&& pending) {
+  t.records.push_back(move(pending));
+  ++m_pending_records;
+}
+
+void DuplicateMarker::release(const Template& t, PendingRecord&& pending) {
+  if (t.duplicate)
+    pending.record.set_duplicate();
+  else
+    pending.record.set_not_duplicate();
+  m_ready.push_back(move(pending));
+}
+
+DuplicateMarker::Signature DuplicateMarker::pair_signature(const uint16_t library, int32_t chromosome1, int32_t position1, bool reverse1, int32_t chromosome2, int32_t position2, bool reverse2) {
+  if (tie(chromosome2, position2, reverse2) < tie(chromosome1, position1, reverse1)) {
+    swap(chromosome1, chromosome2);
+    swap(position1, position2);
+    swap(reverse1, reverse2);
+  }
+  return Signature{chromosome1, position1, chromosome2, position2, library, uint8_t(reverse1 << 1 | reverse2), 1};
+}
+
+/**
+ * @brief groups become ready (can't receive new members) once the input is past their last end by more than the
+ * longest unclipped read seen so far
+ */
+DuplicateMarker::Group& DuplicateMarker::group(const Signature& key, const bool pair_group) {
+  auto& groups = pair_group ? m_pair_groups : m_fragment_groups;
+  auto existing = groups.find(key);
+  if (existing != groups.end())
+    return existing->second;
+  const auto last_chromosome = pair_group ? key.chromosome2 : key.chromosome1;
+  const auto last_position = pair_group ? key.position2 : key.position1;
+  m_ready_queue.push(ReadyEntry{last_chromosome, last_position, pair_group, key});
+  return groups.emplace(key, Group{{}, false, false}).first->second;
+}
+
+void DuplicateMarker::add_to_group(const uint64_t id, const Signature& key, const bool pair_group) {
+  auto& g = group(key, pair_group);
+  auto& t = m_templates.at(id);
+  t.registered = true;
+  t.key = key;
+  g.members.push_back(id);
+  if (g.has_kept_member)
+    decide(id, t, true);
+}
+
+void DuplicateMarker::finalize_ready_groups(const bool everything) {
+  while (!m_ready_queue.empty()) {
+    const auto entry = m_ready_queue.top();
+    if (!everything && (entry.chromosome > m_chromosome || (entry.chromosome == m_chromosome && entry.position + m_max_footprint >= m_position)))
+      return;
+    m_ready_queue.pop();
+    finalize_group(entry.key, entry.pair_group);
+  }
+}
+
+/**
+ * @brief keeps the undecided member with the best score (the earliest one in case of ties) unless a member was
+ * already kept or, for fragments, a read from a pair ends at the same place
+ */
+void DuplicateMarker::finalize_group(const Signature& key, const bool pair_group) {
+  auto& groups = pair_group ? m_pair_groups : m_fragment_groups;
+  const auto it = groups.find(key);
+  if (it == groups.end())
+    return;
+  const auto& g = it->second;
+  const auto best = best_undecided_member(g);
+  for (const auto id : g.members) {
+    const auto t = m_templates.find(id);
+    if (t != m_templates.end() && t->second.duplicate < 0)
+      decide(id, t->second, id != best);
+  }
+  groups.erase(it);
+}
+
+/**
+ * @brief the undecided member with the best score (the earliest one in case of ties), or 0 if no member can be
+ * kept. Members that are already decided may have been released, so they are skipped.
+ */
+uint64_t DuplicateMarker::best_undecided_member(const Group& g) const {
+  if (g.has_kept_member || g.has_pair_end)
+    return 0;
+  auto best = uint64_t{0};
+  auto best_score = uint32_t{0};
+  for (const auto id : g.members) {
+    const auto t = m_templates.find(id);
+    if (t != m_templates.end() && t->second.duplicate < 0 && (best == 0 || t->second.score > best_score)) {
+      best = id;
+      best_score = t->second.score;
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief releases the records held back by the template. Once the pair is complete, nothing refers to the
+ * template anymore.
+ */
+void DuplicateMarker::decide(const uint64_t id, Template& t, const bool duplicate) {
+  t.duplicate = duplicate;
+  if (duplicate && t.pair)
+    ++m_metrics.read_pair_duplicates;
+  else if (duplicate)
+    ++m_metrics.unpaired_read_duplicates;
+  m_undecided.erase(id);
+  m_pending_records -= t.records.size();
+  for (auto& pending : t.records)
+    release(t, move(pending));
+  if (t.complete)
+    m_templates.erase(id);
+  else
+    t.records = vector<PendingRecord>{};
+}
+
+/**
+ * @brief decides a template before its group is complete (when too many records are held back): it is kept only if
+ * it is the best of its group so far, in which case all later members of the group will be marked.
+ */
+void DuplicateMarker::force_decision(const uint64_t id) {
+  auto& t = m_templates.at(id);
+  if (!t.registered) {
+    decide(id, t, false);
+    return;
+  }
+  auto& groups = t.pair ? m_pair_groups : m_fragment_groups;
+  auto& g = groups.at(t.key);
+  const auto best = best_undecided_member(g);
+  decide(id, t, best != id);
+  if (best == id)
+    g.has_kept_member = true;
+}
+
+/**
+ * @brief outputs the records that were released, forcing the decision of the oldest templates first if too many
+ * records are held back (or all of them at the end of the input)
+ */
+void DuplicateMarker::emit(const std::function<void(Sam&, uint64_t)>& output, const bool force) {
+  while (!m_undecided.empty() && (force || m_pending_records > m_options.max_pending_records))
+    force_decision(*m_undecided.begin());
+  for (auto& pending : m_ready)
+    output(pending.record, pending.index);
+  m_ready.clear();
+}
+
+}
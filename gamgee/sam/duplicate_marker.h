@@ -0,0 +1,221 @@
+#ifndef gamgee__duplicate_marker__guard
+#define gamgee__duplicate_marker__guard
+
+#include "sam.h"
+
+#include "../utils/thread_pool.h"
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gamgee {
+
+/**
+ * @brief parallelism and memory settings of the DuplicateMarker
+ */
+struct DuplicateMarkerOptions {
+  uint32_t num_threads {1};                 ///< number of threads computing the signatures and scores of the reads
+  uint32_t batch_size {10000};              ///< number of records read (and analyzed in parallel) at a time
+  uint32_t max_pending_records {1u << 20};  ///< maximum number of records held back waiting for a decision. When exceeded, the oldest undecided template is decided with the information available so far.
+  bool binary_output {true};                ///< whether the output should be in BAM (true) or SAM format (false)
+};
+
+/**
+ * @brief counts of the reads examined and marked by the DuplicateMarker (same definitions as in Picard's
+ * MarkDuplicates metrics)
+ */
+struct DuplicateMetrics {
+  uint64_t unpaired_reads_examined {0};  ///< mapped primary reads without a mapped mate
+  uint64_t read_pairs_examined {0};      ///< pairs with both mates mapped (primary alignments)
+  uint64_t unpaired_read_duplicates {0}; ///< unpaired reads marked as duplicates
+  uint64_t read_pair_duplicates {0};     ///< pairs marked as duplicates (both mates are marked)
+};
+
+/**
+ * @brief Streaming duplicate marking of a coordinate sorted SAM/BAM/CRAM file
+ *
+ * Reads are grouped by a fixed-size signature made of the library (from the read group), the chromosome,
+ * unclipped 5' position and orientation of each end:
+ *
+ * - pairs with both mates mapped are duplicates of each other when both ends match. The pair with the
+ *   largest sum of base qualities (counting qualities of 15 or more) is kept, the others are marked.
+ * - reads without a mapped mate are duplicates of each other when their end matches, and are always marked
+ *   if a read from a pair ends at the same place.
+ *
+ * The mate's 5' end is taken from the mate cigar (MC) tag when present, so a pair joins its group as soon
+ * as its first mate is seen. Only the records of undecided templates are held back, until the groups they
+ * belong to cannot receive new members: the other records are output right away, so a pair waiting for a
+ * distant mate (e.g. on another chromosome) doesn't hold back the records after it. The held back records are
+ * capped by DuplicateMarkerOptions::max_pending_records. Signatures and quality sums of each batch of records
+ * are computed by a pool of threads.
+ *
+ * Secondary, supplementary and unmapped records are passed through untouched. The duplicate flag of the
+ * examined reads is recomputed (set or cleared) through Sam::set_duplicate()/Sam::set_not_duplicate().
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * auto options = DuplicateMarkerOptions{};
+ * options.num_threads = 4;
+ * DuplicateMarker marker {options};
+ * const auto metrics = marker.mark("sorted.bam", "marked.bam");
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ */
+class DuplicateMarker {
+ public:
+  explicit DuplicateMarker(const DuplicateMarkerOptions& options = DuplicateMarkerOptions{});
+
+  /**
+   * @brief no copy or move construction/assignment allowed (the marker owns a thread pool)
+   */
+  DuplicateMarker(const DuplicateMarker&) = delete;
+  DuplicateMarker& operator=(const DuplicateMarker&) = delete;
+
+  /**
+   * @brief marks the duplicates of a coordinate sorted input file, writing all records to the output in input order
+   *
+   * The input is read twice: once to decide which templates are duplicates, then to write the records in order.
+   * Streams (e.g. "-" or a pipe) can't be read twice: mark() their records through the other overload instead.
+   *
+   * @throw std::invalid_argument if the input is not a regular file
+   * @throw UnsortedInputException if the input is not coordinate sorted
+   * @throw OutputException if the input changed between the two passes (it has a different number of records)
+   */
+  DuplicateMetrics mark(const std::string& input_filename, const std::string& output_filename);
+
+  /**
+   * @brief marks the duplicates of a coordinate sorted stream of records
+   *
+   * @param input   function filling its argument with the next record and returning false at the end of the stream
+   * @param output  function receiving the records (with their duplicate flags updated) and their 0-based position
+   *                in the input. Records come out as soon as their template is decided, so not in input order:
+   *                the records of a template waiting for its mate come out after the records that follow them.
+   * @param library_of_read_group maps read group ids to a library index (reads without a read group or with
+   *                an unknown read group belong to library 0)
+   */
+  DuplicateMetrics mark(const std::function<bool(Sam&)>& input, const std::function<void(Sam&, uint64_t)>& output,
+                        const std::unordered_map<std::string, uint16_t>& library_of_read_group = {});
+
+  /**
+   * @brief fixed-size key identifying the reads that are duplicates of each other
+   */
+  struct Signature {
+    int32_t chromosome1;
+    int32_t position1;    ///< unclipped 5' position (1-based) of the first end
+    int32_t chromosome2;  ///< -1 for unpaired reads
+    int32_t position2;    ///< unclipped 5' position (1-based) of the second end (0 for unpaired reads)
+    uint16_t library;
+    uint8_t orientation;  ///< bit 1: first end is reverse, bit 0: second end is reverse
+    uint8_t paired;
+    bool operator==(const Signature& other) const;
+  };
+
+ private:
+  struct SignatureHash { size_t operator()(const Signature& signature) const; };
+  struct NameHashIdentity { size_t operator()(const uint64_t hash) const { return size_t(hash); } };  ///< the name hashes are already good hashes
+
+  /**
+   * @brief everything the marker needs to know about a record, computed in parallel for each batch
+   */
+  struct ReadInfo {
+    bool examined;            ///< primary mapped read
+    bool pair_end;            ///< examined read with a mapped mate
+    bool has_mate_end;        ///< whether the mate's 5' end is known (from the MC tag)
+    bool reverse;
+    int32_t chromosome;
+    int32_t five_prime;       ///< unclipped 5' position of this read
+    int32_t mate_chromosome;
+    int32_t mate_five_prime;  ///< unclipped 5' position of the mate (only if has_mate_end)
+    int32_t mate_alignment_start;
+    bool mate_reverse;
+    int32_t alignment_start;
+    uint64_t name_hash;       ///< hash of the read name (only for pair ends)
+    int32_t footprint;        ///< unclipped length of the read on the reference
+    uint16_t library;
+    uint32_t score;           ///< sum of the base qualities >= 15
+  };
+
+  /**
+   * @brief a record and its position in the input
+   */
+  struct PendingRecord {
+    Sam record;
+    uint64_t index;
+  };
+
+  /**
+   * @brief a fragment (unpaired read) or a pair, the unit that is kept or marked as duplicate
+   */
+  struct Template {
+    bool pair;
+    bool complete;            ///< both mates have been seen (always true for fragments)
+    bool registered;          ///< whether the template belongs to a group
+    int8_t duplicate;         ///< -1 while undecided
+    uint32_t score;
+    Signature key;
+    int32_t first_chromosome; ///< end of the first mate (for pairs without a mate cigar)
+    int32_t first_five_prime;
+    bool first_reverse;
+    int32_t first_alignment_start;       ///< where the first mate and its mate are, to tell the second mate from
+    int32_t first_mate_chromosome;       ///< reads whose names have the same hash
+    int32_t first_mate_alignment_start;
+    std::vector<PendingRecord> records;  ///< records of this template held back until it is decided
+  };
+
+  struct Group {
+    std::vector<uint64_t> members;
+    bool has_pair_end;        ///< for fragment groups: whether a read of a pair ends here
+    bool has_kept_member;     ///< a member was already (early) decided as not duplicate
+  };
+
+  struct ReadyEntry {
+    int32_t chromosome;
+    int64_t position;
+    bool pair_group;
+    Signature key;
+    bool operator>(const ReadyEntry& other) const;
+  };
+
+  DuplicateMarkerOptions m_options;
+  utils::ThreadPool m_pool;
+
+  // state of the current run
+  std::vector<PendingRecord> m_ready;                  ///< records that can be output, in the order they were decided
+  std::unordered_map<uint64_t, Template> m_templates;
+  std::set<uint64_t> m_undecided;                      ///< undecided templates, oldest first
+  std::unordered_multimap<uint64_t, uint64_t, NameHashIdentity> m_open_pairs;  ///< name hash of the first mate -> pair waiting for its second mate
+  uint64_t m_pending_records;                          ///< number of records held back by the undecided templates
+  uint64_t m_next_index;
+  std::unordered_map<Signature, Group, SignatureHash> m_pair_groups;
+  std::unordered_map<Signature, Group, SignatureHash> m_fragment_groups;
+  std::priority_queue<ReadyEntry, std::vector<ReadyEntry>, std::greater<ReadyEntry>> m_ready_queue;
+  uint64_t m_next_template_id;
+  int32_t m_max_footprint;
+  int32_t m_chromosome;
+  int32_t m_position;
+  DuplicateMetrics m_metrics;
+
+  void reset();
+  ReadInfo analyze(const Sam& record, const std::unordered_map<std::string, uint16_t>& library_of_read_group) const;
+  void process(Sam&& record, const ReadInfo& info);
+  uint64_t add_template(const bool pair, const ReadInfo& info, const Signature& key);
+  std::unordered_multimap<uint64_t, uint64_t, NameHashIdentity>::iterator find_first_mate(const ReadInfo& info);
+  void hold(Template& t, PendingRecord&& pending);
+  void release(const Template& t, PendingRecord&& pending);
+  void add_to_group(const uint64_t id, const Signature& key, const bool pair_group);
+  Group& group(const Signature& key, const bool pair_group);
+  void finalize_ready_groups(const bool everything);
+  void finalize_group(const Signature& key, const bool pair_group);
+  uint64_t best_undecided_member(const Group& g) const;
+  void decide(const uint64_t id, Template& t, const bool duplicate);
+  void force_decision(const uint64_t id);
+  void emit(const std::function<void(Sam&, uint64_t)>& output, const bool force);
+  static Signature pair_signature(const uint16_t library, int32_t chromosome1, int32_t position1, bool reverse1, int32_t chromosome2, int32_t position2, bool reverse2);
+};
+
+}  // end of namespace gamgee
+
+#endif // gamgee__duplicate_marker__guard
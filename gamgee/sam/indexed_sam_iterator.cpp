@@ -23,7 +23,7 @@ IndexedSamIterator::IndexedSamIterator(const std::shared_ptr<htsFile>& sam_file_
   m_interval_list {interval_list},
   m_interval_iterator {m_interval_list.begin()},
   m_sam_itr_ptr {utils::make_unique_hts_itr(sam_itr_querys(m_sam_index_ptr.get(), m_sam_header_ptr.get(), (*m_interval_iterator).c_str()))},
-  m_sam_record_ptr {utils::make_shared_sam(bam_init1())},
+  m_sam_record_ptr {utils::SamHandle::create()},
   m_sam_record {m_sam_header_ptr, m_sam_record_ptr} {
     fetch_next_record();
 }
@@ -42,6 +42,7 @@ bool IndexedSamIterator::operator!=(const IndexedSamIterator& rhs) {
 }
 
 void IndexedSamIterator::fetch_next_record() {
+  m_sam_record_ptr = m_sam_record.reusable_body();  ///< copies of the previous record may still be sharing its buffer
   while (sam_itr_next(m_sam_file_ptr.get(), m_sam_itr_ptr.get(), m_sam_record_ptr.get()) < 0) {
     ++m_interval_iterator;
     if (m_interval_list.end() == m_interval_iterator) {
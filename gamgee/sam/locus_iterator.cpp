@@ -0,0 +1,211 @@
+#include "locus_iterator.h"
+
+#include "../exceptions.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace gamgee {
+
+LocusIterator::LocusIterator() :
+  m_sam_file_ptr {nullptr},
+  m_sam_header_ptr {nullptr},
+  m_options {},
+  m_reads {},
+  m_num_active {0},
+  m_next_read {},
+  m_has_next_read {false},
+  m_last_chromosome {-1},
+  m_last_position {-1},
+  m_chromosome {-1},
+  m_position {-1},
+  m_pileup {}
+{}
+
+LocusIterator::LocusIterator(const std::shared_ptr<htsFile>& sam_file_ptr, const std::shared_ptr<bam_hdr_t>& sam_header_ptr, const LocusIteratorOptions& options) :
+  m_sam_file_ptr {sam_file_ptr},
+  m_sam_header_ptr {sam_header_ptr},
+  m_options {options},
+  m_reads {},
+  m_num_active {0},
+  m_next_read {},
+  m_has_next_read {false},
+  m_last_chromosome {-1},
+  m_last_position {-1},
+  m_chromosome {-1},
+  m_position {-1},
+  m_pileup {}
+{
+  m_next_read.record.reset(bam_init1()); ///< the look-ahead buffer is allocated once and then traded with the recycled buffers
+  fetch_next_read();
+  fetch_next_pileup();
+}
+
+Pileup& LocusIterator::operator*() {
+  return m_pileup;
+}
+
+Pileup& LocusIterator::operator++() {
+  fetch_next_pileup();
+  return m_pileup;
+}
+
+bool LocusIterator::operator!=(const LocusIterator& rhs) {
+  return m_sam_file_ptr != rhs.m_sam_file_ptr;
+}
+
+/**
+ * @brief reads records until one passes the filters. Unmapped reads without a position (at the end of a
+ * sorted file) terminate the input.
+ */
+void LocusIterator::fetch_next_read() {
+  m_has_next_read = false;
+  auto record = m_next_read.record.get();
+  while (sam_read1(m_sam_file_ptr.get(), m_sam_header_ptr.get(), record) >= 0) {
+    const auto& core = record->core;
+    if (core.tid < 0)
+      return;
+    if (core.tid < m_last_chromosome || (core.tid == m_last_chromosome && core.pos < m_last_position))
+      throw UnsortedInputException{bam_get_qname(record), core.tid, core.pos};
+    m_last_chromosome = core.tid;
+    m_last_position = core.pos;
+    if ((core.flag & m_options.excluded_flags) || core.qual < m_options.min_mapping_qual || core.n_cigar == 0)
+      continue;
+    m_has_next_read = true;
+    return;
+  }
+}
+
+/**
+ * @brief the look-ahead read swaps buffers with the first recycled slot, so no record is ever copied or allocated
+ * once the pool has grown to the maximum depth
+ */
+void LocusIterator::admit_next_read() {
+  if (m_options.max_depth != 0 && m_num_active >= m_options.max_depth)
+    return;
+  if (m_num_active == m_reads.size()) {
+    m_reads.emplace_back();
+    m_reads.back().record.reset(bam_init1());
+  }
+  auto& read = m_reads[m_num_active++];
+  swap(read.record, m_next_read.record);
+  start_cursor(read);
+}
+
+void LocusIterator::start_cursor(ActiveRead& read) {
+  const auto record = read.record.get();
+  read.cigar = bam_get_cigar(record);
+  read.num_elements = record->core.n_cigar;
+  read.element_index = 0;
+  read.element_op = bam_cigar_op(read.cigar[0]);
+  read.element_length = bam_cigar_oplen(read.cigar[0]);
+  read.element_ref_start = record->core.pos;
+  read.element_read_start = 0;
+}
+
+void LocusIterator::advance_cursor(ActiveRead& read, const int32_t position) {
+  while (read.element_index < read.num_elements) {
+    const auto consumes_reference = bam_cigar_type(read.element_op) & 2;
+    if (consumes_reference && read.element_ref_start + int32_t(read.element_length) > position)
+      return;
+    if (consumes_reference)
+      read.element_ref_start += read.element_length;
+    if (bam_cigar_type(read.element_op) & 1)
+      read.element_read_start += read.element_length;
+    if (++read.element_index < read.num_elements) {
+      read.element_op = bam_cigar_op(read.cigar[read.element_index]);
+      read.element_length = bam_cigar_oplen(read.cigar[read.element_index]);
+    }
+  }
+}
+
+/**
+ * @brief moves the cigar cursors to the current position, recycling the reads that ended before it (keeping the
+ * order of the others)
+ */
+void LocusIterator::remove_ended_reads() {
+  auto survivors = 0u;
+  for (auto i = 0u; i != m_num_active; ++i) {
+    advance_cursor(m_reads[i], m_position);
+    if (m_reads[i].element_index == m_reads[i].num_elements)
+      continue;
+    if (i != survivors)
+      swap(m_reads[i], m_reads[survivors]);
+    ++survivors;
+  }
+  m_num_active = survivors;
+}
+
+/**
+ * @brief advances to the next position with at least one pileup element
+ *
+ * Uncovered stretches are skipped in one jump: when no read is active we go straight to the next read's start
+ * and when all active reads are in a reference skip we go straight to the end of the closest skip.
+ */
+void LocusIterator::fetch_next_pileup() {
+  while (true) {
+    if (m_num_active == 0) {
+      if (!m_has_next_read) {
+        m_sam_file_ptr = nullptr;
+        return;
+      }
+      m_chromosome = m_next_read.record->core.tid;
+      m_position = m_next_read.record->core.pos;
+    }
+    else
+      ++m_position;
+
+    const auto reads_start_here = m_has_next_read && m_next_read.record->core.tid == m_chromosome && m_next_read.record->core.pos <= m_position;
+    if (reads_start_here && m_options.max_depth != 0 && m_num_active >= m_options.max_depth)
+      remove_ended_reads();                                        // reads that ended before this position don't count towards the cap
+    while (m_has_next_read && m_next_read.record->core.tid == m_chromosome && m_next_read.record->core.pos <= m_position) {
+      admit_next_read();
+      fetch_next_read();
+    }
+
+    m_pileup.reset(uint32_t(m_chromosome), uint32_t(m_position + 1));
+    auto next_covered_position = numeric_limits<int32_t>::max();
+    auto survivors = 0u;
+    for (auto i = 0u; i != m_num_active; ++i) {
+      auto& read = m_reads[i];
+      advance_cursor(read, m_position);
+      if (read.element_index == read.num_elements)
+        continue;                                                  // the read has ended, its buffer goes back to the pool
+      if (i != survivors)
+        swap(m_reads[i], m_reads[survivors]);                      // stable compaction of the active reads
+      const auto& active = m_reads[survivors++];
+      const auto record = active.record.get();
+      const auto reverse = bool(record->core.flag & BAM_FREVERSE);
+      const auto last_base_of_element = m_position == active.element_ref_start + int32_t(active.element_length) - 1;
+      const auto insertion = last_base_of_element && active.element_index + 1 < active.num_elements && bam_cigar_op(active.cigar[active.element_index + 1]) == BAM_CINS;
+      switch (active.element_op) {
+        case BAM_CMATCH:
+        case BAM_CEQUAL:
+        case BAM_CDIFF: {
+          const auto offset = active.element_read_start + uint32_t(m_position - active.element_ref_start);
+          m_pileup.add(static_cast<Base>(bam_seqi(bam_get_seq(record), offset)), bam_get_qual(record)[offset], reverse, offset, false, insertion);
+          break;
+        }
+        case BAM_CDEL:
+          m_pileup.add(Base::N, 0, reverse, active.element_read_start, true, insertion);
+          break;
+        default: // reference skip
+          next_covered_position = min(next_covered_position, active.element_ref_start + int32_t(active.element_length));
+          break;
+      }
+    }
+    m_num_active = survivors;
+
+    if (!m_pileup.empty())
+      return;
+    if (m_num_active != 0) {
+      if (m_has_next_read && m_next_read.record->core.tid == m_chromosome)
+        next_covered_position = min(next_covered_position, m_next_read.record->core.pos);
+      m_position = next_covered_position - 1;
+    }
+  }
+}
+
+}
@@ -0,0 +1,137 @@
+#ifndef gamgee__locus_iterator__guard
+#define gamgee__locus_iterator__guard
+
+#include "pileup.h"
+
+#include "../utils/hts_memory.h"
+
+#include "htslib/sam.h"
+
+#include <memory>
+#include <vector>
+
+namespace gamgee {
+
+/**
+ * @brief read filters and limits applied by the LocusIterator when building pileups
+ *
+ * The defaults mirror the usual pileup conventions: unmapped, secondary, qc-failed and duplicate
+ * reads are skipped, there is no mapping quality threshold and no depth cap.
+ */
+struct LocusIteratorOptions {
+  uint16_t excluded_flags {BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP}; ///< reads with any of these flags set are skipped
+  uint8_t min_mapping_qual {0};                                                  ///< reads with a mapping quality below this value are skipped
+  uint32_t max_depth {0};                                                        ///< maximum number of reads piled up at any position (0 means unlimited). Reads starting while the cap is reached are skipped.
+};
+
+/**
+ * @brief Utility class to iterate over every covered reference position of a coordinate sorted SAM/BAM/CRAM file
+ *
+ * Each iteration produces a columnar Pileup with all the reads (that pass the filters) overlapping the
+ * current position. Positions without any coverage (and positions where all reads are in a reference skip)
+ * are not reported.
+ *
+ * The iterator keeps the overlapping reads in a pool of recycled htslib records: records leaving the pileup
+ * donate their buffers to the records entering it, so after warming up the iteration does not allocate.
+ * Every cigar element of a read is decoded exactly once, by a cursor that walks the read alongside the
+ * reference position.
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * for (const auto& pileup : LocusReader{filename})
+ *   cout << pileup.position() << " " << pileup.size() << endl;
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * @throw UnsortedInputException if the input is not coordinate sorted
+ */
+class LocusIterator {
+ public:
+
+  /**
+   * @brief creates an empty iterator (used for the end() method)
+   */
+  LocusIterator();
+
+  /**
+   * @brief initializes a new iterator based on an input stream (e.g. sam/a file, stdin, ...)
+   *
+   * @param sam_file_ptr   pointer to a sam file opened via the sam_open() macro from htslib
+   * @param sam_header_ptr pointer to a sam file header created with the sam_hdr_read() macro from htslib
+   * @param options        read filters and depth cap to apply while building the pileups
+   */
+  LocusIterator(const std::shared_ptr<htsFile>& sam_file_ptr, const std::shared_ptr<bam_hdr_t>& sam_header_ptr, const LocusIteratorOptions& options = LocusIteratorOptions{});
+
+  /**
+   * @brief no copy construction/assignment allowed for readers and iterators
+   */
+  LocusIterator(const LocusIterator&) = delete;
+  LocusIterator& operator=(const LocusIterator&) = delete;
+
+  /**
+   * @brief a LocusIterator move constructor guarantees all objects will have the same state.
+   */
+  LocusIterator(LocusIterator&&) = default;
+  LocusIterator& operator=(LocusIterator&&) = default;
+
+  /**
+   * @brief inequality operator (needed by for-each loop)
+   *
+   * @param rhs the other LocusIterator to compare to
+   *
+   * @return whether or not the two iterators are the same (e.g. have the same input stream on the same
+   * status)
+   */
+  bool operator!=(const LocusIterator& rhs);
+
+  /**
+   * @brief dereference operator (needed by for-each loop)
+   *
+   * @return a Pileup object by reference, valid until the next position is fetched (the iterator re-uses memory at each iteration)
+   */
+  Pileup& operator*();
+
+  /**
+   * @brief moves on to the next covered position
+   *
+   * @return a reference to the pileup of the next position
+   */
+  Pileup& operator++();
+
+ private:
+  /**
+   * @brief a read overlapping the current position along with its cigar cursor
+   */
+  struct ActiveRead {
+    std::unique_ptr<bam1_t, utils::SamBodyDeleter> record; ///< recycled htslib record holding the read
+    const uint32_t* cigar;        ///< cigar of the record (cached)
+    uint32_t num_elements;        ///< number of elements in the cigar
+    uint32_t element_index;       ///< index of the cigar element under the cursor
+    uint32_t element_op;          ///< operator of the cigar element under the cursor (decoded once)
+    uint32_t element_length;      ///< length of the cigar element under the cursor (decoded once)
+    int32_t element_ref_start;    ///< 0-based reference position where the element under the cursor starts
+    uint32_t element_read_start;  ///< 0-based read offset where the element under the cursor starts
+  };
+
+  std::shared_ptr<htsFile> m_sam_file_ptr;     ///< pointer to the sam file
+  std::shared_ptr<bam_hdr_t> m_sam_header_ptr; ///< pointer to the sam header
+  LocusIteratorOptions m_options;              ///< filters and depth cap
+  std::vector<ActiveRead> m_reads;             ///< active reads in [0, m_num_active), recycled buffers after that
+  uint32_t m_num_active;                       ///< number of reads overlapping the current position
+  ActiveRead m_next_read;                      ///< look-ahead read (the next read in the file that passes the filters)
+  bool m_has_next_read;                        ///< whether or not m_next_read holds a read
+  int32_t m_last_chromosome;                   ///< chromosome of the last record read from the file (for the sort order check)
+  int32_t m_last_position;                     ///< position of the last record read from the file (for the sort order check)
+  int32_t m_chromosome;                        ///< current chromosome
+  int32_t m_position;                          ///< current 0-based reference position
+  Pileup m_pileup;                             ///< pileup of the current position, re-used at each iteration
+
+  void fetch_next_read();                      ///< reads the next record passing the filters into the look-ahead read
+  void admit_next_read();                      ///< moves the look-ahead read into the active reads (recycling a buffer)
+  void fetch_next_pileup();                    ///< advances to the next covered position and builds its pileup
+  void remove_ended_reads();                   ///< drops the active reads that ended before the current position
+  static void start_cursor(ActiveRead& read);  ///< positions the cigar cursor at the first element of the read
+  static void advance_cursor(ActiveRead& read, const int32_t position); ///< moves the cigar cursor to the element overlapping position
+};
+
+}  // end of namespace gamgee
+
+#endif // gamgee__locus_iterator__guard
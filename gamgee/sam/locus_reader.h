@@ -0,0 +1,89 @@
+#ifndef gamgee__locus_reader__guard
+#define gamgee__locus_reader__guard
+
+#include "locus_iterator.h"
+#include "sam_header.h"
+
+#include "../exceptions.h"
+#include "../utils/hts_memory.h"
+
+#include "htslib/sam.h"
+
+#include <memory>
+#include <string>
+
+namespace gamgee {
+
+/**
+ * @brief Utility class to pile up the reads of a coordinate sorted SAM/BAM/CRAM file in a for-each loop
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * auto options = LocusIteratorOptions{};
+ * options.min_mapping_qual = 20;
+ * for (const auto& pileup : LocusReader{filename, options})
+ *   do_something_with_pileup(pileup);
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * SamReader<LocusIterator> also works if the default options are good enough.
+ */
+class LocusReader {
+ public:
+
+  /**
+   * @brief reads through all records in a file (or stdin if the filename is empty) piling them up by reference position
+   *
+   * @param filename the name of the sam file
+   * @param options read filters and depth cap to apply while building the pileups
+   */
+  LocusReader(const std::string& filename, const LocusIteratorOptions& options = LocusIteratorOptions{}) :
+    m_sam_file_ptr {},
+    m_sam_header_ptr {},
+    m_options {options}
+  {
+    auto* file_ptr = sam_open(filename.empty() ? "-" : filename.c_str(), "r");
+    if ( file_ptr == nullptr )
+      throw FileOpenException{filename};
+    m_sam_file_ptr = utils::make_shared_hts_file(file_ptr);
+    auto* header_ptr = sam_hdr_read(file_ptr);
+    if ( header_ptr == nullptr )
+      throw HeaderReadException{filename};
+    m_sam_header_ptr = utils::make_shared_sam_header(header_ptr);
+  }
+
+  /**
+   * @brief no copy construction/assignment allowed for iterators and readers
+   */
+  LocusReader(const LocusReader& other) = delete;
+  LocusReader& operator=(const LocusReader&) = delete;
+
+  /**
+   * @brief a LocusReader move constructor guarantees all objects will have the same state.
+   */
+  LocusReader(LocusReader&&) = default;
+  LocusReader& operator=(LocusReader&&) = default;
+
+  /**
+   * @brief creates a LocusIterator pointing at the first covered position of the input stream (needed by for-each loop)
+   */
+  LocusIterator begin() {
+    return LocusIterator{m_sam_file_ptr, m_sam_header_ptr, m_options};
+  }
+
+  /**
+   * @brief creates a LocusIterator with a nullified input stream (needed by for-each loop)
+   */
+  LocusIterator end() {
+    return LocusIterator{};
+  }
+
+  inline SamHeader header() { return SamHeader{m_sam_header_ptr}; }
+
+ private:
+  std::shared_ptr<htsFile> m_sam_file_ptr;     ///< pointer to the internal file structure of the sam/bam/cram file
+  std::shared_ptr<bam_hdr_t> m_sam_header_ptr; ///< pointer to the internal header structure of the sam/bam/cram file
+  LocusIteratorOptions m_options;              ///< filters and depth cap handed to the iterator
+};
+
+}  // end of namespace gamgee
+
+#endif // gamgee__locus_reader__guard
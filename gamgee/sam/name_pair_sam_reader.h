@@ -0,0 +1,91 @@
+#ifndef gamgee__name_pair_sam_reader__guard
+#define gamgee__name_pair_sam_reader__guard
+
+#include "sam_header.h"
+#include "sam_pair_iterator.h"
+
+#include "../exceptions.h"
+#include "../utils/hts_memory.h"
+
+#include "htslib/sam.h"
+
+#include <memory>
+#include <string>
+
+namespace gamgee {
+
+/**
+ * @brief Utility class to read the pairs of a SAM/BAM/CRAM file in any order (e.g. coordinate sorted) in a
+ * for-each loop, matching the mates by name
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * auto options = SamPairIteratorOptions{};
+ * options.memory_limit = uint64_t{1} << 30;
+ * for (const auto& pair : NamePairSamReader{"coordinate_sorted.bam", options})
+ *   do_something_with_pair(pair);
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Use PairSamReader instead if the mates are known to be adjacent (queryname sorted or grouped files).
+ */
+class NamePairSamReader {
+ public:
+
+  /**
+   * @brief reads through all records in a file (or stdin if the filename is empty) pairing them by name
+   *
+   * @param filename the name of the sam file
+   * @param options memory limit and temporary directory for the mates waiting for their pair (the mode is always by_name)
+   */
+  NamePairSamReader(const std::string& filename, const SamPairIteratorOptions& options = SamPairIteratorOptions{}) :
+    m_sam_file_ptr {},
+    m_sam_header_ptr {},
+    m_options {options}
+  {
+    m_options.mode = SamPairingMode::by_name;
+    auto* file_ptr = sam_open(filename.empty() ? "-" : filename.c_str(), "r");
+    if ( file_ptr == nullptr )
+      throw FileOpenException{filename};
+    m_sam_file_ptr = utils::make_shared_hts_file(file_ptr);
+    auto* header_ptr = sam_hdr_read(file_ptr);
+    if ( header_ptr == nullptr )
+      throw HeaderReadException{filename};
+    m_sam_header_ptr = utils::make_shared_sam_header(header_ptr);
+  }
+
+  /**
+   * @brief no copy construction/assignment allowed for iterators and readers
+   */
+  NamePairSamReader(const NamePairSamReader& other) = delete;
+  NamePairSamReader& operator=(const NamePairSamReader&) = delete;
+
+  /**
+   * @brief a NamePairSamReader move constructor guarantees all objects will have the same state.
+   */
+  NamePairSamReader(NamePairSamReader&&) = default;
+  NamePairSamReader& operator=(NamePairSamReader&&) = default;
+
+  /**
+   * @brief creates a SamPairIterator pointing at the first pair of the input stream (needed by for-each loop)
+   */
+  SamPairIterator begin() {
+    return SamPairIterator{m_sam_file_ptr, m_sam_header_ptr, m_options};
+  }
+
+  /**
+   * @brief creates a SamPairIterator with a nullified input stream (needed by for-each loop)
+   */
+  SamPairIterator end() {
+    return SamPairIterator{};
+  }
+
+  inline SamHeader header() { return SamHeader{m_sam_header_ptr}; }
+
+ private:
+  std::shared_ptr<htsFile> m_sam_file_ptr;     ///< pointer to the internal file structure of the sam/bam/cram file
+  std::shared_ptr<bam_hdr_t> m_sam_header_ptr; ///< pointer to the internal header structure of the sam/bam/cram file
+  SamPairIteratorOptions m_options;            ///< memory settings handed to the iterator
+};
+
+}  // end of namespace gamgee
+
+#endif // gamgee__name_pair_sam_reader__guard
@@ -0,0 +1,44 @@
+#include "pileup.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace gamgee {
+
+uint32_t Pileup::deletion_count() const {
+  return uint32_t(count_if(m_deletions.cbegin(), m_deletions.cend(), [](const uint8_t flag) { return flag != 0; }));
+}
+
+uint32_t Pileup::insertion_count() const {
+  return uint32_t(count_if(m_insertions.cbegin(), m_insertions.cend(), [](const uint8_t flag) { return flag != 0; }));
+}
+
+uint32_t Pileup::count(const Base base) const {
+  auto result = 0u;
+  for (auto i = 0u; i < m_bases.size(); ++i)
+    result += (m_bases[i] == base && !m_deletions[i]);
+  return result;
+}
+
+void Pileup::reset(const uint32_t chromosome, const uint32_t position) {
+  m_chromosome = chromosome;
+  m_position = position;
+  m_bases.clear();
+  m_base_quals.clear();
+  m_reverse.clear();
+  m_read_offsets.clear();
+  m_deletions.clear();
+  m_insertions.clear();
+}
+
+void Pileup::add(const Base base, const uint8_t qual, const bool reverse, const uint32_t read_offset, const bool deletion, const bool insertion) {
+  m_bases.push_back(base);
+  m_base_quals.push_back(qual);
+  m_reverse.push_back(reverse);
+  m_read_offsets.push_back(read_offset);
+  m_deletions.push_back(deletion);
+  m_insertions.push_back(insertion);
+}
+
+}
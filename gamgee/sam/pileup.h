@@ -0,0 +1,68 @@
+#ifndef gamgee__pileup__guard
+#define gamgee__pileup__guard
+
+#include "read_bases.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace gamgee {
+
+/**
+ * @brief A columnar view of all the reads overlapping a single reference position
+ *
+ * Each pileup element is stored across parallel columns (bases, base qualities, strands, read offsets
+ * and deletion/insertion flags) so that per-position analyses (genotyping, coverage, base counting)
+ * can scan the columns directly instead of chasing one object per read. Element i of every column
+ * refers to the same read.
+ *
+ * Pileups are produced by the LocusIterator, which re-uses the memory of the columns from one position
+ * to the next, so a Pileup obtained from an iterator is only valid until the iterator is advanced. Copy
+ * it if you need to keep it around.
+ *
+ * @note deletions are represented as elements with Base::N and base quality 0. The read offset of a
+ * deletion element is the offset of the next aligned base in the read.
+ */
+class Pileup {
+ public:
+  Pileup() = default;
+  Pileup(const Pileup& other) = default;
+  Pileup(Pileup&& other) = default;
+  Pileup& operator=(const Pileup& other) = default;
+  Pileup& operator=(Pileup&& other) = default;
+
+  uint32_t chromosome() const { return m_chromosome; }              ///< @brief chromosome index (0-based, as in the sam header) of this pileup
+  uint32_t position() const { return m_position; }                  ///< @brief reference position of this pileup (1-based, as you would see in a Sam file)
+  uint32_t size() const { return uint32_t(m_bases.size()); }        ///< @brief the depth of this pileup (number of elements, deletions included)
+  bool empty() const { return m_bases.empty(); }                    ///< @brief whether or not there are reads overlapping this position
+
+  const std::vector<Base>& bases() const { return m_bases; }                 ///< @brief column of read bases (Base::N for deletions)
+  const std::vector<uint8_t>& base_quals() const { return m_base_quals; }    ///< @brief column of base qualities (0 for deletions)
+  const std::vector<uint8_t>& reverse_strands() const { return m_reverse; }  ///< @brief column of strand flags (1 if the read is on the reverse strand, 0 otherwise)
+  const std::vector<uint32_t>& read_offsets() const { return m_read_offsets; } ///< @brief column of 0-based offsets of the base in its read
+  const std::vector<uint8_t>& deletions() const { return m_deletions; }      ///< @brief column of deletion flags (1 if the read has a deletion at this position)
+  const std::vector<uint8_t>& insertions() const { return m_insertions; }    ///< @brief column of insertion flags (1 if the read has an insertion immediately after this position)
+
+  uint32_t deletion_count() const;  ///< @brief number of elements that are deletions
+  uint32_t insertion_count() const; ///< @brief number of elements followed by an insertion
+  uint32_t count(const Base base) const; ///< @brief number of (non-deletion) elements with the given base
+
+ private:
+  uint32_t m_chromosome {0};
+  uint32_t m_position {0};
+  std::vector<Base> m_bases;
+  std::vector<uint8_t> m_base_quals;
+  std::vector<uint8_t> m_reverse;
+  std::vector<uint32_t> m_read_offsets;
+  std::vector<uint8_t> m_deletions;
+  std::vector<uint8_t> m_insertions;
+
+  void reset(const uint32_t chromosome, const uint32_t position); ///< empties all columns keeping their capacity
+  void add(const Base base, const uint8_t qual, const bool reverse, const uint32_t read_offset, const bool deletion, const bool insertion);
+
+  friend class LocusIterator; ///< the iterator fills the columns in place to avoid re-allocating them at every position
+};
+
+}  // end of namespace gamgee
+
+#endif /* gamgee__pileup__guard */
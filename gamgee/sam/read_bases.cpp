@@ -1,38 +1,50 @@
 #include "read_bases.h"
+#include "sam.h"
 
+#include "../utils/base_encoding.h"
 #include "../utils/hts_memory.h"
 #include "../utils/utils.h"
 
+#include <cstring>
 #include <string>
-#include <sstream>
 #include <stdexcept>
+#include <vector>
 
 using namespace std;
 
 namespace gamgee {
-  const map<Base, const char*> ReadBases::base_to_string_map = { {Base::A, "A"}, {Base::C, "C"}, {Base::G, "G"}, {Base::T, "T"}, {Base::N, "N"} }; 
-
   /**
    * @brief creates a ReadBases object that points to htslib memory already allocated
    * @param sam_record a shared pointer to an htslib raw sam record pointer for this object to take shared ownership
    * @note the resulting ReadBases object shares ownership of the pre-allocated memory via
    *       shared_ptr reference counting
    */
-  ReadBases::ReadBases(const std::shared_ptr<bam1_t>& sam_record) :
+  ReadBases::ReadBases(const utils::SamHandle& sam_record) :
     m_sam_record { sam_record },
     m_bases { bam_get_seq(sam_record.get()) },
-    m_num_bases { uint32_t((sam_record.get())->core.l_qseq) }
+    m_num_bases { uint32_t((sam_record.get())->core.l_qseq) },
+    m_record { nullptr }
   {}
 
+  /**
+   * @brief a view of the bases of a record, that writes go to (see Sam::bases())
+   */
+  ReadBases::ReadBases(const utils::SamHandle& sam_record, Sam* record) :
+    ReadBases { sam_record }
+  {
+    m_record = record;
+  }
+
   /**
    * @brief creates a deep copy of a ReadBases object
    *
    * @note the copy will have exclusive ownership over the newly-allocated htslib memory
    */
   ReadBases::ReadBases(const ReadBases& other) :
-    m_sam_record { utils::make_shared_sam(utils::sam_deep_copy(other.m_sam_record.get())) },
+    m_sam_record { utils::SamRecordPool::thread_local_pool().deep_copy(other.m_sam_record.get()) },
     m_bases { bam_get_seq(m_sam_record.get()) },
-    m_num_bases { other.m_num_bases }
+    m_num_bases { other.m_num_bases },
+    m_record { nullptr }
   {}
 
   /**
@@ -43,9 +55,10 @@ namespace gamgee {
   ReadBases& ReadBases::operator=(const ReadBases& other) {
     if ( &other == this )  
       return *this;
-    m_sam_record = utils::make_shared_sam(utils::sam_deep_copy(other.m_sam_record.get())); ///< shared_ptr assignment will take care of deallocating old sam record if necessary
+    utils::SamRecordPool::thread_local_pool().assign(m_sam_record, other.m_sam_record.get()); ///< copies in place if this object is the only user of its record
     m_bases = bam_get_seq(m_sam_record.get());
     m_num_bases = other.m_num_bases;
+    m_record = nullptr;
     return *this;
   }
 
@@ -67,10 +80,16 @@ namespace gamgee {
    */
   void ReadBases::set_base(const uint32_t index, const Base base) {
     utils::check_max_boundary(index, m_num_bases);
+    prepare_write();
     m_bases[index >> 1] &= ~(0xF << ((~index & 1) << 2));   ///< zero out previous 4-bit base encoding
     m_bases[index >> 1] |= static_cast<uint8_t>(base) << ((~index & 1) << 2);  ///< insert new 4-bit base encoding
   }
 
+  void ReadBases::prepare_write() {
+    if (Sam::prepare_view_write(m_record, m_sam_record))
+      m_bases = bam_get_seq(m_sam_record.get());
+  }
+
   /**
    * @brief check whether this object contains the same bases as another ReadBases object
    */
@@ -78,12 +97,11 @@ namespace gamgee {
     if ( m_num_bases != other.m_num_bases )
       return false;
 
-    for ( auto i = 0u; i < m_num_bases; ++i ) {
-      if ( (*this)[i] != other[i] )
-        return false;
-    }
-
-    return true;
+    // compare the packed bytes, except for the unused low nibble of the last byte of an odd number of bases
+    const auto full_bytes = m_num_bases >> 1;
+    if ( memcmp(m_bases, other.m_bases, full_bytes) != 0 )
+      return false;
+    return (m_num_bases & 1) == 0 || (m_bases[full_bytes] >> 4) == (other.m_bases[full_bytes] >> 4);
   }
 
   /**
@@ -95,14 +113,23 @@ namespace gamgee {
 
   /**
    * @brief returns a string representation of the bases in this read
+   *
+   * @note codes other than A, C, G, T and N are written as their IUPAC letters (see utils::decode_bases())
    */
   string ReadBases::to_string() const {
-    stringstream ss;
-
-    for ( uint32_t i = 0; i < m_num_bases; i++ ) {
-      ss << base_to_string_map.at((*this)[i]);
-    }
+    auto result = string(m_num_bases, '\0');
+    utils::decode_bases(m_bases, m_num_bases, result.data());
+    return result;
+  }
 
-    return ss.str();
+  /**
+   * @brief returns all the bases in this read, decoded at once (see utils::decode_bases())
+   *
+   * @note prefer this over a loop on operator[], which checks the bounds and unpacks a nibble per base
+   */
+  vector<Base> ReadBases::to_vector() const {
+    auto result = vector<Base>(m_num_bases);
+    utils::decode_bases(m_bases, m_num_bases, result.data());
+    return result;
   }
 }
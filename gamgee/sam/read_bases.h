@@ -1,13 +1,18 @@
 #ifndef gamgee__read_bases__guard
 #define gamgee__read_bases__guard
 
+#include "../utils/record_handle.h"
+
 #include "htslib/sam.h"
 
 #include <memory>
-#include <map>
+#include <string>
+#include <vector>
 
 namespace gamgee {
 
+class Sam;
+
 /**
  * @brief simple enum to hold all valid bases in the SAM format
  * @note enum values used here correspond to the 4-bit base encodings in htslib 
@@ -22,10 +27,13 @@ enum class Base { A = 1, C = 2, G = 4, T = 8, N = 15 };
  * with the underlying compressed memory model. 
  *
  * @note Any functionality lost because of this should be made available by the ReadBases class.
+ * @note writing through a view obtained from a non-const Sam modifies that record (after it stops sharing its
+ *       memory with its copies, see Sam), which must still be alive. Writing through any other view first gives
+ *       the view its own copy of the bases if anything else shares them.
  */
 class ReadBases {
 public:
-  explicit ReadBases(const std::shared_ptr<bam1_t>& sam_record);
+  explicit ReadBases(const utils::SamHandle& sam_record);
   ReadBases(const ReadBases& other);
   ReadBases(ReadBases&& other) = default;
   ReadBases& operator=(const ReadBases& other);
@@ -38,14 +46,18 @@ public:
   bool operator==(const ReadBases& other) const; ///< check for equality with another ReadBases object
   bool operator!=(const ReadBases& other) const; ///< check for inequality with another ReadBases object
   std::string to_string() const;  ///< produce a string representation of the bases in this object
+  std::vector<Base> to_vector() const; ///< all the bases at once, decoded in bulk
 
 private:
-  std::shared_ptr<bam1_t> m_sam_record; ///< sam record containing our bases, potentially co-owned by multiple other objects
+  utils::SamHandle m_sam_record; ///< sam record containing our bases, potentially co-owned by multiple other objects
   uint8_t* m_bases;                     ///< pointer to the start of the bases in m_sam_record, cached for efficiency
   uint32_t m_num_bases;                 ///< number of bases in our sam record
+  Sam* m_record;                        ///< record the view was obtained from, that writes go to (null if none)
 
-  static const std::map<Base, const char*> base_to_string_map; ///< @brief simple lookup table to convert Base enum values to chars. 
+  ReadBases(const utils::SamHandle& sam_record, Sam* record);
+  void prepare_write();                 ///< @brief makes sure nothing but m_record (if any) shares the bases before they are modified
 
+  friend class Sam;
   friend class SamBuilder; ///< builder needs access to the internals in order to build efficiently
 };
 
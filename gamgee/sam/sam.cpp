@@ -5,7 +5,9 @@
 
 #include "../missing.h"
 #include "../utils/hts_memory.h"
+#include "../utils/utils.h"
 
+#include <cstring>
 #include <iostream>
 #include <string>
 
@@ -13,45 +15,135 @@ using namespace std;
 
 namespace gamgee {
 
-constexpr auto MATE_CIGAR_TAG = "MC";
+constexpr auto MATE_CIGAR_TAG = SamTagKey{"MC"};
 
-Sam::Sam(const std::shared_ptr<bam_hdr_t>& header, const std::shared_ptr<bam1_t>& body) noexcept :
+Sam::Sam(const std::shared_ptr<bam_hdr_t>& header, const utils::SamHandle& body) noexcept :
   m_header {header},
   m_body {body}
 {}
 
 Sam::Sam(const Sam& other) :
   m_header { other.m_header },
-  m_body { utils::make_shared_sam(utils::sam_deep_copy(other.m_body.get())) }
+  m_body { other.m_body },
+  m_copies { other.m_body == nullptr ? utils::CopyOnWriteGroup{} : other.m_copies.join() }
 {}
 
 Sam& Sam::operator=(const Sam& other) {
   if ( &other == this )  
     return *this;
   m_header = other.m_header;      ///< shared_ptr assignment will take care of deallocating old sam record if necessary
-  m_body = utils::make_shared_sam(utils::sam_deep_copy(other.m_body.get()));     ///< shared_ptr assignment will take care of deallocating old sam record if necessary
+  m_body = other.m_body;
+  m_copies = other.m_body == nullptr ? utils::CopyOnWriteGroup{} : other.m_copies.join();
+  invalidate_caches();
   return *this;
 }
 
-uint32_t Sam::mate_alignment_stop(const SamTag<string>& mate_cigar_tag) const {
-  auto result = mate_alignment_start();
-  stringstream cigar_stream {mate_cigar_tag.value()};
+/**
+ * @brief the deep copy comes from the thread local SamRecordPool, so modifying records copied in a loop doesn't
+ * allocate memory once the pool has warmed up
+ */
+void Sam::unshare() {
+  m_body = utils::SamRecordPool::thread_local_pool().deep_copy(m_body.get());
+  m_copies.leave();
+}
+
+/**
+ * A view still looking at the body of its record writes to the record, which stops sharing it with its copies
+ * first. Any other view (of a const record, or whose record has moved on to another body) takes its own copy
+ * of the body if the record, its copies or other views still use it.
+ */
+bool Sam::prepare_view_write(Sam* record, utils::SamHandle& body) {
+  if (record != nullptr && record->m_body == body) {
+    if (!record->m_copies.shared())
+      return false;
+    record->detach();
+    body = record->m_body;
+    return true;
+  }
+  if (body.use_count() == 1)
+    return false;
+  body = utils::SamRecordPool::thread_local_pool().deep_copy(body.get());
+  return true;
+}
+
+/**
+ * @brief iterators call this before reading the next record into the buffer they served this one from: the
+ * copies the caller took keep the old buffer and the iterator moves on to a new one from the pool
+ */
+const utils::SamHandle& Sam::reusable_body() {
+  invalidate_caches();
+  if (m_copies.shared()) {
+    m_body = utils::SamRecordPool::thread_local_pool().allocate();
+    m_copies.leave();
+  }
+  return m_body;
+}
+
+/**
+ * @brief all the mate coordinates from a single pass over the mate cigar
+ *
+ * Clips before the first other operator count towards the unclipped start, and clips after it towards the
+ * unclipped stop. The stops only move past the start if the mate has operators consuming reference bases.
+ */
+static MateCoordinates parse_mate_coordinates(const uint32_t mate_start, string_view mate_cigar) {
+  auto reference_bases = 0u;
+  auto leading_clips = 0u;
+  auto trailing_clips = 0u;
+  auto past_leading_clips = false;
   auto has_reference_bases = false;
-  while (cigar_stream.peek() != std::char_traits<char>::eof()) {
-    const auto element = Cigar::parse_next_cigar_element(cigar_stream);
-    if (Cigar::consumes_reference_bases(Cigar::cigar_op(element))) {
-      result +=  Cigar::cigar_oplen(element);
+  auto has_unclipped_tail = false;
+  while (!mate_cigar.empty()) {
+    const auto element = Cigar::parse_next_cigar_element(mate_cigar);
+    const auto op = Cigar::cigar_op(element);
+    const auto length = Cigar::cigar_oplen(element);
+    if (op == CigarOperator::S || op == CigarOperator::H) {
+      if (past_leading_clips) {
+        trailing_clips += length;
+        has_unclipped_tail = true;
+      }
+      else
+        leading_clips += length;
+      continue;
+    }
+    past_leading_clips = true;
+    if (Cigar::consumes_reference_bases(op)) {
+      reference_bases += length;
       has_reference_bases = true;
+      has_unclipped_tail = true;
     }
   }
-  return has_reference_bases ? result-1 : result; // we want the last base to be 1-based and **inclusive** but we only need to deduct 1 if we had any reference consuming operators in the read.
+  // we want the stops to be 1-based and **inclusive**, so we deduct 1 only if we added any lengths to the start
+  return MateCoordinates{mate_start,
+                         has_reference_bases ? mate_start + reference_bases - 1 : mate_start,
+                         mate_start - leading_clips,
+                         has_unclipped_tail ? mate_start + reference_bases + trailing_clips - 1 : mate_start};
+}
+
+uint64_t Sam::name_hash() const {
+  return utils::name_hash(bam_get_qname(m_body.get()));
+}
+
+MateCoordinates Sam::mate_coordinates() const {
+  return m_mate_coordinates.get([this] {
+    const auto mate_cigar = string_tag(MATE_CIGAR_TAG);
+    if (missing(mate_cigar))
+      throw std::invalid_argument{string{"Cannot find the mate coordinates on a record without the tag: "} + MATE_CIGAR_TAG.name()};
+    return parse_mate_coordinates(mate_alignment_start(), mate_cigar.value());
+  });
+}
+
+MateCoordinates Sam::mate_coordinates(const SamTag<string_view>& mate_cigar_tag) const {
+  return parse_mate_coordinates(mate_alignment_start(), mate_cigar_tag.value());
+}
+
+uint32_t Sam::mate_alignment_stop(const SamTag<string_view>& mate_cigar_tag) const {
+  return mate_coordinates(mate_cigar_tag).alignment_stop;
 }
 
 uint32_t Sam::mate_alignment_stop() const {
-  const auto mate_cigar = string_tag(MATE_CIGAR_TAG);
-  if (missing(mate_cigar))
-    throw std::invalid_argument{string{"Cannot find the mate alignment stop on a record without the tag: "} + MATE_CIGAR_TAG};
-  return mate_alignment_stop(mate_cigar);
+  if (missing(string_tag(MATE_CIGAR_TAG)))
+    throw std::invalid_argument{string{"Cannot find the mate alignment stop on a record without the tag: "} + MATE_CIGAR_TAG.name()};
+  return mate_coordinates().alignment_stop;
 }
 
 uint32_t Sam::unclipped_start() const {
@@ -81,114 +173,115 @@ uint32_t Sam::unclipped_stop() const {
 }
 
 uint32_t Sam::mate_unclipped_start() const {
-  const auto mate_cigar_tag = string_tag(MATE_CIGAR_TAG);
-  if (missing(mate_cigar_tag))
-    throw std::invalid_argument{string{"Cannot find the mate unclipped start on a record without the tag: "} + MATE_CIGAR_TAG};
-  return mate_unclipped_start(mate_cigar_tag);
+  if (missing(string_tag(MATE_CIGAR_TAG)))
+    throw std::invalid_argument{string{"Cannot find the mate unclipped start on a record without the tag: "} + MATE_CIGAR_TAG.name()};
+  return mate_coordinates().unclipped_start;
 }
 
-uint32_t Sam::mate_unclipped_start(const SamTag<string>& mate_cigar_tag) const {
-  auto result = mate_alignment_start();
-  stringstream cigar_stream {mate_cigar_tag.value()};
-  while (cigar_stream.peek() != std::char_traits<char>::eof()) {
-    const auto element = Cigar::parse_next_cigar_element(cigar_stream);
-    const auto op = Cigar::cigar_op(element);
-    if (op != CigarOperator::S && op != CigarOperator::H)
-      break;
-    result -= Cigar::cigar_oplen(element);
-  }
-  return result;
+uint32_t Sam::mate_unclipped_start(const SamTag<string_view>& mate_cigar_tag) const {
+  return mate_coordinates(mate_cigar_tag).unclipped_start;
 }
 
 uint32_t Sam::mate_unclipped_stop() const {
-  const auto mate_cigar_tag = string_tag(MATE_CIGAR_TAG);
-  if (missing(mate_cigar_tag))
-    throw std::invalid_argument{string{"Cannot find the mate unclipped stop on a record without the tag: "} + MATE_CIGAR_TAG};
-  return mate_unclipped_stop(mate_cigar_tag);
+  if (missing(string_tag(MATE_CIGAR_TAG)))
+    throw std::invalid_argument{string{"Cannot find the mate unclipped stop on a record without the tag: "} + MATE_CIGAR_TAG.name()};
+  return mate_coordinates().unclipped_stop;
 }
 
-uint32_t Sam::mate_unclipped_stop(const SamTag<string>& mate_cigar_tag) const {
-  auto result = mate_alignment_start();
-  stringstream cigar_stream {mate_cigar_tag.value()};
-  auto end_tail = false;
-  auto has_reference_bases = false;
-  while (cigar_stream.peek() != std::char_traits<char>::eof()) {
-    const auto element = Cigar::parse_next_cigar_element(cigar_stream);
-    const auto op = Cigar::cigar_op(element);
-    if (!end_tail && (op == CigarOperator::S || op == CigarOperator::H))
-      continue;
-    if (!end_tail)
-      end_tail = true;
-    if (Cigar::consumes_reference_bases(op) || op == CigarOperator::S || op == CigarOperator::H) {
-      result += Cigar::cigar_oplen(element);
-      has_reference_bases = true;
-    }
-  }
-  return has_reference_bases ? result - 1 : result; // we only want to subtract 1 in case we actually had bases in the read that modified the alignment start. Because we are adding the length of the operators, we will end up pointing to one past the unclipped stop of the read. We want to be **inclusive**. 
+uint32_t Sam::mate_unclipped_stop(const SamTag<string_view>& mate_cigar_tag) const {
+  return mate_coordinates(mate_cigar_tag).unclipped_stop;
 }
 
-
+/**
+ * @brief the value of an aux entry of a fixed size type (aux values aren't aligned)
+ */
+template<class VALUE>
+static VALUE aux_value(const uint8_t* aux_ptr) {
+  auto value = VALUE{};
+  memcpy(&value, aux_ptr + 1, sizeof(VALUE));
+  return value;
+}
 
 /**
  * @brief retrieve an integer-valued tag by name
  *
- * @note returns a SamTag with missing() == true if the read has no tag by this name
+ * @note returns a SamTag with missing() == true if the read has no tag by this name or if it's not an integer
  */
-SamTag<int32_t> Sam::integer_tag(const std::string& tag_name) const {
-  const auto aux_ptr = bam_aux_get(m_body.get(), tag_name.c_str());
-  return aux_ptr == nullptr ? SamTag<int32_t>(tag_name, 0, true) :
-                              SamTag<int32_t>(tag_name, bam_aux2i(aux_ptr));
-
-  // TODO: htslib bam_aux2i() returns 0 if the tag is not of integer type,
-  //       but 0 is a valid value for a correctly-typed tag. This should be patched.
+SamTag<int32_t> Sam::integer_tag(const SamTagKey tag_name) const {
+  const auto aux_ptr = m_tag_index.find(m_body.get(), tag_name);
+  switch (aux_ptr == nullptr ? '\0' : aux_ptr[0]) {
+    case 'c': return SamTag<int32_t>(tag_name, aux_value<int8_t>(aux_ptr));
+    case 'C': return SamTag<int32_t>(tag_name, aux_value<uint8_t>(aux_ptr));
+    case 's': return SamTag<int32_t>(tag_name, aux_value<int16_t>(aux_ptr));
+    case 'S': return SamTag<int32_t>(tag_name, aux_value<uint16_t>(aux_ptr));
+    case 'i': return SamTag<int32_t>(tag_name, aux_value<int32_t>(aux_ptr));
+    case 'I': return SamTag<int32_t>(tag_name, int32_t(aux_value<uint32_t>(aux_ptr)));
+    default:  return SamTag<int32_t>(tag_name, 0, true);
+  }
 }
 
 /**
  * @brief retrieve a double/float-valued tag by name
  *
- * @note returns a SamTag with missing() == true if the read has no tag by this name
+ * @note returns a SamTag with missing() == true if the read has no tag by this name or if it's not a float or double
  */
-SamTag<double> Sam::double_tag(const std::string& tag_name) const {
-  const auto aux_ptr = bam_aux_get(m_body.get(), tag_name.c_str());
-  return aux_ptr == nullptr ? SamTag<double>(tag_name, 0.0, true) :
-                              SamTag<double>(tag_name, bam_aux2f(aux_ptr));
-
-  // TODO: htslib bam_aux2f() returns 0.0 if the tag is not of double/float type,
-  //       but 0.0 is a valid value for a correctly-typed tag. This should be patched.
+SamTag<double> Sam::double_tag(const SamTagKey tag_name) const {
+  const auto aux_ptr = m_tag_index.find(m_body.get(), tag_name);
+  switch (aux_ptr == nullptr ? '\0' : aux_ptr[0]) {
+    case 'f': return SamTag<double>(tag_name, aux_value<float>(aux_ptr));
+    case 'd': return SamTag<double>(tag_name, aux_value<double>(aux_ptr));
+    default:  return SamTag<double>(tag_name, 0.0, true);
+  }
 }
 
 /**
  * @brief retrieve a char-valued tag by name
  *
- * @note returns a SamTag with missing() == true if the read has no tag by this name
+ * @note returns a SamTag with missing() == true if the read has no tag by this name or if it's not a char
  */
-SamTag<char> Sam::char_tag(const std::string& tag_name) const {
-  const auto aux_ptr = bam_aux_get(m_body.get(), tag_name.c_str());
-  if ( aux_ptr == nullptr )  // tag doesn't exist
-    return SamTag<char>(tag_name, '\0', true);
-
-  const auto char_val = bam_aux2A(aux_ptr);
-  if ( char_val == '\0' )    // tag not of char type
+SamTag<char> Sam::char_tag(const SamTagKey tag_name) const {
+  const auto aux_ptr = m_tag_index.find(m_body.get(), tag_name);
+  if ( aux_ptr == nullptr || aux_ptr[0] != 'A' )  // tag doesn't exist or is not of char type
     return SamTag<char>(tag_name, '\0', true);
+  return SamTag<char>(tag_name, char(aux_ptr[1]));
+}
 
-  return SamTag<char>(tag_name, char_val);
+/**
+ * @brief retrieve a string-valued tag by name, pointing into the record
+ *
+ * @note returns a SamTag with missing() == true if the read has no tag by this name or if it's not a string (Z or H)
+ */
+SamTag<string_view> Sam::string_tag(const SamTagKey tag_name) const {
+  const auto aux_ptr = m_tag_index.find(m_body.get(), tag_name);
+  if ( aux_ptr == nullptr || (aux_ptr[0] != 'Z' && aux_ptr[0] != 'H') )  // tag doesn't exist or is not of string type
+    return SamTag<string_view>(tag_name, string_view{}, true);
+  return SamTag<string_view>(tag_name, string_view{reinterpret_cast<const char*>(aux_ptr + 1)});  // found entries are complete (null terminated)
 }
 
 /**
- * @brief retrieve a string-valued tag by name
+ * @brief retrieve an array-valued (B) tag by name, as a view of the values in the record
  *
- * @note returns a SamTag with missing() == true if the read has no tag by this name
+ * @note returns a SamTag with missing() == true if the read has no tag by this name or if it's not an array of ELEMENT
  */
-SamTag<std::string> Sam::string_tag(const std::string& tag_name) const {
-  const auto aux_ptr = bam_aux_get(m_body.get(), tag_name.c_str());
-  if ( aux_ptr == nullptr )  // tag doesn't exist
-    return SamTag<string>(tag_name, "", true);
+template<class ELEMENT>
+SamTag<SamTagArray<ELEMENT>> Sam::array_tag(const SamTagKey tag_name) const {
+  const auto aux_ptr = m_tag_index.find(m_body.get(), tag_name);
+  if ( aux_ptr == nullptr || aux_ptr[0] != 'B' || aux_ptr[1] != SamTagArray<ELEMENT>::type )  // tag doesn't exist or is not an array of this type
+    return SamTag<SamTagArray<ELEMENT>>(tag_name, SamTagArray<ELEMENT>{}, true);
+  return SamTag<SamTagArray<ELEMENT>>(tag_name, SamTagArray<ELEMENT>{aux_ptr + 6, aux_value<uint32_t>(aux_ptr + 1)});  // found entries are complete
+}
 
-  const auto str_ptr = bam_aux2Z(aux_ptr);
-  if ( str_ptr == nullptr )  // tag not of string type
-    return SamTag<string>(tag_name, "", true);
+template SamTag<SamTagArray<int8_t>> Sam::array_tag(const SamTagKey tag_name) const;
+template SamTag<SamTagArray<uint8_t>> Sam::array_tag(const SamTagKey tag_name) const;
+template SamTag<SamTagArray<int16_t>> Sam::array_tag(const SamTagKey tag_name) const;
+template SamTag<SamTagArray<uint16_t>> Sam::array_tag(const SamTagKey tag_name) const;
+template SamTag<SamTagArray<int32_t>> Sam::array_tag(const SamTagKey tag_name) const;
+template SamTag<SamTagArray<uint32_t>> Sam::array_tag(const SamTagKey tag_name) const;
+template SamTag<SamTagArray<float>> Sam::array_tag(const SamTagKey tag_name) const;
 
-  return SamTag<string>(tag_name, string{str_ptr});
+char Sam::array_tag_type(const SamTagKey tag_name) const {
+  const auto aux_ptr = m_tag_index.find(m_body.get(), tag_name);
+  return aux_ptr == nullptr || aux_ptr[0] != 'B' ? '\0' : char(aux_ptr[1]);
 }
 
 }
@@ -7,15 +7,75 @@
 #include "cigar.h"
 #include "sam_tag.h"
 
+#include "../utils/hts_memory.h"
+
 #include "htslib/sam.h"
 
+#include <atomic>
 #include <string>
+#include <string_view>
 #include <memory>
 
 namespace gamgee {
 
+/**
+ * @brief the alignment coordinates of the mate of a read, from its mate position and mate cigar ("MC") tag
+ *
+ * All positions are 1-based and inclusive, as returned by the individual mate_* functions of Sam.
+ */
+struct MateCoordinates {
+  uint32_t alignment_start;   ///< @brief same as Sam::mate_alignment_start()
+  uint32_t alignment_stop;    ///< @brief same as Sam::mate_alignment_stop()
+  uint32_t unclipped_start;   ///< @brief same as Sam::mate_unclipped_start()
+  uint32_t unclipped_stop;    ///< @brief same as Sam::mate_unclipped_stop()
+};
+
+/**
+ * @brief the MateCoordinates of a record, computed by the first call to Sam::mate_coordinates() and kept until
+ * invalidate() is called (by the owner of the cache, whenever the record changes)
+ *
+ * Thread safe in the same way as SamTagIndex: if two threads race to fill the cache, the loser computes the
+ * coordinates itself.
+ */
+class MateCoordinatesCache {
+ public:
+  MateCoordinatesCache() : m_coordinates {}, m_state {empty} {}
+  MateCoordinatesCache(const MateCoordinatesCache&) : MateCoordinatesCache {} {}            ///< @brief copies start empty
+  MateCoordinatesCache& operator=(const MateCoordinatesCache&) { invalidate(); return *this; }
+
+  template<class COMPUTE>
+  MateCoordinates get(COMPUTE compute) const {            ///< @brief the cached coordinates, or the result of compute() (cached if no other thread is filling the cache)
+    auto state = m_state.load(std::memory_order_acquire);
+    if (state == filled)
+      return m_coordinates;
+    if (state == empty && m_state.compare_exchange_strong(state, filling, std::memory_order_acquire)) {
+      m_coordinates = compute();
+      m_state.store(filled, std::memory_order_release);
+      return m_coordinates;
+    }
+    return compute();
+  }
+
+  void invalidate() { m_state.store(empty, std::memory_order_relaxed); }                   ///< @brief forgets the coordinates (the record changed)
+
+ private:
+  enum : uint8_t { empty, filling, filled };
+
+  mutable MateCoordinates m_coordinates;
+  mutable std::atomic<uint8_t> m_state;
+};
+
 /**
  * @brief Utility class to manipulate a Sam record.
+ *
+ * Copies are copy-on-write: a copy shares the htslib memory of the original until either of them is modified,
+ * through a setter or through one of its cigar(), bases() or base_quals() views, which then makes its own deep
+ * copy first. Copying a record just to read it (e.g. to keep a window of records or to hand them to other
+ * threads) is therefore only a reference count increment, and so is reading it through a const record (or a
+ * const view).
+ *
+ * @note writing through a view of a non-const record modifies the record (which must still be alive), and never
+ *       its copies. Writing through a view of a const record gives the view its own copy of the data.
  */
 class Sam {
  public:
@@ -32,14 +92,13 @@ class Sam {
    * @note the resulting Sam shares ownership of the pre-allocated memory via shared_ptr
    *       reference counting
    */
-  explicit Sam(const std::shared_ptr<bam_hdr_t>& header, const std::shared_ptr<bam1_t>& body) noexcept; 
+  explicit Sam(const std::shared_ptr<bam_hdr_t>& header, const utils::SamHandle& body) noexcept; 
 
   /**
-   * @brief creates a deep copy of a sam record
+   * @brief creates a copy-on-write copy of a sam record
    *
-   * @note the copy will have exclusive ownership over the newly-allocated htslib memory
-   *       until a data field (cigar, bases, etc.) is accessed, after which it will be
-   *       shared via reference counting with the Cigar, etc. objects
+   * @note the copy shares the htslib memory of the original until one of them is modified, at which
+   *       point the modified one makes a deep copy of it (see the class documentation)
    * @note does not perform a deep copy of the sam header; to copy the header,
    *       first get it via the header() function and then copy it via the usual C++
    *       semantics
@@ -131,6 +190,24 @@ class Sam {
    */
   uint32_t mate_alignment_start() const { return uint32_t(m_body->core.mpos+1);  }       
 
+  /**
+   * @brief returns all the (1-based and inclusive) coordinates of the mate, from a single parse of the mate cigar ("MC") tag
+   *
+   * The result is cached in the record (until it is modified), so asking for the mate's stop and unclipped
+   * positions separately, through this function or through mate_alignment_stop(), mate_unclipped_start()
+   * and mate_unclipped_stop(), parses the mate cigar only once.
+   *
+   * @throw std::invalid_argument if called on a record that doesn't contain the mate cigar ("MC") tag, or if the tag isn't a valid cigar.
+   */
+  MateCoordinates mate_coordinates() const;
+
+  /**
+   * @brief returns all the (1-based and inclusive) coordinates of the mate from a mate cigar tag you already have (not cached)
+   * @param mate_cigar_tag the MC tag as obtained via the string_tag("MC") API in Sam.
+   * @warning This overload DOES NOT throw an exception if the mate cigar tag is missing. Instead all coordinates are mate_alignment_start(). Treat it as undefined behavior.
+   */
+  MateCoordinates mate_coordinates(const SamTag<std::string_view>& mate_cigar_tag) const;
+
   /**
    * @brief returns a (1-based and inclusive) mate's alignment stop position.
    * @note the internal encoding is 0-based to mimic that of the BAM files. 
@@ -165,7 +242,7 @@ class Sam {
    * @warning This overload DOES NOT throw an exception if the mate cigar tag is missing. Instead it returns mate_alignment_start(). Treat it as undefined behavior. 
    * @note the internal encoding is 0-based to mimic that of the BAM files. 
    */
-  uint32_t mate_alignment_stop(const SamTag<std::string>& mate_cigar_tag) const ;       
+  uint32_t mate_alignment_stop(const SamTag<std::string_view>& mate_cigar_tag) const ;       
 
   /**
    * @brief returns a (1-based and inclusive) mate's unclipped alignment start position. 
@@ -200,7 +277,7 @@ class Sam {
    * @warning This overload DOES NOT throw an exception if the mate cigar tag is missing. Instead it returns mate_alignment_start(). Treat it as undefined behavior. 
    * @note the internal encoding is 0-based to mimic that of the BAM files.
    */
-  uint32_t mate_unclipped_start(const SamTag<std::string>& mate_cigar_tag) const;        
+  uint32_t mate_unclipped_start(const SamTag<std::string_view>& mate_cigar_tag) const;        
 
   /**
    * @brief returns a (1-based and inclusive) mate's unclipped alignment stop position. @throw std::invalid_argument if called on a record that doesn't contain the mate cigar ("MC") tag.
@@ -234,7 +311,7 @@ class Sam {
    * @warning This overload DOES NOT throw an exception if the mate cigar tag is missing. Instead it returns mate_alignment_start(). Treat it as undefined behavior. 
    * @note the internal encoding is 0-based to mimic that of the BAM files.
    */
-  uint32_t mate_unclipped_stop(const SamTag<std::string>& mate_cigar_tag) const;        
+  uint32_t mate_unclipped_stop(const SamTag<std::string_view>& mate_cigar_tag) const;        
 
   /**
    * @brief returns the mapping quality of this alignment
@@ -256,24 +333,31 @@ class Sam {
   int32_t insert_size() const { return m_body->core.isize; }
 
   // modify non-variable length fields (things outside of the data member)
-  void set_chromosome(const uint32_t chr)              { m_body->core.tid  = int32_t(chr);        } ///< @brief simple setter for the chromosome index. Index is 0-based.
-  void set_alignment_start(const uint32_t start)       { m_body->core.pos  = int32_t(start-1);    } ///< @brief simple setter for the alignment start. @warning You should use (1-based and inclusive) alignment but internally this is stored 0-based to simplify BAM conversion.
-  void set_mate_chromosome(const uint32_t mchr)        { m_body->core.mtid = int32_t(mchr);       } ///< @brief simple setter for the mate's chromosome index. Index is 0-based.
-  void set_mate_alignment_start(const uint32_t mstart) { m_body->core.mpos = int32_t(mstart - 1); } ///< @brief simple setter for the mate's alignment start. @warning You should use (1-based and inclusive) alignment but internally this is stored 0-based to simplify BAM conversion.
-  void set_mapping_qual(const uint8_t mapq)            { m_body->core.qual = mapq;                } ///< @brief simple setter for the alignment quality
-  void set_insert_size(const int32_t isize)        { m_body->core.isize = isize;              } ///< @brief simple setter for the insert size
+  void set_chromosome(const uint32_t chr)              { detach(); m_body->core.tid  = int32_t(chr);        } ///< @brief simple setter for the chromosome index. Index is 0-based.
+  void set_alignment_start(const uint32_t start)       { detach(); m_body->core.pos  = int32_t(start-1);    } ///< @brief simple setter for the alignment start. @warning You should use (1-based and inclusive) alignment but internally this is stored 0-based to simplify BAM conversion.
+  void set_mate_chromosome(const uint32_t mchr)        { detach(); m_body->core.mtid = int32_t(mchr);       } ///< @brief simple setter for the mate's chromosome index. Index is 0-based.
+  void set_mate_alignment_start(const uint32_t mstart) { detach(); m_body->core.mpos = int32_t(mstart - 1); } ///< @brief simple setter for the mate's alignment start. @warning You should use (1-based and inclusive) alignment but internally this is stored 0-based to simplify BAM conversion.
+  void set_mapping_qual(const uint8_t mapq)            { detach(); m_body->core.qual = mapq;                } ///< @brief simple setter for the alignment quality
+  void set_insert_size(const int32_t isize)        { detach(); m_body->core.isize = isize;              } ///< @brief simple setter for the insert size
 
   // getters for fields inside the data field
   std::string name() const { return std::string{bam_get_qname(m_body.get())}; } ///< @brief returns the read name
-  Cigar cigar() const { return Cigar{m_body}; }                                 ///< @brief returns the cigar. @warning the objects returned by this member function will share underlying htslib memory with this object. @warning creates an object but doesn't copy the underlying values.
-  ReadBases bases() const { return ReadBases{m_body}; }                         ///< @brief returns the read bases. @warning the objects returned by this member function will share underlying htslib memory with this object. @warning creates an object but doesn't copy the underlying values.
-  BaseQuals base_quals() const { return BaseQuals{m_body}; }                    ///< @brief returns the base qualities. @warning the objects returned by this member function will share underlying htslib memory with this object. @warning creates an object but doesn't copy the underlying values.
-
-  // getters for tagged values within the aux part of the data field
-  SamTag<int32_t> integer_tag(const std::string& tag_name) const;    ///< @brief retrieve an integer-valued tag by name. @warning creates an object but doesn't copy the underlying values.
-  SamTag<double> double_tag(const std::string& tag_name) const;      ///< @brief retrieve an double/float-valued tag by name. @warning creates an object but doesn't copy the underlying values.
-  SamTag<char> char_tag(const std::string& tag_name) const;          ///< @brief retrieve a char-valued tag by name. @warning creates an object but doesn't copy the underlying values.
-  SamTag<std::string> string_tag(const std::string& tag_name) const; ///< @brief retrieve a string-valued tag by name. @warning creates an object but doesn't copy the underlying values.
+  uint64_t name_hash() const;                                                   ///< @brief returns a 64 bit hash of the read name (see utils::name_hash()), without copying the name
+  const Cigar cigar() const { return Cigar{m_body}; }                           ///< @brief returns the cigar. @warning the objects returned by this member function will share underlying htslib memory with this object (and its unmodified copies) until they are written to. @warning creates an object but doesn't copy the underlying values.
+  const ReadBases bases() const { return ReadBases{m_body}; }                   ///< @brief returns the read bases. @warning the objects returned by this member function will share underlying htslib memory with this object (and its unmodified copies) until they are written to. @warning creates an object but doesn't copy the underlying values.
+  const BaseQuals base_quals() const { return BaseQuals{m_body}; }              ///< @brief returns the base qualities. @warning the objects returned by this member function will share underlying htslib memory with this object (and its unmodified copies) until they are written to. @warning creates an object but doesn't copy the underlying values.
+  Cigar cigar() { return Cigar{m_body, this}; }                                 ///< @brief returns the cigar, writing to which modifies this record (see the class documentation). @warning creates an object but doesn't copy the underlying values.
+  ReadBases bases() { return ReadBases{m_body, this}; }                         ///< @brief returns the read bases, writing to which modifies this record (see the class documentation). @warning creates an object but doesn't copy the underlying values.
+  BaseQuals base_quals() { return BaseQuals{m_body, this}; }                    ///< @brief returns the base qualities, writing to which modifies this record (see the class documentation). @warning creates an object but doesn't copy the underlying values.
+
+  // getters for tagged values within the aux part of the data field (the first lookup indexes the aux data, so reading several tags scans it once)
+  SamTag<int32_t> integer_tag(const SamTagKey tag_name) const;            ///< @brief retrieve an integer-valued tag by name (missing if the tag isn't of an integer type). @warning creates an object but doesn't copy the underlying values.
+  SamTag<double> double_tag(const SamTagKey tag_name) const;              ///< @brief retrieve an double/float-valued tag by name (missing if the tag isn't of a floating point type). @warning creates an object but doesn't copy the underlying values.
+  SamTag<char> char_tag(const SamTagKey tag_name) const;                  ///< @brief retrieve a char-valued tag by name (missing if the tag isn't of char type). @warning creates an object but doesn't copy the underlying values.
+  SamTag<std::string_view> string_tag(const SamTagKey tag_name) const;    ///< @brief retrieve a string-valued tag by name (missing if the tag isn't of string or hex string type). @warning the value points into the record, it is only valid while the record is alive and unmodified.
+  template<class ELEMENT>
+  SamTag<SamTagArray<ELEMENT>> array_tag(const SamTagKey tag_name) const; ///< @brief retrieve an array-valued (B) tag by name, e.g. array_tag<uint8_t>("ML") (missing if the tag isn't an array of ELEMENT). @warning the value points into the record, it is only valid while the record is alive and unmodified.
+  char array_tag_type(const SamTagKey tag_name) const;                    ///< @brief the element type of an array-valued (B) tag (one of cCsSiIf, see SamTagArrayType) or '\0' if the record has no array tag by this name
 
   // getters for flags 
   bool paired() const { return m_body->core.flag & BAM_FPAIRED;        }          ///< @brief whether or not this read is paired
@@ -290,37 +374,53 @@ class Sam {
   bool supplementary() const { return m_body->core.flag & BAM_FSUPPLEMENTARY; }   ///< @brief whether or not this read is a supplementary alignment (see definition in the BAM spec)
 
   // modify flags
-  void set_paired()            { m_body->core.flag |= BAM_FPAIRED;         } 
-  void set_not_paired()        { m_body->core.flag &= ~BAM_FPAIRED;        }
-  void set_unmapped()          { m_body->core.flag |= BAM_FUNMAP;          }
-  void set_not_unmapped()      { m_body->core.flag &= ~BAM_FUNMAP;         }
-  void set_mate_unmapped()     { m_body->core.flag |= BAM_FMUNMAP;         }
-  void set_not_mate_unmapped() { m_body->core.flag &= ~BAM_FMUNMAP;        }
-  void set_reverse()           { m_body->core.flag |= BAM_FREVERSE;        }
-  void set_not_reverse()       { m_body->core.flag &= ~BAM_FREVERSE;       }
-  void set_mate_reverse()      { m_body->core.flag |= BAM_FMREVERSE;       }
-  void set_not_mate_reverse()  { m_body->core.flag &= ~BAM_FMREVERSE;      }
-  void set_first()             { m_body->core.flag |= BAM_FREAD1;          }
-  void set_not_first()         { m_body->core.flag &= ~BAM_FREAD1;         }
-  void set_last()              { m_body->core.flag |= BAM_FREAD2;          }
-  void set_not_last()          { m_body->core.flag &= ~BAM_FREAD2;         }
-  void set_secondary()         { m_body->core.flag |= BAM_FSECONDARY;      }
-  void set_not_secondary()     { m_body->core.flag &= ~BAM_FSECONDARY;     }
-  void set_fail()              { m_body->core.flag |= BAM_FQCFAIL;         }
-  void set_not_fail()          { m_body->core.flag &= ~BAM_FQCFAIL;        }
-  void set_duplicate()         { m_body->core.flag |= BAM_FDUP;            }
-  void set_not_duplicate()     { m_body->core.flag &= ~BAM_FDUP;           }
-  void set_supplementary()     { m_body->core.flag |= BAM_FSUPPLEMENTARY;  }
-  void set_not_supplementary() { m_body->core.flag &= ~BAM_FSUPPLEMENTARY; }
+  void set_paired()            { detach(); m_body->core.flag |= BAM_FPAIRED;         } 
+  void set_not_paired()        { detach(); m_body->core.flag &= ~BAM_FPAIRED;        }
+  void set_unmapped()          { detach(); m_body->core.flag |= BAM_FUNMAP;          }
+  void set_not_unmapped()      { detach(); m_body->core.flag &= ~BAM_FUNMAP;         }
+  void set_mate_unmapped()     { detach(); m_body->core.flag |= BAM_FMUNMAP;         }
+  void set_not_mate_unmapped() { detach(); m_body->core.flag &= ~BAM_FMUNMAP;        }
+  void set_reverse()           { detach(); m_body->core.flag |= BAM_FREVERSE;        }
+  void set_not_reverse()       { detach(); m_body->core.flag &= ~BAM_FREVERSE;       }
+  void set_mate_reverse()      { detach(); m_body->core.flag |= BAM_FMREVERSE;       }
+  void set_not_mate_reverse()  { detach(); m_body->core.flag &= ~BAM_FMREVERSE;      }
+  void set_first()             { detach(); m_body->core.flag |= BAM_FREAD1;          }
+  void set_not_first()         { detach(); m_body->core.flag &= ~BAM_FREAD1;         }
+  void set_last()              { detach(); m_body->core.flag |= BAM_FREAD2;          }
+  void set_not_last()          { detach(); m_body->core.flag &= ~BAM_FREAD2;         }
+  void set_secondary()         { detach(); m_body->core.flag |= BAM_FSECONDARY;      }
+  void set_not_secondary()     { detach(); m_body->core.flag &= ~BAM_FSECONDARY;     }
+  void set_fail()              { detach(); m_body->core.flag |= BAM_FQCFAIL;         }
+  void set_not_fail()          { detach(); m_body->core.flag &= ~BAM_FQCFAIL;        }
+  void set_duplicate()         { detach(); m_body->core.flag |= BAM_FDUP;            }
+  void set_not_duplicate()     { detach(); m_body->core.flag &= ~BAM_FDUP;           }
+  void set_supplementary()     { detach(); m_body->core.flag |= BAM_FSUPPLEMENTARY;  }
+  void set_not_supplementary() { detach(); m_body->core.flag &= ~BAM_FSUPPLEMENTARY; }
 
   bool empty() const { return m_body == nullptr; } ///< @brief whether or not this Sam object is empty, meaning that the internal memory has not been initialized (i.e. a Sam object initialized with Sam()).
 
  private:
   std::shared_ptr<bam_hdr_t> m_header; ///< htslib pointer to the header structure
-  std::shared_ptr<bam1_t> m_body;      ///< htslib pointer to the sam body structure
+  utils::SamHandle m_body;      ///< htslib pointer to the sam body structure
+  utils::CopyOnWriteGroup m_copies;    ///< copies of this record sharing m_body until one of them is modified
+  SamTagIndex m_tag_index;             ///< offsets of the aux tags of m_body, built by the first tag lookup
+  MateCoordinatesCache m_mate_coordinates;  ///< mate coordinates of m_body, computed by the first mate_coordinates() call
 
   friend class SamWriter; ///< allows the writer to access the guts of the object
   friend class SamBuilder; ///< builder needs access to the internals in order to build efficiently
+  friend class SamSorter; ///< sorter copies the raw records into its arena
+  friend class SamIterator; ///< iterators only reuse their record buffer if no copies are sharing it
+  friend class IndexedSamIterator;
+  friend class SamPairIterator;
+  friend class Cigar;     ///< views unshare the record before writing to it
+  friend class ReadBases;
+  friend class BaseQuals;
+
+  void detach() { invalidate_caches(); if (m_copies.shared()) unshare(); } ///< @brief makes sure no copies share m_body before modifying it
+  void invalidate_caches() { m_tag_index.invalidate(); m_mate_coordinates.invalidate(); } ///< @brief forgets what was derived from m_body (it is about to change)
+  void unshare();                                     ///< @brief replaces m_body by a private deep copy and leaves the copies
+  static bool prepare_view_write(Sam* record, utils::SamHandle& body);  ///< @brief before a view writes to body: unshares the record it came from, or copies body if anything else shares it. @return whether body changed
+  const utils::SamHandle& reusable_body();     ///< @brief the buffer an iterator can read the next record into: m_body, or a new one if copies are still sharing it
 };
 
 }  // end of namespace
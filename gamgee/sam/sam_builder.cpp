@@ -1,10 +1,11 @@
 #include "sam_builder.h"
 #include "cigar.h"
 
+#include "../utils/base_encoding.h"
 #include "../utils/hts_memory.h"
 
 #include <algorithm>
-#include <sstream>
+#include <cstring>
 #include <stdexcept>
 #include <stdlib.h>
 
@@ -19,7 +20,7 @@ namespace gamgee {
  *       to produce a valid read
  */
 SamBuilder::SamBuilder(const SamHeader& header, const bool validate_on_build) :
-  m_core_read { header.m_header, utils::make_shared_sam(bam_init1()) },
+  m_core_read { header.m_header, utils::SamHandle::create() },
   m_name {},
   m_cigar {},
   m_bases {},
@@ -63,8 +64,10 @@ SamBuilder::SamBuilder(const SamHeader& header, const Sam& starting_read, const
 /**
  * @brief set the read's QNAME to the specified value
  */
-SamBuilder& SamBuilder::set_name(const std::string& new_name) {
-  m_name.update(new_name.c_str(), new_name.length() + 1, 1);  // include a byte for null terminator
+SamBuilder& SamBuilder::set_name(const std::string_view new_name) {
+  auto encoded_name = m_name.overwrite(new_name.length() + 1, 1);  // include a byte for null terminator
+  memcpy(encoded_name, new_name.data(), new_name.length());
+  encoded_name[new_name.length()] = '\0';
   return *this;
 }
 
@@ -85,7 +88,7 @@ SamBuilder& SamBuilder::set_cigar(const Cigar& new_cigar) {
  * @note copies the contents of the vector
  */
 SamBuilder& SamBuilder::set_cigar(const std::vector<CigarElement>& new_cigar) {
-  m_cigar.update(&(new_cigar[0]), new_cigar.size() * sizeof(CigarElement), new_cigar.size());
+  m_cigar.update(new_cigar.data(), new_cigar.size() * sizeof(CigarElement), new_cigar.size());
   return *this;
 }
 
@@ -115,18 +118,11 @@ SamBuilder& SamBuilder::set_cigar(const std::string& new_cigar) {
   if ( num_cigar_elements == 0 )
     throw invalid_argument(string("No operators in cigar: ") + new_cigar);
 
-  auto encoded_cigar = unique_ptr<uint8_t[]>{ new uint8_t[num_cigar_elements * sizeof(CigarElement)] };
-  auto encoded_cigar_ptr = (uint32_t*)encoded_cigar.get();
+  auto encoded_cigar_ptr = (uint32_t*)m_cigar.overwrite(num_cigar_elements * sizeof(CigarElement), num_cigar_elements);
 
-  // cannot use auto here since stringstream is not moveable
-  // (yeah, "almost always auto" actually involves a lot of overhead in the form of "auto x = type{}"
-  // move assignments)
-  stringstream new_cigar_stream{ new_cigar };
+  auto remaining_cigar = std::string_view{new_cigar};
   for ( auto i = 0u; i < num_cigar_elements; ++i ) 
-    encoded_cigar_ptr[i] = Cigar::parse_next_cigar_element(new_cigar_stream);
-
-  // move existing encoded cigar we've just created into the field to avoid an extra copy
-  m_cigar.update(move(encoded_cigar), num_cigar_elements * sizeof(CigarElement), num_cigar_elements);
+    encoded_cigar_ptr[i] = Cigar::parse_next_cigar_element(remaining_cigar);
   return *this;
 }
 
@@ -143,21 +139,11 @@ SamBuilder& SamBuilder::set_bases(const ReadBases& new_bases) {
 /**
  * @brief set the read's bases using a vector of Bases
  *
- * @note copies the contents of the vector
+ * @note copies the contents of the vector, packed a vector of bases at a time by utils::encode_bases()
  */
 SamBuilder& SamBuilder::set_bases(const std::vector<Base>& new_bases) {
-  auto encoded_size = (new_bases.size() + 1) >> 1;
-  auto encoded_bases = unique_ptr<uint8_t[]>{ new uint8_t[encoded_size] };
-  auto encoded_base_ptr = encoded_bases.get();
-
-  // 4 bits per base
-  memset(encoded_base_ptr, 0, encoded_size);
-  for ( auto i = 0u; i < new_bases.size(); ++i ) {
-    encoded_base_ptr[i >> 1] |= static_cast<uint8_t>(new_bases[i]) << ((~i & 1) << 2);
-  }
-
-  // move the encoded bases we just created into the field to avoid an extra copy
-  m_bases.update(move(encoded_bases), encoded_size, new_bases.size());
+  const auto num_bases = uint32_t(new_bases.size());
+  utils::encode_bases(new_bases.data(), num_bases, m_bases.overwrite((num_bases + 1) >> 1, num_bases));
   return *this;
 }
 
@@ -174,21 +160,12 @@ SamBuilder& SamBuilder::set_bases(const std::initializer_list<Base> new_bases) {
 /**
  * @brief set the read's bases using a string of base values (eg., "ACGT")
  *
- * @note this is the least efficient way to set the bases
+ * @note letters are encoded as in htslib (case insensitive, with anything that isn't an IUPAC code becoming N),
+ *       using the vectorized utils::encode_bases()
  */
-SamBuilder& SamBuilder::set_bases(const std::string& new_bases) {
-  auto encoded_size = (new_bases.length() + 1) >> 1;
-  auto encoded_bases = unique_ptr<uint8_t[]>{ new uint8_t[encoded_size] };
-  auto encoded_base_ptr = encoded_bases.get();
-
-  // 4 bits per base
-  memset(encoded_base_ptr, 0, encoded_size);
-  for ( auto i = 0u; i < new_bases.length(); ++i ) {
-    encoded_base_ptr[i >> 1] |= seq_nt16_table[int(new_bases[i])] << ((~i & 1) << 2);
-  }
-
-  // move the encoded bases we just created into the field to avoid an extra copy
-  m_bases.update(move(encoded_bases), encoded_size, new_bases.length());
+SamBuilder& SamBuilder::set_bases(const std::string_view new_bases) {
+  const auto num_bases = uint32_t(new_bases.length());
+  utils::encode_bases(new_bases.data(), num_bases, m_bases.overwrite((num_bases + 1) >> 1, num_bases));
   return *this;
 }
 
@@ -208,7 +185,7 @@ SamBuilder& SamBuilder::set_base_quals(const BaseQuals& new_base_quals) {
  * @note copies the contents of the vector
  */
 SamBuilder& SamBuilder::set_base_quals(const std::vector<uint8_t>& new_base_quals) {
-  m_base_quals.update(&(new_base_quals[0]), new_base_quals.size(), new_base_quals.size());
+  m_base_quals.update(new_base_quals.data(), new_base_quals.size(), new_base_quals.size());
   return *this;
 }
 
@@ -247,6 +224,133 @@ SamBuilder& SamBuilder::set_base_quals(const std::initializer_list<int> new_base
   return set_base_quals(quals_vector);
 }
 
+/**
+ * @brief set the read's base qualities from the ASCII (Phred+33) encoding of FASTQ and SAM files (eg., "II?5")
+ */
+SamBuilder& SamBuilder::set_base_quals_phred33(const std::string_view new_base_quals) {
+  const auto num_quals = uint32_t(new_base_quals.length());
+  utils::decode_phred33(new_base_quals.data(), num_quals, m_base_quals.overwrite(num_quals, num_quals));
+  return *this;
+}
+
+/**
+ * @brief set the read's name, bases and base qualities from a FASTQ (or FASTA) record, eg. to convert reads to unaligned BAM
+ *
+ * Reads from FASTA records (without qualities) get missing base qualities (0xff), like '*' qualities in SAM files.
+ *
+ * @note only the data fields are set: mark the read as unmapped (and paired, first etc.) with the core field setters
+ */
+SamBuilder& SamBuilder::set_fastq(const Fastq& record) {
+  set_name(record.name());
+  set_bases(record.sequence());
+  if ( record.is_fastq() )
+    return set_base_quals_phred33(record.quals());
+  const auto num_quals = m_bases.num_elements();
+  memset(m_base_quals.overwrite(num_quals, num_quals), 0xff, num_quals);
+  return *this;
+}
+
+/**
+ * @brief encodes an array-valued (B) tag straight into the aux data of the builder
+ *
+ * @param values num_values values of element_size bytes each, in little endian order (the values of a SamTagArray or native values)
+ */
+SamBuilder& SamBuilder::set_array_tag(const SamTagKey tag_name, const char type, const void* values, const uint32_t num_values, const uint32_t element_size) {
+  const auto values_bytes = num_values * element_size;
+  auto entry = replace_tag(tag_name, 1 + 1 + sizeof(uint32_t) + values_bytes);
+  *entry++ = 'B';
+  *entry++ = uint8_t(type);
+  memcpy(entry, &num_values, sizeof(uint32_t));
+  if ( values_bytes != 0 )
+    memcpy(entry + sizeof(uint32_t), values, values_bytes);
+  return *this;
+}
+
+/**
+ * @brief set an integer-valued tag, encoded in the smallest integer type that holds the value (as htslib does)
+ */
+SamBuilder& SamBuilder::set_integer_tag(const SamTagKey tag_name, const int32_t value) {
+  if ( value >= 0 ) {
+    if ( value <= UINT8_MAX )
+      encode_scalar_tag(tag_name, 'C', uint8_t(value));
+    else if ( value <= UINT16_MAX )
+      encode_scalar_tag(tag_name, 'S', uint16_t(value));
+    else
+      encode_scalar_tag(tag_name, 'i', value);
+  }
+  else {
+    if ( value >= INT8_MIN )
+      encode_scalar_tag(tag_name, 'c', int8_t(value));
+    else if ( value >= INT16_MIN )
+      encode_scalar_tag(tag_name, 's', int16_t(value));
+    else
+      encode_scalar_tag(tag_name, 'i', value);
+  }
+  return *this;
+}
+
+/**
+ * @brief set a floating point tag (stored as a single precision float, the only floating point type in the SAM spec)
+ */
+SamBuilder& SamBuilder::set_double_tag(const SamTagKey tag_name, const double value) {
+  encode_scalar_tag(tag_name, 'f', float(value));
+  return *this;
+}
+
+/**
+ * @brief set a char-valued tag
+ */
+SamBuilder& SamBuilder::set_char_tag(const SamTagKey tag_name, const char value) {
+  encode_scalar_tag(tag_name, 'A', value);
+  return *this;
+}
+
+/**
+ * @brief set a string-valued tag
+ *
+ * @note will throw invalid_argument if the value contains a null character
+ */
+SamBuilder& SamBuilder::set_string_tag(const SamTagKey tag_name, const std::string_view value) {
+  if ( value.find('\0') != string_view::npos )
+    throw invalid_argument(string{"String tags can't contain null characters: "} + tag_name.name());
+  auto entry = replace_tag(tag_name, 1 + value.size() + 1);
+  *entry++ = 'Z';
+  memcpy(entry, value.data(), value.size());
+  entry[value.size()] = '\0';
+  return *this;
+}
+
+/**
+ * @brief remove a tag from the read (does nothing if the read doesn't have it)
+ */
+SamBuilder& SamBuilder::remove_tag(const SamTagKey tag_name) {
+  const auto* tags = m_tags.raw_data_ptr();
+  const auto* end = tags + m_tags.num_bytes();
+  const auto* entry = SamTagIndex::scan(tags, end, tag_name);
+  if ( entry != nullptr )
+    m_tags.splice(uint32_t(entry - 2 - tags), uint32_t(SamTagIndex::skip(entry - 2, end) - (entry - 2)), 0, m_tags.num_elements());
+  return *this;
+}
+
+/**
+ * @brief makes room for an entry in the aux data: in place of the previous value of the tag if it has one, at the end otherwise
+ *
+ * @param value_bytes size of the entry excluding the two characters of its name (i.e. its type and value)
+ * @return pointer to the type character of the entry (its name is already written)
+ * @note the other entries are not decoded, and the aux data grows geometrically, so setting tags one by one is cheap
+ */
+uint8_t* SamBuilder::replace_tag(const SamTagKey tag_name, const uint32_t value_bytes) {
+  const auto* tags = m_tags.raw_data_ptr();
+  const auto* end = tags + m_tags.num_bytes();
+  const auto* old_entry = SamTagIndex::scan(tags, end, tag_name);
+  const auto offset = old_entry == nullptr ? m_tags.num_bytes() : uint32_t(old_entry - 2 - tags);
+  const auto old_bytes = old_entry == nullptr ? 0u : uint32_t(SamTagIndex::skip(old_entry - 2, end) - (old_entry - 2));
+  auto entry = m_tags.splice(offset, old_bytes, 2 + value_bytes, m_tags.num_elements());
+  entry[0] = uint8_t(tag_name.code() & 0xff);
+  entry[1] = uint8_t(tag_name.code() >> 8);
+  return entry + 2;
+}
+
 /**
  * @brief build a Sam record using the current state of the builder
  *
@@ -259,7 +363,7 @@ Sam SamBuilder::build() const {
     validate();
 
   // Allocate memory for a new Sam
-  auto new_sam_body = utils::make_shared_sam(bam_init1());
+  auto new_sam_body = utils::SamHandle::create();
   auto sam_body_ptr = new_sam_body.get();
 
   // Copy core information first, then construct the concatenated data field
@@ -300,16 +404,75 @@ Sam SamBuilder::one_time_build() {
   return move(m_core_read);
 }
 
+/**
+ * @brief build a Sam record into an existing Sam, reusing its memory
+ *
+ * The destination gets the header of the builder and the record under construction. Its data buffer is reused
+ * if it's large enough, so building one read after another into the same Sam (with reset() or setters in
+ * between) doesn't allocate memory once the buffers have grown to the largest read:
+ *
+ * auto read = Sam{};
+ * for (...) {
+ *   builder.reset().set_name(name).set_cigar(cigar).set_bases(bases).set_base_quals(quals);
+ *   builder.build_into(read);
+ *   writer.add_record(read);
+ * }
+ *
+ * @note if copies of the destination share its record (see Sam), they keep the previous read and the
+ *       destination moves on to a record from the thread local SamRecordPool
+ * @warning Cigar, ReadBases and BaseQuals views of the destination are invalidated
+ */
+void SamBuilder::build_into(Sam& destination) const {
+  if ( m_validate_on_build )
+    validate();
+
+  if ( destination.m_body == nullptr )
+    destination.m_body = utils::SamRecordPool::thread_local_pool().allocate();
+  auto sam_body_ptr = destination.reusable_body().get();
+
+  // Copy core information first, keeping the data buffer of the destination, then construct the data field in it
+  auto data = sam_body_ptr->data;
+  auto data_capacity = sam_body_ptr->m_data;
+  *(sam_body_ptr) = *(m_core_read.m_body.get());
+  sam_body_ptr->data = data;
+  sam_body_ptr->m_data = data_capacity;
+  build_data_array(sam_body_ptr);
+
+  sam_body_ptr->core.bin = hts_reg2bin(sam_body_ptr->core.pos, sam_body_ptr->core.pos + sam_body_ptr->core.l_qseq, 14, 5);
+  sam_body_ptr->core.isize = 0;
+  destination.m_header = m_core_read.m_header;
+}
+
+/**
+ * @brief clear the builder to start a new read from scratch (with the same header), keeping the memory it
+ * has allocated for the data fields
+ */
+SamBuilder& SamBuilder::reset() {
+  if ( m_core_read.m_body == nullptr )           // after one_time_build()
+    m_core_read.m_body = utils::SamHandle::create();
+  else {
+    m_core_read.detach();
+    memset(m_core_read.m_body.get(), 0, sizeof(bam1_t));   // the core read never has a data buffer
+  }
+  m_name.clear();
+  m_cigar.clear();
+  m_bases.clear();
+  m_base_quals.clear();
+  m_tags.clear();
+  return *this;
+}
+
 /**
  * @brief performs pre-build validation of the state of the Sam record under construction
  */
 void SamBuilder::validate() const {
   // Make sure required data fields have been set
-  if ( m_name.empty() || m_cigar.empty() || m_bases.empty() || m_base_quals.empty() )
+  // (unmapped reads don't need a cigar)
+  if ( m_name.empty() || (m_cigar.empty() && !m_core_read.unmapped()) || m_bases.empty() || m_base_quals.empty() )
     throw logic_error("Missing one or more required data fields (name, cigar, bases, or base qualities)");
 
   // Make sure the sequence length implied by the cigar matches the actual sequence length
-  if ( bam_cigar2qlen(m_cigar.num_elements(), (const uint32_t*)m_cigar.raw_data_ptr()) != static_cast<int32_t>(m_bases.num_elements()) )
+  if ( !m_cigar.empty() && bam_cigar2qlen(m_cigar.num_elements(), (const uint32_t*)m_cigar.raw_data_ptr()) != static_cast<int32_t>(m_bases.num_elements()) )
     throw logic_error("Cigar operations and number of bases do not match");
 
   // Make sure the number of base qualities matches the number of bases
@@ -324,8 +487,14 @@ void SamBuilder::validate() const {
  */
 void SamBuilder::build_data_array(bam1_t* sam) const {
   const auto data_array_bytes = m_name.num_bytes() + m_cigar.num_bytes() + m_bases.num_bytes() + m_base_quals.num_bytes() + m_tags.num_bytes();
+  // reuse the buffer the record already has if it's large enough (build_into()), otherwise
   // use malloc() instead of new so that htslib can free this memory
-  auto data_array = (uint8_t*)malloc(data_array_bytes);
+  if ( sam->data == nullptr || uint32_t(sam->m_data) < data_array_bytes ) {
+    free(sam->data);
+    sam->data = (uint8_t*)malloc(data_array_bytes);
+    sam->m_data = data_array_bytes;
+  }
+  auto data_array = sam->data;
   auto data_array_ptr = data_array;
 
   data_array_ptr = m_name.copy_into(data_array_ptr);
@@ -334,9 +503,7 @@ void SamBuilder::build_data_array(bam1_t* sam) const {
   data_array_ptr = m_base_quals.copy_into(data_array_ptr);
   data_array_ptr = m_tags.copy_into(data_array_ptr);
 
-  sam->data = data_array;
   sam->l_data = data_array_bytes;
-  sam->m_data = data_array_bytes;
   sam->core.l_qname = m_name.num_bytes();
   sam->core.l_qseq = m_bases.num_elements();
   sam->core.n_cigar = m_cigar.num_elements();
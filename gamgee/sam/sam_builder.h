@@ -3,8 +3,12 @@
 
 #include "sam.h"
 #include "sam_builder_data_field.h"
+#include "../fastq.h"
+#include "sam_tag.h"
 
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -34,8 +38,19 @@ namespace gamgee {
  * to ever build one read using a given builder. This is slightly more efficient
  * than the more general-purpose repeatable build() function.
  *
+ * To convert or rewrite a stream of reads, reuse one builder and one destination Sam:
+ * reset() clears the builder for the next read while keeping its buffers, and build_into()
+ * reuses the memory of the destination, so that no memory is allocated in steady state.
+ * Validation can be done once up front with validate() and then turned off with
+ * set_validate_on_build(false) when all reads are built the same way.
+ *
+ * Reads from FASTQ files can be converted to unaligned BAM records the same way:
+ *
+ * builder.reset().set_fastq(fastq_record).set_unmapped();
+ *
  * You must provide a value for all essential data fields before building if you
- * build from scratch, unless you disable validation (not recommended).
+ * build from scratch, unless you disable validation (not recommended). Unmapped reads
+ * don't need a cigar.
  *
  * Some methods of setting values are more efficient than others. For example,
  * setting a cigar using a vector is much more efficient than setting it via a string:
@@ -50,6 +65,11 @@ namespace gamgee {
  * to another read, for safety reasons. Altering a read after passing some of its data into
  * a builder will not affect the state of the builder.
  *
+ * Tags are encoded straight into the aux data of the builder, so that all fields (name, cigar, bases,
+ * base qualities and tags) are assembled into the record with a single allocation at build time:
+ *
+ * auto read = builder.set_string_tag("RX", umi).set_string_tag("CB", barcode).set_integer_tag("NM", 2).build();
+ *
  * Before building, the builder performs a validation step to ensure that the read it will
  * create is logically consistent (eg., number of base qualities must match the number of bases).
  * This validation step can be disabled during construction of the builder, but disabling
@@ -69,7 +89,7 @@ class SamBuilder {
   ~SamBuilder() = default;
 
   // Setters for data fields
-  SamBuilder& set_name(const std::string& new_name);
+  SamBuilder& set_name(const std::string_view new_name);
 
   SamBuilder& set_cigar(const Cigar& new_cigar);
   SamBuilder& set_cigar(const std::vector<CigarElement>& new_cigar);
@@ -79,12 +99,30 @@ class SamBuilder {
   SamBuilder& set_bases(const ReadBases& new_bases);
   SamBuilder& set_bases(const std::vector<Base>& new_bases);
   SamBuilder& set_bases(const std::initializer_list<Base> new_bases);
-  SamBuilder& set_bases(const std::string& new_bases);
+  SamBuilder& set_bases(const std::string_view new_bases);
 
   SamBuilder& set_base_quals(const BaseQuals& new_base_quals);
   SamBuilder& set_base_quals(const std::vector<uint8_t>& new_base_quals);
   SamBuilder& set_base_quals(const std::initializer_list<uint8_t> new_base_quals);
   SamBuilder& set_base_quals(const std::initializer_list<int> new_base_quals);
+  SamBuilder& set_base_quals_phred33(const std::string_view new_base_quals);
+
+  SamBuilder& set_fastq(const Fastq& record);    ///< @brief set the name, bases and base qualities of an unaligned read from a FASTQ or FASTA record
+
+  // Setters for aux tags: these replace any previous value of the tag (in place), or add the tag at the end
+  SamBuilder& set_integer_tag(const SamTagKey tag_name, const int32_t value);
+  SamBuilder& set_double_tag(const SamTagKey tag_name, const double value);
+  SamBuilder& set_char_tag(const SamTagKey tag_name, const char value);
+  SamBuilder& set_string_tag(const SamTagKey tag_name, const std::string_view value);
+  SamBuilder& remove_tag(const SamTagKey tag_name);
+  template<class ELEMENT>
+  SamBuilder& set_array_tag(const SamTagKey tag_name, const ELEMENT* values, const uint32_t num_values) { return set_array_tag(tag_name, SamTagArray<ELEMENT>::type, values, num_values, sizeof(ELEMENT)); } ///< @brief set an array-valued (B) tag from num_values values in memory
+  template<class ELEMENT>
+  SamBuilder& set_array_tag(const SamTagKey tag_name, const SamTagArray<ELEMENT>& values) { return set_array_tag(tag_name, SamTagArray<ELEMENT>::type, values.raw_data(), values.size(), sizeof(ELEMENT)); } ///< @brief set an array-valued (B) tag to the values of a tag of another read (copied straight from its aux data)
+  template<class ELEMENT>
+  SamBuilder& set_array_tag(const SamTagKey tag_name, const std::vector<ELEMENT>& values) { return set_array_tag(tag_name, values.data(), uint32_t(values.size())); } ///< @brief set an array-valued (B) tag from the values of a vector
+  template<class ELEMENT>
+  SamBuilder& set_array_tag(const SamTagKey tag_name, const std::initializer_list<ELEMENT> values) { return set_array_tag(tag_name, values.begin(), uint32_t(values.size())); } ///< @brief set an array-valued (B) tag from a list of values
 
   // Setters for core fields: these pass through to the implementations in Sam
   SamBuilder& set_chromosome(const uint32_t chr)              { m_core_read.set_chromosome(chr); return *this;              } ///< @brief simple setter for the chromosome index. Index is 0-based.
@@ -116,6 +154,11 @@ class SamBuilder {
 
   Sam build() const;    ///< build a Sam (can be called repeatedly)
   Sam one_time_build(); ///< build a Sam more efficiently by moving the builder's data out of it and invalidating future builds
+  void build_into(Sam& destination) const;  ///< build a Sam into an existing one, reusing its memory (can be called repeatedly)
+  SamBuilder& reset();                      ///< clear the read under construction (keeping the header and the builder's buffers) to build the next one from scratch
+
+  void validate() const;                                                                     ///< @brief performs pre-build validation of the state of the Sam record under construction. @throw logic_error if the record is inconsistent
+  SamBuilder& set_validate_on_build(const bool validate_on_build) { m_validate_on_build = validate_on_build; return *this; } ///< @brief turn the validation at build time on or off (eg., after validating the first read of a stream of reads of the same shape)
 
  private:
   Sam m_core_read;   ///< Shallow Sam object containing only the core (non-data) parts of the read
@@ -126,8 +169,19 @@ class SamBuilder {
   SamBuilderDataField m_tags;       ///< htslib encoded aux data (tags) for eventual inclusion in the data field
   bool m_validate_on_build;         ///< should we validate the state of the Sam record at build time?
 
-  void validate() const;                    ///< @brief performs pre-build validation of the state of the Sam record under construction
   void build_data_array(bam1_t* sam) const; ///< @brief helper function that constructs the concatenated htslib-encoded data array
+  uint8_t* replace_tag(const SamTagKey tag_name, const uint32_t value_bytes);  ///< @brief makes room for a tag in the aux data (replacing any previous value of the tag), returning where its type and value go
+
+  /**
+   * @brief encodes a fixed size (A, c, C, s, S, i, f) tag
+   */
+  template<class VALUE>
+  void encode_scalar_tag(const SamTagKey tag_name, const char type, const VALUE value) {
+    auto entry = replace_tag(tag_name, 1 + sizeof(VALUE));
+    *entry = uint8_t(type);
+    memcpy(entry + 1, &value, sizeof(VALUE));
+  }
+  SamBuilder& set_array_tag(const SamTagKey tag_name, const char type, const void* values, const uint32_t num_values, const uint32_t element_size); ///< @brief encodes a B tag from values already in little endian order
 };
 
 }
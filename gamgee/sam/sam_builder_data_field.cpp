@@ -1,5 +1,6 @@
 #include "sam_builder_data_field.h"
 
+#include <algorithm>
 #include <cstring>
 
 using namespace std;
@@ -12,7 +13,8 @@ namespace gamgee {
 SamBuilderDataField::SamBuilderDataField() :
   m_data {},
   m_num_bytes { 0 },  // Note: default no-arg constructor would NOT zero out the POD members
-  m_num_elements { 0 }
+  m_num_elements { 0 },
+  m_capacity { 0 }
 {}
 
 /**
@@ -23,7 +25,8 @@ SamBuilderDataField::SamBuilderDataField() :
 SamBuilderDataField::SamBuilderDataField(const void* copy_source, const uint32_t bytes_to_copy, const uint32_t num_elements) :
   m_data { new uint8_t[bytes_to_copy] },
   m_num_bytes { bytes_to_copy },
-  m_num_elements { num_elements }
+  m_num_elements { num_elements },
+  m_capacity { bytes_to_copy }
 {
   memcpy(m_data.get(), copy_source, bytes_to_copy);
 }
@@ -36,7 +39,8 @@ SamBuilderDataField::SamBuilderDataField(const void* copy_source, const uint32_t
 SamBuilderDataField::SamBuilderDataField(std::unique_ptr<uint8_t[]>&& move_source, const uint32_t source_bytes, const uint32_t num_elements) :
   m_data { move(move_source) },
   m_num_bytes { source_bytes },
-  m_num_elements { num_elements }
+  m_num_elements { num_elements },
+  m_capacity { source_bytes }
 {}
 
 /**
@@ -45,7 +49,8 @@ SamBuilderDataField::SamBuilderDataField(std::unique_ptr<uint8_t[]>&& move_sourc
 SamBuilderDataField::SamBuilderDataField(SamBuilderDataField&& other) :
   m_data { move(other.m_data) },
   m_num_bytes { other.m_num_bytes },
-  m_num_elements { other.m_num_elements }
+  m_num_elements { other.m_num_elements },
+  m_capacity { other.m_capacity }
 {}
 
 /**
@@ -58,19 +63,19 @@ SamBuilderDataField& SamBuilderDataField::operator=(SamBuilderDataField&& other)
   m_data = move(other.m_data);
   m_num_bytes = other.m_num_bytes;
   m_num_elements = other.m_num_elements;
+  m_capacity = other.m_capacity;
   return *this;
 }
 
 /**
  * @brief update the field by copying data from a raw pointer (takes no ownership of copy_source)
  *
- * @note any previous value of m_data is destroyed via the unique_ptr assignment
+ * @note reuses the buffer of the field if it's large enough
  */
 void SamBuilderDataField::update(const void* copy_source, const uint32_t bytes_to_copy, const uint32_t num_elements) {
-  m_data = unique_ptr<uint8_t[]>{ new uint8_t[bytes_to_copy] };
-  memcpy(m_data.get(), copy_source, bytes_to_copy);
-  m_num_bytes = bytes_to_copy;
-  m_num_elements = num_elements;
+  auto destination = overwrite(bytes_to_copy, num_elements);
+  if ( bytes_to_copy != 0 )
+    memcpy(destination, copy_source, bytes_to_copy);
 }
 
 /**
@@ -82,6 +87,50 @@ void SamBuilderDataField::update(std::unique_ptr<uint8_t[]>&& move_source, const
   m_data = move(move_source);
   m_num_bytes = source_bytes;
   m_num_elements = num_elements;
+  m_capacity = source_bytes;
+}
+
+/**
+ * @brief discard the current value of the field and make room for num_bytes bytes
+ *
+ * @return pointer to the num_bytes bytes for the caller to fill in (valid until the next change to the field)
+ * @note reuses the buffer of the field if it's large enough, and grows it geometrically otherwise
+ */
+uint8_t* SamBuilderDataField::overwrite(const uint32_t num_bytes, const uint32_t num_elements) {
+  if ( num_bytes > m_capacity ) {
+    const auto new_capacity = max(num_bytes, m_capacity + m_capacity / 2);
+    m_data = unique_ptr<uint8_t[]>{ new uint8_t[new_capacity] };
+    m_capacity = new_capacity;
+  }
+  m_num_bytes = num_bytes;
+  m_num_elements = num_elements;
+  return m_data.get();
+}
+
+/**
+ * @brief replace bytes_removed bytes at offset by room for bytes_inserted bytes, moving the bytes after them
+ *
+ * @return pointer to the bytes_inserted bytes for the caller to fill in (valid until the next change to the field)
+ * @note grows the buffer geometrically when it runs out of capacity, so a series of insertions is amortized linear
+ */
+uint8_t* SamBuilderDataField::splice(const uint32_t offset, const uint32_t bytes_removed, const uint32_t bytes_inserted, const uint32_t num_elements) {
+  const auto tail_bytes = m_num_bytes - offset - bytes_removed;
+  const auto new_num_bytes = m_num_bytes - bytes_removed + bytes_inserted;
+  if ( new_num_bytes > m_capacity ) {
+    const auto new_capacity = max(new_num_bytes, m_capacity + m_capacity / 2);
+    auto new_data = unique_ptr<uint8_t[]>{ new uint8_t[new_capacity] };
+    if ( offset != 0 )
+      memcpy(new_data.get(), m_data.get(), offset);
+    if ( tail_bytes != 0 )
+      memcpy(new_data.get() + offset + bytes_inserted, m_data.get() + offset + bytes_removed, tail_bytes);
+    m_data = move(new_data);
+    m_capacity = new_capacity;
+  }
+  else if ( tail_bytes != 0 && bytes_removed != bytes_inserted )
+    memmove(m_data.get() + offset + bytes_inserted, m_data.get() + offset + bytes_removed, tail_bytes);
+  m_num_bytes = new_num_bytes;
+  m_num_elements = num_elements;
+  return m_data.get() + offset;
 }
 
 /**
@@ -90,7 +139,8 @@ void SamBuilderDataField::update(std::unique_ptr<uint8_t[]>&& move_source, const
  * @return pointer to the byte just AFTER the end of the copied data
  */
 uint8_t* SamBuilderDataField::copy_into(uint8_t* destination) const {
-  memcpy(destination, m_data.get(), m_num_bytes);
+  if ( m_num_bytes != 0 )
+    memcpy(destination, m_data.get(), m_num_bytes);
   return destination + m_num_bytes;
 }
 
@@ -1,6 +1,7 @@
 #ifndef gamgee__sam_builder_data_field__guard
 #define gamgee__sam_builder_data_field__guard
 
+#include <cstdint>
 #include <memory>
 
 namespace gamgee {
@@ -14,7 +15,10 @@ namespace gamgee {
  * auto field = SamBuilderDataField{raw_pointer, num_bytes, num_elements};      // does a copy
  * auto field = SamBuilderDataField{move(unique_ptr), num_bytes, num_elements}; // no copy
  *
- * After construction, a field's value can be altered via the update() functions
+ * After construction, a field's value can be altered via the update() functions, or edited in place with
+ * overwrite() and splice(). Copies, overwrite() and splice() reuse the buffer of the field when it's large
+ * enough and grow it geometrically otherwise, so that repeated edits (eg., adding tags one by one, or
+ * building one read after another with the same builder) don't reallocate every time.
  */
 class SamBuilderDataField {
  public:
@@ -36,12 +40,16 @@ class SamBuilderDataField {
 
   void update(const void* copy_source, const uint32_t bytes_to_copy, const uint32_t num_elements);                   ///<  @brief update the field by copying data from a raw pointer (takes no ownership of copy_source)
   void update(std::unique_ptr<uint8_t[]>&& move_source, const uint32_t source_bytes, const uint32_t num_elements);   ///<  @brief update the field by moving an existing unique_ptr into it and taking ownership (without copying the existing data)
+  uint8_t* overwrite(const uint32_t num_bytes, const uint32_t num_elements);  ///< @brief discard the current value and make room for num_bytes bytes (left for the caller to write), reusing the buffer if it's large enough
+  void clear() { m_num_bytes = 0; m_num_elements = 0; }         ///< @brief empty the field, keeping its buffer for the next value
+  uint8_t* splice(const uint32_t offset, const uint32_t bytes_removed, const uint32_t bytes_inserted, const uint32_t num_elements); ///< @brief replace bytes_removed bytes at offset by bytes_inserted bytes (left for the caller to write), returning where they go
   uint8_t* copy_into(uint8_t* destination) const;    ///< @brief copy this field's byte array into an arbitrary location
 
  private:
   std::unique_ptr<uint8_t[]> m_data;  ///< buffer containing encoded data for the field, managed exclusively by us
   uint32_t m_num_bytes;               ///< number of bytes in m_data
   uint32_t m_num_elements;            ///< number of elements (cigar operations, bases, etc.) in m_data
+  uint32_t m_capacity;                ///< number of bytes allocated in m_data (at least m_num_bytes)
 };
 
 }
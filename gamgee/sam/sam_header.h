@@ -33,6 +33,7 @@ class SamHeader {
 
   friend class SamWriter;
   friend class SamBuilder;
+  friend class SamSorter;
 };
 
 }
@@ -16,7 +16,7 @@ SamIterator::SamIterator() :
 SamIterator::SamIterator(const std::shared_ptr<htsFile>& sam_file_ptr, const std::shared_ptr<bam_hdr_t>& sam_header_ptr) :
   m_sam_file_ptr {sam_file_ptr},
   m_sam_header_ptr {sam_header_ptr},
-  m_sam_record_ptr {utils::make_shared_sam(bam_init1())},      ///< important to initialize the record buffer in the constructor so we can reuse it across the iterator
+  m_sam_record_ptr {utils::SamHandle::create()},      ///< important to initialize the record buffer in the constructor so we can reuse it across the iterator
   m_sam_record {m_sam_header_ptr, m_sam_record_ptr}
 {
     fetch_next_record();
@@ -36,9 +36,11 @@ bool SamIterator::operator!=(const SamIterator& rhs) {
 }
 /**
  * @brief pre-fetches the next sam record
- * @warning we're reusing the existing htslib memory, so users should be aware that all objects from the previous iteration are now stale unless a deep copy has been performed
+ * @warning we're reusing the existing htslib memory, so users should be aware that all objects from the previous iteration are now stale unless a copy has been made
+ * @note the memory is only reused if no copies of the previous record are sharing it
  */
 void SamIterator::fetch_next_record() {
+ m_sam_record_ptr = m_sam_record.reusable_body();
  if (sam_read1(m_sam_file_ptr.get(), m_sam_header_ptr.get(), m_sam_record_ptr.get()) < 0) {
     m_sam_file_ptr = nullptr;
     m_sam_record = Sam{};
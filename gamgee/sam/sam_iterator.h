@@ -68,7 +68,7 @@ class SamIterator {
   private:
     std::shared_ptr<htsFile> m_sam_file_ptr;     ///< pointer to the sam file
     std::shared_ptr<bam_hdr_t> m_sam_header_ptr; ///< pointer to the sam header
-    std::shared_ptr<bam1_t> m_sam_record_ptr;    ///< pointer to the internal structure of the sam record. Useful to only allocate it once.
+    utils::SamHandle m_sam_record_ptr;    ///< pointer to the internal structure of the sam record. Useful to only allocate it once.
     Sam m_sam_record;                            ///< temporary record to hold between fetch (operator++) and serve (operator*)
 
     void fetch_next_record();                    ///< fetches next Sam record into existing htslib memory without making a copy
@@ -1,10 +1,15 @@
 #include "sam_pair_iterator.h"
 #include "sam.h"
 
+#include "../exceptions.h"
 #include "../utils/hts_memory.h"
+#include "../utils/utils.h"
 
 #include "htslib/sam.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <queue>
@@ -13,26 +18,62 @@ using namespace std;
 
 namespace gamgee {
 
+constexpr auto NUM_PARTITIONS = 64u;     ///< number of temporary files the mates are spilled to (by name hash) in by_name mode
+constexpr auto MAX_FREE_RECORDS = 1024u; ///< maximum number of record buffers kept for recycling in by_name mode
+
 SamPairIterator::SamPairIterator() :
   m_sam_file_ptr    {nullptr},
   m_sam_header_ptr  {nullptr},
   m_sam_record_ptr1 {nullptr},
-  m_sam_record_ptr2 {nullptr}
+  m_sam_record_ptr2 {nullptr},
+  m_options         {},
+  m_pending_mates   {},
+  m_pending_bytes   {0},
+  m_sequence        {0},
+  m_free_records    {},
+  m_served_mate     {nullptr},
+  m_unmatched       {},
+  m_partition_names {},
+  m_partition_files {},
+  m_partition_reader{nullptr},
+  m_next_partition  {0},
+  m_input_done      {true}
 {}
 
 SamPairIterator::SamPairIterator(const std::shared_ptr<htsFile>& sam_file_ptr, const std::shared_ptr<bam_hdr_t>& sam_header_ptr) :
+  SamPairIterator {sam_file_ptr, sam_header_ptr, SamPairIteratorOptions{}}
+{}
+
+SamPairIterator::SamPairIterator(const std::shared_ptr<htsFile>& sam_file_ptr, const std::shared_ptr<bam_hdr_t>& sam_header_ptr, const SamPairIteratorOptions& options) :
   m_sam_file_ptr    {sam_file_ptr},
   m_sam_header_ptr  {sam_header_ptr},
-  m_sam_record_ptr1 {utils::make_shared_sam(bam_init1())}, ///< important to initialize the record buffer in the constructor so we can reuse it across the iterator
-  m_sam_record_ptr2 {utils::make_shared_sam(bam_init1())}, ///< important to initialize the record buffer in the constructor so we can reuse it across the iterator
+  m_sam_record_ptr1 {utils::SamHandle::create()}, ///< important to initialize the record buffer in the constructor so we can reuse it across the iterator
+  m_sam_record_ptr2 {utils::SamHandle::create()}, ///< important to initialize the record buffer in the constructor so we can reuse it across the iterator
+  m_options         {options},
+  m_pending_mates   {},
+  m_pending_bytes   {0},
+  m_sequence        {0},
+  m_free_records    {},
+  m_served_mate     {nullptr},
+  m_unmatched       {},
+  m_partition_names {},
+  m_partition_files {},
+  m_partition_reader{nullptr},
+  m_next_partition  {0},
+  m_input_done      {false},
   m_sam_records     {fetch_next_pair()} ///< important queue must be initialized *before* we call fetch_next_pair. Order matters
 {}
 
+SamPairIterator::~SamPairIterator() {
+  remove_partitions();
+}
+
 pair<Sam,Sam> SamPairIterator::operator*() {
   return m_sam_records;
 }
 
 pair<Sam,Sam> SamPairIterator::operator++() {
+  release_served_buffers();
   m_sam_records = fetch_next_pair();
   return m_sam_records;
 }
@@ -41,7 +82,25 @@ bool SamPairIterator::operator!=(const SamPairIterator& rhs) {
   return m_sam_file_ptr != rhs.m_sam_file_ptr;
 }
 
-bool SamPairIterator::read_sam(shared_ptr<bam1_t>& record_ptr) {
+/**
+ * @brief hands the buffers of the last pair over to the copies the caller took (if they are still around) so
+ * reading the next records doesn't overwrite them. The iterator moves on to new buffers from the pool.
+ */
+void SamPairIterator::release_served_buffers() {
+  auto& pool = utils::SamRecordPool::thread_local_pool();
+  for (const auto* served : {&m_sam_records.first, &m_sam_records.second}) {
+    if (served->m_body == nullptr || !served->m_copies.shared())
+      continue;
+    if (m_sam_record_ptr1 == served->m_body)
+      m_sam_record_ptr1 = pool.allocate();
+    if (m_sam_record_ptr2 == served->m_body)
+      m_sam_record_ptr2 = pool.allocate();
+    if (m_served_mate == served->m_body)
+      m_served_mate.reset();                                                          // not recycled
+  }
+}
+
+bool SamPairIterator::read_sam(utils::SamHandle& record_ptr) {
   if (sam_read1(m_sam_file_ptr.get(), m_sam_header_ptr.get(), record_ptr.get()) < 0) {
     m_sam_file_ptr = nullptr;
     return false;
@@ -49,18 +108,24 @@ bool SamPairIterator::read_sam(shared_ptr<bam1_t>& record_ptr) {
   return true;
 }
 
-Sam SamPairIterator::make_sam(shared_ptr<bam1_t>& record_ptr) {
+Sam SamPairIterator::make_sam(utils::SamHandle& record_ptr) {
   return Sam {m_sam_header_ptr, record_ptr};
 }
 
-static bool primary(shared_ptr<bam1_t>& record_ptr) {
+static bool primary(utils::SamHandle& record_ptr) {
   return !(record_ptr->core.flag & BAM_FSECONDARY) && !(record_ptr->core.flag & BAM_FSUPPLEMENTARY);
 }
 
-Sam SamPairIterator::next_primary_alignment(shared_ptr<bam1_t>& record_ptr) {
-  m_supp_alignments.push(utils::make_shared_sam(utils::sam_deep_copy(record_ptr.get())));
-  while (read_sam(record_ptr) && !primary(record_ptr))
-    m_supp_alignments.push(utils::make_shared_sam(utils::sam_deep_copy(record_ptr.get())));
+/**
+ * @brief queues the secondary/supplementary alignments by handing their buffers over to the queue (and
+ * reading into recycled ones) instead of copying them
+ */
+Sam SamPairIterator::next_primary_alignment(utils::SamHandle& record_ptr) {
+  auto& pool = utils::SamRecordPool::thread_local_pool();
+  do {
+    m_supp_alignments.push(move(record_ptr));
+    record_ptr = pool.allocate();
+  } while (read_sam(record_ptr) && !primary(record_ptr));
   return make_sam(record_ptr);
 }
 
@@ -71,6 +136,8 @@ pair<Sam,Sam> SamPairIterator::next_supplementary_alignment() {
 }
 
 pair<Sam,Sam> SamPairIterator::fetch_next_pair() {
+  if (m_options.mode == SamPairingMode::by_name)
+    return fetch_next_pair_by_name();
   if (!m_supp_alignments.empty())                                                     // pending supplementary alignments have priority
     return next_supplementary_alignment();
   if (!read_sam(m_sam_record_ptr1))
@@ -83,5 +150,164 @@ pair<Sam,Sam> SamPairIterator::fetch_next_pair() {
   return make_pair(read1, next_primary_alignment(m_sam_record_ptr2));                 // still haven't found the second primary alignment so search for it while pushing all the secondary/supplementary alignments to the queue
 }
 
+static bool mates(const bam1_t* a, const bam1_t* b) {
+  const auto a_end = a->core.flag & (BAM_FREAD1 | BAM_FREAD2);
+  const auto b_end = b->core.flag & (BAM_FREAD1 | BAM_FREAD2);
+  return (a_end != b_end || a_end == 0) && strcmp(bam_get_qname(a), bam_get_qname(b)) == 0;
+}
+
+static uint64_t memory_footprint(const bam1_t* record) {
+  return sizeof(bam1_t) + record->m_data;
+}
+
+pair<Sam,Sam> SamPairIterator::fetch_next_pair_by_name() {
+  if (m_served_mate)                                                                  // the previous pair has been copied out by now
+    recycle(move(m_served_mate));
+  while (true) {
+    if (!m_unmatched.empty()) {                                                       // mates without a pair go out by themselves at the end
+      m_served_mate = move(m_unmatched.front());
+      m_unmatched.pop_front();
+      return make_pair(make_sam(m_served_mate), Sam{});
+    }
+    if (!read_next_mate()) {
+      if (m_unmatched.empty())
+        break;
+      continue;
+    }
+    if (!primary(m_sam_record_ptr1) || !(m_sam_record_ptr1->core.flag & BAM_FPAIRED)) // unpaired reads and secondary/supplementary alignments go in immediately and by themselves
+      return make_pair(make_sam(m_sam_record_ptr1), Sam{});
+    if (match_or_hold())
+      return make_pair(make_sam(m_served_mate), make_sam(m_sam_record_ptr1));
+  }
+  remove_partitions();
+  m_sam_file_ptr = nullptr;                                                           // we have reached the end of file (and of the spilled mates)
+  return make_pair(Sam{}, Sam{});
+}
+
+/**
+ * @brief reads the input and then, if mates were spilled, each partition in turn. Returns false when there
+ * is nothing left to read or when the mates left without a pair in a partition must be released first.
+ */
+bool SamPairIterator::read_next_mate() {
+  if (!m_input_done) {
+    if (sam_read1(m_sam_file_ptr.get(), m_sam_header_ptr.get(), m_sam_record_ptr1.get()) >= 0)
+      return true;
+    m_input_done = true;
+    if (!m_partition_files.empty()) {                                                 // all mates go to the partitions, which are small enough to be paired up in memory
+      spill_pending_mates();
+      m_partition_files.clear();
+    }
+    release_unmatched_mates();
+    if (!m_unmatched.empty())
+      return false;
+  }
+  while (true) {
+    if (m_partition_reader) {
+      if (sam_read1(m_partition_reader.get(), m_sam_header_ptr.get(), m_sam_record_ptr1.get()) >= 0)
+        return true;
+      m_partition_reader.reset();
+      release_unmatched_mates();
+      if (!m_unmatched.empty())
+        return false;
+    }
+    if (m_next_partition == m_partition_names.size())
+      return false;
+    const auto& filename = m_partition_names[m_next_partition++];
+    m_partition_reader = utils::make_unique_hts_file(hts_open(filename.c_str(), "r"));
+    if (m_partition_reader == nullptr)
+      throw FileOpenException{filename};
+    auto* header_ptr = sam_hdr_read(m_partition_reader.get());
+    if (header_ptr == nullptr)
+      throw HeaderReadException{filename};
+    bam_hdr_destroy(header_ptr);
+  }
 }
 
+/**
+ * @brief looks up the mate by name hash (comparing the names only on a hash hit). An unmatched read is held
+ * by swapping its buffer with a recycled one, so it is never copied.
+ */
+bool SamPairIterator::match_or_hold() {
+  const auto hash = utils::name_hash(bam_get_qname(m_sam_record_ptr1.get()));
+  const auto candidates = m_pending_mates.equal_range(hash);
+  for (auto it = candidates.first; it != candidates.second; ++it) {
+    if (mates(it->second.record.get(), m_sam_record_ptr1.get())) {
+      m_served_mate = move(it->second.record);
+      m_pending_bytes -= memory_footprint(m_served_mate.get());
+      m_pending_mates.erase(it);
+      return true;
+    }
+  }
+  auto held = free_record();
+  swap(held, m_sam_record_ptr1);
+  m_pending_bytes += memory_footprint(held.get());
+  m_pending_mates.emplace(hash, PendingMate{move(held), m_sequence++});
+  if (m_pending_bytes > m_options.memory_limit && !m_input_done)
+    spill_pending_mates();
+  return false;
+}
+
+utils::SamHandle SamPairIterator::free_record() {
+  if (m_free_records.empty())
+    return utils::SamHandle::create();
+  auto record_ptr = move(m_free_records.back());
+  m_free_records.pop_back();
+  return record_ptr;
+}
+
+void SamPairIterator::recycle(utils::SamHandle&& record_ptr) {
+  if (m_free_records.size() < MAX_FREE_RECORDS)
+    m_free_records.push_back(move(record_ptr));
+  record_ptr.reset();
+}
+
+/**
+ * @brief writes all pending mates, in input order, to the partition of their name hash so both mates of a
+ * pair always end up in the same partition
+ */
+void SamPairIterator::spill_pending_mates() {
+  if (m_partition_files.empty()) {
+    for (auto i = 0u; i != NUM_PARTITIONS; ++i) {
+      m_partition_names.push_back(utils::make_temp_file(m_options.temp_dir, "gamgee_pairs_"));
+      m_partition_files.push_back(utils::make_unique_hts_file(hts_open(m_partition_names.back().c_str(), "wb1")));
+      if (m_partition_files.back() == nullptr)
+        throw FileOpenException{m_partition_names.back()};
+      sam_hdr_write(m_partition_files.back().get(), m_sam_header_ptr.get());
+    }
+  }
+  auto pending = vector<PendingMates::iterator>{};
+  pending.reserve(m_pending_mates.size());
+  for (auto it = m_pending_mates.begin(); it != m_pending_mates.end(); ++it)
+    pending.push_back(it);
+  sort(pending.begin(), pending.end(), [](const PendingMates::iterator& a, const PendingMates::iterator& b) { return a->second.sequence < b->second.sequence; });
+  for (auto& it : pending) {
+    const auto error = sam_write1(m_partition_files[it->first % NUM_PARTITIONS].get(), m_sam_header_ptr.get(), it->second.record.get());
+    if (error < 0)
+      throw HtslibException{error};
+    recycle(move(it->second.record));
+  }
+  m_pending_mates.clear();
+  m_pending_bytes = 0;
+}
+
+void SamPairIterator::release_unmatched_mates() {
+  auto unmatched = vector<PendingMate>{};
+  unmatched.reserve(m_pending_mates.size());
+  for (auto& entry : m_pending_mates)
+    unmatched.push_back(move(entry.second));
+  sort(unmatched.begin(), unmatched.end(), [](const PendingMate& a, const PendingMate& b) { return a.sequence < b.sequence; });
+  for (auto& mate : unmatched)
+    m_unmatched.push_back(move(mate.record));
+  m_pending_mates.clear();
+  m_pending_bytes = 0;
+}
+
+void SamPairIterator::remove_partitions() {
+  m_partition_files.clear();
+  m_partition_reader.reset();
+  for (const auto& filename : m_partition_names)
+    remove(filename.c_str());
+  m_partition_names.clear();
+}
+
+}
@@ -3,16 +3,49 @@
 
 #include "sam.h"
 
+#include "../utils/hts_memory.h"
+
 #include "htslib/sam.h"
 
+#include <deque>
 #include <fstream>
 #include <queue>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace gamgee {
 
+/**
+ * @brief how the SamPairIterator finds the mates of a read
+ */
+enum class SamPairingMode {
+  adjacent, ///< mates are next to each other in the input (queryname sorted or grouped files)
+  by_name   ///< mates can be anywhere in the input (e.g. coordinate sorted files): unmatched mates are held until their mate shows up
+};
+
+/**
+ * @brief pairing mode and memory settings of the SamPairIterator
+ */
+struct SamPairIteratorOptions {
+  SamPairingMode mode {SamPairingMode::adjacent};
+  uint64_t memory_limit {uint64_t{256} << 20};    ///< by_name mode: bytes of unmatched mates held in memory. Beyond that they are spilled to disk and paired up at the end of the input.
+  std::string temp_dir {};                        ///< by_name mode: directory for the spilled mates. Empty means $TMPDIR, or /tmp if that is not set.
+};
+
 /**
  * @brief Utility class to enable for-each style iteration by pairs in the SamReader class
+ *
+ * In the default (adjacent) mode the mates must be next to each other in the input. In by_name mode (see
+ * NamePairSamReader) the primary alignment of each mate is held in a hash table keyed by a hash of its name
+ * until the other mate comes along, so pairs come out as soon as the second mate is read. Secondary and
+ * supplementary alignments and unpaired reads come out by themselves, in input order. Mates whose pair
+ * can't be completed (e.g. in a region of the file) come out by themselves at the end of the input.
+ *
+ * @note by_name mode recycles the buffers of the records held in the table and, past the memory limit,
+ * spills them to temporary files partitioned by name hash. Mates spilled to disk are paired up at the end,
+ * one partition at a time.
  */
 class SamPairIterator {
   public:
@@ -30,6 +63,20 @@ class SamPairIterator {
      */
     SamPairIterator(const std::shared_ptr<htsFile>& sam_file_ptr, const std::shared_ptr<bam_hdr_t>& sam_header_ptr);
 
+    /**
+     * @brief initializes a new iterator based on an input stream with the given pairing mode
+     *
+     * @param sam_file_ptr   pointer to a sam file opened via the sam_open() macro from htslib
+     * @param sam_header_ptr pointer to a sam file header created with the sam_hdr_read() macro from htslib
+     * @param options        pairing mode, memory limit and temporary directory
+     */
+    SamPairIterator(const std::shared_ptr<htsFile>& sam_file_ptr, const std::shared_ptr<bam_hdr_t>& sam_header_ptr, const SamPairIteratorOptions& options);
+
+    /**
+     * @brief removes the temporary files of by_name mode, if any
+     */
+    ~SamPairIterator();
+
     /**
      * @brief no copy construction/assignment allowed in readers or iterators
      */
@@ -68,20 +115,56 @@ class SamPairIterator {
     std::pair<Sam,Sam> operator++();
 
   private:
-    using SamPtrQueue = std::queue<std::shared_ptr<bam1_t>>;
+    using SamPtrQueue = std::queue<utils::SamHandle>;
+
+    /**
+     * @brief a mate waiting for its pair in by_name mode
+     */
+    struct PendingMate {
+      utils::SamHandle record;
+      uint64_t sequence;                               ///< input order, to release unmatched mates in a deterministic order
+    };
+
+    /**
+     * @brief the name hashes are already good hashes
+     */
+    struct NameHashIdentity { size_t operator()(const uint64_t hash) const { return size_t(hash); } };
+
+    using PendingMates = std::unordered_multimap<uint64_t, PendingMate, NameHashIdentity>;
 
     SamPtrQueue m_supp_alignments;                     ///< queue to hold the supplementary alignments temporarily while processing the pairs
     std::shared_ptr<htsFile> m_sam_file_ptr;           ///< pointer to the sam file
     std::shared_ptr<bam_hdr_t> m_sam_header_ptr; ///< pointer to the sam header
-    std::shared_ptr<bam1_t> m_sam_record_ptr1;         ///< pointer to the internal structure of the sam record. Useful to only allocate it once.
-    std::shared_ptr<bam1_t> m_sam_record_ptr2;         ///< pointer to the internal structure of the sam record. Useful to only allocate it once.
+    utils::SamHandle m_sam_record_ptr1;         ///< pointer to the internal structure of the sam record. Useful to only allocate it once.
+    utils::SamHandle m_sam_record_ptr2;         ///< pointer to the internal structure of the sam record. Useful to only allocate it once.
+    SamPairIteratorOptions m_options;                  ///< pairing mode and memory settings
+    PendingMates m_pending_mates;                      ///< by_name mode: mates waiting for their pair, keyed by name hash
+    uint64_t m_pending_bytes;                          ///< by_name mode: memory used by m_pending_mates
+    uint64_t m_sequence;                               ///< by_name mode: number of mates added to m_pending_mates so far
+    std::vector<utils::SamHandle> m_free_records;                           ///< by_name mode: recycled record buffers
+    utils::SamHandle m_served_mate;                                         ///< by_name mode: buffer of the first mate of the last pair (recycled on the next fetch)
+    std::deque<utils::SamHandle> m_unmatched;                               ///< by_name mode: mates released alone at the end of the input
+    std::vector<std::string> m_partition_names;                                    ///< by_name mode: temporary files with the spilled mates, by name hash
+    std::vector<std::unique_ptr<htsFile, utils::HtsFileDeleter>> m_partition_files; ///< by_name mode: spilled mates being written (while reading the input)
+    std::unique_ptr<htsFile, utils::HtsFileDeleter> m_partition_reader;             ///< by_name mode: partition being paired up (after the input)
+    uint32_t m_next_partition;                         ///< by_name mode: next partition to pair up
+    bool m_input_done;                                 ///< by_name mode: whether the input has been exhausted
     std::pair<Sam,Sam> m_sam_records;                  ///< temporary record to hold between fetch (operator++) and serve (operator*)
 
     std::pair<Sam,Sam> fetch_next_pair();              ///< makes a new (through copy) pair of Sam objects that the user is free to use/keep without having to worry about memory management
-    bool read_sam(std::shared_ptr<bam1_t>& record_ptr);                 ///< reads a sam record and checks for the end-of-file invalidating the file and header pointers if necessary
-    Sam make_sam(std::shared_ptr<bam1_t>& record_ptr);                  ///< creates a sam record from the internal data
-    Sam next_primary_alignment(std::shared_ptr<bam1_t>& record_ptr);
+    bool read_sam(utils::SamHandle& record_ptr);                 ///< reads a sam record and checks for the end-of-file invalidating the file and header pointers if necessary
+    Sam make_sam(utils::SamHandle& record_ptr);                  ///< creates a sam record from the internal data
+    Sam next_primary_alignment(utils::SamHandle& record_ptr);
     std::pair<Sam,Sam> next_supplementary_alignment();
+    void release_served_buffers();                     ///< stops reusing the buffers of the last pair if the caller's copies are still sharing them
+    std::pair<Sam,Sam> fetch_next_pair_by_name();      ///< by_name mode version of fetch_next_pair
+    bool read_next_mate();                             ///< by_name mode: reads the next record into m_sam_record_ptr1 from the input or, after that, from the partitions. False when there is nothing left.
+    bool match_or_hold();                              ///< by_name mode: pairs m_sam_record_ptr1 with its pending mate (returning true) or holds it (returning false)
+    utils::SamHandle free_record();             ///< by_name mode: a recycled (or new) record buffer
+    void recycle(utils::SamHandle&& record_ptr);
+    void spill_pending_mates();
+    void release_unmatched_mates();
+    void remove_partitions();
 };
 
 }  // end namespace gamgee
@@ -0,0 +1,457 @@
+#include "sam_sorter.h"
+#include "sam_reader.h"
+#include "sam_writer.h"
+
+#include "../exceptions.h"
+#include "../utils/utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <queue>
+#include <stdexcept>
+
+using namespace std;
+
+namespace gamgee {
+
+constexpr auto RECORD_ALIGNMENT = size_t{8};
+constexpr auto MIN_PARALLEL_SORT_ENTRIES = size_t{1} << 14;  ///< arenas with fewer records are sorted by a single thread
+constexpr auto MERGE_BLOCK_SIZE = size_t{256};               ///< records decoded at a time from each run, ahead of the merge
+constexpr auto RECORD_HEADER_SIZE = (sizeof(bam1_core_t) + sizeof(int32_t) + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);  ///< core and data length, padded
+
+static size_t aligned(const size_t size) {
+  return (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+/**
+ * @brief copies the header replacing (or adding) the SO field of the \@HD line
+ */
+static shared_ptr<bam_hdr_t> sorted_header(const bam_hdr_t* original, const SamSortOrder order) {
+  const auto sort_order = string{order == SamSortOrder::coordinate ? "coordinate" : "queryname"};
+  auto text = original->text == nullptr ? string{} : string(original->text, original->l_text);
+  if (text.compare(0, 3, "@HD") == 0) {
+    const auto line_end = min(text.find('\n'), text.size());
+    auto line = text.substr(0, line_end);
+    const auto so_start = line.find("\tSO:");
+    if (so_start == string::npos)
+      line += "\tSO:" + sort_order;
+    else
+      line.replace(so_start, min(line.find('\t', so_start + 1), line.size()) - so_start, "\tSO:" + sort_order);
+    text.replace(0, line_end, line);
+  }
+  else
+    text = "@HD\tVN:1.4\tSO:" + sort_order + "\n" + text;
+  auto* header = bam_hdr_dup(original);
+  free(header->text);
+  header->text = static_cast<char*>(malloc(text.size() + 1));
+  memcpy(header->text, text.c_str(), text.size() + 1);
+  header->l_text = uint32_t(text.size());
+  return utils::make_shared_sam_header(header);
+}
+
+/**
+ * @brief a non-owning bam1_t over a record serialized in the arena
+ */
+static bam1_t view(const vector<uint8_t>& bytes, const uint64_t offset) {
+  auto record = bam1_t{};
+  const auto* serialized = bytes.data() + offset;
+  memcpy(&record.core, serialized, sizeof(bam1_core_t));
+  memcpy(&record.l_data, serialized + sizeof(bam1_core_t), sizeof(int32_t));
+  record.m_data = record.l_data;
+  record.data = const_cast<uint8_t*>(serialized + RECORD_HEADER_SIZE);
+  return record;
+}
+
+SamSorter::SamSorter(const SamHeader& header, const std::string& output_fname, const SamSorterOptions& options) :
+  m_options {options},
+  m_output_fname {output_fname},
+  m_header {sorted_header(header.m_header.get(), options.order)},
+  m_arenas {},
+  m_filling {0},
+  m_runs {},
+  m_spilled_runs {0},
+  m_spill {},
+  m_finished {false},
+  m_pool {options.num_threads > 1 ? options.num_threads + 1 : 1}  // the background spill waits for the threads sorting its arena
+{
+  m_options.memory_limit = max(m_options.memory_limit, uint64_t{2});
+  m_options.spill_compression_level = min(m_options.spill_compression_level, 9u);
+}
+
+SamSorter::~SamSorter() {
+  if (m_spill.valid())
+    m_spill.wait();
+  remove_runs();
+}
+
+void SamSorter::add_record(const Sam& record) {
+  if (m_finished)
+    throw logic_error{"cannot add records to a SamSorter after finish()"};
+  const auto* body = record.m_body.get();
+  const auto size = RECORD_HEADER_SIZE + aligned(body->l_data);
+  const auto budget = m_options.memory_limit / 2;
+  if (!m_arenas[m_filling].entries.empty() && m_arenas[m_filling].used() + size + sizeof(SortEntry) > budget)
+    spill();
+  auto& arena = m_arenas[m_filling];
+  if (arena.bytes.capacity() == 0)
+    arena.bytes.reserve(budget);
+  const auto offset = arena.bytes.size();
+  const auto* core = reinterpret_cast<const uint8_t*>(&body->core);
+  const auto* l_data = reinterpret_cast<const uint8_t*>(&body->l_data);
+  arena.bytes.insert(arena.bytes.end(), core, core + sizeof(bam1_core_t));
+  arena.bytes.insert(arena.bytes.end(), l_data, l_data + sizeof(int32_t));
+  arena.bytes.resize(offset + RECORD_HEADER_SIZE);
+  arena.bytes.insert(arena.bytes.end(), body->data, body->data + body->l_data);
+  arena.bytes.resize(offset + size);
+  arena.entries.push_back(SortEntry{key(body), offset});
+}
+
+void SamSorter::finish() {
+  if (m_finished)
+    return;
+  m_finished = true;
+  if (m_runs.empty()) {
+    write_sorted(m_arenas[m_filling]);
+    return;
+  }
+  if (!m_arenas[m_filling].entries.empty())
+    spill();
+  m_spill.get();
+  merge_runs();
+  remove_runs();
+}
+
+void SamSorter::sort(const std::string& input_fname, const std::string& output_fname, const SamSorterOptions& options) {
+  auto reader = SingleSamReader{input_fname};
+  SamSorter sorter {reader.header(), output_fname, options};
+  for (const auto& record : reader)
+    sorter.add_record(record);
+  sorter.finish();
+}
+
+/**
+ * @brief hands the full arena to the background thread and starts filling the other one (once its previous
+ * run is on disk)
+ */
+void SamSorter::spill() {
+  if (m_spill.valid())
+    m_spill.get();
+  auto& full = m_arenas[m_filling];
+  m_filling ^= 1;
+  m_runs.push_back(utils::make_temp_file(m_options.temp_dir, "gamgee_sort_"));
+  ++m_spilled_runs;
+  const auto filename = m_runs.back();
+  m_spill = m_pool.submit([this, &full, filename] { write_run(full, filename); });
+}
+
+void SamSorter::write_run(Arena& arena, const std::string& filename) {
+  sort_entries(arena);
+  const auto mode = "wb" + to_string(m_options.spill_compression_level);
+  auto file = utils::make_unique_hts_file(hts_open(filename.c_str(), mode.c_str()));
+  if (file == nullptr)
+    throw FileOpenException{filename};
+  if (m_options.num_threads > 1)
+    hts_set_threads(file.get(), int(m_options.num_threads));
+  sam_hdr_write(file.get(), m_header.get());
+  for (const auto& entry : arena.entries) {
+    const auto record = view(arena.bytes, entry.offset);
+    const auto error = sam_write1(file.get(), m_header.get(), &record);
+    if (error < 0)
+      throw HtslibException{error};
+  }
+  arena.bytes.clear();
+  arena.entries.clear();
+}
+
+/**
+ * @brief sorts the arena with a single thread (see sort_range()) or, if it is large enough, with several: each
+ * thread sorts a slice of the entries, then the sorted slices are split at keys sampled from them and each
+ * thread merges one part of every slice into its place in the output
+ */
+void SamSorter::sort_entries(Arena& arena) {
+  if (m_options.order == SamSortOrder::queryname)
+    rekey_names(arena);
+  auto& entries = arena.entries;
+  const auto& bytes = arena.bytes;
+  auto buffer = vector<SortEntry>(entries.size());
+  const auto num_slices = size_t{m_options.num_threads};
+  if (num_slices < 2 || entries.size() < MIN_PARALLEL_SORT_ENTRIES) {
+    sort_range(entries.data(), entries.data() + entries.size(), buffer.data(), bytes);
+    return;
+  }
+  const auto slice_size = (entries.size() + num_slices - 1) / num_slices;
+  auto slices = vector<pair<SortEntry*, SortEntry*>>{};
+  for (auto start = size_t{0}; start < entries.size(); start += slice_size)
+    slices.emplace_back(entries.data() + start, entries.data() + min(start + slice_size, entries.size()));
+  auto tasks = vector<future<void>>{};
+  for (const auto& slice : slices) {
+    auto* const slice_buffer = buffer.data() + (slice.first - entries.data());
+    tasks.push_back(m_pool.submit([this, slice, slice_buffer, &bytes] { sort_range(slice.first, slice.second, slice_buffer, bytes); }));
+  }
+  for (auto& task : tasks)
+    task.get();
+
+  // splitters: every num_slices-th of num_slices evenly spaced samples of each sorted slice
+  auto samples = vector<SortEntry>{};
+  for (const auto& slice : slices)
+    for (auto i = size_t{1}; i <= num_slices; ++i)
+      samples.push_back(slice.first[(slice.second - slice.first) * i / (num_slices + 1)]);
+  const auto entry_less = [this, &bytes](const SortEntry& a, const SortEntry& b) { return less(a, b, bytes); };
+  std::sort(samples.begin(), samples.end(), entry_less);
+  auto bounds = vector<vector<const SortEntry*>>(slices.size());  // where each part starts in each slice
+  for (auto s = 0u; s != slices.size(); ++s) {
+    bounds[s].push_back(slices[s].first);
+    for (auto part = size_t{1}; part != num_slices; ++part)
+      bounds[s].push_back(lower_bound(bounds[s].back(), static_cast<const SortEntry*>(slices[s].second), samples[part * num_slices], entry_less));
+    bounds[s].push_back(slices[s].second);
+  }
+  tasks.clear();
+  auto* destination = buffer.data();
+  for (auto part = size_t{0}; part != num_slices; ++part) {
+    auto ranges = vector<pair<const SortEntry*, const SortEntry*>>{};
+    auto size = size_t{0};
+    for (const auto& slice_bounds : bounds) {
+      ranges.emplace_back(slice_bounds[part], slice_bounds[part + 1]);
+      size += size_t(slice_bounds[part + 1] - slice_bounds[part]);
+    }
+    tasks.push_back(m_pool.submit([this, ranges, destination, &bytes] { merge_ranges(ranges, destination, bytes); }));
+    destination += size;
+  }
+  for (auto& task : tasks)
+    task.get();
+  entries.swap(buffer);
+}
+
+/**
+ * @brief LSD radix sort of the 64 bit keys in [first, last), one byte at a time (skipping the bytes that are the
+ * same for all keys), followed by a comparison sort of the (rare) runs of equal keys that need a tie break
+ * @param buffer room for last - first entries
+ */
+void SamSorter::sort_range(SortEntry* first, SortEntry* last, SortEntry* buffer, const std::vector<uint8_t>& bytes) const {
+  const auto size = size_t(last - first);
+  auto* source = first;
+  auto* destination = buffer;
+  for (auto shift = 0u; shift != 64; shift += 8) {
+    size_t counts[256] = {0};
+    for (const auto* entry = source; entry != source + size; ++entry)
+      ++counts[(entry->key >> shift) & 0xff];
+    if (any_of(begin(counts), end(counts), [size](const size_t count) { return count == size; }))
+      continue;
+    auto total = size_t{0};
+    for (auto& count : counts) {
+      const auto bucket_size = count;
+      count = total;
+      total += bucket_size;
+    }
+    for (const auto* entry = source; entry != source + size; ++entry)
+      destination[counts[(entry->key >> shift) & 0xff]++] = *entry;
+    swap(source, destination);
+  }
+  if (source != first)
+    copy(source, source + size, first);
+  if (m_options.order == SamSortOrder::coordinate)
+    return;
+  for (auto range_start = first; range_start != last; ) {
+    const auto range_end = find_if(range_start, last, [range_start](const SortEntry& entry) { return entry.key != range_start->key; });
+    if (range_end - range_start > 1)
+      stable_sort(range_start, range_end, [this, &bytes](const SortEntry& a, const SortEntry& b) { return less(a, b, bytes); });
+    range_start = range_end;
+  }
+}
+
+/**
+ * @brief merges sorted ranges of entries (one from each sorted slice of the arena, in arena order) into destination
+ */
+void SamSorter::merge_ranges(const std::vector<std::pair<const SortEntry*, const SortEntry*>>& ranges, SortEntry* destination, const std::vector<uint8_t>& bytes) const {
+  auto heads = ranges;
+  const auto after = [this, &heads, &bytes](const size_t a, const size_t b) { return less(*heads[b].first, *heads[a].first, bytes); };
+  auto heap = priority_queue<size_t, vector<size_t>, decltype(after)>{after};
+  for (auto i = size_t{0}; i != heads.size(); ++i)
+    if (heads[i].first != heads[i].second)
+      heap.push(i);
+  while (!heap.empty()) {
+    const auto i = heap.top();
+    heap.pop();
+    *destination++ = *heads[i].first++;
+    if (heads[i].first != heads[i].second)
+      heap.push(i);
+  }
+}
+
+/**
+ * @brief the order of the sort: by key, then by compare(), then in input order (records are appended to the arena)
+ */
+bool SamSorter::less(const SortEntry& a, const SortEntry& b, const std::vector<uint8_t>& bytes) const {
+  if (a.key != b.key)
+    return a.key < b.key;
+  if (m_options.order != SamSortOrder::coordinate) {
+    const auto record_a = view(bytes, a.offset);
+    const auto record_b = view(bytes, b.offset);
+    const auto order = compare(&record_a, &record_b);
+    if (order != 0)
+      return order < 0;
+  }
+  return a.offset < b.offset;
+}
+
+void SamSorter::write_sorted(Arena& arena) {
+  sort_entries(arena);
+  auto writer = SamWriter{SamHeader{m_header}, m_output_fname, m_options.binary_output, m_options.num_threads};
+  const auto body = utils::SamHandle::create();
+  const auto record = Sam{m_header, body};
+  for (const auto& entry : arena.entries) {
+    const auto serialized = view(arena.bytes, entry.offset);
+    bam_copy1(body.get(), &serialized);
+    writer.add_record(record);
+  }
+}
+
+/**
+ * @brief k-way merge of the runs with a heap of their current records (ties go to the earlier run, which
+ * holds the earlier records, so the merge is stable). The next block of records of each run is decoded by the
+ * pool while the current one is being merged.
+ */
+void SamSorter::merge_runs() {
+  auto files = vector<unique_ptr<htsFile, utils::HtsFileDeleter>>{};
+  auto records = vector<Sam>{};
+  records.reserve(m_runs.size());
+  for (const auto& run : m_runs) {
+    files.push_back(utils::make_unique_hts_file(hts_open(run.c_str(), "r")));
+    if (files.back() == nullptr)
+      throw FileOpenException{run};
+    auto* run_header = sam_hdr_read(files.back().get());
+    if (run_header == nullptr)
+      throw HeaderReadException{run};
+    bam_hdr_destroy(run_header);
+    records.emplace_back(m_header, utils::SamHandle::create());
+  }
+  const auto read_block = [this, &files](const uint32_t run) {
+    auto block = vector<utils::SamHandle>{};
+    block.reserve(MERGE_BLOCK_SIZE);
+    while (block.size() != MERGE_BLOCK_SIZE) {
+      auto record = utils::SamHandle::create();
+      const auto status = sam_read1(files[run].get(), m_header.get(), record.get());
+      if (status < -1)
+        throw HtslibException{status};
+      if (status < 0)
+        break;
+      block.push_back(move(record));
+    }
+    return block;
+  };
+  auto blocks = vector<vector<utils::SamHandle>>(m_runs.size());
+  auto next_records = vector<size_t>(m_runs.size());
+  auto next_blocks = vector<future<vector<utils::SamHandle>>>(m_runs.size());
+  auto body = [&records](const uint32_t run) { return records[run].m_body.get(); };
+  auto keys = vector<uint64_t>(m_runs.size());
+  const auto after = [this, &keys, &body](const uint32_t a, const uint32_t b) {
+    if (keys[a] != keys[b])
+      return keys[a] > keys[b];
+    const auto order = compare(body(a), body(b));
+    return order != 0 ? order > 0 : a > b;
+  };
+  auto heap = priority_queue<uint32_t, vector<uint32_t>, decltype(after)>{after};
+  const auto read_next = [this, &blocks, &next_records, &next_blocks, &read_block, &records, &keys, &body, &heap](const uint32_t run) {
+    if (next_records[run] == blocks[run].size()) {
+      if (!next_blocks[run].valid())
+        return;                                           // the run is exhausted
+      blocks[run] = next_blocks[run].get();
+      next_records[run] = 0;
+      if (blocks[run].size() == MERGE_BLOCK_SIZE)
+        next_blocks[run] = m_pool.submit([&read_block, run] { return read_block(run); });
+      if (blocks[run].empty())
+        return;
+    }
+    records[run].m_body = move(blocks[run][next_records[run]++]);
+    keys[run] = key(body(run));
+    heap.push(run);
+  };
+  try {
+    for (auto run = 0u; run != m_runs.size(); ++run) {
+      next_blocks[run] = m_pool.submit([&read_block, run] { return read_block(run); });
+      read_next(run);
+    }
+    auto writer = SamWriter{SamHeader{m_header}, m_output_fname, m_options.binary_output, m_options.num_threads};
+    while (!heap.empty()) {
+      const auto run = heap.top();
+      heap.pop();
+      writer.add_record(records[run]);
+      read_next(run);
+    }
+  }
+  catch (...) {
+    for (auto& next_block : next_blocks)                 // the blocks being decoded use the files
+      if (next_block.valid())
+        next_block.wait();
+    throw;
+  }
+}
+
+void SamSorter::remove_runs() {
+  for (const auto& run : m_runs)
+    remove(run.c_str());
+  m_runs.clear();
+}
+
+/**
+ * @brief coordinate order: chromosome (unmapped reads without a chromosome last), position and strand.
+ * queryname order: the first 8 characters of the name, big endian so keys compare like the names do.
+ */
+/**
+ * @param name_offset queryname order: where the 8 characters of the key start in the name (which must be at
+ * least that long). Keys with different offsets can't be compared.
+ */
+uint64_t SamSorter::key(const bam1_t* record, const uint32_t name_offset) const {
+  if (m_options.order == SamSortOrder::coordinate)
+    return uint64_t{uint32_t(record->core.tid)} << 32 | uint64_t{uint32_t(record->core.pos + 1)} << 1 | uint64_t{bam_is_rev(record) ? 1u : 0u};
+  const auto* name = bam_get_qname(record) + name_offset;
+  auto result = uint64_t{0};
+  for (auto i = 0u; i != 8 && name[i] != '\0'; ++i)
+    result |= uint64_t{uint8_t(name[i])} << (56 - 8 * i);
+  return result;
+}
+
+/**
+ * @brief queryname order: keys the names of the arena past the prefix they all share, so that the radix sort
+ * tells them apart instead of leaving the whole arena to the tie break
+ */
+void SamSorter::rekey_names(Arena& arena) const {
+  if (arena.entries.size() < 2)
+    return;
+  const auto first = view(arena.bytes, arena.entries.front().offset);
+  const auto* prefix = bam_get_qname(&first);
+  auto prefix_length = uint32_t(strlen(prefix));
+  for (const auto& entry : arena.entries) {
+    const auto record = view(arena.bytes, entry.offset);
+    const auto* name = bam_get_qname(&record);
+    auto length = 0u;
+    while (length != prefix_length && name[length] == prefix[length])
+      ++length;
+    prefix_length = length;
+    if (prefix_length == 0)
+      return;
+  }
+  for (auto& entry : arena.entries) {
+    const auto record = view(arena.bytes, entry.offset);
+    entry.key = key(&record, prefix_length);
+  }
+}
+
+/**
+ * @brief tie break between records with the same key (only queryname order needs one): the full name, then
+ * unpaired reads, first mates and second mates in this order
+ */
+int SamSorter::compare(const bam1_t* a, const bam1_t* b) const {
+  if (m_options.order == SamSortOrder::coordinate)
+    return 0;
+  const auto names = strcmp(bam_get_qname(a), bam_get_qname(b));
+  if (names != 0)
+    return names;
+  const auto mates_a = a->core.flag & (BAM_FREAD1 | BAM_FREAD2);
+  const auto mates_b = b->core.flag & (BAM_FREAD1 | BAM_FREAD2);
+  return mates_a < mates_b ? -1 : mates_a > mates_b;
+}
+
+}
@@ -0,0 +1,146 @@
+#ifndef gamgee__sam_sorter__guard
+#define gamgee__sam_sorter__guard
+
+#include "sam.h"
+#include "sam_header.h"
+
+#include "../utils/hts_memory.h"
+#include "../utils/thread_pool.h"
+
+#include "htslib/sam.h"
+
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gamgee {
+
+/**
+ * @brief sort orders supported by the SamSorter (as in the SO field of the \@HD header line)
+ */
+enum class SamSortOrder { coordinate, queryname };
+
+/**
+ * @brief memory, temporary storage and parallelism settings of the SamSorter
+ */
+struct SamSorterOptions {
+  SamSortOrder order {SamSortOrder::coordinate};  ///< coordinate: by chromosome, position and strand (unmapped reads last). queryname: by read name, first mate before second mate.
+  uint64_t memory_limit {uint64_t{768} << 20};    ///< bytes of records (and sort keys) held in memory. Records are read into one half while the other half is being sorted and spilled.
+  std::string temp_dir {};                        ///< directory for the spilled runs. Empty means $TMPDIR, or /tmp if that is not set.
+  uint32_t num_threads {1};                       ///< threads sorting the records, decoding the runs being merged and compressing the spilled runs and the output
+  uint32_t spill_compression_level {1};           ///< BGZF compression level of the spilled runs (0-9, speed matters more than size for temporary files)
+  bool binary_output {true};                      ///< whether the output should be in BAM (true) or SAM format (false)
+};
+
+/**
+ * @brief External memory sort of SAM/BAM records with a fixed memory budget
+ *
+ * Records are appended to a fixed size arena and keyed by a compact 64 bit key: (chromosome, position,
+ * strand) for coordinate order or 8 characters of the read name for queryname order: the 8 characters after the
+ * prefix all the names of the arena share when it is sorted, since the names of a run or an instrument usually
+ * share a long one (ties are broken by the full name and mate flags). When the arena is full, its keys are radix sorted and the records
+ * are written out, in order, as a compressed run in the temporary directory -- in the background, while the
+ * next records are read into the second arena. Finally the runs are k-way merged into the output. If
+ * everything fits in memory nothing is spilled. The sort is stable: records that compare equal come out in
+ * input order.
+ *
+ * With several threads, each thread radix sorts a slice of the arena and then merges its share of all the
+ * sorted slices (split by keys sampled from them), and the runs are decoded ahead of the merge by the threads.
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * auto options = SamSorterOptions{};
+ * options.memory_limit = uint64_t{4} << 30;
+ * options.num_threads = 8;
+ * SamSorter::sort("unsorted.bam", "sorted.bam", options);
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * @note the SO field of the \@HD line of the output header is set to the sort order
+ */
+class SamSorter {
+ public:
+  /**
+   * @brief creates a sorter writing to output_fname once finish() is called
+   * @param header       header of the records to sort (copied, with the sort order updated, to the output)
+   * @param output_fname file to write to ("-" for stdout)
+   * @param options      sort order, memory budget, temporary directory and threads
+   */
+  explicit SamSorter(const SamHeader& header, const std::string& output_fname, const SamSorterOptions& options = SamSorterOptions{});
+
+  /**
+   * @brief removes any temporary file left behind (the output is not written unless finish() was called)
+   */
+  ~SamSorter();
+
+  /**
+   * @brief no copy or move construction/assignment allowed (the sorter owns a thread pool)
+   */
+  SamSorter(const SamSorter&) = delete;
+  SamSorter& operator=(const SamSorter&) = delete;
+
+  /**
+   * @brief adds a copy of a record to the sort, spilling a sorted run to disk if the memory budget is exhausted
+   * @throw FileOpenException if a temporary file cannot be created
+   */
+  void add_record(const Sam& record);
+
+  /**
+   * @brief sorts the records added so far, writes them to the output and removes the temporary files
+   * @note no records can be added after finishing
+   */
+  void finish();
+
+  uint32_t spilled_runs() const { return m_spilled_runs; } ///< @brief number of sorted runs spilled to the temporary directory
+
+  /**
+   * @brief sorts a SAM/BAM/CRAM file into another
+   */
+  static void sort(const std::string& input_fname, const std::string& output_fname, const SamSorterOptions& options = SamSorterOptions{});
+
+ private:
+  /**
+   * @brief a sort key and the offset of its record in the arena
+   */
+  struct SortEntry {
+    uint64_t key;
+    uint64_t offset;
+  };
+
+  /**
+   * @brief records serialized back to back (core, data length and data, 8 byte aligned) and their keys
+   */
+  struct Arena {
+    std::vector<uint8_t> bytes;
+    std::vector<SortEntry> entries;
+    uint64_t used() const { return bytes.size() + entries.size() * sizeof(SortEntry); }
+  };
+
+  SamSorterOptions m_options;
+  std::string m_output_fname;
+  std::shared_ptr<bam_hdr_t> m_header;  ///< header of the output (and of the runs), with the sort order set
+  Arena m_arenas[2];
+  uint32_t m_filling;                   ///< index of the arena receiving records
+  std::vector<std::string> m_runs;      ///< file names of the spilled runs (until they are removed)
+  uint32_t m_spilled_runs;
+  std::future<void> m_spill;            ///< run being spilled in the background (from the arena not filling)
+  bool m_finished;
+  utils::ThreadPool m_pool;             ///< background spilling, sorting and decoding of the runs (declared last so it is joined before anything else is destroyed)
+
+  void spill();
+  void write_run(Arena& arena, const std::string& filename);
+  void sort_entries(Arena& arena);
+  void sort_range(SortEntry* first, SortEntry* last, SortEntry* buffer, const std::vector<uint8_t>& bytes) const;
+  void merge_ranges(const std::vector<std::pair<const SortEntry*, const SortEntry*>>& ranges, SortEntry* destination, const std::vector<uint8_t>& bytes) const;
+  bool less(const SortEntry& a, const SortEntry& b, const std::vector<uint8_t>& bytes) const;
+  void write_sorted(Arena& arena);
+  void merge_runs();
+  void remove_runs();
+  uint64_t key(const bam1_t* record, const uint32_t name_offset = 0) const;
+  void rekey_names(Arena& arena) const;
+  int compare(const bam1_t* a, const bam1_t* b) const;
+};
+
+}  // end of namespace gamgee
+
+#endif // gamgee__sam_sorter__guard
@@ -0,0 +1,90 @@
+#include "sam_tag.h"
+
+#include <cstring>
+
+using namespace std;
+
+namespace gamgee {
+
+/**
+ * @brief size of a single value of an aux type (0 for the variable length Z, H and B types and for unknown types)
+ */
+static uint32_t aux_type_size(const uint8_t type) {
+  switch (type) {
+    case 'A': case 'c': case 'C': return 1;
+    case 's': case 'S': return 2;
+    case 'i': case 'I': case 'f': return 4;
+    case 'd': return 8;
+    default: return 0;
+  }
+}
+
+const uint8_t* SamTagIndex::skip(const uint8_t* entry, const uint8_t* end) {
+  if (end - entry < 3)
+    return nullptr;
+  const auto type = entry[2];
+  const auto* value = entry + 3;
+  if (type == 'Z' || type == 'H') {
+    const auto* terminator = static_cast<const uint8_t*>(memchr(value, '\0', size_t(end - value)));
+    return terminator == nullptr ? nullptr : terminator + 1;
+  }
+  if (type == 'B') {
+    if (end - value < 5)
+      return nullptr;
+    auto count = uint32_t{0};
+    memcpy(&count, value + 1, sizeof(count));
+    const auto bytes = uint64_t{count} * aux_type_size(value[0]);
+    return bytes > uint64_t(end - value - 5) ? nullptr : value + 5 + bytes;
+  }
+  const auto size = aux_type_size(type);
+  return size == 0 || size > uint32_t(end - value) ? nullptr : value + size;
+}
+
+const uint8_t* SamTagIndex::scan(const uint8_t* begin, const uint8_t* end, const SamTagKey key) {
+  for (auto* entry = begin; end - entry >= 3; ) {
+    const auto* next = skip(entry, end);
+    if (next == nullptr)          // truncated entry
+      return nullptr;
+    if (SamTagKey::encode(char(entry[0]), char(entry[1])) == key.code())
+      return entry + 2;
+    entry = next;
+  }
+  return nullptr;
+}
+
+void SamTagIndex::build(const uint8_t* aux, const uint8_t* end) const {
+  m_size = 0;
+  auto* entry = aux;
+  while (end - entry >= 3 && m_size != max_indexed_tags && entry - aux <= UINT16_MAX) {
+    const auto* next = skip(entry, end);
+    if (next == nullptr) {        // a truncated entry ends the search
+      entry = end;
+      break;
+    }
+    m_keys[m_size] = SamTagKey::encode(char(entry[0]), char(entry[1]));
+    m_offsets[m_size++] = uint16_t(entry - aux);
+    entry = next;
+  }
+  m_resume_offset = uint32_t(entry - aux);
+}
+
+const uint8_t* SamTagIndex::find(const bam1_t* record, const SamTagKey key) const {
+  const auto* aux = bam_get_aux(record);
+  const auto* end = record->data + record->l_data;
+  auto state = m_state.load(memory_order_acquire);
+  if (state == unbuilt) {
+    if (!m_state.compare_exchange_strong(state, building, memory_order_acquire))
+      return scan(aux, end, key);   // another thread is building it
+    build(aux, end);
+    m_state.store(built, memory_order_release);
+  }
+  else if (state == building)
+    return scan(aux, end, key);
+  for (auto i = 0u; i != m_size; ++i) {
+    if (m_keys[i] == key.code())
+      return aux + m_offsets[i] + 2;
+  }
+  return scan(aux + m_resume_offset, end, key);
+}
+
+}
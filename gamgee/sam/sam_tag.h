@@ -1,24 +1,155 @@
 #ifndef gamgee__sam_tag__guard
 #define gamgee__sam_tag__guard
 
+#include "../utils/utils.h"
+
+#include "htslib/sam.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
 namespace gamgee {
 
+/**
+ * @brief the two character name of a Sam tag, encoded as the two bytes it is stored as in the aux data
+ *
+ * String literals convert at compile time and can be kept as constants:
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * constexpr auto UMI_TAG = SamTagKey{"RX"};
+ * const auto umi = record.string_tag(UMI_TAG);
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ */
+class SamTagKey {
+ public:
+  constexpr SamTagKey(const char (&name)[3]) : m_code {encode(name[0], name[1])} {}  ///< @brief from a two character literal (e.g. "NM")
+  constexpr SamTagKey(const std::string_view name) : m_code {check(name)} {}          ///< @brief from a runtime name. @throw std::invalid_argument if name doesn't have exactly two characters
+  SamTagKey(const std::string& name) : SamTagKey {std::string_view{name}} {}         ///< @copydoc SamTagKey(const std::string_view)
+
+  constexpr uint16_t code() const { return m_code; }                                 ///< @brief the name as a little endian number (first character in the low byte)
+  std::string name() const { return std::string{char(m_code & 0xff), char(m_code >> 8)}; }
+  constexpr bool operator==(const SamTagKey& other) const { return m_code == other.m_code; }
+  constexpr bool operator!=(const SamTagKey& other) const { return m_code != other.m_code; }
+
+  static constexpr uint16_t encode(const char first, const char second) { return uint16_t(uint8_t(first) | (uint8_t(second) << 8)); }
+
+ private:
+  uint16_t m_code;
+
+  static constexpr uint16_t check(const std::string_view name) {
+    if (name.size() != 2)
+      throw std::invalid_argument{"Sam tag names have exactly two characters"};
+    return encode(name[0], name[1]);
+  }
+};
+
+/**
+ * @brief the subtype character of the B (array) aux tags holding elements of a given type
+ */
+template<class ELEMENT> struct SamTagArrayType;
+template<> struct SamTagArrayType<int8_t>   { static constexpr char value = 'c'; };
+template<> struct SamTagArrayType<uint8_t>  { static constexpr char value = 'C'; };
+template<> struct SamTagArrayType<int16_t>  { static constexpr char value = 's'; };
+template<> struct SamTagArrayType<uint16_t> { static constexpr char value = 'S'; };
+template<> struct SamTagArrayType<int32_t>  { static constexpr char value = 'i'; };
+template<> struct SamTagArrayType<uint32_t> { static constexpr char value = 'I'; };
+template<> struct SamTagArrayType<float>    { static constexpr char value = 'f'; };
+
+/**
+ * @brief zero-copy view of the values of a B (array) aux tag, e.g. ML:B:C or ZB:B:s
+ *
+ * Points into the record the tag came from (valid as long as that record is alive and not modified). The
+ * values aren't aligned in the aux data, so they are returned by value.
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * const auto modification_probabilities = record.array_tag<uint8_t>("ML");
+ * for (const auto probability : modification_probabilities.value())
+ *   ...
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ */
+template<class ELEMENT>
+class SamTagArray {
+ public:
+  static constexpr char type = SamTagArrayType<ELEMENT>::value;   ///< the subtype character of the tag
+
+  /**
+   * @brief random access iterator over the values of the array
+   */
+  class const_iterator {
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = ELEMENT;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const ELEMENT*;
+    using reference = ELEMENT;
+
+    explicit const_iterator(const uint8_t* position = nullptr) : m_position {position} {}
+    ELEMENT operator*() const { return load(m_position); }
+    ELEMENT operator[](const difference_type n) const { return load(m_position + n * difference_type(sizeof(ELEMENT))); }
+    const_iterator& operator++() { m_position += sizeof(ELEMENT); return *this; }
+    const_iterator operator++(int) { auto old = *this; ++(*this); return old; }
+    const_iterator& operator--() { m_position -= sizeof(ELEMENT); return *this; }
+    const_iterator operator--(int) { auto old = *this; --(*this); return old; }
+    const_iterator& operator+=(const difference_type n) { m_position += n * difference_type(sizeof(ELEMENT)); return *this; }
+    const_iterator& operator-=(const difference_type n) { m_position -= n * difference_type(sizeof(ELEMENT)); return *this; }
+    const_iterator operator+(const difference_type n) const { return const_iterator{*this} += n; }
+    const_iterator operator-(const difference_type n) const { return const_iterator{*this} -= n; }
+    difference_type operator-(const const_iterator& other) const { return (m_position - other.m_position) / difference_type(sizeof(ELEMENT)); }
+    bool operator==(const const_iterator& other) const { return m_position == other.m_position; }
+    bool operator!=(const const_iterator& other) const { return m_position != other.m_position; }
+    bool operator<(const const_iterator& other) const { return m_position < other.m_position; }
+    bool operator>(const const_iterator& other) const { return m_position > other.m_position; }
+    bool operator<=(const const_iterator& other) const { return m_position <= other.m_position; }
+    bool operator>=(const const_iterator& other) const { return m_position >= other.m_position; }
+    friend const_iterator operator+(const difference_type n, const const_iterator& it) { return it + n; }
+
+   private:
+    const uint8_t* m_position;
+  };
+
+  SamTagArray() : m_values {nullptr}, m_size {0} {}
+  SamTagArray(const uint8_t* values, const uint32_t size) : m_values {values}, m_size {size} {}   ///< @brief a view of size little endian values starting at values
+
+  ELEMENT operator[](const uint32_t index) const { utils::check_max_boundary(index, m_size); return load(m_values + index * sizeof(ELEMENT)); }
+  uint32_t size() const { return m_size; }                        ///< @brief number of values in the array
+  bool empty() const { return m_size == 0; }
+  const uint8_t* raw_data() const { return m_values; }             ///< @brief the encoded values (size() * sizeof(ELEMENT) bytes)
+  const_iterator begin() const { return const_iterator{m_values}; }
+  const_iterator end() const { return const_iterator{m_values + m_size * sizeof(ELEMENT)}; }
+
+ private:
+  const uint8_t* m_values;
+  uint32_t m_size;
+
+  static ELEMENT load(const uint8_t* position) {
+    auto value = ELEMENT{};
+    memcpy(&value, position, sizeof(ELEMENT));
+    return value;
+  }
+};
+
 /**
  * @brief class to represent a Sam TAG:TYPE:VALUE entry
+ *
+ * @note string tags are returned as SamTag<std::string_view> pointing into the record, valid as long as the
+ *       record they came from is alive and not modified
  */
 template<class TAG_TYPE>
 class SamTag {
  public:
-  explicit SamTag(const std::string& name, const TAG_TYPE& value, const bool missing = false) :
-    m_name { name },
+  explicit SamTag(const SamTagKey key, const TAG_TYPE& value, const bool missing = false) :
+    m_key { key },
     m_value { value },
     m_missing { missing }
   {}
 
-  explicit SamTag(const std::string& name, TAG_TYPE&& value, const bool missing = false) :
-    m_name { name },
+  explicit SamTag(const SamTagKey key, TAG_TYPE&& value, const bool missing = false) :
+    m_key { key },
     m_value { std::move(value) },
     m_missing { missing }
   {}
@@ -29,16 +160,55 @@ class SamTag {
   SamTag& operator=(SamTag&& other) = default;
   ~SamTag() = default;
 
-  std::string name() const { return m_name; }
+  std::string name() const { return m_key.name(); }
+  SamTagKey key() const { return m_key; }
   TAG_TYPE value() const { return m_value; }
   bool missing() const { return m_missing; }
 
  private:
-  std::string m_name;
+  SamTagKey m_key;
   TAG_TYPE m_value;
   bool m_missing;
 };
 
+/**
+ * @brief offsets of the aux tags of a record, so that reading several tags scans the aux data only once
+ *
+ * Built by the first lookup and kept until invalidate() is called (by the owner of the index, whenever the
+ * record changes). Lookups are safe from several threads: if two threads race to build the index, the loser
+ * simply scans the aux data itself. Tags beyond the first max_indexed_tags (or beyond 64KB into the aux data)
+ * are found by scanning from where the index stops.
+ */
+class SamTagIndex {
+ public:
+  static constexpr uint32_t max_indexed_tags = 8;
+
+  SamTagIndex() : m_keys {}, m_offsets {}, m_size {0}, m_resume_offset {0}, m_state {unbuilt} {}
+  SamTagIndex(const SamTagIndex&) : SamTagIndex {} {}                            ///< @brief copies start with an empty index (it is rebuilt on demand)
+  SamTagIndex& operator=(const SamTagIndex&) { invalidate(); return *this; }
+
+  /**
+   * @brief the aux entry of a tag (pointing at its type character, like bam_aux_get) or nullptr if the record doesn't have it
+   */
+  const uint8_t* find(const bam1_t* record, const SamTagKey key) const;
+
+  void invalidate() { m_state.store(unbuilt, std::memory_order_relaxed); }      ///< @brief forgets the offsets (the record changed)
+
+  static const uint8_t* skip(const uint8_t* entry, const uint8_t* end);          ///< @brief the aux entry following entry (or nullptr if entry is truncated)
+  static const uint8_t* scan(const uint8_t* begin, const uint8_t* end, const SamTagKey key);  ///< @brief linear search for a tag in the aux entries between begin and end
+
+ private:
+  enum : uint8_t { unbuilt, building, built };
+
+  mutable uint16_t m_keys[max_indexed_tags];
+  mutable uint16_t m_offsets[max_indexed_tags];   ///< offsets of the entries from the start of the aux data
+  mutable uint8_t m_size;
+  mutable uint32_t m_resume_offset;               ///< where the tags not in the index start (the end of the aux data if they are all indexed)
+  mutable std::atomic<uint8_t> m_state;
+
+  void build(const uint8_t* aux, const uint8_t* end) const;
+};
+
 }
 
 #endif // gamgee__sam_tag__guard
@@ -4,13 +4,13 @@
 
 namespace gamgee {
 
-SamWriter::SamWriter(const std::string& output_fname, const bool binary) :
-  m_out_file {utils::make_unique_hts_file(open_file(output_fname, binary ? "wb" : "w"))},
+SamWriter::SamWriter(const std::string& output_fname, const bool binary, const uint32_t num_threads) :
+  m_out_file {utils::make_unique_hts_file(open_file(output_fname, binary ? "wb" : "w", num_threads))},
   m_header {nullptr}
 {}
 
-SamWriter::SamWriter(const SamHeader& header, const std::string& output_fname, const bool binary) :
-  m_out_file {utils::make_unique_hts_file(open_file(output_fname, binary ? "wb" : "w"))},
+SamWriter::SamWriter(const SamHeader& header, const std::string& output_fname, const bool binary, const uint32_t num_threads) :
+  m_out_file {utils::make_unique_hts_file(open_file(output_fname, binary ? "wb" : "w", num_threads))},
   m_header{header}
 {
   write_header();
@@ -25,8 +25,11 @@ void SamWriter::add_record(const Sam& body) {
   sam_write1(m_out_file.get(), m_header.m_header.get(), body.m_body.get());
 }
 
-htsFile* SamWriter::open_file(const std::string& output_fname, const std::string& mode) {
-  return hts_open(output_fname.empty() ? "-" : output_fname.c_str(), mode.c_str());
+htsFile* SamWriter::open_file(const std::string& output_fname, const std::string& mode, const uint32_t num_threads) {
+  auto* file = hts_open(output_fname.empty() ? "-" : output_fname.c_str(), mode.c_str());
+  if (file != nullptr && num_threads > 1 && mode == "wb")
+    hts_set_threads(file, int(num_threads));
+  return file;
 }
 
 void SamWriter::write_header() const {
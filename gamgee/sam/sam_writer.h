@@ -25,18 +25,20 @@ class SamWriter {
    * @brief Creates a new SamWriter using the specified output file name
    * @param output_fname file to write to. The default is stdout (as defined by htslib)
    * @param binary whether the output should be in BAM (true) or SAM format (false) 
+   * @param num_threads number of threads compressing the output (BAM only)
    * @note the header is copied and managed internally
    */
-  explicit SamWriter(const std::string& output_fname = "-", const bool binary = true);
+  explicit SamWriter(const std::string& output_fname = "-", const bool binary = true, const uint32_t num_threads = 1);
 
   /**
    * @brief Creates a new SamWriter with the header extracted from a Sam record and using the specified output file name
    * @param header       SamHeader object to make a copy from
    * @param output_fname file to write to. The default is stdout  (as defined by htslib)
    * @param binary whether the output should be in BAM (true) or SAM format (false) 
+   * @param num_threads number of threads compressing the output (BAM only)
    * @note the header is copied and managed internally
    */
-  explicit SamWriter(const SamHeader& header, const std::string& output_fname = "-", const bool binary = true);
+  explicit SamWriter(const SamHeader& header, const std::string& output_fname = "-", const bool binary = true, const uint32_t num_threads = 1);
 
   /**
    * @brief a SamWriter cannot be copied safely, as it is iterating over a stream.
@@ -69,7 +71,7 @@ class SamWriter {
   std::unique_ptr<htsFile, utils::HtsFileDeleter> m_out_file;  ///< the file or stream to write out to ("-" means stdout)
   SamHeader m_header;                   ///< holds a copy of the header throughout the production of the output (necessary for every record that gets added)
 
-  static htsFile* open_file(const std::string& output_fname, const std::string& binary);
+  static htsFile* open_file(const std::string& output_fname, const std::string& binary, const uint32_t num_threads);
   void write_header() const;
 
 };
@@ -0,0 +1,606 @@
+#include "base_encoding.h"
+
+#include "htslib/hts.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace gamgee {
+namespace utils {
+
+/**
+ * @brief the letters of both bases of every possible byte of 4-bit encoded bases
+ */
+static const array<array<char, 2>, 256> build_pair_table() {
+  auto table = array<array<char, 2>, 256>{};
+  for (auto byte = 0u; byte != 256; ++byte)
+    table[byte] = {seq_nt16_str[byte >> 4], seq_nt16_str[byte & 0xf]};
+  return table;
+}
+
+static void decode_bases_scalar(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  static const auto pair_table = build_pair_table();
+  const auto num_pairs = num_bases >> 1;
+  for (auto i = 0u; i != num_pairs; ++i)
+    memcpy(ascii + 2 * i, pair_table[packed[i]].data(), 2);
+  if (num_bases & 1)
+    ascii[num_bases - 1] = seq_nt16_str[packed[num_pairs] >> 4];
+}
+
+static void encode_bases_scalar(const char* ascii, const uint32_t num_bases, uint8_t* packed) {
+  const auto num_pairs = num_bases >> 1;
+  for (auto i = 0u; i != num_pairs; ++i)
+    packed[i] = uint8_t(seq_nt16_table[uint8_t(ascii[2 * i])] << 4 | seq_nt16_table[uint8_t(ascii[2 * i + 1])]);
+  if (num_bases & 1)
+    packed[num_pairs] = uint8_t(seq_nt16_table[uint8_t(ascii[num_bases - 1])] << 4);
+}
+
+/**
+ * @brief the letters of the four bases of every possible byte of 2-bit encoded bases
+ */
+static const array<array<char, 4>, 256> build_quad_table() {
+  auto table = array<array<char, 4>, 256>{};
+  for (auto byte = 0u; byte != 256; ++byte)
+    for (auto base = 0u; base != 4; ++base)
+      table[byte][base] = "ACGT"[byte >> (6 - 2 * base) & 3];
+  return table;
+}
+
+static void decode_2bit_bases_scalar(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  static const auto quad_table = build_quad_table();
+  const auto num_quads = num_bases >> 2;
+  for (auto i = 0u; i != num_quads; ++i)
+    memcpy(ascii + 4 * i, quad_table[packed[i]].data(), 4);
+  for (auto i = num_quads * 4; i != num_bases; ++i)
+    ascii[i] = "ACGT"[packed[num_quads] >> (6 - 2 * (i & 3)) & 3];
+}
+
+#if defined(__SSSE3__) && !defined(__AVX2__)
+
+/**
+ * @brief letters of 16 2-bit encoded bases, given the bytes holding them four times each
+ *
+ * Each copy of a byte keeps one of its bases, where it is: the code of the first two ends up in the high nibble and
+ * the code of the last two in the low one, the other nibble being zero, so the two nibbles or'ed together index a
+ * single 16 entry table (code, code << 2).
+ */
+static inline __m128i decode_16_2bit_bases(const __m128i spread_bytes) {
+  const auto letters = _mm_setr_epi8('A', 'C', 'G', 'T', 'C', 0, 0, 0, 'G', 0, 0, 0, 'T', 0, 0, 0);
+  const auto codes = _mm_and_si128(spread_bytes, _mm_set1_epi32(0x030c30c0));
+  const auto low_nibbles = _mm_set1_epi8(0x0f);
+  const auto index = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(codes, 4), low_nibbles), _mm_and_si128(codes, low_nibbles));
+  return _mm_shuffle_epi8(letters, index);
+}
+
+/**
+ * @brief 4-bit codes of 16 ASCII bases (the seq_nt16_table conversion, without a 256 entry lookup)
+ *
+ * Letters are looked up by their low 5 bits (the same for both cases) in two 16 entry tables, the other
+ * characters between '0' and '?' by their low 4 bits (htslib encodes '0' to '3' as ACGT and '=' as 0) and
+ * everything else is N.
+ */
+static inline __m128i encode_16_bases(const __m128i chars) {
+  //                                        @   A   B  C   D   E   F  G   H   I   J   K   L  M   N   O
+  const auto letters_0_15  = _mm_setr_epi8(15,  1, 14, 2, 13, 15, 15, 4, 11, 15, 15, 12, 15, 3, 15, 15);
+  //                                        P   Q  R  S  T  U  V  W   X   Y   Z   [   \   ]   ^   _
+  const auto letters_16_31 = _mm_setr_epi8(15, 15, 5, 6, 8, 8, 7, 9, 15, 10, 15, 15, 15, 15, 15, 15);
+  const auto index = _mm_and_si128(chars, _mm_set1_epi8(0x0f));
+  const auto upper_half = _mm_cmpeq_epi8(_mm_and_si128(chars, _mm_set1_epi8(0x10)), _mm_set1_epi8(0x10));
+  const auto letter_code = _mm_or_si128(_mm_and_si128(upper_half, _mm_shuffle_epi8(letters_16_31, index)),
+                                        _mm_andnot_si128(upper_half, _mm_shuffle_epi8(letters_0_15, index)));
+  const auto lower_case = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+  const auto is_letter = _mm_cmpeq_epi8(_mm_max_epu8(_mm_min_epu8(lower_case, _mm_set1_epi8('z')), _mm_set1_epi8('a')), lower_case);
+  const auto digits_code = _mm_shuffle_epi8(_mm_setr_epi8(1, 2, 4, 8, 15, 15, 15, 15, 15, 15, 15, 15, 15, 0, 15, 15), index);   // '0'-'3' and '='
+  const auto in_digit_row = _mm_cmpeq_epi8(_mm_and_si128(chars, _mm_set1_epi8(char(0xf0))), _mm_set1_epi8(0x30));
+  const auto other_code = _mm_or_si128(_mm_and_si128(in_digit_row, digits_code), _mm_andnot_si128(in_digit_row, _mm_set1_epi8(15)));
+  return _mm_or_si128(_mm_and_si128(is_letter, letter_code), _mm_andnot_si128(is_letter, other_code));
+}
+
+/**
+ * @brief packs pairs of 4-bit codes into bytes: 16 codes (a 16 bit lane per pair, first code in the high nibble) to 8 bytes
+ */
+static inline __m128i pair_codes(const __m128i codes) {
+  return _mm_maddubs_epi16(codes, _mm_set1_epi16(0x0110));   // first code * 16 + second code
+}
+
+#endif
+
+#if defined(__AVX2__)
+
+static void decode_bases_simd(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  const auto letters = _mm256_setr_epi8('=','A','C','M','G','R','S','V','T','W','Y','H','K','D','B','N',
+                                        '=','A','C','M','G','R','S','V','T','W','Y','H','K','D','B','N');
+  const auto low_nibbles = _mm256_set1_epi8(0x0f);
+  auto i = 0u;
+  for (; i + 64 <= num_bases; i += 64) {
+    const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packed + i / 2));
+    const auto first = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), low_nibbles);
+    const auto second = _mm256_and_si256(bytes, low_nibbles);
+    // interleaving works within each 128 bit lane: bytes 0-7 and 16-23 go to low, 8-15 and 24-31 to high
+    const auto low = _mm256_shuffle_epi8(letters, _mm256_unpacklo_epi8(first, second));
+    const auto high = _mm256_shuffle_epi8(letters, _mm256_unpackhi_epi8(first, second));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ascii + i), _mm256_permute2x128_si256(low, high, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ascii + i + 32), _mm256_permute2x128_si256(low, high, 0x31));
+  }
+  decode_bases_scalar(packed + i / 2, num_bases - i, ascii + i);
+}
+
+/**
+ * @brief 4-bit codes of 32 ASCII bases (the seq_nt16_table conversion, without a 256 entry lookup)
+ *
+ * Letters are looked up by their low 5 bits (the same for both cases) in two 16 entry tables, the other
+ * characters between '0' and '?' by their low 4 bits (htslib encodes '0' to '3' as ACGT and '=' as 0) and
+ * everything else is N.
+ */
+static inline __m256i encode_32_bases(const __m256i chars) {
+  //                                                                    @   A   B  C   D   E   F  G   H   I   J   K   L  M   N   O
+  const auto letters_0_15  = _mm256_broadcastsi128_si256(_mm_setr_epi8(15,  1, 14, 2, 13, 15, 15, 4, 11, 15, 15, 12, 15, 3, 15, 15));
+  //                                                                    P   Q  R  S  T  U  V  W   X   Y   Z   [   \   ]   ^   _
+  const auto letters_16_31 = _mm256_broadcastsi128_si256(_mm_setr_epi8(15, 15, 5, 6, 8, 8, 7, 9, 15, 10, 15, 15, 15, 15, 15, 15));
+  const auto index = _mm256_and_si256(chars, _mm256_set1_epi8(0x0f));
+  const auto upper_half = _mm256_cmpeq_epi8(_mm256_and_si256(chars, _mm256_set1_epi8(0x10)), _mm256_set1_epi8(0x10));
+  const auto letter_code = _mm256_blendv_epi8(_mm256_shuffle_epi8(letters_0_15, index), _mm256_shuffle_epi8(letters_16_31, index), upper_half);
+  const auto lower_case = _mm256_or_si256(chars, _mm256_set1_epi8(0x20));
+  const auto is_letter = _mm256_cmpeq_epi8(_mm256_max_epu8(_mm256_min_epu8(lower_case, _mm256_set1_epi8('z')), _mm256_set1_epi8('a')), lower_case);
+  const auto digits_code = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_setr_epi8(1, 2, 4, 8, 15, 15, 15, 15, 15, 15, 15, 15, 15, 0, 15, 15)), index);   // '0'-'3' and '='
+  const auto in_digit_row = _mm256_cmpeq_epi8(_mm256_and_si256(chars, _mm256_set1_epi8(char(0xf0))), _mm256_set1_epi8(0x30));
+  const auto other_code = _mm256_or_si256(_mm256_and_si256(in_digit_row, digits_code), _mm256_andnot_si256(in_digit_row, _mm256_set1_epi8(15)));
+  return _mm256_or_si256(_mm256_and_si256(is_letter, letter_code), _mm256_andnot_si256(is_letter, other_code));
+}
+
+static void encode_bases_simd(const char* ascii, const uint32_t num_bases, uint8_t* packed) {
+  const auto pair_weights = _mm256_set1_epi16(0x0110);   // first code * 16 + second code
+  auto i = 0u;
+  for (; i + 64 <= num_bases; i += 64) {
+    const auto codes = encode_32_bases(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ascii + i)));
+    const auto more_codes = encode_32_bases(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ascii + i + 32)));
+    const auto pairs = _mm256_maddubs_epi16(codes, pair_weights);
+    const auto more_pairs = _mm256_maddubs_epi16(more_codes, pair_weights);
+    // packing works within each 128 bit lane too, so put the 64 bit quarters back in order
+    const auto bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(pairs, more_pairs), 0xd8);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(packed + i / 2), bytes);
+  }
+  encode_bases_scalar(ascii + i, num_bases - i, packed + i / 2);
+}
+
+/**
+ * @brief letters of 32 2-bit encoded bases, given the bytes holding them four times each (see decode_16_2bit_bases)
+ */
+static inline __m256i decode_32_2bit_bases(const __m256i spread_bytes) {
+  const auto letters = _mm256_broadcastsi128_si256(_mm_setr_epi8('A', 'C', 'G', 'T', 'C', 0, 0, 0, 'G', 0, 0, 0, 'T', 0, 0, 0));
+  const auto codes = _mm256_and_si256(spread_bytes, _mm256_set1_epi32(0x030c30c0));
+  const auto low_nibbles = _mm256_set1_epi8(0x0f);
+  const auto index = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(codes, 4), low_nibbles), _mm256_and_si256(codes, low_nibbles));
+  return _mm256_shuffle_epi8(letters, index);
+}
+
+static void decode_2bit_bases_simd(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  // shuffles work within each 128 bit lane: every byte of a quarter four times in the first lane, of the next quarter in the second
+  const auto spread_0_7 = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+  const auto spread_8_15 = _mm256_add_epi8(spread_0_7, _mm256_set1_epi8(8));
+  auto i = 0u;
+  for (; i + 64 <= num_bases; i += 64) {
+    const auto bytes = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + i / 4)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ascii + i), decode_32_2bit_bases(_mm256_shuffle_epi8(bytes, spread_0_7)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ascii + i + 32), decode_32_2bit_bases(_mm256_shuffle_epi8(bytes, spread_8_15)));
+  }
+  decode_2bit_bases_scalar(packed + i / 4, num_bases - i, ascii + i);
+}
+
+const char* base_encoding_instruction_set() { return "avx2"; }
+
+#elif defined(__SSSE3__)
+
+static void decode_bases_simd(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  const auto letters = _mm_setr_epi8('=','A','C','M','G','R','S','V','T','W','Y','H','K','D','B','N');
+  const auto low_nibbles = _mm_set1_epi8(0x0f);
+  auto i = 0u;
+  for (; i + 32 <= num_bases; i += 32) {
+    const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + i / 2));
+    const auto first = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibbles);
+    const auto second = _mm_and_si128(bytes, low_nibbles);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ascii + i), _mm_shuffle_epi8(letters, _mm_unpacklo_epi8(first, second)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ascii + i + 16), _mm_shuffle_epi8(letters, _mm_unpackhi_epi8(first, second)));
+  }
+  decode_bases_scalar(packed + i / 2, num_bases - i, ascii + i);
+}
+
+static void encode_bases_simd(const char* ascii, const uint32_t num_bases, uint8_t* packed) {
+  auto i = 0u;
+  for (; i + 32 <= num_bases; i += 32) {
+    const auto codes = encode_16_bases(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ascii + i)));
+    const auto more_codes = encode_16_bases(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ascii + i + 16)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i / 2), _mm_packus_epi16(pair_codes(codes), pair_codes(more_codes)));
+  }
+  encode_bases_scalar(ascii + i, num_bases - i, packed + i / 2);
+}
+
+static void decode_2bit_bases_simd(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  const auto spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);   // every byte four times
+  auto i = 0u;
+  for (; i + 64 <= num_bases; i += 64) {
+    auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + i / 4));
+    for (auto j = 0u; j != 64; j += 16, bytes = _mm_srli_si128(bytes, 4))
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ascii + i + j), decode_16_2bit_bases(_mm_shuffle_epi8(bytes, spread)));
+  }
+  decode_2bit_bases_scalar(packed + i / 4, num_bases - i, ascii + i);
+}
+
+const char* base_encoding_instruction_set() { return "ssse3"; }
+
+#else
+
+static void decode_bases_simd(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  decode_bases_scalar(packed, num_bases, ascii);
+}
+
+static void encode_bases_simd(const char* ascii, const uint32_t num_bases, uint8_t* packed) {
+  encode_bases_scalar(ascii, num_bases, packed);
+}
+
+static void decode_2bit_bases_simd(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  decode_2bit_bases_scalar(packed, num_bases, ascii);
+}
+
+const char* base_encoding_instruction_set() { return "scalar"; }
+
+#endif
+
+void decode_bases(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  decode_bases_simd(packed, num_bases, ascii);
+}
+
+void encode_bases(const char* ascii, const uint32_t num_bases, uint8_t* packed) {
+  encode_bases_simd(ascii, num_bases, packed);
+}
+
+void decode_2bit_bases(const uint8_t* packed, const uint32_t num_bases, char* ascii) {
+  decode_2bit_bases_simd(packed, num_bases, ascii);
+}
+
+// the quality conversions only need SSE2, which every x86-64 CPU has
+void encode_phred33(const uint8_t* quals, const uint32_t num_quals, char* ascii) {
+  auto i = 0u;
+#if defined(__SSE2__)
+  for (; i + 16 <= num_quals; i += 16) {
+    const auto values = _mm_min_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quals + i)), _mm_set1_epi8(93));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ascii + i), _mm_add_epi8(values, _mm_set1_epi8(33)));
+  }
+#endif
+  for (; i != num_quals; ++i)
+    ascii[i] = char((quals[i] < 93 ? quals[i] : 93) + 33);
+}
+
+void decode_phred33(const char* ascii, const uint32_t num_quals, uint8_t* quals) {
+  auto i = 0u;
+#if defined(__SSE2__)
+  for (; i + 16 <= num_quals; i += 16) {
+    const auto values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ascii + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(quals + i), _mm_sub_epi8(values, _mm_set1_epi8(33)));
+  }
+#endif
+  for (; i != num_quals; ++i)
+    quals[i] = uint8_t(ascii[i] - 33);
+}
+
+// the Base conversions only need SSE2 too: they widen the codes to (and narrow them from) the int of Base
+#if defined(__SSE2__)
+
+/**
+ * @brief stores 16 codes (one per byte) as Base values
+ */
+static inline void store_16_bases(const __m128i codes, Base* bases) {
+#if defined(__AVX2__)
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(bases), _mm256_cvtepu8_epi32(codes));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(bases + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(codes, 8)));
+#else
+  const auto zero = _mm_setzero_si128();
+  const auto low = _mm_unpacklo_epi8(codes, zero);
+  const auto high = _mm_unpackhi_epi8(codes, zero);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bases), _mm_unpacklo_epi16(low, zero));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bases + 4), _mm_unpackhi_epi16(low, zero));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bases + 8), _mm_unpacklo_epi16(high, zero));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(bases + 12), _mm_unpackhi_epi16(high, zero));
+#endif
+}
+
+/**
+ * @brief loads 16 Base values as codes (one per byte)
+ */
+static inline __m128i load_16_bases(const Base* bases) {
+  const auto words_0_7 = _mm_packs_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bases)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(bases + 4)));
+  const auto words_8_15 = _mm_packs_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bases + 8)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(bases + 12)));
+  return _mm_packus_epi16(words_0_7, words_8_15);
+}
+
+/**
+ * @brief packs each pair of codes of a vector of 16 codes into its 16 bit word: the low byte of every word becomes
+ * the encoded byte of the pair (first base in the high nibble) and the high byte zero
+ */
+static inline __m128i pair_words(const __m128i codes) {
+  return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(codes, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(codes, 8));
+}
+
+#endif
+
+void decode_bases(const uint8_t* packed, const uint32_t num_bases, Base* bases) {
+  auto i = 0u;
+#if defined(__SSE2__)
+  for (; i + 32 <= num_bases; i += 32) {
+    const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + i / 2));
+    const auto first = _mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0f));
+    const auto second = _mm_and_si128(bytes, _mm_set1_epi8(0x0f));
+    store_16_bases(_mm_unpacklo_epi8(first, second), bases + i);
+    store_16_bases(_mm_unpackhi_epi8(first, second), bases + i + 16);
+  }
+#endif
+  for (; i != num_bases; ++i)
+    bases[i] = static_cast<Base>(packed[i >> 1] >> ((~i & 1) << 2) & 0xf);
+}
+
+void encode_bases(const Base* bases, const uint32_t num_bases, uint8_t* packed) {
+  auto i = 0u;
+#if defined(__SSE2__)
+  for (; i + 32 <= num_bases; i += 32) {
+    const auto bytes = _mm_packus_epi16(pair_words(load_16_bases(bases + i)), pair_words(load_16_bases(bases + i + 16)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i / 2), bytes);
+  }
+#endif
+  for (; i + 1 < num_bases; i += 2)
+    packed[i / 2] = uint8_t(static_cast<uint8_t>(bases[i]) << 4 | static_cast<uint8_t>(bases[i + 1]));
+  if (num_bases & 1)
+    packed[num_bases / 2] = uint8_t(static_cast<uint8_t>(bases[num_bases - 1]) << 4);
+}
+
+/**
+ * @brief the complement of every character: A, C, G and T (in either case) are swapped, anything else is kept
+ */
+static const array<char, 256> build_complement_table() {
+  auto table = array<char, 256>{};
+  for (auto c = 0u; c != 256; ++c)
+    table[c] = char(c);
+  for (const auto& pair : {"AT", "CG", "at", "cg"}) {
+    table[uint8_t(pair[0])] = pair[1];
+    table[uint8_t(pair[1])] = pair[0];
+  }
+  return table;
+}
+
+/**
+ * @brief every byte with its bits reversed: the complements of its two 4-bit bases, swapped (the 4-bit codes of the
+ * complementary bases are the reverse of each other, e.g. A=0001 and T=1000)
+ */
+static const array<uint8_t, 256> build_reversed_bits_table() {
+  auto table = array<uint8_t, 256>{};
+  for (auto byte = 0u; byte != 256; ++byte)
+    for (auto bit = 0u; bit != 8; ++bit)
+      table[byte] |= uint8_t((byte >> bit & 1) << (7 - bit));
+  return table;
+}
+
+static const auto complement_table = build_complement_table();
+static const auto reversed_bits_table = build_reversed_bits_table();
+
+// the complement and lookup kernels are written once, on vectors of the widest instruction set available
+#if defined(__AVX2__)
+
+using BaseVector = __m256i;
+static constexpr auto vector_size = 32u;
+
+static inline BaseVector load_vector(const void* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+static inline void store_vector(void* data, const BaseVector bytes) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), bytes); }
+
+/**
+ * @brief the complement of 32 ASCII bases (see complement_table)
+ *
+ * The complement of A, C, G and T is the letter xor a difference that doesn't depend on the case, looked up by
+ * the low 5 bits of the letters in two 16 entry tables.
+ */
+static inline BaseVector complement_vector(const BaseVector chars) {
+  //                                                                 @     A  B     C  D  E  F     G
+  const auto differences_0_15 = _mm256_broadcastsi128_si256(_mm_setr_epi8(0, 0x15, 0, 0x04, 0, 0, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0));
+  //                                                                 P  Q  R  S     T
+  const auto differences_16_31 = _mm256_broadcastsi128_si256(_mm_setr_epi8(0, 0, 0, 0, 0x15, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+  const auto index = _mm256_and_si256(chars, _mm256_set1_epi8(0x0f));
+  const auto upper_half = _mm256_cmpeq_epi8(_mm256_and_si256(chars, _mm256_set1_epi8(0x10)), _mm256_set1_epi8(0x10));
+  const auto difference = _mm256_blendv_epi8(_mm256_shuffle_epi8(differences_0_15, index), _mm256_shuffle_epi8(differences_16_31, index), upper_half);
+  const auto is_letter = _mm256_cmpeq_epi8(_mm256_and_si256(chars, _mm256_set1_epi8(char(0xc0))), _mm256_set1_epi8(0x40));
+  return _mm256_xor_si256(chars, _mm256_and_si256(is_letter, difference));
+}
+
+static inline BaseVector reverse_vector(const BaseVector bytes) {
+  // shuffles work within each 128 bit lane: reverse both, then swap them
+  const auto reversed_lanes = _mm256_shuffle_epi8(bytes, _mm256_broadcastsi128_si256(_mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)));
+  return _mm256_permute4x64_epi64(reversed_lanes, 0x4e);
+}
+
+static inline BaseVector reverse_bits_vector(const BaseVector bytes) {
+  const auto reversed_nibbles = _mm256_broadcastsi128_si256(_mm_setr_epi8(0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf));
+  const auto low_nibbles = _mm256_set1_epi8(0x0f);
+  const auto low = _mm256_shuffle_epi8(reversed_nibbles, _mm256_and_si256(bytes, low_nibbles));
+  const auto high = _mm256_shuffle_epi8(reversed_nibbles, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), low_nibbles));
+  return _mm256_or_si256(_mm256_slli_epi16(low, 4), high);
+}
+
+/**
+ * @brief looks 32 bytes up in the first num_tables 16 entry tables of table, the bytes past them in table[255]
+ */
+static inline BaseVector lookup_vector(const uint8_t* table, const uint32_t num_tables, const BaseVector bytes) {
+  const auto low_nibbles = _mm256_set1_epi8(0x0f);
+  const auto low = _mm256_and_si256(bytes, low_nibbles);
+  const auto high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), low_nibbles);
+  auto result = _mm256_set1_epi8(char(table[255]));
+  for (auto i = 0u; i != num_tables; ++i) {
+    const auto entries = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table + 16 * i)));
+    result = _mm256_blendv_epi8(result, _mm256_shuffle_epi8(entries, low), _mm256_cmpeq_epi8(high, _mm256_set1_epi8(char(i))));
+  }
+  return result;
+}
+
+#elif defined(__SSSE3__)
+
+using BaseVector = __m128i;
+static constexpr auto vector_size = 16u;
+
+static inline BaseVector load_vector(const void* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+static inline void store_vector(void* data, const BaseVector bytes) { _mm_storeu_si128(reinterpret_cast<__m128i*>(data), bytes); }
+
+/**
+ * @brief the complement of 16 ASCII bases (see complement_table)
+ *
+ * The complement of A, C, G and T is the letter xor a difference that doesn't depend on the case, looked up by
+ * the low 5 bits of the letters in two 16 entry tables.
+ */
+static inline BaseVector complement_vector(const BaseVector chars) {
+  //                                             @     A  B     C  D  E  F     G
+  const auto differences_0_15 = _mm_setr_epi8(0, 0x15, 0, 0x04, 0, 0, 0, 0x04, 0, 0, 0, 0, 0, 0, 0, 0);
+  //                                              P  Q  R  S     T
+  const auto differences_16_31 = _mm_setr_epi8(0, 0, 0, 0, 0x15, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const auto index = _mm_and_si128(chars, _mm_set1_epi8(0x0f));
+  const auto upper_half = _mm_cmpeq_epi8(_mm_and_si128(chars, _mm_set1_epi8(0x10)), _mm_set1_epi8(0x10));
+  const auto difference = _mm_or_si128(_mm_and_si128(upper_half, _mm_shuffle_epi8(differences_16_31, index)),
+                                       _mm_andnot_si128(upper_half, _mm_shuffle_epi8(differences_0_15, index)));
+  const auto is_letter = _mm_cmpeq_epi8(_mm_and_si128(chars, _mm_set1_epi8(char(0xc0))), _mm_set1_epi8(0x40));
+  return _mm_xor_si128(chars, _mm_and_si128(is_letter, difference));
+}
+
+static inline BaseVector reverse_vector(const BaseVector bytes) {
+  return _mm_shuffle_epi8(bytes, _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+static inline BaseVector reverse_bits_vector(const BaseVector bytes) {
+  const auto reversed_nibbles = _mm_setr_epi8(0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+  const auto low_nibbles = _mm_set1_epi8(0x0f);
+  const auto low = _mm_shuffle_epi8(reversed_nibbles, _mm_and_si128(bytes, low_nibbles));
+  const auto high = _mm_shuffle_epi8(reversed_nibbles, _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibbles));
+  return _mm_or_si128(_mm_slli_epi16(low, 4), high);
+}
+
+/**
+ * @brief looks 16 bytes up in the first num_tables 16 entry tables of table, the bytes past them in table[255]
+ */
+static inline BaseVector lookup_vector(const uint8_t* table, const uint32_t num_tables, const BaseVector bytes) {
+  const auto low_nibbles = _mm_set1_epi8(0x0f);
+  const auto low = _mm_and_si128(bytes, low_nibbles);
+  const auto high = _mm_and_si128(_mm_srli_epi16(bytes, 4), low_nibbles);
+  auto result = _mm_set1_epi8(char(table[255]));
+  for (auto i = 0u; i != num_tables; ++i) {
+    const auto entries = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table + 16 * i));
+    const auto in_table = _mm_cmpeq_epi8(high, _mm_set1_epi8(char(i)));
+    result = _mm_or_si128(_mm_and_si128(in_table, _mm_shuffle_epi8(entries, low)), _mm_andnot_si128(in_table, result));
+  }
+  return result;
+}
+
+#endif
+
+void complement_bases(const char* ascii, const uint32_t num_bases, char* complement) {
+  auto i = 0u;
+#if defined(__SSSE3__)
+  for (; i + vector_size <= num_bases; i += vector_size)
+    store_vector(complement + i, complement_vector(load_vector(ascii + i)));
+#endif
+  for (; i != num_bases; ++i)
+    complement[i] = complement_table[uint8_t(ascii[i])];
+}
+
+void reverse_complement_bases(const char* ascii, const uint32_t num_bases, char* reverse_complement) {
+  auto i = 0u;
+#if defined(__SSSE3__)
+  for (; i + vector_size <= num_bases; i += vector_size)
+    store_vector(reverse_complement + num_bases - i - vector_size, reverse_vector(complement_vector(load_vector(ascii + i))));
+#endif
+  for (; i != num_bases; ++i)
+    reverse_complement[num_bases - i - 1] = complement_table[uint8_t(ascii[i])];
+}
+
+void reverse_complement_bases(char* ascii, const uint32_t num_bases) {
+  auto left = 0u;
+  auto right = num_bases;
+#if defined(__SSSE3__)
+  for (; right - left >= 2 * vector_size; left += vector_size, right -= vector_size) {  // swaps a vector from each end
+    const auto front = load_vector(ascii + left);
+    const auto back = load_vector(ascii + right - vector_size);
+    store_vector(ascii + left, reverse_vector(complement_vector(back)));
+    store_vector(ascii + right - vector_size, reverse_vector(complement_vector(front)));
+  }
+#endif
+  for (; right - left >= 2; ++left, --right) {
+    const auto front = ascii[left];
+    ascii[left] = complement_table[uint8_t(ascii[right - 1])];
+    ascii[right - 1] = complement_table[uint8_t(front)];
+  }
+  if (left != right)   // the middle base
+    ascii[left] = complement_table[uint8_t(ascii[left])];
+}
+
+/**
+ * @brief with an odd number of bases, the reverse complement of all the bytes starts with the complement of the
+ * padding nibble: moves every base a nibble forward (which leaves the last low nibble zeroed)
+ */
+static void drop_first_nibble(uint8_t* packed, const uint32_t num_bytes) {
+  for (auto i = 0u; i + 1 < num_bytes; ++i)
+    packed[i] = uint8_t(packed[i] << 4 | packed[i + 1] >> 4);
+  if (num_bytes != 0)
+    packed[num_bytes - 1] = uint8_t(packed[num_bytes - 1] << 4);
+}
+
+void reverse_complement_encoded_bases(const uint8_t* packed, const uint32_t num_bases, uint8_t* reverse_complement) {
+  const auto num_bytes = (num_bases + 1) / 2;
+  auto i = 0u;
+#if defined(__SSSE3__)
+  for (; i + vector_size <= num_bytes; i += vector_size)
+    store_vector(reverse_complement + num_bytes - i - vector_size, reverse_vector(reverse_bits_vector(load_vector(packed + i))));
+#endif
+  for (; i != num_bytes; ++i)
+    reverse_complement[num_bytes - i - 1] = reversed_bits_table[packed[i]];
+  if (num_bases & 1)
+    drop_first_nibble(reverse_complement, num_bytes);
+}
+
+void reverse_complement_encoded_bases(uint8_t* packed, const uint32_t num_bases) {
+  const auto num_bytes = (num_bases + 1) / 2;
+  auto left = 0u;
+  auto right = num_bytes;
+#if defined(__SSSE3__)
+  for (; right - left >= 2 * vector_size; left += vector_size, right -= vector_size) {  // swaps a vector from each end
+    const auto front = load_vector(packed + left);
+    const auto back = load_vector(packed + right - vector_size);
+    store_vector(packed + left, reverse_vector(reverse_bits_vector(back)));
+    store_vector(packed + right - vector_size, reverse_vector(reverse_bits_vector(front)));
+  }
+#endif
+  for (; right - left >= 2; ++left, --right) {
+    const auto front = packed[left];
+    packed[left] = reversed_bits_table[packed[right - 1]];
+    packed[right - 1] = reversed_bits_table[front];
+  }
+  if (left != right)
+    packed[left] = reversed_bits_table[packed[left]];
+  if (num_bases & 1)
+    drop_first_nibble(packed, num_bytes);
+}
+
+void lookup_quals(const uint8_t* table, const uint32_t table_end, const uint8_t* quals, const uint32_t num_quals, uint8_t* result) {
+  auto i = 0u;
+#if defined(__SSSE3__)
+  const auto num_tables = (table_end + 15) / 16;
+  for (; i + vector_size <= num_quals; i += vector_size)
+    store_vector(result + i, lookup_vector(table, num_tables, load_vector(quals + i)));
+#endif
+  for (; i != num_quals; ++i)
+    result[i] = table[quals[i]];
+}
+
+}
+}
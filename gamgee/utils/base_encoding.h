@@ -0,0 +1,158 @@
+#ifndef gamgee__base_encoding__guard
+#define gamgee__base_encoding__guard
+
+#include <cstdint>
+
+namespace gamgee {
+
+enum class Base;
+
+namespace utils {
+
+/**
+ * @brief converts 4-bit encoded bases (two per byte, first base in the high nibble, as in BAM records) to
+ * their ASCII letters
+ *
+ * Every code is converted, using the IUPAC letters of the BAM specification ("=ACMGRSVTWYHKDBN").
+ *
+ * @param packed the encoded bases ((num_bases + 1) / 2 bytes)
+ * @param num_bases number of bases to convert
+ * @param ascii where the num_bases letters go (no terminator is written)
+ */
+void decode_bases(const uint8_t* packed, const uint32_t num_bases, char* ascii);
+
+/**
+ * @brief converts ASCII bases to their 4-bit encoding (two per byte, first base in the high nibble)
+ *
+ * Same conversion as htslib's seq_nt16_table: letters are case insensitive, U is encoded as T, '=' as 0, '0' to
+ * '3' as ACGT and anything else that isn't an IUPAC code as N. If num_bases is odd, the low nibble of the last
+ * byte is zero.
+ *
+ * @param ascii the bases to convert
+ * @param num_bases number of bases to convert
+ * @param packed where the (num_bases + 1) / 2 encoded bytes go
+ */
+void encode_bases(const char* ascii, const uint32_t num_bases, uint8_t* packed);
+
+/**
+ * @brief converts 4-bit encoded bases (two per byte, first base in the high nibble, as in BAM records) to Base
+ * values, a whole vector of bases at a time
+ *
+ * The Base of every code is the code itself (see Base), so the IUPAC codes other than A, C, G, T and N come out as
+ * unnamed Base values.
+ *
+ * @param packed the encoded bases ((num_bases + 1) / 2 bytes)
+ * @param num_bases number of bases to convert
+ * @param bases where the num_bases values go
+ */
+void decode_bases(const uint8_t* packed, const uint32_t num_bases, Base* bases);
+
+/**
+ * @brief converts Base values to their 4-bit encoding (two per byte, first base in the high nibble), a whole
+ * vector of bases at a time
+ *
+ * @param bases the bases to convert (4-bit codes, as all the Base values are)
+ * @param num_bases number of bases to convert
+ * @param packed where the (num_bases + 1) / 2 encoded bytes go (if num_bases is odd, the low nibble of the last
+ *        byte is zero)
+ */
+void encode_bases(const Base* bases, const uint32_t num_bases, uint8_t* packed);
+
+/**
+ * @brief converts 2-bit encoded bases (A=0, C=1, G=2, T=3, four per byte, first base in the high bits) to their
+ * upper case ASCII letters
+ *
+ * @param packed the encoded bases ((num_bases + 3) / 4 bytes)
+ * @param num_bases number of bases to convert
+ * @param ascii where the num_bases letters go (no terminator is written)
+ */
+void decode_2bit_bases(const uint8_t* packed, const uint32_t num_bases, char* ascii);
+
+/**
+ * @brief the complement of ASCII bases (A and T, C and G are swapped, in either case, and anything else is kept)
+ *
+ * @param ascii the bases
+ * @param num_bases number of bases
+ * @param complement where the num_bases complementary bases go (can be ascii, to complement them in place)
+ */
+void complement_bases(const char* ascii, const uint32_t num_bases, char* complement);
+
+/**
+ * @brief the reverse complement of ASCII bases (see complement_bases())
+ *
+ * @param ascii the bases
+ * @param num_bases number of bases
+ * @param reverse_complement where the num_bases bases of the reverse complement go (must not overlap ascii)
+ */
+void reverse_complement_bases(const char* ascii, const uint32_t num_bases, char* reverse_complement);
+
+/**
+ * @brief turns ASCII bases into their reverse complement in place (see complement_bases())
+ */
+void reverse_complement_bases(char* ascii, const uint32_t num_bases);
+
+/**
+ * @brief the reverse complement of 4-bit encoded bases (two per byte, first base in the high nibble, as in BAM
+ * records)
+ *
+ * Every IUPAC code is turned into its complement (e.g. R into Y, N stays N). If num_bases is odd, the low nibble
+ * of the last byte is zero.
+ *
+ * @param packed the encoded bases ((num_bases + 1) / 2 bytes)
+ * @param num_bases number of bases
+ * @param reverse_complement where the (num_bases + 1) / 2 encoded bytes go (must not overlap packed)
+ */
+void reverse_complement_encoded_bases(const uint8_t* packed, const uint32_t num_bases, uint8_t* reverse_complement);
+
+/**
+ * @brief turns 4-bit encoded bases into their reverse complement in place (see the other overload)
+ */
+void reverse_complement_encoded_bases(uint8_t* packed, const uint32_t num_bases);
+
+/**
+ * @brief converts base qualities to their Phred+33 ASCII encoding (as in FASTQ and SAM files)
+ *
+ * Qualities above 93 (including the 0xff of missing qualities) are capped at 93 ('~'), the highest quality
+ * the encoding can represent.
+ *
+ * @param quals the qualities to convert
+ * @param num_quals number of qualities to convert
+ * @param ascii where the num_quals characters go (no terminator is written)
+ */
+void encode_phred33(const uint8_t* quals, const uint32_t num_quals, char* ascii);
+
+/**
+ * @brief converts Phred+33 ASCII qualities (as in FASTQ and SAM files) to base qualities
+ *
+ * @param ascii the characters to convert (not validated: characters below '!' wrap around)
+ * @param num_quals number of qualities to convert
+ * @param quals where the num_quals qualities go
+ */
+void decode_phred33(const char* ascii, const uint32_t num_quals, uint8_t* quals);
+
+/**
+ * @brief maps base qualities through a lookup table (e.g. to bin them, see QualityBinning)
+ *
+ * The vectorized versions look the qualities up 16 table entries at a time, so they are fastest when the values
+ * of the high qualities are all the same (as with binning) and table_end is small.
+ *
+ * @param table the value of every quality (256 entries)
+ * @param table_end qualities from table_end on all have the value table[255] (256 if the table has no such tail)
+ * @param quals the qualities to map
+ * @param num_quals number of qualities to map
+ * @param result where the num_quals values go (can be quals, to map them in place)
+ */
+void lookup_quals(const uint8_t* table, const uint32_t table_end, const uint8_t* quals, const uint32_t num_quals, uint8_t* result);
+
+/**
+ * @brief name of the instruction set the base encoding functions were compiled for ("avx2", "ssse3" or "scalar")
+ *
+ * The vectorized versions are used when the library is compiled for a CPU that has them (e.g. with
+ * -DGAMGEE_NATIVE_ARCH=ON or -march=haswell).
+ */
+const char* base_encoding_instruction_set();
+
+}
+}
+
+#endif // gamgee__base_encoding__guard
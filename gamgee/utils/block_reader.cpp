@@ -0,0 +1,25 @@
+#include "block_reader.h"
+#include "gzip_block_reader.h"
+
+using namespace std;
+
+namespace gamgee {
+namespace utils {
+
+StreamBlockReader::StreamBlockReader(shared_ptr<istream> input) :
+  m_input {move(input)}
+{}
+
+size_t StreamBlockReader::read(char* destination, const size_t size) {
+  m_input->read(destination, size);
+  return size_t(m_input->gcount());
+}
+
+unique_ptr<BlockReader> make_block_reader(shared_ptr<istream> input, const uint32_t num_threads) {
+  if (input->peek() == 0x1f)
+    return make_unique<GzipBlockReader>(move(input), num_threads);
+  return make_unique<StreamBlockReader>(move(input));
+}
+
+}
+}
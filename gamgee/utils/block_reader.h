@@ -0,0 +1,56 @@
+#ifndef gamgee__block_reader__guard
+#define gamgee__block_reader__guard
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+
+namespace gamgee {
+namespace utils {
+
+/**
+ * @brief a source of input data read in large blocks (e.g. by the FastqParser), hiding whether the data is
+ * decompressed on the way
+ */
+class BlockReader {
+ public:
+  virtual ~BlockReader() = default;
+
+  /**
+   * @brief copies the next bytes of the input into destination
+   * @param destination where the bytes go
+   * @param size number of bytes wanted
+   * @return number of bytes copied: size, unless the end of the input was reached
+   */
+  virtual std::size_t read(char* destination, const std::size_t size) = 0;
+};
+
+/**
+ * @brief reads an uncompressed stream
+ */
+class StreamBlockReader : public BlockReader {
+ public:
+  explicit StreamBlockReader(std::shared_ptr<std::istream> input);
+  std::size_t read(char* destination, const std::size_t size) override;
+
+ private:
+  std::shared_ptr<std::istream> m_input;  ///< the stream being read
+};
+
+/**
+ * @brief creates the block reader for a stream: a GzipBlockReader if the stream is gzip (or BGZF) compressed, a
+ * StreamBlockReader otherwise
+ *
+ * Compression is detected by the first byte of the stream (0x1f, the first byte of the gzip magic number, can't
+ * start a text file), which is peeked at, so that this works on pipes too.
+ *
+ * @param input the stream to read
+ * @param num_threads number of threads decompressing BGZF input (see GzipBlockReader)
+ */
+std::unique_ptr<BlockReader> make_block_reader(std::shared_ptr<std::istream> input, const uint32_t num_threads = 1);
+
+}
+}
+
+#endif // gamgee__block_reader__guard
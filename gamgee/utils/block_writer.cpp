@@ -0,0 +1,36 @@
+#include "block_writer.h"
+#include "gzip_block_writer.h"
+
+#include "../exceptions.h"
+
+using namespace std;
+
+namespace gamgee {
+namespace utils {
+
+StreamBlockWriter::StreamBlockWriter(shared_ptr<ostream> output) :
+  m_output {move(output)}
+{}
+
+void StreamBlockWriter::write(string block) {
+  if (!m_output->write(block.data(), streamsize(block.size())))
+    throw OutputException{"the output stream failed"};
+}
+
+void StreamBlockWriter::flush() {
+  if (!m_output->flush())
+    throw OutputException{"the output stream failed"};
+}
+
+void StreamBlockWriter::finish() {
+  flush();
+}
+
+unique_ptr<BlockWriter> make_block_writer(shared_ptr<ostream> output, const Compression compression, const uint32_t num_threads) {
+  if (compression == Compression::none)
+    return make_unique<StreamBlockWriter>(move(output));
+  return make_unique<GzipBlockWriter>(move(output), compression == Compression::bgzf, num_threads);
+}
+
+}
+}
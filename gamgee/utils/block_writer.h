@@ -0,0 +1,75 @@
+#ifndef gamgee__block_writer__guard
+#define gamgee__block_writer__guard
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace gamgee {
+namespace utils {
+
+/**
+ * @brief compression of the output of a writer
+ */
+enum class Compression {
+  none,   ///< plain text
+  gzip,   ///< a single gzip member, readable by any gzip tool
+  bgzf    ///< a series of independent gzip blocks (as written by bgzip and htslib), also readable by any gzip tool
+};
+
+/**
+ * @brief a destination of output data written in large blocks (e.g. by the FastqWriter), hiding whether the data
+ * is compressed on the way
+ */
+class BlockWriter {
+ public:
+  virtual ~BlockWriter() = default;
+
+  /**
+   * @brief appends a block of data to the output
+   * @param block the data (taken over by the writer, which may hold on to it until it is written)
+   */
+  virtual void write(std::string block) = 0;
+
+  /**
+   * @brief waits until all the data written so far has reached the output stream, and flushes it
+   */
+  virtual void flush() = 0;
+
+  /**
+   * @brief writes out all the data and ends the output (e.g. with the trailer of a compressed stream), then flushes
+   * it. Nothing can be written afterwards.
+   * @throws OutputException if the output stream fails: unlike the destructor, this reports a failed final write
+   */
+  virtual void finish() = 0;
+};
+
+/**
+ * @brief writes to an uncompressed stream
+ */
+class StreamBlockWriter : public BlockWriter {
+ public:
+  explicit StreamBlockWriter(std::shared_ptr<std::ostream> output);
+  void write(std::string block) override;
+  void flush() override;
+  void finish() override;
+
+ private:
+  std::shared_ptr<std::ostream> m_output;  ///< the stream being written
+};
+
+/**
+ * @brief creates the block writer for a stream: a GzipBlockWriter for compressed output, a StreamBlockWriter
+ * otherwise
+ *
+ * @param output the stream to write
+ * @param compression the compression of the output
+ * @param num_threads number of threads compressing the output (see GzipBlockWriter)
+ */
+std::unique_ptr<BlockWriter> make_block_writer(std::shared_ptr<std::ostream> output, const Compression compression = Compression::none, const uint32_t num_threads = 1);
+
+}
+}
+
+#endif // gamgee__block_writer__guard
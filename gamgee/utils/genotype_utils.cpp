@@ -12,12 +12,12 @@ template<class TYPE>
 bool allele_missing(const uint8_t* data_ptr, const uint32_t allele_index, const TYPE missing);
 
 template<class TYPE>
-vector<int32_t> allele_keys(const std::shared_ptr<bcf1_t>& body,
+vector<int32_t> allele_keys(const utils::VariantHandle& body,
     const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr,
     const TYPE missing, const TYPE vector_end);
 
 template<class TYPE>
-vector<string> allele_strings(const std::shared_ptr<bcf1_t>& body,
+vector<string> allele_strings(const utils::VariantHandle& body,
     const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr,
     const TYPE missing, const TYPE vector_end);
 
@@ -41,7 +41,7 @@ bool allele_missing(const uint8_t* data_ptr, const uint32_t allele_index, const
   return !(p[allele_index]>>1) || p[allele_index] == missing;
 }
 
-vector<int32_t> allele_keys(const std::shared_ptr<bcf1_t>& body,
+vector<int32_t> allele_keys(const utils::VariantHandle& body,
     const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr) {
   switch (format_ptr->type) {
   case BCF_BT_INT8:
@@ -56,7 +56,7 @@ vector<int32_t> allele_keys(const std::shared_ptr<bcf1_t>& body,
 }
 
 template<class TYPE>
-vector<int32_t> allele_keys(const std::shared_ptr<bcf1_t>& body,
+vector<int32_t> allele_keys(const utils::VariantHandle& body,
     const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr,
     const TYPE missing, const TYPE vector_end) {
   const auto p = reinterpret_cast<const TYPE*>(data_ptr);
@@ -81,7 +81,7 @@ vector<int32_t> allele_keys(const std::shared_ptr<bcf1_t>& body,
   return results;
 }
 
-vector<string> allele_strings(const std::shared_ptr<bcf1_t>& body,
+vector<string> allele_strings(const utils::VariantHandle& body,
     const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr) {
   switch (format_ptr->type) {
   case BCF_BT_INT8:
@@ -96,7 +96,7 @@ vector<string> allele_strings(const std::shared_ptr<bcf1_t>& body,
 }
 
 template<class TYPE>
-vector<string> allele_strings(const std::shared_ptr<bcf1_t>& body,
+vector<string> allele_strings(const utils::VariantHandle& body,
     const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr,
     const TYPE missing, const TYPE vector_end) {
   const auto p = reinterpret_cast<const TYPE*>(data_ptr);
@@ -123,7 +123,7 @@ vector<string> allele_strings(const std::shared_ptr<bcf1_t>& body,
 }
 
 string allele_key_to_string(
-    const std::shared_ptr<bcf1_t>& body, const int32_t allele_int) {
+    const utils::VariantHandle& body, const int32_t allele_int) {
   if (allele_int == missing_values::int32) {
     return missing_values::string_empty;
   }
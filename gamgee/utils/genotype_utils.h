@@ -81,7 +81,7 @@ using namespace std;
    * @return The genotype allele keys.
    * @warning Only int8_t GT fields have been tested.
    */
-  vector<int32_t> allele_keys(const std::shared_ptr<bcf1_t>& body, const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr);
+  vector<int32_t> allele_keys(const utils::VariantHandle& body, const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr);
 
   /**
    * @brief Returns the genotype allele strings.
@@ -91,7 +91,7 @@ using namespace std;
    * @return The genotype allele strings.
    * @warning Only int8_t GT fields have been tested.
    */
-  vector<string> allele_strings(const std::shared_ptr<bcf1_t>& body,
+  vector<string> allele_strings(const utils::VariantHandle& body,
       const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr); // returns the actual alleles (e.g. A/T or TG/C or T/T/C or T/T/T/T/T ... )
 
   /**
@@ -101,7 +101,7 @@ using namespace std;
    * @return The genotype allele string from this line.
    * @warning Only int8_t GT fields have been tested.
    */
-  string allele_key_to_string(const std::shared_ptr<bcf1_t>& body, const int32_t key_index);
+  string allele_key_to_string(const utils::VariantHandle& body, const int32_t key_index);
 }
 
 }
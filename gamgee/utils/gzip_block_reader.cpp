@@ -0,0 +1,293 @@
+#include "gzip_block_reader.h"
+
+#include "../exceptions.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace gamgee {
+namespace utils {
+
+static constexpr size_t bgzf_header_size = 18;          ///< gzip header with the BC extra field holding the block size
+static constexpr size_t bgzf_footer_size = 8;           ///< crc32 and size of the uncompressed data
+static constexpr size_t bgzf_batch_size = 1 << 19;      ///< compressed bytes inflated by one task (about 2MB once inflated)
+static constexpr size_t stream_input_size = 1 << 18;    ///< compressed bytes read at a time from non BGZF input
+static constexpr size_t stream_block_size = 1 << 20;    ///< decompressed bytes per block of non BGZF input
+
+static uint32_t load_le32(const unsigned char* bytes) {
+  return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+}
+
+/**
+ * @brief whether a gzip member header is the header of a BGZF block (the same check htslib does)
+ */
+static bool is_bgzf_header(const string& header) {
+  const auto bytes = reinterpret_cast<const unsigned char*>(header.data());
+  return header.size() == bgzf_header_size &&
+         bytes[0] == 31 && bytes[1] == 139 && bytes[2] == 8 && (bytes[3] & 4) &&   // gzip, deflate, with extra fields
+         bytes[10] == 6 && bytes[11] == 0 &&                                      // the only extra field is...
+         bytes[12] == 'B' && bytes[13] == 'C' && bytes[14] == 2 && bytes[15] == 0; // ...BC, holding the block size
+}
+
+/**
+ * @brief a zlib inflate stream, ended when it goes out of scope
+ */
+class InflateStream {
+ public:
+  explicit InflateStream(const int window_bits) : m_stream {} {
+    if (inflateInit2(&m_stream, window_bits) != Z_OK)
+      throw DecompressionException{"could not initialize zlib"};
+  }
+  ~InflateStream() { inflateEnd(&m_stream); }
+  InflateStream(const InflateStream&) = delete;
+  InflateStream& operator=(const InflateStream&) = delete;
+
+  z_stream* operator->() { return &m_stream; }
+  z_stream* get() { return &m_stream; }
+
+ private:
+  z_stream m_stream;
+};
+
+/**
+ * @brief inflates a series of complete BGZF blocks, checking their sizes and checksums
+ */
+static string inflate_bgzf_blocks(const string& blocks) {
+  auto inflated = string{};
+  auto stream = InflateStream{-15};  // raw deflate data: the gzip header and footer are handled here
+  for (auto position = size_t{0}; position != blocks.size(); ) {
+    const auto block = reinterpret_cast<const unsigned char*>(blocks.data()) + position;
+    const auto block_size = size_t(block[16] | block[17] << 8) + 1;
+    const auto footer = block + block_size - bgzf_footer_size;
+    const auto inflated_size = load_le32(footer + 4);
+    const auto offset = inflated.size();
+    inflated.resize(offset + inflated_size);
+    inflateReset(stream.get());
+    stream->next_in = const_cast<unsigned char*>(block + bgzf_header_size);
+    stream->avail_in = uInt(block_size - bgzf_header_size - bgzf_footer_size);
+    stream->next_out = reinterpret_cast<unsigned char*>(&inflated[0] + offset);
+    stream->avail_out = uInt(inflated_size);
+    if (inflate(stream.get(), Z_FINISH) != Z_STREAM_END || stream->avail_out != 0)
+      throw DecompressionException{"corrupted BGZF block"};
+    if (crc32(crc32(0, nullptr, 0), reinterpret_cast<const unsigned char*>(inflated.data()) + offset, inflated_size) != load_le32(footer))
+      throw DecompressionException{"BGZF block checksum mismatch"};
+    position += block_size;
+  }
+  return inflated;
+}
+
+template<class VALUE>
+static future<VALUE> ready_future(VALUE value) {
+  auto promise = std::promise<VALUE>{};
+  promise.set_value(move(value));
+  return promise.get_future();
+}
+
+GzipBlockReader::GzipBlockReader(shared_ptr<istream> input, const uint32_t num_threads) :
+  m_input {move(input)},
+  m_pool {num_threads > 1 ? make_unique<ThreadPool>(num_threads) : nullptr},
+  m_max_pending_blocks {2 * size_t{max(num_threads, 1u)} + 2},
+  m_pending {},
+  m_mutex {},
+  m_block_available {},
+  m_space_available {},
+  m_decompressed_all {false},
+  m_stopping {false},
+  m_block {},
+  m_block_position {0},
+  m_decompressor {}
+{
+  m_decompressor = thread{[this]{ decompress(); }};
+}
+
+GzipBlockReader::~GzipBlockReader() {
+  {
+    lock_guard<mutex> lock {m_mutex};
+    m_stopping = true;
+  }
+  m_space_available.notify_all();
+  m_decompressor.join();
+}
+
+size_t GzipBlockReader::read(char* destination, const size_t size) {
+  auto copied = size_t{0};
+  while (copied != size) {
+    if (m_block_position == m_block.size()) {
+      if (!next_block())
+        break;
+      continue;
+    }
+    const auto bytes = min(size - copied, m_block.size() - m_block_position);
+    memcpy(destination + copied, m_block.data() + m_block_position, bytes);
+    m_block_position += bytes;
+    copied += bytes;
+  }
+  return copied;
+}
+
+/**
+ * @brief waits for the next decompressed block
+ * @return false if there are no more blocks
+ */
+bool GzipBlockReader::next_block() {
+  auto block = future<string>{};
+  {
+    unique_lock<mutex> lock {m_mutex};
+    m_block_available.wait(lock, [this]{ return !m_pending.empty() || m_decompressed_all; });
+    if (m_pending.empty())
+      return false;
+    block = move(m_pending.front());
+    m_pending.pop_front();
+  }
+  m_space_available.notify_one();
+  m_block = block.get();   // rethrows decompression errors
+  m_block_position = 0;
+  return true;
+}
+
+/**
+ * @brief queues a block for read(), waiting for room in the queue
+ * @return false if the reader is being destroyed
+ */
+bool GzipBlockReader::push(future<string> block) {
+  {
+    unique_lock<mutex> lock {m_mutex};
+    m_space_available.wait(lock, [this]{ return m_stopping || m_pending.size() < m_max_pending_blocks; });
+    if (m_stopping)
+      return false;
+    m_pending.push_back(move(block));
+  }
+  m_block_available.notify_one();
+  return true;
+}
+
+/**
+ * @brief the background thread: decompresses the whole input (BGZF blocks first, then any other gzip data)
+ */
+void GzipBlockReader::decompress() {
+  try {
+    auto header = read_input(bgzf_header_size);
+    const auto bgzf = is_bgzf_header(header);
+    if (decompress_bgzf(header) && !header.empty())
+      inflate_stream(move(header), bgzf);
+  }
+  catch (...) {
+    auto failure = std::promise<string>{};
+    failure.set_exception(current_exception());
+    push(failure.get_future());
+  }
+  {
+    lock_guard<mutex> lock {m_mutex};
+    m_decompressed_all = true;
+  }
+  m_block_available.notify_all();
+}
+
+/**
+ * @brief reads BGZF blocks and queues them for inflation in batches, until the input ends or a gzip member that
+ * isn't a BGZF block shows up
+ * @param header the header of the first block (replaced by the bytes read after the last block)
+ * @return false if the reader is being destroyed
+ */
+bool GzipBlockReader::decompress_bgzf(string& header) {
+  auto batch = string{};
+  const auto queue_batch = [this, &batch] {
+    if (batch.empty())
+      return true;
+    auto queued = m_pool ? push(m_pool->submit([blocks = move(batch)]{ return inflate_bgzf_blocks(blocks); }))
+                         : push(ready_future(inflate_bgzf_blocks(batch)));
+    batch.clear();
+    return queued;
+  };
+  while (is_bgzf_header(header)) {
+    const auto block_size = size_t(uint8_t(header[16]) | uint8_t(header[17]) << 8) + 1;
+    if (block_size < bgzf_header_size + bgzf_footer_size)
+      throw DecompressionException{"invalid BGZF block size"};
+    const auto offset = batch.size();
+    batch.resize(offset + block_size);
+    memcpy(&batch[offset], header.data(), bgzf_header_size);
+    m_input->read(&batch[offset + bgzf_header_size], block_size - bgzf_header_size);
+    if (size_t(m_input->gcount()) != block_size - bgzf_header_size)
+      throw DecompressionException{"truncated BGZF block"};
+    if (batch.size() >= bgzf_batch_size && !queue_batch())
+      return false;
+    header = read_input(bgzf_header_size);
+  }
+  return queue_batch();
+}
+
+/**
+ * @brief inflates gzip (or zlib) data with a single stream, including any number of concatenated members
+ *
+ * Like gzip (and zlib's gzread()), anything after a complete member that doesn't start another gzip member (e.g.
+ * zero padding) is ignored.
+ *
+ * @param prefix the first bytes of the data, already read from the input
+ * @param after_member whether the prefix follows a complete member (the BGZF blocks before it)
+ * @return false if the reader is being destroyed
+ */
+bool GzipBlockReader::inflate_stream(string prefix, const bool after_member) {
+  auto stream = InflateStream{15 + 32};  // gzip or zlib header, detected automatically
+  auto input = move(prefix);
+  stream->next_in = reinterpret_cast<unsigned char*>(&input[0]);
+  stream->avail_in = uInt(input.size());
+  auto output = string(stream_block_size, '\0');
+  auto produced = size_t{0};
+  auto in_member = false;
+  auto ended_member = after_member;   // whether the data so far ends with a complete member
+  while (true) {
+    if (stream->avail_in < (ended_member ? 2u : 1u)) {   // the two bytes of the gzip magic number after a member
+      const auto more = read_input(stream_input_size);
+      if (more.empty())
+        break;
+      input = string{reinterpret_cast<const char*>(stream->next_in), stream->avail_in} + more;
+      stream->next_in = reinterpret_cast<unsigned char*>(&input[0]);
+      stream->avail_in = uInt(input.size());
+      continue;
+    }
+    if (ended_member) {
+      if (stream->next_in[0] != 0x1f || stream->next_in[1] != 0x8b)
+        break;   // not another gzip member: trailing data (the rest of the input isn't read)
+      ended_member = false;
+    }
+    stream->next_out = reinterpret_cast<unsigned char*>(&output[produced]);
+    stream->avail_out = uInt(stream_block_size - produced);
+    in_member = true;
+    const auto status = inflate(stream.get(), Z_NO_FLUSH);
+    produced = stream_block_size - stream->avail_out;
+    if (status == Z_STREAM_END) {
+      in_member = false;
+      ended_member = true;
+      inflateReset(stream.get());   // the next member (if any) starts with a new header
+    }
+    else if (status != Z_OK && status != Z_BUF_ERROR)
+      throw DecompressionException{stream->msg != nullptr ? stream->msg : "corrupted gzip data"};
+    if (produced == stream_block_size) {
+      if (!push(ready_future(move(output))))
+        return false;
+      output = string(stream_block_size, '\0');
+      produced = 0;
+    }
+  }
+  if (in_member)
+    throw DecompressionException{"truncated gzip data"};
+  output.resize(produced);
+  return output.empty() || push(ready_future(move(output)));
+}
+
+/**
+ * @brief reads up to size bytes of the input (fewer at the end of the input)
+ */
+string GzipBlockReader::read_input(const size_t size) {
+  auto bytes = string(size, '\0');
+  m_input->read(&bytes[0], size);
+  bytes.resize(size_t(m_input->gcount()));
+  return bytes;
+}
+
+}
+}
@@ -0,0 +1,84 @@
+#ifndef gamgee__gzip_block_reader__guard
+#define gamgee__gzip_block_reader__guard
+
+#include "block_reader.h"
+#include "thread_pool.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace gamgee {
+namespace utils {
+
+/**
+ * @brief reads a gzip or BGZF compressed stream, decompressing it on background threads
+ *
+ * A background thread reads the compressed stream and decompresses it ahead of the reader, so the thread
+ * calling read() only copies inflated data. BGZF input (a series of independent gzip blocks of at most 64KB, as
+ * written by bgzip and htslib) is cut into batches of blocks which are inflated in parallel by num_threads
+ * threads and delivered in input order. Any other gzip input (including concatenated members) is inflated by the
+ * background thread alone. As with gzip, data after the last member that doesn't start another gzip member (e.g.
+ * zero padding) is ignored.
+ *
+ * Only a few megabytes per thread are decompressed ahead of the reader. Corrupted or truncated input throws a
+ * DecompressionException from read().
+ */
+class GzipBlockReader : public BlockReader {
+ public:
+  /**
+   * @brief starts decompressing a stream
+   * @param input the compressed stream
+   * @param num_threads number of threads inflating BGZF blocks (1 inflates them on the background thread reading
+   * the input)
+   */
+  explicit GzipBlockReader(std::shared_ptr<std::istream> input, const uint32_t num_threads = 1);
+
+  /**
+   * @brief stops the background decompression (the rest of the input is not read)
+   */
+  ~GzipBlockReader() override;
+
+  /**
+   * @brief no copy or move construction/assignment allowed (the background thread holds on to the reader)
+   */
+  GzipBlockReader(const GzipBlockReader&) = delete;
+  GzipBlockReader& operator=(const GzipBlockReader&) = delete;
+  GzipBlockReader(GzipBlockReader&&) = delete;
+  GzipBlockReader& operator=(GzipBlockReader&&) = delete;
+
+  std::size_t read(char* destination, const std::size_t size) override;
+
+ private:
+  std::shared_ptr<std::istream> m_input;           ///< the compressed stream (only used by the background thread)
+  std::unique_ptr<ThreadPool> m_pool;              ///< threads inflating batches of BGZF blocks (null with a single thread)
+  std::size_t m_max_pending_blocks;                ///< number of decompressed blocks the background thread can get ahead of read()
+  std::deque<std::future<std::string>> m_pending;  ///< decompressed blocks (or blocks being decompressed) in input order
+  std::mutex m_mutex;                              ///< protects m_pending, m_decompressed_all and m_stopping
+  std::condition_variable m_block_available;       ///< signals read() that there is a block (or that there won't be any more)
+  std::condition_variable m_space_available;       ///< signals the background thread that read() took a block (or that it must stop)
+  bool m_decompressed_all;                         ///< whether or not the background thread reached the end of the input
+  bool m_stopping;                                 ///< whether or not the reader is being destroyed
+  std::string m_block;                             ///< the decompressed block being read
+  std::size_t m_block_position;                    ///< the first byte of m_block that hasn't been read
+  std::thread m_decompressor;                      ///< the background thread reading (and decompressing) the input
+
+  void decompress();
+  bool decompress_bgzf(std::string& header);
+  bool inflate_stream(std::string prefix, const bool after_member);
+  bool push(std::future<std::string> block);
+  bool next_block();
+  std::string read_input(const std::size_t size);
+};
+
+}
+}
+
+#endif // gamgee__gzip_block_reader__guard
@@ -0,0 +1,213 @@
+#include "gzip_block_writer.h"
+
+#include "../exceptions.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace gamgee {
+namespace utils {
+
+static constexpr size_t bgzf_block_input_size = 0xff00;   ///< uncompressed bytes per BGZF block (what htslib uses)
+static constexpr size_t bgzf_max_block_size = 1 << 16;    ///< BGZF blocks can't be larger than this
+static constexpr size_t bgzf_header_size = 18;            ///< gzip header with the BC extra field holding the block size
+static constexpr size_t bgzf_footer_size = 8;             ///< crc32 and size of the uncompressed data
+static constexpr size_t dictionary_size = 1 << 15;        ///< the deflate window: how much of the previous block can help compress the next
+
+static const char bgzf_eof_block[] = "\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00";
+static const char gzip_header[] = "\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff";   // deflate, no name or time (so the output is reproducible)
+static const char final_deflate_block[] = "\x03\x00";                         // an empty block with the last block bit set
+
+static void store_le32(char* bytes, const uint32_t value) {
+  for (auto i = 0; i != 4; ++i)
+    bytes[i] = char((value >> (8 * i)) & 0xff);
+}
+
+/**
+ * @brief a zlib raw deflate stream, ended when it goes out of scope
+ */
+class DeflateStream {
+ public:
+  explicit DeflateStream(const int level) : m_stream {} {
+    if (deflateInit2(&m_stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      throw OutputException{"could not initialize zlib"};
+  }
+  ~DeflateStream() { deflateEnd(&m_stream); }
+  DeflateStream(const DeflateStream&) = delete;
+  DeflateStream& operator=(const DeflateStream&) = delete;
+
+  z_stream* operator->() { return &m_stream; }
+  z_stream* get() { return &m_stream; }
+
+ private:
+  z_stream m_stream;
+};
+
+static uint32_t crc(const char* data, const size_t size) {
+  return uint32_t(crc32(crc32(0, nullptr, 0), reinterpret_cast<const unsigned char*>(data), uInt(size)));
+}
+
+/**
+ * @brief compresses up to bgzf_block_input_size bytes into a BGZF block appended to output
+ */
+static void append_bgzf_block(string& output, const char* data, const size_t size) {
+  const auto offset = output.size();
+  output.resize(offset + bgzf_max_block_size);
+  const auto block = &output[offset];
+  auto compressed_size = size_t{0};
+  for (const auto level : {Z_DEFAULT_COMPRESSION, Z_NO_COMPRESSION}) {  // incompressible data is stored instead
+    auto stream = DeflateStream{level};
+    stream->next_in = reinterpret_cast<unsigned char*>(const_cast<char*>(data));
+    stream->avail_in = uInt(size);
+    stream->next_out = reinterpret_cast<unsigned char*>(block + bgzf_header_size);
+    stream->avail_out = uInt(bgzf_max_block_size - bgzf_header_size - bgzf_footer_size);
+    if (deflate(stream.get(), Z_FINISH) == Z_STREAM_END) {
+      compressed_size = stream->total_out;
+      break;
+    }
+  }
+  const auto block_size = bgzf_header_size + compressed_size + bgzf_footer_size;
+  memcpy(block, bgzf_eof_block, bgzf_header_size);   // the same header, but for the block size
+  block[16] = char((block_size - 1) & 0xff);
+  block[17] = char((block_size - 1) >> 8);
+  store_le32(block + bgzf_header_size + compressed_size, crc(data, size));
+  store_le32(block + bgzf_header_size + compressed_size + 4, uint32_t(size));
+  output.resize(offset + block_size);
+}
+
+static GzipBlockWriter::CompressedBlock compress_bgzf(const string& block) {
+  auto compressed = GzipBlockWriter::CompressedBlock{string{}, 0, block.size()};
+  compressed.data.reserve(block.size() / 2);
+  for (auto position = size_t{0}; position < block.size(); position += bgzf_block_input_size)
+    append_bgzf_block(compressed.data, block.data() + position, min(bgzf_block_input_size, block.size() - position));
+  return compressed;
+}
+
+/**
+ * @brief deflates a block of a gzip member, byte-aligned with a sync flush so that it can be followed by the next
+ * compressed block
+ * @param block the data to compress
+ * @param dictionary the data preceding the block (up to 32KB)
+ */
+static GzipBlockWriter::CompressedBlock compress_gzip(const string& block, const string& dictionary) {
+  auto compressed = GzipBlockWriter::CompressedBlock{string{}, crc(block.data(), block.size()), block.size()};
+  auto stream = DeflateStream{Z_DEFAULT_COMPRESSION};
+  if (!dictionary.empty() && deflateSetDictionary(stream.get(), reinterpret_cast<const unsigned char*>(dictionary.data()), uInt(dictionary.size())) != Z_OK)
+    throw OutputException{"could not initialize zlib"};
+  compressed.data.resize(deflateBound(stream.get(), uLong(block.size())) + 16);
+  stream->next_in = reinterpret_cast<unsigned char*>(const_cast<char*>(block.data()));
+  stream->avail_in = uInt(block.size());
+  stream->next_out = reinterpret_cast<unsigned char*>(&compressed.data[0]);
+  stream->avail_out = uInt(compressed.data.size());
+  while (true) {
+    if (deflate(stream.get(), Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+      throw OutputException{"could not compress the data"};
+    if (stream->avail_out != 0)
+      break;
+    const auto produced = compressed.data.size();   // the output is full: there may be more to come
+    compressed.data.resize(2 * produced);
+    stream->next_out = reinterpret_cast<unsigned char*>(&compressed.data[produced]);
+    stream->avail_out = uInt(produced);
+  }
+  compressed.data.resize(stream->total_out);
+  return compressed;
+}
+
+GzipBlockWriter::GzipBlockWriter(shared_ptr<ostream> output, const bool bgzf, const uint32_t num_threads) :
+  m_output {move(output)},
+  m_bgzf {bgzf},
+  m_max_pending_blocks {2 * size_t{max(num_threads, 1u)} + 2},
+  m_pending {},
+  m_dictionary {},
+  m_crc {0},
+  m_size {0},
+  m_started {false},
+  m_finished {false},
+  m_pool {num_threads}
+{}
+
+GzipBlockWriter::~GzipBlockWriter() {
+  if (m_finished)
+    return;
+  try {
+    finish();
+  }
+  catch (...) {}   // destructors can't throw
+}
+
+void GzipBlockWriter::write(string block) {
+  if (block.empty())
+    return;
+  if (m_bgzf)
+    m_pending.push_back(m_pool.submit([block = move(block)]{ return compress_bgzf(block); }));
+  else {
+    auto dictionary = move(m_dictionary);
+    if (block.size() >= dictionary_size)
+      m_dictionary.assign(block, block.size() - dictionary_size, dictionary_size);
+    else {
+      m_dictionary = dictionary + block;
+      m_dictionary.erase(0, m_dictionary.size() - min(m_dictionary.size(), dictionary_size));
+    }
+    m_pending.push_back(m_pool.submit([block = move(block), dictionary = move(dictionary)]{ return compress_gzip(block, dictionary); }));
+  }
+  while (m_pending.size() > m_max_pending_blocks)
+    write_next();
+}
+
+void GzipBlockWriter::flush() {
+  while (!m_pending.empty())
+    write_next();
+  if (!m_output->flush())
+    throw OutputException{"the output stream failed"};
+}
+
+/**
+ * @brief waits for the first block being compressed and writes it out
+ */
+void GzipBlockWriter::write_next() {
+  auto next = move(m_pending.front());
+  m_pending.pop_front();
+  const auto block = next.get();   // rethrows compression errors
+  if (!m_bgzf) {
+    if (!m_started)
+      write_out(string{gzip_header, sizeof(gzip_header) - 1});
+    m_started = true;
+    m_crc = uint32_t(crc32_combine(m_crc, block.crc, z_off_t(block.size)));
+    m_size += block.size;
+  }
+  write_out(block.data);
+}
+
+void GzipBlockWriter::write_out(const string& data) {
+  if (!m_output->write(data.data(), streamsize(data.size())))
+    throw OutputException{"the output stream failed"};
+}
+
+/**
+ * @brief writes out all the blocks, and the end of the compressed stream (only once: a stream that failed half way
+ * through its end isn't ended again by the destructor)
+ */
+void GzipBlockWriter::finish() {
+  m_finished = true;
+  while (!m_pending.empty())
+    write_next();
+  if (m_bgzf)
+    write_out(string{bgzf_eof_block, sizeof(bgzf_eof_block) - 1});
+  else {
+    if (!m_started)
+      write_out(string{gzip_header, sizeof(gzip_header) - 1});
+    auto footer = string{final_deflate_block, sizeof(final_deflate_block) - 1} + string(8, '\0');
+    store_le32(&footer[2], m_crc);
+    store_le32(&footer[6], uint32_t(m_size));
+    write_out(footer);
+  }
+  if (!m_output->flush())
+    throw OutputException{"the output stream failed"};
+}
+
+}
+}
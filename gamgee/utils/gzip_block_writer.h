@@ -0,0 +1,90 @@
+#ifndef gamgee__gzip_block_writer__guard
+#define gamgee__gzip_block_writer__guard
+
+#include "block_writer.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <ostream>
+#include <string>
+
+namespace gamgee {
+namespace utils {
+
+/**
+ * @brief writes a gzip or BGZF compressed stream, compressing it on a pool of threads
+ *
+ * Each block given to write() is compressed by one of num_threads threads while the caller goes on producing the
+ * next blocks. Compressed blocks are written out in the order they were given, so the output only depends on the
+ * data (not on the number of threads, or on the timing of the threads):
+ *
+ *   - BGZF output cuts the blocks in the usual BGZF blocks of up to 65280 bytes, each one a gzip member, and
+ *     ends with the BGZF end of file marker. Files can be indexed (e.g. by samtools faidx) and read by htslib.
+ *   - gzip output is a single gzip member, compressed like pigz does: each block is deflated on its own (primed
+ *     with the end of the previous block) and byte-aligned with a sync flush, so that the compressed blocks can
+ *     be concatenated.
+ *
+ * Only a few blocks per thread are compressed ahead of the output stream. Corrupted output streams throw an
+ * OutputException from write(), flush() or finish().
+ */
+class GzipBlockWriter : public BlockWriter {
+ public:
+  /**
+   * @brief starts a compressed stream
+   * @param output the stream the compressed data goes to
+   * @param bgzf whether to write BGZF or gzip
+   * @param num_threads number of threads compressing the blocks
+   */
+  GzipBlockWriter(std::shared_ptr<std::ostream> output, const bool bgzf, const uint32_t num_threads = 1);
+
+  /**
+   * @brief compresses what is left, and finishes the compressed stream if finish() wasn't called (errors are
+   * ignored: call finish() to get them)
+   */
+  ~GzipBlockWriter() override;
+
+  /**
+   * @brief no copy or move construction/assignment allowed (the compressing threads hold on to the writer)
+   */
+  GzipBlockWriter(const GzipBlockWriter&) = delete;
+  GzipBlockWriter& operator=(const GzipBlockWriter&) = delete;
+  GzipBlockWriter(GzipBlockWriter&&) = delete;
+  GzipBlockWriter& operator=(GzipBlockWriter&&) = delete;
+
+  void write(std::string block) override;
+  void flush() override;
+  void finish() override;
+
+  /**
+   * @brief a block of data compressed by one of the threads
+   */
+  struct CompressedBlock {
+    std::string data;        ///< the compressed data
+    uint32_t crc;            ///< crc32 of the uncompressed data
+    std::size_t size;        ///< size of the uncompressed data
+  };
+
+ private:
+  std::shared_ptr<std::ostream> m_output;               ///< the compressed stream
+  bool m_bgzf;                                          ///< whether we are writing BGZF or gzip
+  std::size_t m_max_pending_blocks;                     ///< number of blocks compressed ahead of the output stream
+  std::deque<std::future<CompressedBlock>> m_pending;   ///< blocks being compressed, in output order
+  std::string m_dictionary;                             ///< the end of the last block (gzip primes the next block with it)
+  uint32_t m_crc;                                       ///< crc32 of the data written so far (gzip only)
+  uint64_t m_size;                                      ///< size of the data written so far (gzip only)
+  bool m_started;                                       ///< whether or not the gzip header has been written
+  bool m_finished;                                      ///< whether or not finish() was called (even if it failed)
+  ThreadPool m_pool;                                    ///< the threads compressing the blocks (destroyed first, so the blocks being compressed are finished)
+
+  void write_next();
+  void write_out(const std::string& data);
+};
+
+}
+}
+
+#endif // gamgee__gzip_block_writer__guard
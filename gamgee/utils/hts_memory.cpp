@@ -1,6 +1,11 @@
 #include "hts_memory.h"
 
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <stdexcept>
 
 using namespace std;
@@ -33,11 +38,20 @@ shared_ptr<hts_itr_t> make_shared_hts_itr(hts_itr_t* hts_itr_ptr) {
 }
 
 /**
-  * @brief wraps a pre-allocated bam1_t in a shared_ptr with correct deleter
+  * @brief moves a pre-allocated bam1_t into a reference counted handle (the struct itself is freed)
   * @param sam_ptr an htslib raw bam pointer
   */
-shared_ptr<bam1_t> make_shared_sam(bam1_t* sam_ptr) {
-  return shared_ptr<bam1_t>(sam_ptr, SamBodyDeleter());
+SamHandle make_shared_sam(bam1_t* sam_ptr) {
+  return SamHandle::adopt(sam_ptr);
+}
+
+/**
+  * @brief moves a pre-allocated bam1_t into a reference counted handle that returns it to a pool when released
+  * @param sam_ptr an htslib raw bam pointer
+  * @param pool the pool the record goes back to
+  */
+SamHandle make_shared_sam(bam1_t* sam_ptr, SamRecordPool& pool) {
+  return pool.make_shared(sam_ptr);
 }
 
 /**
@@ -49,11 +63,11 @@ shared_ptr<bam_hdr_t> make_shared_sam_header(bam_hdr_t* sam_header_ptr) {
 }
 
 /**
-  * @brief wraps a pre-allocated bcf1_t in a shared_ptr with correct deleter
+  * @brief moves a pre-allocated bcf1_t into a reference counted handle (the struct itself is freed)
   * @param bcf_ptr an htslib raw vcf pointer
   */
-shared_ptr<bcf1_t> make_shared_variant(bcf1_t* bcf_ptr) {
-  return shared_ptr<bcf1_t>(bcf_ptr, VariantBodyDeleter());
+VariantHandle make_shared_variant(bcf1_t* bcf_ptr) {
+  return VariantHandle::adopt(bcf_ptr);
 }
 
 /**
@@ -96,6 +110,160 @@ bam1_t* sam_deep_copy(bam1_t* original) {
   return bam_dup1(original);
 }
 
+/**
+ * @brief idle records and counters of a SamRecordPool, kept alive by the records handed out
+ */
+struct SamRecordPool::State : public RecordRecycler<bam1_t> {
+  using Node = RecordNode<bam1_t>;
+
+  mutex idle_mutex;
+  vector<Node*> idle;
+  uint32_t max_idle_records;
+  bool closed;                  ///< the pool is gone: released records are freed
+  atomic<uint64_t> record_allocations;
+  atomic<uint64_t> data_allocations;
+  atomic<uint64_t> records_reused;
+
+  explicit State(const uint32_t max_idle) :
+    idle_mutex {}, idle {}, max_idle_records {max_idle}, closed {false}, record_allocations {0}, data_allocations {0}, records_reused {0}
+  {}
+
+  /**
+   * @brief an idle record, emptied but with its data buffer (and capacity) intact, or a new one
+   */
+  Node* acquire() {
+    {
+      lock_guard<mutex> lock {idle_mutex};
+      if (!idle.empty()) {
+        auto* node = idle.back();
+        idle.pop_back();
+        ++records_reused;
+        auto* record = &node->record;
+        auto* data = record->data;
+        const auto capacity = record->m_data;
+        memset(record, 0, sizeof(bam1_t));
+        record->data = data;
+        record->m_data = capacity;
+        node->references = 1;
+        return node;
+      }
+    }
+    ++record_allocations;
+    return Node::create();
+  }
+
+  /**
+   * @brief keeps the node for reuse (it still points back to this state, which the pool breaks by emptying
+   * the idle list when it's destroyed)
+   */
+  void recycle(Node* node) override {
+    {
+      lock_guard<mutex> lock {idle_mutex};
+      if (!closed && idle.size() < max_idle_records) {
+        idle.push_back(node);
+        return;
+      }
+    }
+    Node::destroy(node);
+  }
+
+  /**
+   * @brief same as bam_copy1, growing the data buffer of the destination only if it's too small
+   */
+  void copy(bam1_t* destination, const bam1_t* original) {
+    auto* data = destination->data;
+    auto capacity = destination->m_data;
+    if (capacity < original->l_data) {
+      capacity = 1;
+      while (capacity < original->l_data)
+        capacity <<= 1;
+      data = static_cast<uint8_t*>(realloc(data, capacity));
+      if (data == nullptr)
+        throw bad_alloc{};
+      ++data_allocations;
+    }
+    *destination = *original;
+    destination->data = data;
+    destination->m_data = capacity;
+    if (original->l_data > 0)
+      memcpy(data, original->data, original->l_data);
+  }
+};
+
+SamRecordPool::SamRecordPool(const uint32_t max_idle_records) :
+  m_state {std::make_shared<State>(max_idle_records)}
+{}
+
+SamRecordPool::~SamRecordPool() {
+  auto idle = vector<State::Node*>{};
+  {
+    lock_guard<mutex> lock {m_state->idle_mutex};
+    m_state->closed = true;
+    idle.swap(m_state->idle);
+  }
+  for (auto* node : idle)
+    State::Node::destroy(node);
+}
+
+SamHandle SamRecordPool::make_shared(bam1_t* sam_ptr) {
+  auto record = SamHandle::adopt(sam_ptr);
+  if (record != nullptr)
+    record.node()->recycler = m_state;
+  return record;
+}
+
+SamHandle SamRecordPool::allocate() {
+  auto* node = m_state->acquire();
+  if (node->recycler == nullptr)
+    node->recycler = m_state;
+  return SamHandle{node};
+}
+
+SamHandle SamRecordPool::deep_copy(const bam1_t* original) {
+  if (original == nullptr)
+    return SamHandle{};
+  auto record = allocate();
+  m_state->copy(record.get(), original);
+  return record;
+}
+
+void SamRecordPool::assign(SamHandle& destination, const bam1_t* original) {
+  if (destination != nullptr && original != nullptr && destination.use_count() == 1)
+    m_state->copy(destination.get(), original);
+  else
+    destination = deep_copy(original);
+}
+
+SamRecordPoolStatistics SamRecordPool::statistics() const {
+  auto idle_records = uint64_t{0};
+  {
+    lock_guard<mutex> lock {m_state->idle_mutex};
+    idle_records = m_state->idle.size();
+  }
+  return SamRecordPoolStatistics{m_state->record_allocations, m_state->data_allocations, m_state->records_reused, idle_records};
+}
+
+SamRecordPool& SamRecordPool::thread_local_pool() {
+  static thread_local SamRecordPool pool {};
+  return pool;
+}
+
+/**
+ * @brief the group is created by the first copy, with a compare and swap in case several threads are copying
+ * the same record at once (loser threads join the winner's group)
+ */
+CopyOnWriteGroup CopyOnWriteGroup::join() const {
+  auto group = atomic_load(&m_group);
+  if (group == nullptr) {
+    const auto created = std::make_shared<int>(0);
+    if (atomic_compare_exchange_strong(&m_group, &group, created))
+      group = created;
+  }
+  auto member = CopyOnWriteGroup{};
+  member.m_group = move(group);
+  return member;
+}
+
 /**
   * @brief creates a deep copy of an existing bam_hdr_t
   * @param original an htslib raw bam header pointer
@@ -1,11 +1,14 @@
 #ifndef gamgee__hts_memory__guard
 #define gamgee__hts_memory__guard
 
+#include "record_handle.h"
+
 #include "htslib/sam.h"
 #include "htslib/vcf.h"
 #include "htslib/synced_bcf_reader.h"
 #include "htslib/kstring.h"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <string>
@@ -71,12 +74,86 @@ struct SyncedReaderDeleter {
   void operator()(bcf_srs_t* p) const { bcf_sr_destroy(p); }
 };
 
+/**
+ * @brief allocation counts of a SamRecordPool
+ */
+struct SamRecordPoolStatistics {
+  uint64_t record_allocations; ///< bam1_t structs allocated because the pool had none to reuse
+  uint64_t data_allocations;   ///< data buffers allocated or grown because the record reused didn't have enough capacity
+  uint64_t records_reused;     ///< records handed out from the pool instead of allocated
+  uint64_t idle_records;       ///< records currently waiting in the pool to be reused
+};
+
+/**
+ * @brief Recycles bam1_t records and the capacity of their data buffers
+ *
+ * Records handed out by the pool (or wrapped with make_shared_sam(record, pool)) go back to the pool when
+ * their last handle goes away instead of being freed, and the pool copies records into the data buffers
+ * it already has. Once the pool has warmed up, copying records in a loop doesn't allocate memory:
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * auto& pool = SamRecordPool::thread_local_pool();
+ * const auto before = pool.statistics();
+ * for (const auto& record : SingleSamReader{filename})
+ *   window.push_back(record);   // the iterator moves on to a record from the thread local pool
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Cigar, ReadBases and BaseQuals copies, Sam records modified while shared with their copy-on-write copies
+ * and Sam iterators whose last record is still shared use the pool of the calling thread. Records can go back
+ * to the pool from any thread, and may outlive the pool (they are simply freed then).
+ */
+class SamRecordPool {
+ public:
+  /**
+   * @param max_idle_records maximum number of records kept for reuse (records returned beyond that are freed)
+   */
+  explicit SamRecordPool(const uint32_t max_idle_records = 4096);
+  ~SamRecordPool();
+
+  /**
+   * @brief no copy or move construction/assignment allowed (records point back to their pool)
+   */
+  SamRecordPool(const SamRecordPool&) = delete;
+  SamRecordPool& operator=(const SamRecordPool&) = delete;
+
+  SamHandle allocate();                                                             ///< @brief an empty record (reused if possible) that goes back to the pool when released
+  SamHandle deep_copy(const bam1_t* original);                                      ///< @brief a copy of original in a record from the pool (null if original is null)
+  void assign(SamHandle& destination, const bam1_t* original);                      ///< @brief copies original into destination in place if nobody else is using it, or into a record from the pool otherwise
+  SamHandle make_shared(bam1_t* sam_ptr);                                           ///< @brief takes over a record allocated by htslib so it goes back to the pool when released
+  SamRecordPoolStatistics statistics() const;                                       ///< @brief allocation counts since the pool was created
+
+  static SamRecordPool& thread_local_pool();                                        ///< @brief the pool of the calling thread (used by Sam, Cigar, ReadBases and BaseQuals copies and by the Sam iterators)
+
+ private:
+  struct State;
+  std::shared_ptr<State> m_state;   ///< shared with the records handed out, which may outlive the pool
+};
+
+/**
+ * @brief Tracks the Sam or Variant copies sharing a record body (copy-on-write), as opposed to the views and
+ * iterator buffers that merely alias it
+ *
+ * A copy joins the group of the original (created on the first copy) instead of copying the body. Mutators
+ * check shared() and make a private copy of the body (leaving the group) before writing to it, and iterators
+ * check it before reading the next record into the buffer they served the last one from.
+ */
+class CopyOnWriteGroup {
+ public:
+  CopyOnWriteGroup join() const;                             ///< @brief a new member of this group (safe to call from several threads copying the same record)
+  bool shared() const { return m_group.use_count() > 1; }    ///< @brief whether other copies are sharing the body
+  void leave() { m_group.reset(); }                          ///< @brief leaves the group (once the body is no longer shared with it)
+
+ private:
+  mutable std::shared_ptr<int> m_group;                      ///< created lazily by the first join()
+};
+
 std::shared_ptr<htsFile> make_shared_hts_file(htsFile* hts_file_ptr);
 std::shared_ptr<hts_idx_t> make_shared_hts_index(hts_idx_t* hts_index_ptr);
 std::shared_ptr<hts_itr_t> make_shared_hts_itr(hts_itr_t* hts_itr_ptr);
-std::shared_ptr<bam1_t> make_shared_sam(bam1_t* sam_ptr);
+SamHandle make_shared_sam(bam1_t* sam_ptr);
+SamHandle make_shared_sam(bam1_t* sam_ptr, SamRecordPool& pool);
 std::shared_ptr<bam_hdr_t> make_shared_sam_header(bam_hdr_t* sam_header_ptr);
-std::shared_ptr<bcf1_t> make_shared_variant(bcf1_t* bcf_ptr);
+VariantHandle make_shared_variant(bcf1_t* bcf_ptr);
 std::shared_ptr<bcf_hdr_t> make_shared_variant_header(bcf_hdr_t* bcf_hdr_ptr);
 std::shared_ptr<bcf_srs_t> make_shared_synced_variant_reader(bcf_srs_t* synced_reader_ptr);
 
@@ -0,0 +1,58 @@
+#include "memory_mapped_file.h"
+
+#include "../exceptions.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+using namespace std;
+
+namespace gamgee {
+namespace utils {
+
+MemoryMappedFile::MemoryMappedFile(const string& filename) :
+  m_data {nullptr},
+  m_size {0}
+{
+  const auto descriptor = open(filename.c_str(), O_RDONLY);
+  if (descriptor == -1)
+    throw FileOpenException{filename};
+  struct stat status;
+  if (fstat(descriptor, &status) != 0) {
+    close(descriptor);
+    throw FileOpenException{filename};
+  }
+  m_size = size_t(status.st_size);
+  if (m_size != 0) {
+    const auto mapping = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    if (mapping == MAP_FAILED) {
+      close(descriptor);
+      throw FileOpenException{filename};
+    }
+    m_data = static_cast<const char*>(mapping);
+  }
+  close(descriptor);   // the mapping stays valid
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+  if (m_data != nullptr)
+    munmap(const_cast<char*>(m_data), m_size);
+}
+
+MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& other) noexcept :
+  m_data {exchange(other.m_data, nullptr)},
+  m_size {exchange(other.m_size, 0)}
+{}
+
+MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&& other) noexcept {
+  swap(m_data, other.m_data);
+  swap(m_size, other.m_size);
+  return *this;
+}
+
+}
+}
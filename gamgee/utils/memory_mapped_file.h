@@ -0,0 +1,47 @@
+#ifndef gamgee__memory_mapped_file__guard
+#define gamgee__memory_mapped_file__guard
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace gamgee {
+namespace utils {
+
+/**
+ * @brief a file mapped read-only into memory, unmapped when the object goes out of scope
+ *
+ * The pages of the file are loaded on demand and shared with every other process mapping the same file, so
+ * opening even a very large file is immediate.
+ */
+class MemoryMappedFile {
+ public:
+  /**
+   * @brief maps a whole file
+   * @throw FileOpenException if the file can't be opened or mapped
+   */
+  explicit MemoryMappedFile(const std::string& filename);
+
+  ~MemoryMappedFile();
+
+  /**
+   * @brief a MemoryMappedFile can be moved, but not copied (share it instead)
+   */
+  MemoryMappedFile(const MemoryMappedFile&) = delete;
+  MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+  MemoryMappedFile(MemoryMappedFile&& other) noexcept;
+  MemoryMappedFile& operator=(MemoryMappedFile&& other) noexcept;
+
+  const char* data() const { return m_data; }                        ///< @brief the contents of the file
+  std::size_t size() const { return m_size; }                        ///< @brief the size of the file
+  std::string_view contents() const { return {m_data, m_size}; }     ///< @brief the contents of the file as a string_view
+
+ private:
+  const char* m_data;   ///< the mapping (null for empty files)
+  std::size_t m_size;   ///< size of the mapping
+};
+
+}
+}
+
+#endif // gamgee__memory_mapped_file__guard
@@ -0,0 +1,149 @@
+#ifndef gamgee__record_handle__guard
+#define gamgee__record_handle__guard
+
+#include "htslib/sam.h"
+#include "htslib/vcf.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+
+namespace gamgee {
+namespace utils {
+
+/**
+ * @brief reference count of the htslib records
+ *
+ * Define GAMGEE_NONATOMIC_REFCOUNT (cmake -DGAMGEE_NONATOMIC_REFCOUNT=ON) to use plain integers in single
+ * threaded pipelines. Handles to the same record must then never be copied or released concurrently by
+ * different threads (e.g. no Sam copies handed to a thread pool, no SamRecordPool shared between threads).
+ */
+#ifdef GAMGEE_NONATOMIC_REFCOUNT
+using RecordReferenceCount = uint32_t;
+inline void add_reference(RecordReferenceCount& count) { ++count; }
+inline bool remove_reference(RecordReferenceCount& count) { return --count == 0; }  ///< @return whether that was the last reference
+inline uint32_t reference_count(const RecordReferenceCount& count) { return count; }
+#else
+using RecordReferenceCount = std::atomic<uint32_t>;
+inline void add_reference(RecordReferenceCount& count) { count.fetch_add(1, std::memory_order_relaxed); }
+inline bool remove_reference(RecordReferenceCount& count) { return count.fetch_sub(1, std::memory_order_acq_rel) == 1; }  ///< @return whether that was the last reference
+inline uint32_t reference_count(const RecordReferenceCount& count) { return count.load(std::memory_order_relaxed); }
+#endif
+
+inline void free_record_contents(bam1_t* record) { free(record->data); }  ///< @brief bam_destroy1 without freeing the struct itself
+inline void free_record_contents(bcf1_t* record) { bcf_empty1(record); }  ///< @brief bcf_destroy1 without freeing the struct itself
+
+template <class RECORD> struct RecordNode;
+
+/**
+ * @brief where released records go instead of being freed (e.g. a pool keeping them for reuse)
+ */
+template <class RECORD>
+class RecordRecycler {
+ public:
+  virtual ~RecordRecycler() = default;
+  virtual void recycle(RecordNode<RECORD>* node) = 0;  ///< @brief takes over a node nobody references anymore
+};
+
+/**
+ * @brief an htslib record allocated together with its reference count
+ */
+template <class RECORD>
+struct RecordNode {
+  RECORD record;
+  RecordReferenceCount references;
+  std::shared_ptr<RecordRecycler<RECORD>> recycler;  ///< where the node goes when released (freed if null)
+
+  static RecordNode* create() {                      ///< @brief an empty record (as from bam_init1/bcf_init1) referenced once
+    auto* node = new RecordNode{};
+    node->references = 1;
+    return node;
+  }
+
+  static void destroy(RecordNode* node) {
+    free_record_contents(&node->record);
+    delete node;
+  }
+};
+
+/**
+ * @brief Intrusive reference counted handle to an htslib record (bam1_t or bcf1_t)
+ *
+ * Works like the shared_ptr it replaces in Sam, Variant and their views, but the count lives in the same
+ * allocation as the record: creating a record is a single allocation and copying a handle is a single
+ * (possibly non-atomic, see RecordReferenceCount) increment, with no control block or deleter to go through.
+ */
+template <class RECORD>
+class RecordHandle {
+ public:
+  RecordHandle() noexcept : m_node {nullptr} {}
+  RecordHandle(std::nullptr_t) noexcept : m_node {nullptr} {}
+  explicit RecordHandle(RecordNode<RECORD>* node) noexcept : m_node {node} {}  ///< @brief takes over the reference the node was created with
+  RecordHandle(const RecordHandle& other) noexcept : m_node {other.m_node} { if (m_node != nullptr) add_reference(m_node->references); }
+  RecordHandle(RecordHandle&& other) noexcept : m_node {other.m_node} { other.m_node = nullptr; }
+  RecordHandle& operator=(const RecordHandle& other) noexcept { RecordHandle{other}.swap(*this); return *this; }
+  RecordHandle& operator=(RecordHandle&& other) noexcept { RecordHandle{std::move(other)}.swap(*this); return *this; }
+  ~RecordHandle() { reset(); }
+
+  /**
+   * @brief a new, empty record
+   */
+  static RecordHandle create() { return RecordHandle{RecordNode<RECORD>::create()}; }
+
+  /**
+   * @brief moves a record allocated by htslib (e.g. with bam_init1, bam_dup1 or bcf_dup) into a node, freeing the original struct
+   */
+  static RecordHandle adopt(RECORD* record) {
+    if (record == nullptr)
+      return RecordHandle{};
+    auto* node = RecordNode<RECORD>::create();
+    node->record = *record;
+    free(record);
+    return RecordHandle{node};
+  }
+
+  RECORD* get() const noexcept { return m_node == nullptr ? nullptr : &m_node->record; }
+  RECORD* operator->() const noexcept { return &m_node->record; }
+  RECORD& operator*() const noexcept { return m_node->record; }
+  explicit operator bool() const noexcept { return m_node != nullptr; }
+  long use_count() const noexcept { return m_node == nullptr ? 0 : long(reference_count(m_node->references)); }
+  RecordNode<RECORD>* node() const noexcept { return m_node; }
+  void swap(RecordHandle& other) noexcept { std::swap(m_node, other.m_node); }
+
+  /**
+   * @brief releases the record (recycling or freeing it if this was the last reference)
+   */
+  void reset() noexcept {
+    auto* node = m_node;
+    m_node = nullptr;
+    if (node == nullptr || !remove_reference(node->references))
+      return;
+    if (node->recycler == nullptr) {
+      RecordNode<RECORD>::destroy(node);
+      return;
+    }
+    const auto recycler = node->recycler;  ///< the recycler may free the node (and with it the node's reference to the recycler)
+    recycler->recycle(node);
+  }
+
+  friend bool operator==(const RecordHandle& lhs, const RecordHandle& rhs) noexcept { return lhs.m_node == rhs.m_node; }
+  friend bool operator!=(const RecordHandle& lhs, const RecordHandle& rhs) noexcept { return lhs.m_node != rhs.m_node; }
+  friend bool operator==(const RecordHandle& lhs, std::nullptr_t) noexcept { return lhs.m_node == nullptr; }
+  friend bool operator!=(const RecordHandle& lhs, std::nullptr_t) noexcept { return lhs.m_node != nullptr; }
+  friend bool operator==(std::nullptr_t, const RecordHandle& rhs) noexcept { return rhs.m_node == nullptr; }
+  friend bool operator!=(std::nullptr_t, const RecordHandle& rhs) noexcept { return rhs.m_node != nullptr; }
+
+ private:
+  RecordNode<RECORD>* m_node;
+};
+
+using SamHandle = RecordHandle<bam1_t>;      ///< @brief handle to an htslib sam record, shared by a Sam and its Cigar, ReadBases and BaseQuals views
+using VariantHandle = RecordHandle<bcf1_t>;  ///< @brief handle to an htslib variant record, shared by a Variant and its field views
+
+}  // end of namespace utils
+}  // end of namespace gamgee
+
+#endif // gamgee__record_handle__guard
@@ -0,0 +1,49 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace gamgee {
+namespace utils {
+
+ThreadPool::ThreadPool(const uint32_t num_threads) :
+  m_workers {},
+  m_tasks {},
+  m_mutex {},
+  m_task_available {},
+  m_stopping {false}
+{
+  const auto workers = max(num_threads, 1u);
+  m_workers.reserve(workers);
+  for (auto i = 0u; i != workers; ++i)
+    m_workers.emplace_back([this]{ work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    lock_guard<mutex> lock {m_mutex};
+    m_stopping = true;
+  }
+  m_task_available.notify_all();
+  for (auto& worker : m_workers)
+    worker.join();
+}
+
+void ThreadPool::work() {
+  while (true) {
+    auto task = function<void()>{};
+    {
+      unique_lock<mutex> lock {m_mutex};
+      m_task_available.wait(lock, [this]{ return m_stopping || !m_tasks.empty(); });
+      if (m_tasks.empty())
+        return;                                  // only reached when stopping, after the queue has been drained
+      task = move(m_tasks.front());
+      m_tasks.pop();
+    }
+    task();
+  }
+}
+
+}
+}
@@ -0,0 +1,81 @@
+#ifndef gamgee__thread_pool__guard
+#define gamgee__thread_pool__guard
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace gamgee {
+namespace utils {
+
+/**
+ * @brief A fixed-size pool of worker threads executing tasks in submission order
+ *
+ * Tasks are any callable taking no arguments. Submitting a task returns a std::future with its result
+ * (exceptions thrown by the task are re-thrown by std::future::get()). The destructor waits for all
+ * submitted tasks to finish before joining the workers.
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * auto pool = ThreadPool{4};
+ * auto result = pool.submit([]{ return expensive_computation(); });
+ * do_something_with(result.get());
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ */
+class ThreadPool {
+ public:
+  /**
+   * @brief creates a pool with num_threads workers (at least one)
+   */
+  explicit ThreadPool(const uint32_t num_threads = std::thread::hardware_concurrency());
+
+  /**
+   * @brief finishes all pending tasks and joins the workers
+   */
+  ~ThreadPool();
+
+  /**
+   * @brief no copy or move construction/assignment allowed: tasks hold on to the pool's internals
+   */
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  /**
+   * @brief queues a task for execution
+   * @return a future holding the result of the task
+   */
+  template<class FUNCTION>
+  auto submit(FUNCTION&& function) -> std::future<decltype(function())> {
+    using result_type = decltype(function());
+    auto task = std::make_shared<std::packaged_task<result_type()>>(std::forward<FUNCTION>(function));
+    auto result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock {m_mutex};
+      m_tasks.emplace([task]{ (*task)(); });
+    }
+    m_task_available.notify_one();
+    return result;
+  }
+
+  uint32_t size() const { return uint32_t(m_workers.size()); } ///< @brief number of worker threads
+
+ private:
+  std::vector<std::thread> m_workers;         ///< the worker threads
+  std::queue<std::function<void()>> m_tasks;  ///< tasks waiting for a worker
+  std::mutex m_mutex;                         ///< protects m_tasks and m_stopping
+  std::condition_variable m_task_available;   ///< signals workers that there is a task (or that the pool is stopping)
+  bool m_stopping;                            ///< whether or not the pool is shutting down
+
+  void work();                                ///< worker loop
+};
+
+}
+}
+
+#endif // gamgee__thread_pool__guard
@@ -1,14 +1,19 @@
 #include "utils.h" 
 
+#include "base_encoding.h"
+#include "../exceptions.h"
+
+#include <cstdlib>
 #include <string>
 #include <algorithm>
 #include <memory.h>
+#include <unistd.h>
 #include <vector>
 
 namespace gamgee {
 namespace utils {
 
-char complement_base (const char base) {
+char complement (const char base) {
   switch (base) {
     case 'A':
       return 'T';
@@ -32,22 +37,20 @@ char complement_base (const char base) {
 }
 
 std::string complement(std::string& sequence) {
-  std::transform(sequence.begin(), sequence.end(), sequence.begin(), complement_base);
+  complement_bases(sequence.data(), sequence.size(), &sequence[0]);
   return sequence;
 }
 
 std::string complement(const std::string& sequence) {
-  auto rev = std::string{};
-  rev.reserve(sequence.length());
-  std::transform(sequence.cbegin(), sequence.cend(), std::back_inserter(rev), complement_base);
-  return rev;
+  auto result = std::string(sequence.size(), '\0');
+  complement_bases(sequence.data(), sequence.size(), &result[0]);
+  return result;
 }
 
 std::string reverse_complement(const std::string& sequence) {
-  auto rev = std::string{};
-  rev.reserve(sequence.length());
-  std::transform(sequence.crbegin(), sequence.crend(), std::back_inserter(rev), complement_base);
-  return rev;
+  auto result = std::string(sequence.size(), '\0');
+  reverse_complement_bases(sequence.data(), sequence.size(), &result[0]);
+  return result;
 }
 
 std::vector<std::string> hts_string_array_to_vector(const char * const * const string_array, const uint32_t array_size) {
@@ -58,5 +61,26 @@ std::vector<std::string> hts_string_array_to_vector(const char * const * const s
   return result;
 }
 
+std::string make_temp_file(const std::string& directory, const std::string& prefix) {
+  auto name = directory;
+  if (name.empty()) {
+    const auto* environment = getenv("TMPDIR");
+    name = environment != nullptr && *environment != '\0' ? environment : "/tmp";
+  }
+  name += "/" + prefix + "XXXXXX";
+  const auto descriptor = mkstemp(&name[0]);
+  if (descriptor < 0)
+    throw FileOpenException{name};
+  close(descriptor);
+  return name;
+}
+
+uint64_t name_hash(const char* name) {
+  auto hash = uint64_t{0xcbf29ce484222325ull};
+  for (const auto* c = name; *c != '\0'; ++c)
+    hash = (hash ^ uint8_t(*c)) * 0x100000001b3ull;
+  return hash;
+}
+
 }
 }
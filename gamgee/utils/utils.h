@@ -1,6 +1,7 @@
 #ifndef gamgee__utils__guard
 #define gamgee__utils__guard
 
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <vector>
@@ -53,6 +54,21 @@ char complement (const char base);
  */
 std::vector<std::string> hts_string_array_to_vector(const char * const * const string_array, const uint32_t array_size);
 
+/**
+ * @brief creates an empty, uniquely named file for temporary data
+ * @param directory where to create the file. Empty means $TMPDIR, or /tmp if that is not set.
+ * @param prefix beginning of the file name
+ * @return the name of the file (removing it is up to the caller)
+ * @exception throws a FileOpenException if the file cannot be created
+ */
+std::string make_temp_file(const std::string& directory, const std::string& prefix);
+
+/**
+ * @brief 64 bit FNV-1a hash of a read name (to look up mates by name without keeping or comparing the names)
+ * @param name a null-terminated read name
+ */
+uint64_t name_hash(const char* name);
+
 /**
  * @brief checks that an index is greater than or equal to size
  * @param index the index between 0 and size to check
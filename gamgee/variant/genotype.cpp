@@ -11,7 +11,7 @@ using namespace std;
 /**
  * @note Most of the patterns here are directly copied or adapted from htslib.
  */
-Genotype::Genotype(const std::shared_ptr<bcf1_t>& body, const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr) :
+Genotype::Genotype(const utils::VariantHandle& body, const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr) :
   m_body {body},
   m_format_ptr {format_ptr},
   m_data_ptr {data_ptr} {
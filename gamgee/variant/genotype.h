@@ -27,7 +27,7 @@ class Genotype{
    * @param format_ptr The GT field from the line.
    * @param data_ptr The GT for this sample.
    */
-  Genotype(const std::shared_ptr<bcf1_t>& body, const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr);
+  Genotype(const utils::VariantHandle& body, const bcf_fmt_t* const format_ptr, const uint8_t* data_ptr);
 
   /**
    * @brief copying of the Genotype object is not allowed.
@@ -346,7 +346,7 @@ class Genotype{
   }
 
  private:
-  std::shared_ptr<bcf1_t> m_body;
+  utils::VariantHandle m_body;
   const bcf_fmt_t* m_format_ptr;
   const uint8_t* m_data_ptr;
 
@@ -43,6 +43,7 @@ bool IndexedVariantIterator::operator!=(const IndexedVariantIterator& rhs) {
  * @warning we're reusing the existing htslib memory, so users should be aware that all objects from the previous iteration are now stale unless a deep copy has been performed
  */
 void IndexedVariantIterator::fetch_next_record() {
+  m_variant_record_ptr = m_variant_record.reusable_body();  ///< copies of the previous record may still be sharing its buffer
   while (bcf_itr_next(m_variant_file_ptr, m_index_iter_ptr.get(), m_variant_record_ptr.get()) < 0) {
     ++m_interval_iter;
     if (m_interval_list.end() == m_interval_iter) {
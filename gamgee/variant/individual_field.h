@@ -78,7 +78,7 @@ class IndividualField {
    * @param format_ptr a structure with a pointer to the location in the raw byte array (m_body->indiv) where the format field starts and information about the values (size, type, number,...)
    * @note this implementation doesn't make any copies, simply manages the access to the raw byte array in Variant giving iterator interfaces to the users
    */
-  explicit IndividualField(const std::shared_ptr<bcf1_t>& body, bcf_fmt_t* format_ptr) :
+  explicit IndividualField(const utils::VariantHandle& body, bcf_fmt_t* format_ptr) :
     m_body {body}, m_format_ptr {format_ptr} 
   {}
 
@@ -165,7 +165,7 @@ class IndividualField {
   TYPE back() const { return operator[](m_body->n_sample - 1); }   ///< @brief convenience function to access the last element
 
  private:
-  std::shared_ptr<bcf1_t> m_body; ///< shared ownership of the Variant record memory so it stays alive while this object is in scope
+  utils::VariantHandle m_body; ///< shared ownership of the Variant record memory so it stays alive while this object is in scope
   bcf_fmt_t*  m_format_ptr;  ///< pointer to m_body structure where the data for this particular type is located.
 };
 
@@ -1,10 +1,12 @@
 #ifndef gamgee__individual_field_iterator__guard
 #define gamgee__individual_field_iterator__guard 
 
+#include "../utils/record_handle.h"
 #include "../utils/utils.h"
 
 #include "htslib/vcf.h"
 
+#include <cstddef>
 #include<iterator>
 
 namespace gamgee {
@@ -25,8 +27,13 @@ namespace gamgee {
  * performance while maintaining a friendly interface.
  */
 template<class TYPE>
-class IndividualFieldIterator : public std::iterator<std::random_access_iterator_tag, TYPE> {
+class IndividualFieldIterator {
  public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = TYPE;
+  using difference_type = std::ptrdiff_t;
+  using pointer = TYPE*;
+  using reference = TYPE&;
 
   /**
    * @brief simple constructor used by VariantField to create an iterator
@@ -35,7 +42,7 @@ class IndividualFieldIterator : public std::iterator<std::random_access_iterator
    * @param end_iterator whether or not this is being called by the VariantField::end() function.
    * @note this constructor serves only the VariantField::begin() and VariantField::end() functions. 
    */
-  IndividualFieldIterator(const std::shared_ptr<bcf1_t>& body, bcf_fmt_t* format_ptr, bool end_iterator = false) :
+  IndividualFieldIterator(const utils::VariantHandle& body, bcf_fmt_t* format_ptr, bool end_iterator = false) :
     m_body {body}, 
     m_format_ptr {format_ptr},
     m_data_ptr {end_iterator ? format_ptr->p + m_format_ptr->size * m_body->n_sample : format_ptr->p} 
@@ -224,7 +231,7 @@ class IndividualFieldIterator : public std::iterator<std::random_access_iterator
   }
 
  private:
-  std::shared_ptr<bcf1_t> m_body;      ///< shared ownership of the Variant record memory so it stays alive while this object is in scope
+  utils::VariantHandle m_body;      ///< shared ownership of the Variant record memory so it stays alive while this object is in scope
   bcf_fmt_t* m_format_ptr; 			   ///< pointer to the format_field in the body so we can access the tag's information
   uint8_t* m_data_ptr;                 ///< pointer to m_body structure where the data for this particular type is located.
 
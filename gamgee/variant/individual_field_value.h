@@ -55,12 +55,12 @@ class IndividualFieldValue {
 
   /**
    * @brief creates a new IndividualFieldValue poiinting to the shared byte array inside the variant object
-   * @copydetails IndividualField::IndividualField(const std::shared_ptr<bcf1_t>&, bcf_fmt_t*)
+   * @copydetails IndividualField::IndividualField(const utils::VariantHandle&, bcf_fmt_t*)
    * @param body the the bcf1_t structure to hold a shared pointer to
    * @param format_ptr the format field pointer inside the body
    * @param data_ptr the location in the specific value inside the format_ptr byte array
    */
-  IndividualFieldValue(const std::shared_ptr<bcf1_t>& body, const bcf_fmt_t* const format_ptr, uint8_t* const data_ptr) :
+  IndividualFieldValue(const utils::VariantHandle& body, const bcf_fmt_t* const format_ptr, uint8_t* const data_ptr) :
     m_body {body},
     m_format_ptr {format_ptr},
     m_data_ptr {data_ptr},
@@ -181,7 +181,7 @@ class IndividualFieldValue {
   }
 
  private:
-  std::shared_ptr<bcf1_t> m_body;
+  utils::VariantHandle m_body;
   const bcf_fmt_t* m_format_ptr;
   uint8_t* m_data_ptr;
   uint8_t m_num_bytes;
@@ -1,10 +1,12 @@
 #ifndef gamgee__individual_field_value_iterator__guard
 #define gamgee__individual_field_value_iterator__guard
 
+#include "../utils/record_handle.h"
 #include "../utils/variant_field_type.h"
 
 #include "htslib/vcf.h"
 
+#include <cstddef>
 #include <iterator>
 #include <memory>
 
@@ -28,8 +30,13 @@ namespace gamgee {
  * in the Variant record. 
  */
 template<class VALUE_TYPE>
-class IndividualFieldValueIterator : public std::iterator<std::random_access_iterator_tag, VALUE_TYPE> {
+class IndividualFieldValueIterator {
  public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = VALUE_TYPE;
+  using difference_type = std::ptrdiff_t;
+  using pointer = VALUE_TYPE*;
+  using reference = VALUE_TYPE&;
 
    /**
    * @brief Constructor with bcf1_t structure and start and end pointers of the array/vector 
@@ -41,7 +48,7 @@ class IndividualFieldValueIterator : public std::iterator<std::random_access_ite
    * @note this constructor is probably only used by IndividualFieldValue::begin() and
    * IndividualFieldValue::end()
    */
-  explicit IndividualFieldValueIterator(const std::shared_ptr<bcf1_t>& body, uint8_t* data_ptr, uint8_t* end_ptr, const uint8_t num_bytes, const utils::VariantFieldType& type) :
+  explicit IndividualFieldValueIterator(const utils::VariantHandle& body, uint8_t* data_ptr, uint8_t* end_ptr, const uint8_t num_bytes, const utils::VariantFieldType& type) :
     m_body {body},
     m_current_data_ptr {data_ptr},
     m_original_data_ptr {data_ptr},
@@ -60,7 +67,7 @@ class IndividualFieldValueIterator : public std::iterator<std::random_access_ite
    * @note this constructor is probably only used by IndividualFieldValue::begin() and
    * IndividualFieldValue::end()
    */
-  explicit IndividualFieldValueIterator(const std::shared_ptr<bcf1_t>& body, uint8_t* data_ptr, const uint8_t num_bytes, const utils::VariantFieldType& type): IndividualFieldValueIterator(body, data_ptr, nullptr, num_bytes, type)
+  explicit IndividualFieldValueIterator(const utils::VariantHandle& body, uint8_t* data_ptr, const uint8_t num_bytes, const utils::VariantFieldType& type): IndividualFieldValueIterator(body, data_ptr, nullptr, num_bytes, type)
   {}
   
   /**
@@ -265,7 +272,7 @@ class IndividualFieldValueIterator : public std::iterator<std::random_access_ite
   }
 
  private:
-  std::shared_ptr<bcf1_t> m_body;
+  utils::VariantHandle m_body;
   const uint8_t* m_current_data_ptr;
   const uint8_t* m_original_data_ptr;
   const uint8_t* m_end_data_ptr;
@@ -3,6 +3,7 @@
 
 #include "shared_field_iterator.h"
 
+#include "../utils/record_handle.h"
 #include "../utils/utils.h"
 
 #include "htslib/vcf.h"
@@ -69,7 +70,7 @@ class SharedField {
    * @param body the the bcf1_t structure to hold a shared pointer to
    * @param info_ptr the info field pointer inside the body
    */
-  explicit SharedField(const std::shared_ptr<bcf1_t>& body, const bcf_info_t* const info_ptr) :
+  explicit SharedField(const utils::VariantHandle& body, const bcf_info_t* const info_ptr) :
     m_body {body},
     m_info_ptr {info_ptr},
     m_bytes_per_value {utils::size_for_type(static_cast<utils::VariantFieldType>(info_ptr->type), info_ptr)}
@@ -148,7 +149,7 @@ class SharedField {
   TYPE back() const { return operator[](m_info_ptr->len - 1); }   ///< @brief convenience function to access the last element
 
  private:
-  std::shared_ptr<bcf1_t> m_body;
+  utils::VariantHandle m_body;
   const bcf_info_t* m_info_ptr;
   uint8_t m_bytes_per_value;
 
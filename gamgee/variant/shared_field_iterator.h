@@ -1,10 +1,12 @@
 #ifndef gamgee__shared_field_iterator__guard
 #define gamgee__shared_field_iterator__guard
 
+#include "../utils/record_handle.h"
 #include "../utils/variant_field_type.h"
 
 #include "htslib/vcf.h"
 
+#include <cstddef>
 #include <iterator>
 #include <memory>
 
@@ -25,8 +27,13 @@ namespace gamgee {
  * performance while maintaining a friendly interface.
  */
 template<class VALUE_TYPE>
-class SharedFieldIterator : public std::iterator<std::random_access_iterator_tag, VALUE_TYPE> {
+class SharedFieldIterator {
  public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = VALUE_TYPE;
+  using difference_type = std::ptrdiff_t;
+  using pointer = VALUE_TYPE*;
+  using reference = VALUE_TYPE&;
 
   /**
    * @brief default constructor of an empty iterator
@@ -51,7 +58,7 @@ class SharedFieldIterator : public std::iterator<std::random_access_iterator_tag
    * @param type the encoding of the value 
    * @note this constructor is probably only used by SharedField::begin() and SharedField::end()
    */  
-  explicit SharedFieldIterator(const std::shared_ptr<bcf1_t>& body, uint8_t* data_ptr, uint8_t* end_ptr, const uint8_t bytes_per_value, const utils::VariantFieldType& type) :
+  explicit SharedFieldIterator(const utils::VariantHandle& body, uint8_t* data_ptr, uint8_t* end_ptr, const uint8_t bytes_per_value, const utils::VariantFieldType& type) :
     m_body {body},
     m_current_data_ptr {data_ptr},
     m_original_data_ptr {data_ptr},
@@ -69,7 +76,7 @@ class SharedFieldIterator : public std::iterator<std::random_access_iterator_tag
    * @param type the encoding of the value 
    * @note this constructor is probably only used by SharedField::begin() and SharedField::end()
    */
-  explicit SharedFieldIterator(const std::shared_ptr<bcf1_t>& body, uint8_t* data_ptr, const uint8_t bytes_per_value, const utils::VariantFieldType& type): SharedFieldIterator(body, data_ptr, nullptr, bytes_per_value, type)
+  explicit SharedFieldIterator(const utils::VariantHandle& body, uint8_t* data_ptr, const uint8_t bytes_per_value, const utils::VariantFieldType& type): SharedFieldIterator(body, data_ptr, nullptr, bytes_per_value, type)
   {}
    
   SharedFieldIterator(const SharedFieldIterator& other) = default; ///< standard copy constructor creates a new iterator pointing to the same underlying data
@@ -185,7 +192,7 @@ class SharedFieldIterator : public std::iterator<std::random_access_iterator_tag
   }
 
  private:
-  std::shared_ptr<bcf1_t> m_body;
+  utils::VariantHandle m_body;
   const uint8_t* m_current_data_ptr;
   const uint8_t* m_original_data_ptr;
   const uint8_t* m_end_data_ptr;
@@ -8,6 +8,10 @@
 
 #include "htslib/vcf.h"
 
+#include <array>
+#include <cstdint>
+#include <mutex>
+
 using namespace std;
 namespace gamgee {
 
@@ -38,6 +42,28 @@ SharedField<FIELD_TYPE> Variant::shared_field_as(const INDEX_OR_TAG& p) const {
   return SharedField<FIELD_TYPE>{m_body, field_ptr};
 }
 
+/**
+ * @brief the lock the copies sharing a body take to unpack it (a few locks are shared by all the bodies, to keep
+ * copies as cheap as a reference count increment)
+ */
+static mutex& unpack_lock(const bcf1_t* body) {
+  static auto locks = array<mutex, 64>{};
+  return locks[(reinterpret_cast<uintptr_t>(body) >> 6) % locks.size()];
+}
+
+/**
+ * @brief bcf_unpack() writes the unpacked fields to the body (once), so copies sharing it, possibly read from
+ * several threads, unpack it under a lock. A body no copy shares is unpacked as usual.
+ */
+void Variant::unpack(const int which) const {
+  if (!m_copies.shared()) {
+    bcf_unpack(m_body.get(), which);
+    return;
+  }
+  const auto lock = lock_guard<mutex>{unpack_lock(m_body.get())};
+  bcf_unpack(m_body.get(), which);
+}
+
 AlleleType Variant::allele_type_from_difference(const int diff) const {
   if (diff == 0)
     return AlleleType::SNP;
@@ -53,13 +79,13 @@ AlleleType Variant::allele_type_from_difference(const int diff) const {
  * @brief creates a variant record that points to htslib memory already allocated
  * @note the resulting Variant shares ownership of the pre-allocated memory via shared_ptr reference counting
  */
-Variant::Variant(const std::shared_ptr<bcf_hdr_t>& header, const std::shared_ptr<bcf1_t>& body) noexcept :
+Variant::Variant(const std::shared_ptr<bcf_hdr_t>& header, const utils::VariantHandle& body) noexcept :
   m_header {header},
   m_body {body}
 {}
 
 /**
- * @brief creates a deep copy of a variant record
+ * @brief creates a copy-on-write copy of a variant record (sharing the htslib memory until either one is modified)
  *
  * @note does not perform a deep copy of the variant header; to copy the header,
  *       first get it via the header() function and then copy it via the usual C++
@@ -67,11 +93,12 @@ Variant::Variant(const std::shared_ptr<bcf_hdr_t>& header, const std::shared_ptr
  */
 Variant::Variant(const Variant& other) :
   m_header {other.m_header.m_header},   // Avoid a deep copy here by constructing using other's internal shared header pointer
-  m_body {utils::make_shared_variant(utils::variant_deep_copy(other.m_body.get()))}
+  m_body {other.m_body},
+  m_copies {share(other)}
 {}
 
 /**
- * @brief creates a deep copy of a variant record
+ * @brief copy-on-write assignment of a variant record (sharing the htslib memory until either one is modified)
  * @param other the Variant to be copied
  * @note does not perform a deep copy of the variant header; to copy the header,
  *       first get it via the header() function and then copy it via the usual C++
@@ -81,36 +108,64 @@ Variant& Variant::operator=(const Variant& other) {
   if ( &other == this )  
     return *this;
   m_header = VariantHeader{other.m_header.m_header};    // Avoid a deep copy here by constructing using other's internal shared header pointer
-  m_body = utils::make_shared_variant(utils::variant_deep_copy(other.m_body.get()));  ///< shared_ptr assignment will take care of deallocating old record if necessary
+  m_body = other.m_body;                                ///< shared_ptr assignment will take care of deallocating old record if necessary
+  m_copies = share(other);
   return *this;
 }
 
+/**
+ * @brief the body is shared as it is (packed or not): the copies unpack what they read lazily (see unpack())
+ */
+utils::CopyOnWriteGroup Variant::share(const Variant& original) {
+  if (original.m_body == nullptr)
+    return utils::CopyOnWriteGroup{};
+  return original.m_copies.join();
+}
+
+void Variant::unshare() {
+  m_body = utils::make_shared_variant(utils::variant_deep_copy(m_body.get()));
+  m_copies.leave();
+}
+
+/**
+ * @brief iterators call this before reading the next record into the buffer they served this one from: the
+ * copies the caller took keep the old buffer and the iterator moves on to a new one
+ */
+const utils::VariantHandle& Variant::reusable_body() {
+  if (m_copies.shared()) {
+    m_body = utils::VariantHandle::create();
+    m_copies.leave();
+  }
+  return m_body;
+}
+
 
 /******************************************************************************
  * General record API                                                         *
  ******************************************************************************/
 std::string Variant::id () const {
-  bcf_unpack(m_body.get(), BCF_UN_STR);
+  unpack(BCF_UN_STR);
   return std::string{m_body->d.id};
 }
 
 std::string Variant::ref() const {
-  bcf_unpack(m_body.get(), BCF_UN_STR);
+  unpack(BCF_UN_STR);
   return n_alleles() > 0 ?  string{m_body.get()->d.allele[0]} : string{}; 
 }
 
 std::vector<std::string> Variant::alt() const {
-  bcf_unpack(m_body.get(), BCF_UN_STR);
+  unpack(BCF_UN_STR);
   const auto n_all = n_alleles();
   return n_all > 1 ? utils::hts_string_array_to_vector(m_body.get()->d.allele+1, n_all-1) : vector<string>{}; // skip the first allele because it's the ref
 }
 
 VariantFilters Variant::filters() const {
-  bcf_unpack(m_body.get(), BCF_UN_FLT);
+  unpack(BCF_UN_FLT);
   return VariantFilters{m_header.m_header, m_body};
 }
 
 bool Variant::has_filter(const std::string& filter) const {
+  unpack(BCF_UN_FLT);
   return bcf_has_filter(m_header.m_header.get(), m_body.get(), const_cast<char*>(filter.c_str())) > 0; // have to cast away the constness here for the C api to work. But the promise still remains as the C function is not modifying the string.
 }
 
@@ -250,7 +305,7 @@ SharedField<string> Variant::shared_field_as_string(const int32_t index) const {
 }
 
 IndividualField<Genotype> Variant::genotypes() const {
-  // bcf_get_fmt() will unpack the record if necessary
+  unpack(BCF_UN_STR | BCF_UN_FMT);   // the genotypes read the alleles too
   const auto fmt = bcf_get_fmt(m_header.m_header.get(), m_body.get(), "GT");
   if (fmt == nullptr) ///< if the variant is missing or the GT tag is missing, return an empty IndividualField
     return IndividualField<Genotype>{};
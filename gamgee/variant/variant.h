@@ -8,6 +8,7 @@
 #include "variant_filters.h"
 #include "genotype.h"
 
+#include "../utils/hts_memory.h"
 #include "../utils/variant_utils.h"
 
 #include "htslib/sam.h"
@@ -25,13 +26,18 @@ enum class DiploidPLGenotype { HOM_REF = 0, HET = 1, HOM_VAR = 2};
 
 /**
  * @brief Utility class to manipulate a Variant record.
+ *
+ * Copies are copy-on-write: a copy shares the htslib memory of the original until one of them is modified, so
+ * copying records just to read them (e.g. to fan them out to other threads) is a reference count increment.
+ * The body is shared as it was read (possibly still packed): each accessor unpacks only the parts it reads, and
+ * while copies share the body they do so under one of a few striped locks, since bcf_unpack() writes to it.
  */
 class Variant {
  public:
   Variant() = default;                                                                                        ///< initializes a null Variant @note this is only used internally by the iterators @warning if you need to create a Variant from scratch, use the builder instead
-  explicit Variant(const std::shared_ptr<bcf_hdr_t>& header, const std::shared_ptr<bcf1_t>& body) noexcept;   ///< creates a Variant given htslib objects. @note used by all iterators
-  Variant(const Variant& other);                                                                              ///< makes a deep copy of a Variant and it's header. Shared pointers maintain state to all other associated objects correctly.
-  Variant& operator=(const Variant& other);                                                                   ///< deep copy assignment of a Variant and it's header. Shared pointers maintain state to all other associated objects correctly.
+  explicit Variant(const std::shared_ptr<bcf_hdr_t>& header, const utils::VariantHandle& body) noexcept;   ///< creates a Variant given htslib objects. @note used by all iterators
+  Variant(const Variant& other);                                                                              ///< makes a copy-on-write copy of a Variant (sharing the htslib memory until either one is modified). Shared pointers maintain state to all other associated objects correctly.
+  Variant& operator=(const Variant& other);                                                                   ///< copy-on-write assignment of a Variant (sharing the htslib memory until either one is modified). Shared pointers maintain state to all other associated objects correctly.
   Variant(Variant&& other) = default;                                                                         ///< moves Variant and it's header accordingly. Shared pointers maintain state to all other associated objects correctly.
   Variant& operator=(Variant&& other) = default;                                                              ///< move assignment of a Variant and it's header. Shared pointers maintain state to all other associated objects correctly.
 
@@ -173,12 +179,13 @@ class Variant {
 
  private:
   VariantHeader m_header;                                                                        ///< variant header
-  std::shared_ptr<bcf1_t> m_body;                                                                ///< htslib variant body pointer
+  utils::VariantHandle m_body;                                                                ///< htslib variant body pointer
+  utils::CopyOnWriteGroup m_copies;                                                              ///< copies of this record sharing m_body until one of them is modified
 
-  bcf_fmt_t*  find_individual_field(const std::string& tag) const { return bcf_get_fmt(m_header.m_header.get(), m_body.get(), tag.c_str());  }
-  bcf_info_t* find_shared_field(const std::string& tag)     const { return bcf_get_info(m_header.m_header.get(), m_body.get(), tag.c_str()); }
-  bcf_fmt_t*  find_individual_field(const uint32_t index) const { return bcf_get_fmt_id(m_body.get(), index); }
-  bcf_info_t* find_shared_field(const uint32_t index)     const { return bcf_get_info_id(m_body.get(), index); }
+  bcf_fmt_t*  find_individual_field(const std::string& tag) const { unpack(BCF_UN_FMT); return bcf_get_fmt(m_header.m_header.get(), m_body.get(), tag.c_str());  }
+  bcf_info_t* find_shared_field(const std::string& tag)     const { unpack(BCF_UN_INFO); return bcf_get_info(m_header.m_header.get(), m_body.get(), tag.c_str()); }
+  bcf_fmt_t*  find_individual_field(const uint32_t index) const { unpack(BCF_UN_FMT); return bcf_get_fmt_id(m_body.get(), index); }
+  bcf_info_t* find_shared_field(const uint32_t index)     const { unpack(BCF_UN_INFO); return bcf_get_info_id(m_body.get(), index); }
   bool check_field(const int32_t type_field, const int32_t type_value, const int32_t index) const;
   inline AlleleType allele_type_from_difference(const int diff) const;
 
@@ -187,16 +194,25 @@ class Variant {
 
   friend class VariantWriter;
   friend class VariantBuilder; ///< builder needs access to the internals in order to build efficiently
+  friend class VariantIterator; ///< iterators only reuse their record buffer if no copies are sharing it
+  friend class IndexedVariantIterator;
+
+  static utils::CopyOnWriteGroup share(const Variant& original);                                 ///< joins the copies of original
+  void unpack(const int which) const;                                                            ///< unpacks the parts of m_body the caller needs (bcf_unpack() writes to the body, so the copies sharing it take turns)
+  void detach() { if (m_copies.shared()) unshare(); }                                            ///< makes sure no copies share m_body before modifying it
+  void unshare();                                                                                ///< replaces m_body by a private deep copy and leaves the copies
+  const utils::VariantHandle& reusable_body();                                                ///< the buffer an iterator can read the next record into: m_body, or a new one if copies are still sharing it
 
   // TODO: remove this friendship and these mutators after Issue #320 is resolved
 
   friend class ReferenceBlockSplittingVariantIterator;
 
-  inline void set_alignment_start(const int32_t start) { m_body->pos = start - 1; }
-  inline void set_alignment_stop(const int32_t end) { m_body->rlen = end - m_body->pos; }
+  inline void set_alignment_start(const int32_t start) { detach(); m_body->pos = start - 1; }
+  inline void set_alignment_stop(const int32_t end) { detach(); m_body->rlen = end - m_body->pos; }
 
   inline void set_reference_allele(const char* ref, const int32_t ref_length)
   {
+    detach();
     bcf_unpack(m_body.get(), BCF_UN_STR);
     //Try to avoid calling bcf_update_alleles as it causes significant overhead in
     //terms of memory re-allocation etc.
@@ -508,7 +508,7 @@ VariantBuilderMultiSampleVector<float> VariantBuilder::get_float_multi_sample_ve
  ******************************************************************************/
 
 Variant VariantBuilder::build() const {
-  const auto new_variant_body = utils::make_shared_variant(bcf_init1());
+  const auto new_variant_body = utils::VariantHandle::create();
 
   // Always build from scratch for now, until support for building from a starting variant is added
   build_from_scratch(new_variant_body);
@@ -538,7 +538,7 @@ VariantBuilder& VariantBuilder::clear() {
  *
  ******************************************************************************/
 
-void VariantBuilder::build_from_scratch(const std::shared_ptr<bcf1_t>& new_variant_body) const {
+void VariantBuilder::build_from_scratch(const utils::VariantHandle& new_variant_body) const {
   // Missing rid/pos are errors that will be caught in post-build validation (if validation is turned on)
   new_variant_body->rid = m_contig.is_set() ? m_contig.field_value() : missing_values::int32;
   new_variant_body->pos = m_start_pos.is_set() ? m_start_pos.field_value() : missing_values::int32;
@@ -576,7 +576,7 @@ void VariantBuilder::build_from_scratch(const std::shared_ptr<bcf1_t>& new_varia
   }
 }
 
-void VariantBuilder::post_build_validation(const std::shared_ptr<bcf1_t>& new_variant_body) const {
+void VariantBuilder::post_build_validation(const utils::VariantHandle& new_variant_body) const {
   // Note that we only do validation of core (non-data-region) fields here.
   // The data region fields are validated in the VariantBuilderSharedRegion and
   // VariantBuilderIndividualRegion/VariantBuilderIndividualField classes.
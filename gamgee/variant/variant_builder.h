@@ -1323,8 +1323,8 @@ class VariantBuilder {
   VariantBuilderIndividualRegion m_individual_region;
   bool m_enable_validation;
 
-  void build_from_scratch(const std::shared_ptr<bcf1_t>& new_variant_body) const;
-  void post_build_validation(const std::shared_ptr<bcf1_t>& new_variant_body) const;
+  void build_from_scratch(const utils::VariantHandle& new_variant_body) const;
+  void post_build_validation(const utils::VariantHandle& new_variant_body) const;
 };
 
 }
@@ -27,7 +27,7 @@ class VariantFilters {
    * @param header an htslib variant header to keep shared ownership of the memory
    * @param body an htslib variant body to keep shared ownership of the memory
    */
-  explicit VariantFilters(const std::shared_ptr<bcf_hdr_t>& header, const std::shared_ptr<bcf1_t>& body) : m_header {header}, m_body {body} {}
+  explicit VariantFilters(const std::shared_ptr<bcf_hdr_t>& header, const utils::VariantHandle& body) : m_header {header}, m_body {body} {}
 
   /**
    * @brief random access operator
@@ -57,7 +57,7 @@ class VariantFilters {
 
  private:
   std::shared_ptr<bcf_hdr_t> m_header; ///< shared ownership of the VariantHeader record memory so it stays alive while this object is in scope
-  std::shared_ptr<bcf1_t> m_body;      ///< shared ownership of the Variant record memory so it stays alive while this object is in scope
+  utils::VariantHandle m_body;      ///< shared ownership of the Variant record memory so it stays alive while this object is in scope
 
 };
 
@@ -7,6 +7,8 @@
 
 #include "htslib/vcf.h"
 
+#include <cstddef>
+#include <iterator>
 #include <string>
 #include <memory>
 
@@ -15,8 +17,13 @@ namespace gamgee {
 /**
  * @brief simple random-access iterator class for VariantFilters objects
  */
-class VariantFiltersIterator : public std::iterator<std::random_access_iterator_tag, std::string> {
+class VariantFiltersIterator {
  public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = std::string;
+  using difference_type = std::ptrdiff_t;
+  using pointer = std::string*;
+  using reference = std::string&;
 
   /**
    * @brief simple constructor used by the VariantFilters begin/end member functions
@@ -24,7 +31,7 @@ class VariantFiltersIterator : public std::iterator<std::random_access_iterator_
    * @param body an htslib variant body to keep shared ownership of the memory
    * @param position current position in the iterator (starts at 0, normally)
    */
-  VariantFiltersIterator(const std::shared_ptr<bcf_hdr_t>& header, const std::shared_ptr<bcf1_t>& body, const uint32_t position) : 
+  VariantFiltersIterator(const std::shared_ptr<bcf_hdr_t>& header, const utils::VariantHandle& body, const uint32_t position) : 
     m_header {header},
     m_body {body},
     m_position {position} 
@@ -47,7 +54,7 @@ class VariantFiltersIterator : public std::iterator<std::random_access_iterator_
 
  private:
   std::shared_ptr<bcf_hdr_t> m_header; ///< shared ownership of the VariantHeader record memory so it stays alive while this object is in scope
-  std::shared_ptr<bcf1_t> m_body;      ///< shared ownership of the Variant record memory so it stays alive while this object is in scope
+  utils::VariantHandle m_body;      ///< shared ownership of the Variant record memory so it stays alive while this object is in scope
   uint32_t m_position;                 ///< current position in the iterator
 };
 
@@ -10,7 +10,7 @@ namespace gamgee {
 VariantIterator::VariantIterator(const std::shared_ptr<htsFile>& variant_file_ptr, const std::shared_ptr<bcf_hdr_t>& variant_header_ptr) :
   m_variant_file_ptr {variant_file_ptr},
   m_variant_header_ptr {variant_header_ptr},
-  m_variant_record_ptr {utils::make_shared_variant(bcf_init1())},      ///< important to initialize the record buffer in the constructor so we can reuse it across the iterator
+  m_variant_record_ptr {utils::VariantHandle::create()},      ///< important to initialize the record buffer in the constructor so we can reuse it across the iterator
   m_variant_record {m_variant_header_ptr, m_variant_record_ptr}
 {
   fetch_next_record();
@@ -35,9 +35,11 @@ bool VariantIterator::empty() const {
 
 /**
  * @brief pre-fetches the next variant record
- * @warning we're reusing the existing htslib memory, so users should be aware that all objects from the previous iteration are now stale unless a deep copy has been performed
+ * @warning we're reusing the existing htslib memory, so users should be aware that all objects from the previous iteration are now stale unless a copy has been made
+ * @note the memory is only reused if no copies of the previous record are sharing it
  */
 void VariantIterator::fetch_next_record() {
+ m_variant_record_ptr = m_variant_record.reusable_body();
  if (bcf_read1(m_variant_file_ptr.get(), m_variant_header_ptr.get(), m_variant_record_ptr.get()) < 0) {
     m_variant_file_ptr.reset();
     m_variant_record = Variant{};
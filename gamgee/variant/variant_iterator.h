@@ -83,7 +83,7 @@ class VariantIterator {
  protected:
   std::shared_ptr<htsFile> m_variant_file_ptr;          ///< pointer to the vcf/bcf file
   std::shared_ptr<bcf_hdr_t> m_variant_header_ptr;      ///< pointer to the variant header
-  std::shared_ptr<bcf1_t> m_variant_record_ptr;         ///< pointer to the internal structure of the variant record. Useful to only allocate it once.
+  utils::VariantHandle m_variant_record_ptr;         ///< pointer to the internal structure of the variant record. Useful to only allocate it once.
   Variant m_variant_record;                             ///< temporary record to hold between fetch (operator++) and serve (operator*)
 
   virtual void fetch_next_record();                     ///< fetches next Variant record into existing htslib memory without making a copy
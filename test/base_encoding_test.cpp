@@ -0,0 +1,201 @@
+#include "utils/base_encoding.h"
+#include "sam/read_bases.h"
+
+#include "htslib/sam.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace gamgee::utils;
+
+BOOST_AUTO_TEST_CASE( encode_bases_matches_htslib_for_every_character )
+{
+  // every byte value, at every position of a vector (and the scalar remainder)
+  auto ascii = string(256 + 64 + 1, '\0');
+  for (auto i = 0u; i != ascii.size(); ++i)
+    ascii[i] = char(i);
+  for (const auto offset : {0u, 64u, 65u}) {
+    const auto bases = ascii.substr(offset) + ascii.substr(0, offset);
+    auto packed = vector<uint8_t>((bases.size() + 1) / 2, 0xaa);
+    encode_bases(bases.data(), bases.size(), packed.data());
+    for (auto i = 0u; i != bases.size(); ++i)
+      BOOST_CHECK_EQUAL(int(bam_seqi(packed.data(), i)), int(seq_nt16_table[uint8_t(bases[i])]));
+    BOOST_CHECK_EQUAL(packed.back() & 0xf, 0);   // odd number of bases: the last low nibble is zeroed
+  }
+}
+
+BOOST_AUTO_TEST_CASE( decode_bases_matches_htslib_for_every_code )
+{
+  for (auto num_bases = 0u; num_bases != 200; ++num_bases) {
+    auto packed = vector<uint8_t>((num_bases + 1) / 2 + 1);
+    for (auto i = 0u; i != packed.size(); ++i)
+      packed[i] = uint8_t(i * 37 + num_bases);   // all pairs of codes show up across the lengths
+    auto ascii = string(num_bases + 1, '!');
+    decode_bases(packed.data(), num_bases, &ascii[0]);
+    for (auto i = 0u; i != num_bases; ++i)
+      BOOST_CHECK_EQUAL(ascii[i], seq_nt16_str[bam_seqi(packed.data(), i)]);
+    BOOST_CHECK_EQUAL(ascii[num_bases], '!');    // nothing written past the last base
+  }
+}
+
+BOOST_AUTO_TEST_CASE( encode_decode_round_trip )
+{
+  const auto iupac = string{"=ACMGRSVTWYHKDBN"};
+  for (auto num_bases = 0u; num_bases != 300; ++num_bases) {
+    auto bases = string(num_bases, 'A');
+    for (auto i = 0u; i != num_bases; ++i)
+      bases[i] = iupac[(i * 7 + num_bases) % iupac.size()];
+    auto packed = vector<uint8_t>((num_bases + 1) / 2);
+    encode_bases(bases.data(), num_bases, packed.data());
+    auto decoded = string(num_bases, '\0');
+    decode_bases(packed.data(), num_bases, &decoded[0]);
+    BOOST_CHECK_EQUAL(decoded, bases);
+  }
+  const auto lower_case = string{"acgtnacgtnacgtnacgtnacgtnacgtnacgtnacgtnacgtnacgtnacgtnacgtnacgtnacgtn"};
+  auto packed = vector<uint8_t>((lower_case.size() + 1) / 2);
+  encode_bases(lower_case.data(), lower_case.size(), packed.data());
+  auto decoded = string(lower_case.size(), '\0');
+  decode_bases(packed.data(), lower_case.size(), &decoded[0]);
+  BOOST_CHECK_EQUAL(decoded, string{"ACGTNACGTNACGTNACGTNACGTNACGTNACGTNACGTNACGTNACGTNACGTNACGTNACGTNACGTN"});
+}
+
+BOOST_AUTO_TEST_CASE( base_values_round_trip_for_every_code )
+{
+  using gamgee::Base;
+  for (auto num_bases = 0u; num_bases != 300; ++num_bases) {
+    auto packed = vector<uint8_t>((num_bases + 1) / 2 + 1);
+    for (auto i = 0u; i != packed.size(); ++i)
+      packed[i] = uint8_t(i * 37 + num_bases);   // all pairs of codes show up across the lengths
+    if (num_bases & 1)
+      packed[num_bases / 2] &= 0xf0;
+    auto bases = vector<Base>(num_bases + 1, Base::A);
+    decode_bases(packed.data(), num_bases, bases.data());
+    for (auto i = 0u; i != num_bases; ++i)
+      BOOST_CHECK_EQUAL(int(bases[i]), int(bam_seqi(packed.data(), i)));
+    BOOST_CHECK(bases[num_bases] == Base::A);    // nothing written past the last base
+    auto encoded = vector<uint8_t>(packed.size(), 0xaa);
+    encode_bases(bases.data(), num_bases, encoded.data());
+    BOOST_CHECK(equal(encoded.begin(), encoded.end() - 1, packed.begin()));
+    BOOST_CHECK_EQUAL(int(encoded.back()), 0xaa);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( decode_2bit_bases_for_every_code )
+{
+  for (auto num_bases = 0u; num_bases != 300; ++num_bases) {
+    auto packed = vector<uint8_t>((num_bases + 3) / 4 + 1);
+    for (auto i = 0u; i != packed.size(); ++i)
+      packed[i] = uint8_t(i * 37 + num_bases);   // all the bytes show up across the lengths
+    auto ascii = string(num_bases + 1, '!');
+    decode_2bit_bases(packed.data(), num_bases, &ascii[0]);
+    for (auto i = 0u; i != num_bases; ++i)
+      BOOST_CHECK_EQUAL(ascii[i], "ACGT"[packed[i / 4] >> (6 - 2 * (i % 4)) & 3]);
+    BOOST_CHECK_EQUAL(ascii[num_bases], '!');    // nothing written past the last base
+  }
+}
+
+BOOST_AUTO_TEST_CASE( complement_bases_for_every_character )
+{
+  const auto complement_of = [](const char c) {
+    const auto bases = string{"ACGTacgt"};
+    const auto position = bases.find(c);
+    return position == string::npos ? c : string{"TGCAtgca"}[position];
+  };
+  auto characters = string(256, '\0');
+  for (auto i = 0u; i != characters.size(); ++i)
+    characters[i] = char(i);
+  for (auto num_bases = 0u; num_bases != 300; ++num_bases) {
+    auto bases = string(num_bases, '\0');
+    for (auto i = 0u; i != num_bases; ++i)
+      bases[i] = characters[(i * 37 + num_bases) % 256];   // all the characters show up across the lengths
+    auto expected_complement = bases;
+    transform(bases.begin(), bases.end(), expected_complement.begin(), complement_of);
+    const auto expected_reverse_complement = string{expected_complement.rbegin(), expected_complement.rend()};
+    auto result = string(num_bases + 1, '!');
+    complement_bases(bases.data(), num_bases, &result[0]);
+    BOOST_CHECK_EQUAL(result, expected_complement + "!");   // nothing written past the last base
+    reverse_complement_bases(bases.data(), num_bases, &result[0]);
+    BOOST_CHECK_EQUAL(result, expected_reverse_complement + "!");
+    auto in_place = bases;
+    complement_bases(in_place.data(), num_bases, &in_place[0]);
+    BOOST_CHECK_EQUAL(in_place, expected_complement);
+    in_place = bases;
+    reverse_complement_bases(&in_place[0], num_bases);
+    BOOST_CHECK_EQUAL(in_place, expected_reverse_complement);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( reverse_complement_encoded_bases_for_every_code )
+{
+  const auto complement_of = [](const uint8_t code) { return uint8_t((code & 1) << 3 | (code & 2) << 1 | (code & 4) >> 1 | (code & 8) >> 3); };
+  BOOST_CHECK_EQUAL(int(complement_of(seq_nt16_table[uint8_t('A')])), int(seq_nt16_table[uint8_t('T')]));
+  BOOST_CHECK_EQUAL(int(complement_of(seq_nt16_table[uint8_t('R')])), int(seq_nt16_table[uint8_t('Y')]));
+  for (auto num_bases = 0u; num_bases != 300; ++num_bases) {
+    const auto num_bytes = (num_bases + 1) / 2;
+    auto packed = vector<uint8_t>(num_bytes);
+    for (auto i = 0u; i != num_bytes; ++i)
+      packed[i] = uint8_t(i * 37 + num_bases);   // all the bytes show up across the lengths (odd lengths: padding isn't zero)
+    auto result = vector<uint8_t>(num_bytes + 1, 0xaa);
+    reverse_complement_encoded_bases(packed.data(), num_bases, result.data());
+    auto in_place = packed;
+    reverse_complement_encoded_bases(in_place.data(), num_bases);
+    for (auto i = 0u; i != num_bases; ++i) {
+      const auto expected = complement_of(bam_seqi(packed.data(), num_bases - 1 - i));
+      BOOST_CHECK_EQUAL(int(bam_seqi(result.data(), i)), int(expected));
+      BOOST_CHECK_EQUAL(int(bam_seqi(in_place.data(), i)), int(expected));
+    }
+    if (num_bases & 1) {   // the last low nibble is zeroed
+      BOOST_CHECK_EQUAL(result[num_bytes - 1] & 0xf, 0);
+      BOOST_CHECK_EQUAL(in_place[num_bytes - 1] & 0xf, 0);
+    }
+    BOOST_CHECK_EQUAL(result[num_bytes], 0xaa);   // nothing written past the last byte
+  }
+}
+
+BOOST_AUTO_TEST_CASE( phred33_round_trip )
+{
+  for (auto num_quals = 0u; num_quals != 100; ++num_quals) {
+    auto quals = vector<uint8_t>(num_quals);
+    for (auto i = 0u; i != num_quals; ++i)
+      quals[i] = uint8_t((i * 13 + num_quals) % 94);
+    auto ascii = string(num_quals, '\0');
+    encode_phred33(quals.data(), num_quals, &ascii[0]);
+    for (auto i = 0u; i != num_quals; ++i)
+      BOOST_CHECK_EQUAL(ascii[i], char(quals[i] + 33));
+    auto decoded = vector<uint8_t>(num_quals);
+    decode_phred33(ascii.data(), num_quals, decoded.data());
+    BOOST_CHECK(decoded == quals);
+  }
+  const auto missing = vector<uint8_t>(20, 0xff);
+  auto ascii = string(20, '\0');
+  encode_phred33(missing.data(), 20, &ascii[0]);
+  BOOST_CHECK_EQUAL(ascii, string(20, '~'));
+}
+
+BOOST_AUTO_TEST_CASE( lookup_quals_for_every_quality )
+{
+  for (const auto table_end : {0u, 1u, 16u, 41u, 200u, 256u}) {
+    auto table = array<uint8_t, 256>{};
+    for (auto quality = 0u; quality != table.size(); ++quality)
+      table[quality] = quality < table_end ? uint8_t(quality * 7 + 3) : uint8_t(99);
+    for (auto num_quals = 0u; num_quals != 300; ++num_quals) {
+      auto quals = vector<uint8_t>(num_quals);
+      for (auto i = 0u; i != num_quals; ++i)
+        quals[i] = uint8_t(i * 37 + num_quals);   // all the qualities show up across the lengths
+      auto result = vector<uint8_t>(num_quals + 1, 0xaa);
+      lookup_quals(table.data(), table_end, quals.data(), num_quals, result.data());
+      auto in_place = quals;
+      lookup_quals(table.data(), table_end, in_place.data(), num_quals, in_place.data());
+      for (auto i = 0u; i != num_quals; ++i) {
+        BOOST_CHECK_EQUAL(int(result[i]), int(table[quals[i]]));
+        BOOST_CHECK_EQUAL(int(in_place[i]), int(table[quals[i]]));
+      }
+      BOOST_CHECK_EQUAL(result[num_quals], 0xaa);   // nothing written past the last quality
+    }
+  }
+}
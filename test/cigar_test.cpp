@@ -2,6 +2,10 @@
 
 #include "sam/cigar.h"
 
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
 using namespace std;
 using namespace gamgee;
 
@@ -31,3 +35,21 @@ BOOST_AUTO_TEST_CASE( cigar_consumes_reference_bases ) {
 	BOOST_CHECK(!Cigar::consumes_reference_bases(CigarOperator::P));
 	BOOST_CHECK(!Cigar::consumes_reference_bases(CigarOperator::B));
 }
+
+BOOST_AUTO_TEST_CASE( cigar_parse_string_view ) {
+	auto cigar = string_view{"5S10M2I3D1=1X120N4H"};
+	auto elements = vector<CigarElement>{};
+	while (!cigar.empty())
+		elements.push_back(Cigar::parse_next_cigar_element(cigar));
+	const auto expected = vector<CigarElement>{
+		Cigar::make_cigar_element(5, CigarOperator::S), Cigar::make_cigar_element(10, CigarOperator::M),
+		Cigar::make_cigar_element(2, CigarOperator::I), Cigar::make_cigar_element(3, CigarOperator::D),
+		Cigar::make_cigar_element(1, CigarOperator::EQ), Cigar::make_cigar_element(1, CigarOperator::X),
+		Cigar::make_cigar_element(120, CigarOperator::N), Cigar::make_cigar_element(4, CigarOperator::H)};
+	BOOST_CHECK(elements == expected);
+
+	for (const auto invalid : {"M", "10", "10Q", "10M5", "-1M", "300000000M"}) {
+		auto view = string_view{invalid};
+		BOOST_CHECK_THROW(while (!view.empty()) Cigar::parse_next_cigar_element(view), invalid_argument);
+	}
+}
@@ -0,0 +1,91 @@
+#include "sam/coverage_engine.h"
+#include "exceptions.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace gamgee;
+
+BOOST_AUTO_TEST_CASE( coverage_engine_whole_genome )
+{
+  for (const auto threads : {1u, 4u}) {
+    for (const auto tile_size : {1000u, 1u << 20}) {
+      auto options = CoverageOptions{};
+      options.num_threads = threads;
+      options.tile_size = tile_size;
+      CoverageEngine engine {"testdata/test_simple.bam", options};
+      auto positions = 0u;
+      auto covered = 0u;
+      auto total_depth = 0u;
+      auto expected_start = 1u;
+      engine.for_each_tile([&](const CoverageTile& tile) {
+        BOOST_CHECK_EQUAL(tile.chromosome(), 0u);
+        BOOST_CHECK_EQUAL(tile.start(), expected_start);  // tiles come in reference order
+        BOOST_CHECK_LE(tile.size(), tile_size);
+        expected_start = tile.stop() + 1;
+        for (const auto depth : tile.depths()) {
+          covered += depth > 0;
+          total_depth += depth;
+          ++positions;
+        }
+        if (tile.start() <= 257 && tile.stop() >= 257)
+          BOOST_CHECK_EQUAL(tile.depth(257), 3u);
+      });
+      BOOST_CHECK_EQUAL(positions, 100000u);
+      BOOST_CHECK_EQUAL(covered, 2052u);
+      BOOST_CHECK_EQUAL(total_depth, 33u * 76u);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( coverage_engine_intervals )
+{
+  auto options = CoverageOptions{};
+  options.num_threads = 2;
+  options.tile_size = 10;
+  CoverageEngine engine {"testdata/test_simple.bam", options};
+  const auto intervals = vector<Interval>{Interval{"chr1", 200, 275}, Interval{"chr1", 1, 100}, Interval{"chr1", 255, 256}};
+  const auto summaries = engine.summarize(intervals, {1, 2, 3});
+  BOOST_REQUIRE_EQUAL(summaries.size(), 3u);
+  BOOST_CHECK(summaries[0].interval() == intervals[0]);
+  BOOST_CHECK_CLOSE(summaries[0].mean(), 116.0 / 76.0, 0.0001);
+  BOOST_CHECK_EQUAL(summaries[0].median(), 1u);
+  BOOST_CHECK_CLOSE(summaries[0].fraction_at_least(1), 1.0, 0.0001);
+  BOOST_CHECK_CLOSE(summaries[0].fraction_at_least(2), 21.0 / 76.0, 0.0001);
+  BOOST_CHECK_CLOSE(summaries[0].fraction_at_least(3), 19.0 / 76.0, 0.0001);
+  BOOST_CHECK_THROW(summaries[0].fraction_at_least(30), invalid_argument);
+  BOOST_CHECK_EQUAL(summaries[1].mean(), 0.0);
+  BOOST_CHECK_EQUAL(summaries[1].median(), 0u);
+  BOOST_CHECK_EQUAL(summaries[1].fraction_at_least(1), 0.0);
+  BOOST_CHECK_EQUAL(summaries[2].median(), 2u);
+  BOOST_CHECK_CLOSE(summaries[2].mean(), 2.0, 0.0001);
+}
+
+BOOST_AUTO_TEST_CASE( coverage_engine_filters )
+{
+  auto options = CoverageOptions{};
+  options.min_mapping_qual = 1;
+  CoverageEngine engine {"testdata/test_simple.bam", options};
+  auto covered = 0u;
+  engine.for_each_tile(vector<Interval>{Interval{"chr1", 1, 100000}}, [&covered](const CoverageTile& tile) {
+    for (const auto depth : tile.depths())
+      covered += depth > 0;
+  });
+  BOOST_CHECK_EQUAL(covered, 312u);
+}
+
+BOOST_AUTO_TEST_CASE( coverage_engine_errors )
+{
+  BOOST_CHECK_THROW(CoverageEngine{"testdata/test_paired.bam"}, IndexLoadException);
+  CoverageEngine engine {"testdata/test_simple.bam"};
+  BOOST_CHECK_THROW(engine.summarize({Interval{"chrZ", 1, 10}}), ChromosomeNotFoundException);
+  const auto empty = engine.summarize({Interval{"chr1", 256, 255}}, {1});   // no positions: no division by zero
+  BOOST_REQUIRE_EQUAL(empty.size(), 1u);
+  BOOST_CHECK_EQUAL(empty[0].mean(), 0.0);
+  BOOST_CHECK_EQUAL(empty[0].fraction_at_least(1), 0.0);
+  const auto reversed = engine.summarize({Interval{"chr1", 300, 255}}, {1});   // stops well before it starts: no positions either
+  BOOST_CHECK_EQUAL(reversed[0].mean(), 0.0);
+  BOOST_CHECK_EQUAL(reversed[0].median(), 0u);
+  BOOST_CHECK_EQUAL(reversed[0].fraction_at_least(1), 0.0);
+  BOOST_CHECK_CLOSE(engine.summarize({Interval{"chr1", 255, 256}})[0].mean(), 2.0, 0.0001);   // still usable after the errors
+}
@@ -0,0 +1,159 @@
+#include "sam/duplicate_marker.h"
+#include "sam/sam_reader.h"
+#include "exceptions.h"
+
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+using namespace std;
+using namespace gamgee;
+
+namespace {
+
+vector<Sam> read_all(const string& filename) {
+  auto records = vector<Sam>{};
+  for (const auto& record : SingleSamReader{filename})
+    records.push_back(record);
+  return records;
+}
+
+// puts the output records back in input order, and the input positions in the order the records came out in order
+DuplicateMetrics mark_records(DuplicateMarker& marker, const vector<Sam>& input, vector<Sam>& output, vector<uint64_t>& order) {
+  auto next = 0u;
+  output.assign(input.size(), Sam{});
+  order.clear();
+  return marker.mark([&input, &next](Sam& record) {
+                       if (next == input.size())
+                         return false;
+                       record = input[next++];
+                       return true;
+                     },
+                     [&output, &order](Sam& record, const uint64_t index) {
+                       output.at(index) = move(record);
+                       order.push_back(index);
+                     },
+                     {{"rg1", 1}, {"rg2", 2}});
+}
+
+void check_all_output_once(const vector<uint64_t>& order, const size_t size) {
+  auto sorted = order;
+  sort(sorted.begin(), sorted.end());
+  auto expected = vector<uint64_t>(size);
+  iota(expected.begin(), expected.end(), 0);
+  BOOST_CHECK(sorted == expected);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( duplicate_marker_marks_pairs_and_fragments )
+{
+  const auto input = read_all("testdata/test_duplicates.sam");
+  // expected duplicate flag of each record of testdata/test_duplicates.sam, in order
+  const auto expected = vector<bool>{true, false, false, true, true, true, false, true, false, true, true, false, false, true, false, true, false, false};
+  BOOST_REQUIRE_EQUAL(input.size(), expected.size());
+  for (const auto threads : {1u, 3u}) {
+    for (const auto batch_size : {1u, 4u, 10000u}) {
+      auto options = DuplicateMarkerOptions{};
+      options.num_threads = threads;
+      options.batch_size = batch_size;
+      DuplicateMarker marker {options};
+      auto output = vector<Sam>{};
+      auto order = vector<uint64_t>{};
+      const auto metrics = mark_records(marker, input, output, order);
+      check_all_output_once(order, input.size());
+      for (auto i = 0u; i != output.size(); ++i) {
+        BOOST_CHECK_EQUAL(output[i].name(), input[i].name());
+        BOOST_CHECK_EQUAL(output[i].duplicate(), expected[i]);
+      }
+      BOOST_CHECK_EQUAL(metrics.unpaired_reads_examined, 4u);
+      BOOST_CHECK_EQUAL(metrics.read_pairs_examined, 6u);
+      BOOST_CHECK_EQUAL(metrics.unpaired_read_duplicates, 2u);
+      BOOST_CHECK_EQUAL(metrics.read_pair_duplicates, 3u);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( duplicate_marker_bounded_window )
+{
+  const auto input = read_all("testdata/test_duplicates.sam");
+  auto options = DuplicateMarkerOptions{};
+  options.max_pending_records = 1;
+  DuplicateMarker marker {options};
+  auto output = vector<Sam>{};
+  auto order = vector<uint64_t>{};
+  const auto metrics = mark_records(marker, input, output, order);
+  check_all_output_once(order, input.size());
+  for (auto i = 0u; i != output.size(); ++i)
+    BOOST_CHECK_EQUAL(output[i].name(), input[i].name());
+  BOOST_CHECK(output[0].duplicate() == output[5].duplicate());  // both mates of a pair always get the same flag
+  BOOST_CHECK(output[4].duplicate() == output[7].duplicate());
+  BOOST_CHECK(output[3].duplicate());                           // a pair ends at the same position as this fragment
+  BOOST_CHECK(output[10].duplicate());                          // secondary alignments are untouched
+  BOOST_CHECK(!output[16].duplicate());
+  BOOST_CHECK_EQUAL(metrics.read_pairs_examined, 6u);
+  BOOST_CHECK_EQUAL(metrics.unpaired_reads_examined, 4u);
+}
+
+BOOST_AUTO_TEST_CASE( duplicate_marker_unsorted_input )
+{
+  const auto input = read_all("testdata/test_paired.bam");
+  DuplicateMarker marker {};
+  auto output = vector<Sam>{};
+  auto order = vector<uint64_t>{};
+  BOOST_CHECK_THROW(mark_records(marker, input, output, order), UnsortedInputException);
+}
+
+BOOST_AUTO_TEST_CASE( duplicate_marker_inter_chromosomal_pairs )
+{
+  const auto filename = string{"duplicate_marker_test.sam"};
+  const auto marked_filename = string{"duplicate_marker_test_marked.sam"};
+  {
+    auto file = ofstream{filename};
+    file << "@HD\tVN:1.4\tSO:coordinate\n@SQ\tSN:chr1\tLN:10000\n@SQ\tSN:chr2\tLN:10000\n@RG\tID:rg1\tLB:lib1\tSM:sample1\n"
+         << "interA\t97\tchr1\t100\t60\t10M\tchr2\t500\t0\tACGTACGTAC\tIIIIIIIIII\tRG:Z:rg1\tMC:Z:10M\n"
+         << "interC\t97\tchr1\t100\t60\t10M\tchr2\t500\t0\tACGTACGTAC\t##########\tRG:Z:rg1\tMC:Z:10M\n"
+         << "frag1\t0\tchr1\t200\t60\t10M\t*\t0\t0\tACGTACGTAC\tIIIIIIIIII\tRG:Z:rg1\n"
+         << "pairB\t99\tchr1\t300\t60\t10M\t=\t400\t110\tACGTACGTAC\tIIIIIIIIII\tRG:Z:rg1\tMC:Z:10M\n"
+         << "pairB\t147\tchr1\t400\t60\t10M\t=\t300\t-110\tACGTACGTAC\tIIIIIIIIII\tRG:Z:rg1\tMC:Z:10M\n"
+         << "frag2\t0\tchr1\t5000\t60\t10M\t*\t0\t0\tACGTACGTAC\tIIIIIIIIII\tRG:Z:rg1\n"
+         << "interA\t145\tchr2\t500\t60\t10M\tchr1\t100\t0\tACGTACGTAC\tIIIIIIIIII\tRG:Z:rg1\tMC:Z:10M\n"
+         << "interC\t145\tchr2\t500\t60\t10M\tchr1\t100\t0\tACGTACGTAC\t##########\tRG:Z:rg1\tMC:Z:10M\n";
+  }
+  const auto input = read_all(filename);
+  const auto expected = vector<bool>{false, true, false, false, false, false, false, true};
+  BOOST_REQUIRE_EQUAL(input.size(), expected.size());
+  DuplicateMarker marker {};
+  auto output = vector<Sam>{};
+  auto order = vector<uint64_t>{};
+  const auto metrics = mark_records(marker, input, output, order);
+  check_all_output_once(order, input.size());
+  for (auto i = 0u; i != output.size(); ++i)
+    BOOST_CHECK_EQUAL(output[i].duplicate(), expected[i]);
+  const auto position = [&order](const uint64_t index) { return find(order.begin(), order.end(), index) - order.begin(); };
+  for (const auto index : {2u, 3u, 4u})                          // the pairs waiting for their mates on chr2 don't hold back the reads after them
+    BOOST_CHECK_LT(position(index), position(0));
+  BOOST_CHECK_EQUAL(metrics.read_pairs_examined, 3u);
+  BOOST_CHECK_EQUAL(metrics.read_pair_duplicates, 1u);
+  BOOST_CHECK_EQUAL(metrics.unpaired_reads_examined, 2u);
+  BOOST_CHECK_EQUAL(metrics.unpaired_read_duplicates, 0u);
+
+  auto options = DuplicateMarkerOptions{};
+  options.binary_output = false;
+  DuplicateMarker file_marker {options};
+  const auto file_metrics = file_marker.mark(filename, marked_filename);
+  BOOST_CHECK_EQUAL(file_metrics.read_pair_duplicates, 1u);
+  const auto marked = read_all(marked_filename);              // written in input order
+  BOOST_REQUIRE_EQUAL(marked.size(), input.size());
+  for (auto i = 0u; i != marked.size(); ++i) {
+    BOOST_CHECK_EQUAL(marked[i].name(), input[i].name());
+    BOOST_CHECK_EQUAL(marked[i].duplicate(), expected[i]);
+  }
+  BOOST_CHECK_THROW(file_marker.mark("-", marked_filename), invalid_argument);   // streams can't be read twice
+  BOOST_CHECK_THROW(file_marker.mark("missing_duplicate_marker_input.bam", marked_filename), invalid_argument);
+  remove(filename.c_str());
+  remove(marked_filename.c_str());
+}
@@ -0,0 +1,115 @@
+#include <boost/test/unit_test.hpp>
+
+#include "fastq_batch_reader.h"
+#include "fastq_parser.h"
+#include "fastq_reader.h"
+#include "exceptions.h"
+#include "test_utils.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace gamgee;
+
+vector<Fastq> read_sequentially(FastqReader&& reader) {
+  auto records = vector<Fastq>{};
+  for (const auto& record : reader)
+    records.push_back(record);
+  return records;
+}
+
+vector<Fastq> read_in_batches(FastqBatchReader&& reader, uint32_t* num_batches = nullptr) {
+  auto records = vector<Fastq>{};
+  for (auto& batch : reader) {
+    BOOST_CHECK(!batch.empty());
+    for (const auto& record : batch)
+      records.push_back(record.to_fastq());
+    if (num_batches != nullptr)
+      ++*num_batches;
+  }
+  return records;
+}
+
+BOOST_AUTO_TEST_CASE( fastq_batch_reader_files )
+{
+  for (const auto& filename : {"testdata/complete_same_seq.fa", "testdata/complete_same_seq.fq", "testdata/complete_same_seq.fq.gz",
+                               "testdata/test_clean.fq", "testdata/test_reference.fa", "testdata/test_reference.fa.gz"}) {
+    const auto truth = read_sequentially(FastqReader{filename});
+    for (const auto num_threads : {1u, 4u})
+      for (const auto chunk_size : {size_t{1}, size_t{7}, size_t{64}, FastqBatchIterator::default_chunk_size})
+        BOOST_CHECK(read_in_batches(FastqBatchReader{filename, num_threads, chunk_size}) == truth);
+  }
+  BOOST_CHECK_THROW(FastqBatchReader{"foo/bar/nonexistent.fq"}, FileOpenException);
+}
+
+BOOST_AUTO_TEST_CASE( fastq_batch_reader_resynchronizes_at_records )
+{
+  // qualities starting with '@' (and lines starting with '+') are not taken for the start of a record
+  auto fastq = string{};
+  auto fasta = string{};
+  for (auto i = 0; i != 3000; ++i) {
+    const auto length = 1 + i % 50;
+    fastq += "@read" + to_string(i) + " comment\n" + string(length, "ACGT"[i % 4]) + "\n+\n" + (i % 3 ? "@" : "+") + string(length - 1, char('!' + i % 60)) + "\n";
+    fasta += ">chr" + to_string(i) + "\n";
+    for (auto line = 0; line != i % 4; ++line)
+      fasta += string(1 + i % 70, "ACGT"[line]) + "\n";
+  }
+  for (const auto& contents : {fastq, fasta}) {
+    const auto truth = read_sequentially(FastqReader{new istringstream{contents}});
+    BOOST_REQUIRE_EQUAL(truth.size(), 3000u);
+    for (const auto chunk_size : {size_t{1}, size_t{100}, size_t{4096}}) {
+      auto num_batches = 0u;
+      BOOST_CHECK(read_in_batches(FastqBatchReader{new istringstream{contents}, 3, chunk_size}, &num_batches) == truth);
+      BOOST_CHECK_GT(num_batches, chunk_size == 4096 ? 10u : 100u);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( fastq_batch_reader_empty_input_and_early_exit )
+{
+  BOOST_CHECK(read_in_batches(FastqBatchReader{new istringstream{""}, 2}).empty());
+  BOOST_CHECK(read_in_batches(FastqBatchReader{new istringstream{"\n\n"}, 2}).empty());
+  auto fastq = string{};
+  for (auto i = 0; i != 10000; ++i)
+    fastq += "@read" + to_string(i) + "\nACGT\n+\nIIII\n";
+  auto reader = FastqBatchReader{new istringstream{fastq}, 4, 256};
+  auto iterator = reader.begin();
+  BOOST_CHECK_EQUAL((*iterator)[0].name(), "read0");
+  const auto first_batch_size = (*iterator).size();
+  BOOST_CHECK_EQUAL((++iterator)[0].name(), "read" + to_string(first_batch_size));
+  auto moved = check_move_constructor(iterator);
+  BOOST_CHECK(moved != reader.end());
+}
+
+BOOST_AUTO_TEST_CASE( fastq_batch_records_are_views_of_its_buffer )
+{
+  // multi-line fields (and whitespace in them) are joined in place
+  const auto contents = string{"@read1 first comment\r\nAC GT\nAC\r\n+\nII\nI III\n@read2\nA\n+\n@\n"};
+  const auto truth = read_sequentially(FastqReader{new istringstream{contents}});
+  auto batch = FastqBatch{contents};
+  BOOST_REQUIRE_EQUAL(batch.size(), truth.size());
+  for (auto i = 0u; i != batch.size(); ++i)
+    BOOST_CHECK(batch[i].to_fastq() == truth[i]);
+  BOOST_CHECK_EQUAL(batch[0].sequence(), "ACGTAC");
+  BOOST_CHECK(batch[1].name().data() + 10 == batch[1].quals().data());  // "read2\nA\n+\n@": in the buffer, where they were
+  // copies share the buffer
+  auto copy = FastqBatch{};
+  {
+    auto reader = FastqBatchReader{new istringstream{contents}, 2};
+    copy = *reader.begin();
+  }
+  BOOST_REQUIRE_EQUAL(copy.size(), 2u);
+  BOOST_CHECK(copy[0] == batch[0]);
+  BOOST_CHECK(copy[1] == batch[1]);
+  BOOST_CHECK(FastqBatch{""}.empty());
+  BOOST_CHECK(FastqBatch{"\n"}.empty());
+}
+
+BOOST_AUTO_TEST_CASE( fastq_parser_views_only_of_buffers )
+{
+  auto parser = FastqParser{make_shared<istringstream>("@read\nA\n+\nI\n")};
+  auto view = FastqView{};
+  BOOST_CHECK_THROW(parser.next(view), logic_error);
+}
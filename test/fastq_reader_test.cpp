@@ -1,9 +1,16 @@
 #include <boost/test/unit_test.hpp>
 
 #include "fastq_reader.h"
+#include "fastq_parser.h"
 #include "test_utils.h"
 #include "exceptions.h"
 
+#include <zlib.h>
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+
 using namespace std;
 using namespace gamgee;
 
@@ -74,3 +81,151 @@ BOOST_AUTO_TEST_CASE( fastq_iterator_move_constructor ) {
 BOOST_AUTO_TEST_CASE( fastq_reader_nonexistent_file ) {
   BOOST_CHECK_THROW(FastqReader{"foo/bar/nonexistent.fa"}, FileOpenException);
 }
+
+vector<Fastq> parse_records(const string& contents, const size_t block_size = FastqParser::default_block_size) {
+  auto parser = FastqParser{make_shared<istringstream>(contents), block_size};
+  auto records = vector<Fastq>{};
+  for (auto record = Fastq{}; parser.next(record); )
+    records.push_back(record);
+  return records;
+}
+
+BOOST_AUTO_TEST_CASE( fastq_parser_multiline_records ) {
+  const auto fasta = parse_records(">chr1 first chromosome\nACGT\nAC GT\n\nTT\n>chr2\n>chr3\tdescription\nGG\nCC");
+  BOOST_REQUIRE_EQUAL(fasta.size(), 3u);
+  BOOST_CHECK(fasta[0] == (Fastq{"chr1", "first chromosome", "ACGTACGTTT"}));
+  BOOST_CHECK(fasta[1] == (Fastq{"chr2", "", ""}));
+  BOOST_CHECK(fasta[2] == (Fastq{"chr3", "\tdescription", "GGCC"}));
+
+  // qualities can start with '@' or '+' and span several lines, extra qualities are skipped
+  const auto fastq = parse_records("@read1 comment\nACGT\nAC\n+read1\n@@+\n@II\n@read2\nAAAA\n+\nII II\n@read3\nAC\n+\nIIJJ\n");
+  BOOST_REQUIRE_EQUAL(fastq.size(), 3u);
+  BOOST_CHECK(fastq[0] == (Fastq{"read1", "comment", "ACGTAC", "@@+@II"}));
+  BOOST_CHECK(fastq[1] == (Fastq{"read2", "", "AAAA", "IIII"}));
+  BOOST_CHECK(fastq[2] == (Fastq{"read3", "", "AC", "IIJJ"}));
+}
+
+BOOST_AUTO_TEST_CASE( fastq_parser_edge_cases ) {
+  BOOST_CHECK(parse_records("").empty());
+  BOOST_CHECK(parse_records("@").empty());
+  BOOST_CHECK(parse_records(">\n\n  \n").empty());
+  const auto crlf = parse_records("@read1 comment\r\nACGT\r\n+\r\nIIII\r\n@read2\r\nA\r\n+\r\nI");
+  BOOST_REQUIRE_EQUAL(crlf.size(), 2u);
+  BOOST_CHECK(crlf[0] == (Fastq{"read1", "comment\r", "ACGT", "IIII"}));
+  BOOST_CHECK(crlf[1] == (Fastq{"read2", "\r", "A", "I"}));
+  const auto truncated = parse_records("@read1\nACGT\n+\nII");
+  BOOST_REQUIRE_EQUAL(truncated.size(), 1u);
+  BOOST_CHECK(truncated[0] == (Fastq{"read1", "", "ACGT", "II"}));
+}
+
+BOOST_AUTO_TEST_CASE( fastq_parser_block_boundaries ) {
+  // records (and lines) split across blocks of any size parse the same as from a single block
+  for (const auto& filename : {"testdata/complete_same_seq.fa", "testdata/complete_same_seq.fq", "testdata/test_clean.fq", "testdata/test_reference.fa"}) {
+    auto file = ifstream{filename};
+    const auto contents = string{istreambuf_iterator<char>{file}, istreambuf_iterator<char>{}};
+    const auto truth = parse_records(contents);
+    BOOST_CHECK(!truth.empty());
+    for (const auto block_size : {1u, 2u, 3u, 5u, 7u, 16u, 17u, 64u, 1000u})
+      BOOST_CHECK(parse_records(contents, block_size) == truth);
+  }
+  auto long_sequence = string{">long\n"};
+  for (auto line = 0; line != 1000; ++line)
+    long_sequence += "ACGTACGTAC\n";
+  const auto records = parse_records(long_sequence, 16);
+  BOOST_REQUIRE_EQUAL(records.size(), 1u);
+  BOOST_CHECK_EQUAL(records[0].sequence().size(), 10000u);
+}
+
+BOOST_AUTO_TEST_CASE( fastq_iterator_reuses_the_record ) {
+  auto reader = FastqReader{"testdata/complete_same_seq.fq"};
+  auto iterator = reader.begin();
+  const auto first = *iterator;
+  BOOST_CHECK_EQUAL(first.name(), "test1");
+  BOOST_CHECK(&(++iterator) == &(*iterator));
+  BOOST_CHECK_EQUAL((*iterator).name(), "test2");
+  BOOST_CHECK_EQUAL(first.name(), "test1");
+}
+
+string file_contents(const string& filename) {
+  auto file = ifstream{filename, ios::binary};
+  return string{istreambuf_iterator<char>{file}, istreambuf_iterator<char>{}};
+}
+
+vector<Fastq> read_all(FastqReader&& reader) {
+  auto records = vector<Fastq>{};
+  for (const auto& record : reader)
+    records.push_back(record);
+  return records;
+}
+
+string bgzf_compress(const string& data, const size_t block_size) {
+  auto compressed = string{};
+  for (auto position = size_t{0}; position <= data.size(); position += block_size) {  // an empty block at the end, like bgzip
+    const auto block = data.substr(position, block_size);
+    auto deflated = string(compressBound(block.size()) + 32, '\0');
+    auto stream = z_stream{};
+    deflateInit2(&stream, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block.data()));
+    stream.avail_in = block.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&deflated[0]);
+    stream.avail_out = deflated.size();
+    deflate(&stream, Z_FINISH);
+    deflated.resize(stream.total_out);
+    deflateEnd(&stream);
+    const auto block_size_minus_one = deflated.size() + 25;
+    const auto crc = crc32(0, reinterpret_cast<const Bytef*>(block.data()), block.size());
+    compressed += string{"\x1f\x8b\x08\x04\0\0\0\0\0\xff\x06\0BC\x02\0", 16};
+    compressed += {char(block_size_minus_one & 0xff), char(block_size_minus_one >> 8)};
+    compressed += deflated;
+    for (const auto value : {uint32_t(crc), uint32_t(block.size())})
+      compressed += {char(value), char(value >> 8), char(value >> 16), char(value >> 24)};
+  }
+  return compressed;
+}
+
+BOOST_AUTO_TEST_CASE( read_compressed_fastq ) {
+  BOOST_CHECK_EQUAL(count_records("testdata/complete_same_seq.fq.gz"), 3);  // two concatenated gzip members
+  const auto truth = read_all(FastqReader{"testdata/test_reference.fa"});
+  for (const auto num_threads : {1u, 4u}) {
+    BOOST_CHECK(read_all(FastqReader{"testdata/test_reference.fa.gz", num_threads}) == truth);  // BGZF
+    BOOST_CHECK(read_all(FastqReader{new ifstream{"testdata/test_reference.fa.gz", ios::binary}, num_threads}) == truth);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( read_bgzf_fastq_in_parallel ) {
+  auto fastq = string{};
+  for (auto i = 0; i != 20000; ++i)
+    fastq += "@read" + to_string(i) + "\n" + string(100, "ACGT"[i % 4]) + "\n+\n" + string(100, char('!' + i % 40)) + "\n";
+  const auto compressed = bgzf_compress(fastq, 60000);
+  const auto truth = parse_records(fastq);
+  BOOST_REQUIRE_EQUAL(truth.size(), 20000u);
+  for (const auto num_threads : {1u, 2u, 8u})
+    BOOST_CHECK(read_all(FastqReader{new istringstream{compressed}, num_threads}) == truth);
+  BOOST_CHECK(parse_records(compressed, 1000) == truth);
+  auto reader = FastqReader{new istringstream{compressed}, 4};   // stops decompressing when destroyed halfway
+  BOOST_CHECK_EQUAL((*reader.begin()).name(), "read0");
+}
+
+BOOST_AUTO_TEST_CASE( read_compressed_fastq_with_trailing_data ) {
+  const auto gzip = file_contents("testdata/complete_same_seq.fq.gz");
+  const auto bgzf = file_contents("testdata/test_reference.fa.gz");
+  const auto gzip_truth = read_all(FastqReader{"testdata/complete_same_seq.fq.gz"});
+  const auto bgzf_truth = read_all(FastqReader{"testdata/test_reference.fa"});
+  for (const auto& trailing : {string(1, '\0'), string(512, '\0'), string{"trailing garbage"}, string{"\x1f"}}) {   // ignored, like gzip does
+    for (const auto num_threads : {1u, 4u}) {
+      BOOST_CHECK(read_all(FastqReader{new istringstream{gzip + trailing}, num_threads}) == gzip_truth);
+      BOOST_CHECK(read_all(FastqReader{new istringstream{bgzf + trailing}, num_threads}) == bgzf_truth);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( read_corrupted_compressed_fastq ) {
+  const auto gzip = file_contents("testdata/complete_same_seq.fq.gz");
+  const auto bgzf = file_contents("testdata/test_reference.fa.gz");
+  auto flipped = bgzf;
+  flipped[30] ^= 0x55;
+  for (const auto& corrupted : {gzip.substr(0, gzip.size() - 20), bgzf.substr(0, 400), flipped, string{"\x1f\x8bnot really gzip"}}) {
+    for (const auto num_threads : {1u, 4u})
+      BOOST_CHECK_THROW(read_all(FastqReader{new istringstream{corrupted}, num_threads}), DecompressionException);
+  }
+}
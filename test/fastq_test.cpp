@@ -1,5 +1,6 @@
 #include "fastq.h"
 #include "fastq_reader.h"
+#include "fastq_view.h"
 #include "test_utils.h"
 
 #include <boost/test/unit_test.hpp>
@@ -91,3 +92,25 @@ BOOST_AUTO_TEST_CASE( fastq_copy_and_move_constructor ) {
   auto m2 = *it;
   BOOST_CHECK(m1 == m2);
 }
+
+BOOST_AUTO_TEST_CASE( fastq_accessors_do_not_copy ) {
+  auto fq = Fastq{"name", "comment", string(1000, 'A'), string(1000, 'I')};
+  BOOST_CHECK_EQUAL(&fq.sequence(), &fq.sequence());
+  const auto bases = fq.sequence().data();
+  const auto sequence = move(fq).sequence();  // moved out of a record that is not needed anymore
+  BOOST_CHECK_EQUAL(sequence.data(), bases);
+  BOOST_CHECK(fq.sequence().empty());
+  BOOST_CHECK_EQUAL(fq.name(), "name");
+}
+
+BOOST_AUTO_TEST_CASE( fastq_view_test ) {
+  const auto fq = Fastq{"name", "comment", "ACGT", "IIII"};
+  const auto view = FastqView{fq};
+  BOOST_CHECK_EQUAL(view.sequence().data(), fq.sequence().data());
+  BOOST_CHECK(view.is_fastq());
+  BOOST_CHECK(view.to_fastq() == fq);
+  BOOST_CHECK(view == FastqView("name", "comment", "ACGT", "IIII"));
+  BOOST_CHECK(view != FastqView("name", "comment", "ACGT"));
+  BOOST_CHECK(!FastqView("name", "comment", "ACGT").is_fastq());
+  check_fastq_fields(FastqView{}.to_fastq(), "", "", "", "");
+}
@@ -0,0 +1,160 @@
+#include <boost/test/unit_test.hpp>
+
+#include "fastq_writer.h"
+#include "fastq_batch_reader.h"
+#include "fastq_reader.h"
+#include "exceptions.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace gamgee;
+
+vector<Fastq> read_records(const string& contents) {
+  auto records = vector<Fastq>{};
+  for (const auto& record : FastqReader{new istringstream{contents}})
+    records.push_back(record);
+  return records;
+}
+
+vector<Fastq> random_records(const uint32_t num_records) {
+  auto random = mt19937{13};
+  auto records = vector<Fastq>{};
+  for (auto i = 0u; i != num_records; ++i) {
+    auto bases = string(1 + random() % 300, 'A');
+    auto quals = string(bases.size(), 'I');
+    for (auto j = 0u; j != bases.size(); ++j) {
+      bases[j] = "ACGTN"[random() % 5];
+      quals[j] = char('!' + random() % 42);
+    }
+    records.push_back(Fastq{"read" + to_string(i), i % 2 ? "comment" : "", bases, quals});
+  }
+  return records;
+}
+
+string write_records(const vector<Fastq>& records, const utils::Compression compression, const uint32_t num_threads) {
+  auto output = make_shared<ostringstream>();
+  {
+    auto writer = FastqWriter{output, compression, num_threads};
+    for (const auto& record : records)
+      writer.add_record(record);
+  }
+  return output->str();
+}
+
+/**
+ * @brief a stream buffer that takes capacity bytes, and then fails like a full disk
+ */
+class FullDiskBuffer : public streambuf {
+ public:
+  explicit FullDiskBuffer(const size_t capacity) : m_capacity {capacity} {}
+
+ protected:
+  streamsize xsputn(const char*, const streamsize count) override {
+    const auto written = min(count, streamsize(m_capacity));
+    m_capacity -= size_t(written);
+    return written;
+  }
+  int_type overflow(const int_type c) override {
+    if (m_capacity == 0)
+      return traits_type::eof();
+    --m_capacity;
+    return c;
+  }
+
+ private:
+  size_t m_capacity;
+};
+
+BOOST_AUTO_TEST_CASE( fastq_writer_format )
+{
+  BOOST_CHECK_EQUAL(write_records({Fastq{"read1", "comment", "ACGT", "IIII"}, Fastq{"read2", "", "AC", "#@"}}, utils::Compression::none, 1),
+                    "@read1 comment\nACGT\n+\nIIII\n@read2\nAC\n+\n#@\n");
+  BOOST_CHECK_EQUAL(write_records({Fastq{"chr1", "the first", "ACGT"}, Fastq{"chr2", "", "A"}}, utils::Compression::none, 1),
+                    ">chr1 the first\nACGT\n>chr2\nA\n");
+  BOOST_CHECK_EQUAL(write_records({}, utils::Compression::none, 1), "");
+  BOOST_CHECK_THROW(FastqWriter{"foo/bar/nonexistent.fq"}, FileOpenException);
+}
+
+BOOST_AUTO_TEST_CASE( fastq_writer_compression )
+{
+  const auto records = random_records(20000);   // several blocks of output
+  for (const auto compression : {utils::Compression::none, utils::Compression::gzip, utils::Compression::bgzf}) {
+    const auto output = write_records(records, compression, 1);
+    BOOST_CHECK(read_records(output) == records);
+    BOOST_CHECK_EQUAL(output, write_records(records, compression, 3));   // the output doesn't depend on the threads
+    BOOST_CHECK(read_records(write_records({}, compression, 2)).empty());
+    if (compression != utils::Compression::none)
+      BOOST_CHECK_LT(output.size(), write_records(records, utils::Compression::none, 1).size());
+  }
+  const auto bgzf = write_records(records, utils::Compression::bgzf, 2);
+  BOOST_CHECK_EQUAL(bgzf.substr(12, 2), "BC");
+  BOOST_CHECK_EQUAL(bgzf.substr(bgzf.size() - 28), string("\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43\x02\x00\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00", 28));
+  const auto gzip = write_records(records, utils::Compression::gzip, 2);
+  BOOST_CHECK_EQUAL(gzip.substr(0, 4), string("\x1f\x8b\x08\x00", 4));   // a single member, without the BGZF extra field
+}
+
+BOOST_AUTO_TEST_CASE( fastq_writer_records_larger_than_blocks )
+{
+  auto random = mt19937{7};
+  auto bases = string(1500000, 'A');
+  for (auto& base : bases)
+    base = char(33 + random() % 94);
+  const auto records = vector<Fastq>{Fastq{"random", "", bases, bases}};
+  BOOST_CHECK(read_records(write_records(records, utils::Compression::bgzf, 2)) == records);
+  BOOST_CHECK(read_records(write_records(records, utils::Compression::gzip, 2)) == records);
+}
+
+BOOST_AUTO_TEST_CASE( fastq_writer_batches_and_files )
+{
+  const auto output = string{"fastq_writer_test_output.fq.gz"};
+  for (const auto& filename : {"testdata/complete_same_seq.fq", "testdata/test_reference.fa"}) {
+    {
+      auto writer = FastqWriter{output, utils::Compression::bgzf, 2};
+      for (const auto& batch : FastqBatchReader{filename, 2, 64})
+        writer.add_batch(batch);
+      writer.flush();
+    }
+    auto truth = vector<Fastq>{};
+    for (const auto& record : FastqReader{filename})
+      truth.push_back(record);
+    auto written = vector<Fastq>{};
+    for (const auto& record : FastqReader{output})
+      written.push_back(record);
+    BOOST_CHECK(written == truth);
+  }
+  auto writer = FastqWriter{output};
+  auto moved = check_move_constructor(writer);
+  moved.add_record(Fastq{"read", "", "A", "I"});
+  moved.flush();
+  auto written = vector<Fastq>{};
+  for (const auto& record : FastqReader{output})
+    written.push_back(record);
+  BOOST_CHECK(written == vector<Fastq>(1, Fastq{"read", "", "A", "I"}));
+  remove(output.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( fastq_writer_close_reports_failed_final_writes )
+{
+  const auto records = random_records(100);
+  for (const auto compression : {utils::Compression::none, utils::Compression::gzip, utils::Compression::bgzf}) {
+    const auto size = write_records(records, compression, 2).size();
+    for (const auto capacity : {size_t{0}, size - 1, size}) {   // the last byte (e.g. of the compressed stream's trailer) doesn't fit
+      auto buffer = FullDiskBuffer{capacity};
+      auto writer = FastqWriter{make_shared<ostream>(&buffer), compression, 2};
+      for (const auto& record : records)
+        writer.add_record(record);
+      if (capacity < size)
+        BOOST_CHECK_THROW(writer.close(), OutputException);
+      else
+        BOOST_CHECK_NO_THROW(writer.close());
+      BOOST_CHECK_NO_THROW(writer.close());   // closed already
+    }
+  }
+}
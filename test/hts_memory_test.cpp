@@ -0,0 +1,90 @@
+#include "sam/sam.h"
+#include "sam/sam_reader.h"
+#include "utils/hts_memory.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <deque>
+#include <thread>
+
+using namespace std;
+using namespace gamgee;
+using namespace gamgee::utils;
+
+BOOST_AUTO_TEST_CASE( sam_record_pool_recycles_records )
+{
+  SamRecordPool pool {};
+  auto file = make_unique_hts_file(sam_open("testdata/test_simple.bam", "r"));
+  const auto header = make_shared_sam_header(sam_hdr_read(file.get()));
+  const auto record = SamHandle::create();
+  BOOST_REQUIRE_GE(sam_read1(file.get(), header.get(), record.get()), 0);
+  auto copy = pool.deep_copy(record.get());
+  BOOST_CHECK_EQUAL(Sam(header, copy).name(), Sam(header, record).name());
+  auto statistics = pool.statistics();
+  BOOST_CHECK_EQUAL(statistics.record_allocations, 1u);
+  BOOST_CHECK_EQUAL(statistics.data_allocations, 1u);
+  copy.reset();
+  BOOST_CHECK_EQUAL(pool.statistics().idle_records, 1u);
+  auto empty = pool.allocate();                                // reused, but empty
+  BOOST_CHECK_EQUAL(empty->l_data, 0);
+  BOOST_CHECK_EQUAL(pool.statistics().records_reused, 1u);
+  pool.assign(empty, record.get());                     // nobody else uses it: copied in place
+  BOOST_CHECK_EQUAL(pool.statistics().record_allocations, 1u);
+  BOOST_CHECK_EQUAL(pool.statistics().data_allocations, 1u);
+  BOOST_CHECK(pool.deep_copy(nullptr) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE( sam_record_pool_steady_state )
+{
+  auto& pool = SamRecordPool::thread_local_pool();
+  auto window = deque<Sam>{};
+  auto allocations = SamRecordPoolStatistics{};
+  for (auto pass = 0u; pass != 3; ++pass) {
+    for (const auto& record : SingleSamReader{"testdata/test_simple.bam"}) {
+      window.push_back(record);                                // the iterator moves on to records from the thread local pool
+      if (window.size() > 8)
+        window.pop_front();
+    }
+    if (pass == 0)
+      allocations = pool.statistics();
+  }
+  const auto after = pool.statistics();
+  BOOST_CHECK_EQUAL(after.record_allocations, allocations.record_allocations);
+  BOOST_CHECK_GT(after.records_reused, allocations.records_reused);
+  BOOST_CHECK_LE(after.data_allocations, allocations.data_allocations + 8);  // only the records of the window can still grow
+}
+
+BOOST_AUTO_TEST_CASE( sam_record_pool_records_outlive_pool )
+{
+  auto record = SamHandle{};
+  {
+    SamRecordPool pool {};
+    record = pool.allocate();
+  }
+  auto thread_record = SamHandle{};
+  auto worker = thread{[&thread_record] { thread_record = SamRecordPool::thread_local_pool().allocate(); }};
+  worker.join();
+  record.reset();
+  thread_record.reset();
+  BOOST_CHECK(record == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE( record_handle_reference_counts )
+{
+  auto record = SamHandle::create();
+  BOOST_CHECK_EQUAL(record.use_count(), 1);
+  BOOST_CHECK_EQUAL(record->l_data, 0);
+  auto copy = record;
+  BOOST_CHECK(copy == record);
+  BOOST_CHECK_EQUAL(record.use_count(), 2);
+  auto moved = std::move(copy);
+  BOOST_CHECK(copy == nullptr);
+  BOOST_CHECK_EQUAL(moved.use_count(), 2);
+  moved.reset();
+  BOOST_CHECK_EQUAL(record.use_count(), 1);
+  const auto adopted = SamHandle::adopt(sam_deep_copy(record.get()));
+  BOOST_CHECK(adopted != record);
+  BOOST_CHECK_EQUAL(adopted.use_count(), 1);
+  BOOST_CHECK(SamHandle::adopt(nullptr) == nullptr);
+  BOOST_CHECK_EQUAL(SamHandle{}.use_count(), 0);
+}
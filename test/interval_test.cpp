@@ -121,6 +121,14 @@ BOOST_AUTO_TEST_CASE( interval_equality )
   BOOST_CHECK(!(i == j));
 }
 
+BOOST_AUTO_TEST_CASE( interval_size )
+{
+  BOOST_CHECK_EQUAL((Interval{"TEST", 234, 432}.size()), 199u);
+  BOOST_CHECK_EQUAL((Interval{"TEST", 234, 234}.size()), 1u);
+  BOOST_CHECK_EQUAL((Interval{"TEST", 234, 233}.size()), 0u);
+  BOOST_CHECK_EQUAL((Interval{"TEST", 234, 100}.size()), 0u);   // no wrap around
+}
+
 BOOST_AUTO_TEST_CASE( interval_copy_and_move_constructors ) {
   auto i0 = Interval {"A", 1'000, 2'000};
   auto copies = check_copy_constructor(i0);
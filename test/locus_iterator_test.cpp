@@ -0,0 +1,173 @@
+#include "sam/locus_reader.h"
+#include "sam/sam_reader.h"
+#include "exceptions.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace gamgee;
+
+BOOST_AUTO_TEST_CASE( locus_iterator_simple_pileups )
+{
+  auto positions = 0u;
+  auto elements = 0u;
+  auto max_depth = 0u;
+  for (const auto& pileup : LocusReader{"testdata/test_simple.bam"}) {
+    if (positions == 0) {
+      BOOST_CHECK_EQUAL(pileup.chromosome(), 0u);
+      BOOST_CHECK_EQUAL(pileup.position(), 200u);
+      BOOST_REQUIRE_EQUAL(pileup.size(), 1u);
+      BOOST_CHECK(pileup.bases()[0] == Base::A);
+      BOOST_CHECK_EQUAL(pileup.base_quals()[0], 33);
+      BOOST_CHECK_EQUAL(pileup.read_offsets()[0], 0u);
+      BOOST_CHECK_EQUAL(pileup.reverse_strands()[0], 0);
+    }
+    if (pileup.position() == 257) {
+      BOOST_REQUIRE_EQUAL(pileup.size(), 3u);
+      BOOST_CHECK(pileup.bases()[0] == Base::C);
+      BOOST_CHECK(pileup.bases()[1] == Base::A);
+      BOOST_CHECK(pileup.bases()[2] == Base::A);
+      BOOST_CHECK_EQUAL(pileup.base_quals()[0], 6);
+      BOOST_CHECK_EQUAL(pileup.base_quals()[1], 5);
+      BOOST_CHECK_EQUAL(pileup.base_quals()[2], 28);
+      BOOST_CHECK_EQUAL(pileup.read_offsets()[0], 57u);
+      BOOST_CHECK_EQUAL(pileup.read_offsets()[1], 2u);
+      BOOST_CHECK_EQUAL(pileup.read_offsets()[2], 0u);
+      BOOST_CHECK_EQUAL(pileup.reverse_strands()[1], 1);
+      BOOST_CHECK_EQUAL(pileup.count(Base::A), 2u);
+      BOOST_CHECK_EQUAL(pileup.deletion_count(), 0u);
+      BOOST_CHECK_EQUAL(pileup.insertion_count(), 0u);
+    }
+    max_depth = max(max_depth, pileup.size());
+    elements += pileup.size();
+    ++positions;
+  }
+  BOOST_CHECK_EQUAL(positions, 2052u);
+  BOOST_CHECK_EQUAL(elements, 2508u);
+  BOOST_CHECK_EQUAL(max_depth, 3u);
+}
+
+BOOST_AUTO_TEST_CASE( locus_iterator_through_sam_reader )
+{
+  auto positions = 0u;
+  for (const auto& pileup : SamReader<LocusIterator>{"testdata/test_simple.sam"}) {
+    BOOST_CHECK(!pileup.empty());
+    ++positions;
+  }
+  BOOST_CHECK_EQUAL(positions, 2052u);
+}
+
+BOOST_AUTO_TEST_CASE( locus_iterator_filters )
+{
+  auto options = LocusIteratorOptions{};
+  options.min_mapping_qual = 1;
+  auto positions = 0u;
+  for (const auto& pileup : LocusReader{"testdata/test_simple.bam", options}) {
+    if (positions == 0)
+      BOOST_CHECK_EQUAL(pileup.position(), 255u);
+    if (pileup.position() == 257)
+      BOOST_CHECK_EQUAL(pileup.size(), 1u);
+    ++positions;
+  }
+  BOOST_CHECK_EQUAL(positions, 312u);
+}
+
+BOOST_AUTO_TEST_CASE( locus_iterator_max_depth )
+{
+  auto options = LocusIteratorOptions{};
+  options.max_depth = 2;
+  for (const auto& pileup : LocusReader{"testdata/test_simple.bam", options}) {
+    BOOST_CHECK_LE(pileup.size(), 2u);
+    if (pileup.position() == 257)
+      BOOST_CHECK_EQUAL(pileup.size(), 2u);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( locus_iterator_max_depth_frees_ended_reads )
+{
+  // r1 and r2 end at 105, where r3 and r4 start: they take the places r1 and r2 freed under the cap
+  const auto filename = string{"locus_iterator_max_depth_test.sam"};
+  {
+    auto output = ofstream{filename};
+    output << "@HD\tVN:1.5\tSO:coordinate\n@SQ\tSN:chr1\tLN:1000\n"
+           << "r1\t0\tchr1\t101\t60\t4M\t*\t0\t0\tACGT\tIIII\n"
+           << "r2\t0\tchr1\t101\t60\t4M\t*\t0\t0\tACGT\tIIII\n"
+           << "r3\t0\tchr1\t105\t60\t4M\t*\t0\t0\tTTTT\tIIII\n"
+           << "r4\t0\tchr1\t105\t60\t4M\t*\t0\t0\tGGGG\tIIII\n"
+           << "r5\t0\tchr1\t106\t60\t4M\t*\t0\t0\tCCCC\tIIII\n";
+  }
+  auto options = LocusIteratorOptions{};
+  options.max_depth = 2;
+  auto position = 101u;
+  for (const auto& pileup : LocusReader{filename, options}) {
+    BOOST_CHECK_EQUAL(pileup.position(), position);
+    BOOST_REQUIRE_EQUAL(pileup.size(), 2u);                      // r5 is skipped: r3 and r4 still cover 106
+    if (position >= 105) {
+      BOOST_CHECK(pileup.bases()[0] == Base::T);
+      BOOST_CHECK(pileup.bases()[1] == Base::G);
+    }
+    ++position;
+  }
+  BOOST_CHECK_EQUAL(position, 109u);
+  remove(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( locus_iterator_unsorted_input )
+{
+  auto reader = LocusReader{"testdata/test_paired.bam"};
+  BOOST_CHECK_THROW(for (const auto& pileup : reader) (void) pileup, UnsortedInputException);
+}
+
+BOOST_AUTO_TEST_CASE( locus_iterator_deletions_insertions_and_skips )
+{
+  // r1 has a deletion, r2 an insertion and r3 a reference skip (spliced read)
+  const auto filename = string{"locus_iterator_test.sam"};
+  {
+    auto output = ofstream{filename};
+    output << "@HD\tVN:1.5\tSO:coordinate\n@SQ\tSN:chr1\tLN:1000\n"
+           << "r1\t0\tchr1\t101\t60\t3M2D3M\t*\t0\t0\tACGTAC\tIIIIII\n"
+           << "r2\t16\tchr1\t101\t60\t2M2I4M\t*\t0\t0\tGGTTCCAA\tIIIIIIII\n"
+           << "r3\t0\tchr1\t103\t60\t2M3N2M\t*\t0\t0\tTTGG\tIIII\n";
+  }
+  struct Element { Base base; uint32_t read_offset; uint8_t deletion; uint8_t insertion; };
+  const auto A = Base::A, C = Base::C, G = Base::G, T = Base::T, N = Base::N;
+  const auto expected = vector<vector<Element>>{
+    {{A, 0, 0, 0}, {G, 0, 0, 0}},                   // 101
+    {{C, 1, 0, 0}, {G, 1, 0, 1}},                   // 102: r2 has an insertion after it
+    {{G, 2, 0, 0}, {C, 4, 0, 0}, {T, 0, 0, 0}},     // 103: r1 is followed by a deletion, not an insertion
+    {{N, 3, 1, 0}, {C, 5, 0, 0}, {T, 1, 0, 0}},     // 104: r1 deletion (offset of the next base)
+    {{N, 3, 1, 0}, {A, 6, 0, 0}},                   // 105: r3 skips 105-107
+    {{T, 3, 0, 0}, {A, 7, 0, 0}},                   // 106
+    {{A, 4, 0, 0}},                                 // 107
+    {{C, 5, 0, 0}, {G, 2, 0, 0}},                   // 108
+    {{G, 3, 0, 0}}                                  // 109
+  };
+  auto position = 101u;
+  for (const auto& pileup : LocusReader{filename}) {
+    BOOST_REQUIRE_LT(position - 101, expected.size());
+    BOOST_CHECK_EQUAL(pileup.position(), position);
+    const auto& elements = expected[position - 101];
+    BOOST_REQUIRE_EQUAL(pileup.size(), elements.size());
+    auto deletions = 0u, insertions = 0u;
+    for (auto i = 0u; i != elements.size(); ++i) {
+      BOOST_CHECK(pileup.bases()[i] == elements[i].base);
+      BOOST_CHECK_EQUAL(pileup.read_offsets()[i], elements[i].read_offset);
+      BOOST_CHECK_EQUAL(pileup.deletions()[i], elements[i].deletion);
+      BOOST_CHECK_EQUAL(pileup.insertions()[i], elements[i].insertion);
+      if (elements[i].deletion)
+        BOOST_CHECK_EQUAL(pileup.base_quals()[i], 0);
+      deletions += elements[i].deletion;
+      insertions += elements[i].insertion;
+    }
+    BOOST_CHECK_EQUAL(pileup.deletion_count(), deletions);
+    BOOST_CHECK_EQUAL(pileup.insertion_count(), insertions);
+    ++position;
+  }
+  BOOST_CHECK_EQUAL(position, 110u);
+  remove(filename.c_str());
+}
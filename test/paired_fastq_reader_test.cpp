@@ -0,0 +1,82 @@
+#include <boost/test/unit_test.hpp>
+
+#include "paired_fastq_reader.h"
+#include "exceptions.h"
+#include "test_utils.h"
+
+#include <sstream>
+#include <string>
+
+using namespace std;
+using namespace gamgee;
+
+string paired_fastq(const uint32_t num_reads, const string& suffix, const char base) {
+  auto fastq = string{};
+  for (auto i = 0u; i != num_reads; ++i)
+    fastq += "@read" + to_string(i) + suffix + " comment\n" + string(10 + i % 7, base) + "\n+\n" + string(10 + i % 7, 'I') + "\n";
+  return fastq;
+}
+
+uint32_t count_pairs(PairedFastqReader&& reader) {
+  auto pairs = 0u;
+  for (auto& mates : reader) {
+    BOOST_CHECK_EQUAL(mates.first.name().substr(0, mates.first.name().size() - 2), "read" + to_string(pairs));
+    BOOST_CHECK_EQUAL(mates.first.sequence(), string(10 + pairs % 7, 'A'));
+    BOOST_CHECK_EQUAL(mates.second.sequence(), string(10 + pairs % 7, 'C'));
+    ++pairs;
+  }
+  return pairs;
+}
+
+BOOST_AUTO_TEST_CASE( paired_fastq_reader_pairs_mates )
+{
+  for (const auto num_reads : {0u, 1u, 1024u, 3000u}) {
+    const auto first = paired_fastq(num_reads, "/1", 'A');
+    const auto second = paired_fastq(num_reads, "/2", 'C');
+    BOOST_CHECK_EQUAL(count_pairs(PairedFastqReader{new istringstream{first}, new istringstream{second}}), num_reads);
+  }
+  auto pairs = 0u;
+  for (auto& mates : PairedFastqReader{"testdata/complete_same_seq.fq", "testdata/complete_same_seq.fq.gz"}) {
+    BOOST_CHECK(mates.first == mates.second);
+    ++pairs;
+  }
+  BOOST_CHECK_EQUAL(pairs, 3u);
+}
+
+BOOST_AUTO_TEST_CASE( paired_fastq_reader_mismatches )
+{
+  const auto first = paired_fastq(2000, "/1", 'A');
+  auto swapped = paired_fastq(2000, "/2", 'C');
+  swapped.replace(swapped.find("@read1500/2"), 11, "@read1501/2");
+  BOOST_CHECK_THROW(count_pairs(PairedFastqReader{new istringstream{first}, new istringstream{swapped}}), MateMismatchException);
+  auto unchecked = 0u;
+  for (auto& mates : PairedFastqReader{new istringstream{first}, new istringstream{swapped}, 1, false}) {
+    BOOST_CHECK(!mates.first.name().empty());
+    ++unchecked;
+  }
+  BOOST_CHECK_EQUAL(unchecked, 2000u);
+  BOOST_CHECK_THROW(count_pairs(PairedFastqReader{new istringstream{first}, new istringstream{paired_fastq(1999, "/2", 'C')}}), MateMismatchException);
+  BOOST_CHECK_THROW(count_pairs(PairedFastqReader{new istringstream{paired_fastq(2048, "/1", 'A')}, new istringstream{paired_fastq(2049, "/2", 'C')}}), MateMismatchException);
+  BOOST_CHECK_THROW(PairedFastqReader("testdata/complete_same_seq.fq", "foo/bar/nonexistent.fq"), FileOpenException);
+}
+
+BOOST_AUTO_TEST_CASE( paired_fastq_reader_stops_halfway )
+{
+  auto reader = PairedFastqReader{new istringstream{paired_fastq(5000, "/1", 'A')}, new istringstream{paired_fastq(5000, "/2", 'C')}};
+  auto iterator = reader.begin();
+  BOOST_CHECK_EQUAL((*iterator).first.name(), "read0/1");
+  BOOST_CHECK_EQUAL((++iterator).second.name(), "read1/2");
+  auto moved = check_move_constructor(iterator);
+  BOOST_CHECK_EQUAL((*moved).second.name(), "read1/2");
+  BOOST_CHECK(moved != reader.end());
+}
+
+BOOST_AUTO_TEST_CASE( mate_names )
+{
+  BOOST_CHECK(mate_names_match("read1", "read1"));
+  BOOST_CHECK(mate_names_match("read1/1", "read1/2"));
+  BOOST_CHECK(!mate_names_match("read1/1", "read2/2"));
+  BOOST_CHECK(!mate_names_match("read1", "read12"));
+  BOOST_CHECK(!mate_names_match("read1a", "read1b"));
+  BOOST_CHECK(mate_names_match("", ""));
+}
@@ -1,10 +1,16 @@
 #include "reference_map.h"
 #include "reference_iterator.h"
+#include "indexed_reference.h"
+#include "packed_reference.h"
+#include "exceptions.h"
 
 #include "utils/utils.h"
 
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -89,3 +95,207 @@ BOOST_AUTO_TEST_CASE( reference_iterator_test ) {
   }
 }
 
+
+BOOST_AUTO_TEST_CASE( reference_iterator_random_access_test ) {
+  // line-wrapped contigs longer than a window, with bases asked for in any order
+  const auto filename = string{"reference_iterator_test.fa"};
+  auto sequences = vector<string>{string(3 * ReferenceIterator::window_size + 100, 'A'), string(1000, 'A'), "ACGTN"};
+  for (auto& sequence : sequences)
+    for (auto i = 0u; i != sequence.size(); ++i)
+      sequence[i] = "ACGTNacgtn"[(i * 7 + i / 11 + sequence.size()) % 10];
+  {
+    auto output = ofstream{filename};
+    for (auto contig = 0u; contig != sequences.size(); ++contig) {
+      output << ">contig" << contig << "\n";
+      for (auto i = 0u; i < sequences[contig].size(); i += 60)
+        output << sequences[contig].substr(i, 60) << "\n";
+    }
+  }
+  auto reference = ReferenceIterator{filename};
+  for (auto i = 0u; i != 20000; ++i) {
+    const auto contig = (i * 13 + i / 7) % sequences.size();
+    const auto location = (i * 7919 + i / 3) % sequences[contig].size() + 1;
+    BOOST_CHECK_EQUAL(reference.ref_base("contig" + to_string(contig), location), sequences[contig][location - 1]);
+  }
+  for (auto contig = sequences.size(); contig-- != 0; )   // backwards
+    for (auto location = sequences[contig].size(); location != 0; --location)
+      BOOST_CHECK_EQUAL(reference.ref_base("contig" + to_string(contig), location), sequences[contig][location - 1]);
+  BOOST_CHECK_THROW(reference.ref_base("contig3", 1), ChromosomeNotFoundException);
+  BOOST_CHECK_THROW(reference.ref_base("contig2", 0), ChromosomeSizeException);
+  BOOST_CHECK_THROW(reference.ref_base("contig2", 6), ChromosomeSizeException);
+  BOOST_CHECK_EQUAL(reference.ref_base("contig0", 1), sequences[0][0]);   // still usable after the errors
+  auto copy = reference;
+  BOOST_CHECK_EQUAL(copy.ref_base("contig0", 2), sequences[0][1]);
+  BOOST_CHECK(!ifstream{filename + ".fai"}.good());   // the index is only saved when asked for
+  ReferenceIterator{filename, true};
+  BOOST_CHECK(ifstream{filename + ".fai"}.good());
+  remove((filename + ".fai").c_str());
+  remove(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( indexed_reference_get_sequence_test )
+{
+  for (const auto& filename : {FILE1, FILE2}) {
+    const auto reference_map = ReferenceMap{filename};
+    const auto reference = IndexedReference{filename, false};
+    BOOST_CHECK_EQUAL(reference.contigs().size(), reference_map.size());
+    auto buffer = string{};
+    for (const auto& chr_seq : reference_map) {
+      const auto& sequence = chr_seq.second;
+      BOOST_CHECK_EQUAL(reference.contig(chr_seq.first).length, sequence.size());
+      for (auto start = 1u; start <= sequence.size(); ++start) {
+        BOOST_CHECK_EQUAL(reference.base(chr_seq.first, start), sequence[start - 1]);
+        for (auto stop = start; stop <= sequence.size() + 1; ++stop) {  // intervals are cut at the end of the contig
+          const auto interval = Interval{chr_seq.first, start, stop};
+          BOOST_CHECK_EQUAL(reference.get_sequence(interval), reference_map.get_sequence(interval));
+          BOOST_CHECK_EQUAL(reference.get_sequence(interval, true), reference_map.get_sequence(interval, true));
+          BOOST_CHECK_EQUAL(reference.get_sequence_view(interval, buffer), reference_map.get_sequence(interval));
+        }
+      }
+    }
+    BOOST_CHECK_THROW(reference.get_sequence(Interval{"chrZ", 1, 2}), ChromosomeNotFoundException);
+    BOOST_CHECK_THROW(reference.base(reference.contigs().front().name, 1000), ChromosomeSizeException);
+    BOOST_CHECK_THROW(reference.get_sequence(Interval{reference.contigs().front().name, 0, 2}), ChromosomeSizeException);
+  }
+  // sequences on a single line are not copied
+  const auto reference = IndexedReference{FILE1, false};
+  auto buffer = string{};
+  const auto view = reference.get_sequence_view(Interval{"chrB", 3, 10}, buffer);
+  BOOST_CHECK(view.data() > reference.data() && buffer.empty());
+  BOOST_CHECK_THROW(IndexedReference{"testdata/test_reference.fa.gz"}, ReferenceIndexException);
+  BOOST_CHECK_THROW(IndexedReference{"foo/bar/nonexistent.fa"}, FileOpenException);
+}
+
+BOOST_AUTO_TEST_CASE( indexed_reference_fai_test )
+{
+  // line-wrapped contigs (with and without windows line breaks, empty lines at the end, no line break at the end)
+  const auto filename = string{"indexed_reference_test.fa"};
+  const auto index_filename = filename + ".fai";
+  auto sequences = vector<string>{string(100, 'A'), "ACGTNacgtn", "", string(7, 'G'), "TTTTTTTTTTTTTT"};
+  for (auto i = 0u; i != sequences[0].size(); ++i)
+    sequences[0][i] = "ACGT"[i * 7 % 4];
+  {
+    auto output = ofstream{filename};
+    output << ">one first contig\n";
+    for (auto i = 0u; i < 100; i += 7)
+      output << sequences[0].substr(i, 7) << "\n";
+    output << ">two\r\nACGTN\r\nacgtn\r\n\r\n>three\n>four\nGGGGGGG\n\n>five\nTTTTTT\nTTTTTT\nTT";
+  }
+  remove(index_filename.c_str());
+  IndexedReference{filename};
+  BOOST_CHECK(!ifstream{index_filename}.good());   // the index is only saved when asked for
+  for (auto i = 0; i != 2; ++i) {   // builds the index (and saves it), then reads it
+    const auto reference = IndexedReference{filename, true};
+    BOOST_CHECK(ifstream{index_filename}.good());
+    BOOST_REQUIRE_EQUAL(reference.contigs().size(), sequences.size());
+    auto buffer = string{};
+    for (auto contig = 0u; contig != sequences.size(); ++contig) {
+      const auto& name = reference.contigs()[contig].name;
+      BOOST_CHECK_EQUAL(reference.contig(name).length, sequences[contig].size());
+      for (auto start = 1u; start <= sequences[contig].size(); ++start)
+        for (auto stop = start; stop <= sequences[contig].size(); ++stop)
+          BOOST_CHECK_EQUAL(reference.get_sequence_view(Interval{name, start, stop}, buffer), sequences[contig].substr(start - 1, stop - start + 1));
+    }
+  }
+  auto index = ifstream{index_filename};
+  auto first_line = string{};
+  getline(index, first_line);
+  BOOST_CHECK_EQUAL(first_line, "one\t100\t18\t7\t8");   // the samtools format
+  index.close();
+  {
+    auto output = ofstream{filename};  // the index doesn't match anymore
+    output << ">one\nACGT\n";
+  }
+  BOOST_CHECK_THROW(IndexedReference{filename}, ReferenceIndexException);
+  remove(index_filename.c_str());
+  remove(filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( packed_reference_get_sequence_test )
+{
+  for (const auto& filename : {FILE1, FILE2}) {
+    const auto reference_map = ReferenceMap{filename};
+    const auto reference = PackedReference{filename};
+    BOOST_CHECK_EQUAL(reference.contigs().size(), reference_map.size());
+    for (const auto& chr_seq : reference_map) {
+      const auto& sequence = chr_seq.second;
+      BOOST_CHECK_EQUAL(reference.contig(chr_seq.first).length, sequence.size());
+      for (auto start = 1u; start <= sequence.size(); ++start) {
+        BOOST_CHECK_EQUAL(reference.base(chr_seq.first, start), sequence[start - 1]);
+        for (auto stop = start; stop <= sequence.size() + 1; ++stop) {  // intervals are cut at the end of the contig
+          const auto interval = Interval{chr_seq.first, start, stop};
+          BOOST_CHECK_EQUAL(reference.get_sequence(interval), reference_map.get_sequence(interval));
+          BOOST_CHECK_EQUAL(reference.get_sequence(interval, true), reference_map.get_sequence(interval, true));
+        }
+      }
+    }
+    BOOST_CHECK_THROW(reference.get_sequence(Interval{"chrZ", 1, 2}), ChromosomeNotFoundException);
+    BOOST_CHECK_THROW(reference.base(string{reference.contigs().front().name}, 1000), ChromosomeSizeException);
+    BOOST_CHECK_THROW(reference.get_sequence(Interval{string{reference.contigs().front().name}, 0, 2}), ChromosomeSizeException);
+  }
+  BOOST_CHECK_THROW(PackedReference{"foo/bar/nonexistent.fa"}, FileOpenException);
+}
+
+BOOST_AUTO_TEST_CASE( packed_reference_exceptions_and_soft_mask_test )
+{
+  // contigs of every length around the byte and vector sizes, with IUPAC codes, runs of Ns and lower case bases
+  const auto filename = string{"packed_reference_test.fa"};
+  auto sequences = vector<string>{};
+  for (const auto length : {0u, 1u, 3u, 4u, 5u, 63u, 64u, 65u, 200u, 1000u}) {
+    auto sequence = string(length, 'A');
+    for (auto i = 0u; i != length; ++i)
+      sequence[i] = "ACGTACGTTGCAacgtNNNNNRYnnK-"[(i * 7 + i / 13) % 27];
+    sequences.push_back(sequence);
+  }
+  {
+    auto output = ofstream{filename};
+    for (auto i = 0u; i != sequences.size(); ++i)
+      output << ">contig" << i << "\n" << sequences[i] << "\n";
+  }
+  const auto packed_filename = filename + ".2bit";
+  PackedReference{filename}.save(packed_filename);
+  const auto check_bases = [&sequences](const PackedReference& reference, const bool soft_mask) {
+    BOOST_REQUIRE_EQUAL(reference.contigs().size(), sequences.size());
+    BOOST_CHECK_EQUAL(reference.soft_masked(), soft_mask);
+    for (auto i = 0u; i != sequences.size(); ++i) {
+      auto expected = sequences[i];
+      if (!soft_mask)
+        transform(expected.begin(), expected.end(), expected.begin(), ::toupper);
+      const auto& contig = reference.contigs()[i];
+      BOOST_CHECK_EQUAL(contig.name, "contig" + to_string(i));
+      const auto step = expected.size() > 100 ? 7u : 1u;
+      for (auto begin = 0u; begin <= expected.size(); begin += step) {
+        for (auto end = begin; end <= expected.size(); end += step) {
+          auto bases = string(end - begin, '\0');
+          contig.unpack(begin, end, &bases[0]);
+          BOOST_CHECK_EQUAL(bases, expected.substr(begin, end - begin));
+          BOOST_CHECK_EQUAL(contig.has_exceptions(begin, end), expected.find_first_not_of("ACGTacgt", begin) < end);
+        }
+      }
+    }
+  };
+  check_bases(PackedReference{filename}, true);
+  check_bases(PackedReference{filename, false}, false);
+  const auto loaded = PackedReference::load(packed_filename);   // memory-mapped
+  check_bases(loaded, true);
+  // the windows are the 2-bit codes of the bases, exceptions being A
+  const auto& contig = loaded.contigs().back();
+  const auto& sequence = sequences.back();
+  for (auto k = 1u; k <= 32; ++k) {
+    for (auto position = 0u; position + k <= sequence.size(); ++position) {
+      auto expected = uint64_t{0};
+      for (auto i = position; i != position + k; ++i) {
+        const auto code = string{"ACGT"}.find(char(toupper(sequence[i])));
+        expected = expected << 2 | (code == string::npos ? 0 : code);
+      }
+      BOOST_CHECK_EQUAL(contig.window(position, k), expected);
+    }
+  }
+  {
+    auto output = ofstream{packed_filename};   // not a packed reference
+    output << ">one\nACGT\n";
+  }
+  BOOST_CHECK_THROW(PackedReference::load(packed_filename), ReferenceIndexException);
+  remove(packed_filename.c_str());
+  remove(filename.c_str());
+}
@@ -1,7 +1,11 @@
 #include "sam/sam_builder.h"
 #include "sam/sam_reader.h"
+#include "fastq.h"
+#include "missing.h"
 
 #include <boost/test/unit_test.hpp>
+#include <limits>
+#include <algorithm>
 #include <stdexcept>
 
 using namespace std;
@@ -427,6 +431,62 @@ BOOST_AUTO_TEST_CASE( missing_required_data_field ) {
   BOOST_CHECK_THROW(builder.build(), logic_error);
 }
 
+BOOST_AUTO_TEST_CASE( set_bases_long_and_odd_length_strings ) {
+  auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
+  auto builder = SamBuilder{header, false};
+  for (const auto length : {1u, 31u, 32u, 33u, 63u, 64u, 65u, 151u}) {
+    auto bases = string(length, 'A');
+    for (auto i = 0u; i != length; ++i)
+      bases[i] = "ACGTNacgtn"[(i * 3) % 10];
+    const auto read = builder.set_name("foo").set_bases(bases).build();
+    auto upper_case = bases;
+    for (auto& base : upper_case)
+      base = toupper(base);
+    BOOST_CHECK_EQUAL(read.bases().to_string(), upper_case);
+    BOOST_CHECK(read.bases() == builder.set_bases(upper_case).build().bases());
+  }
+}
+
+BOOST_AUTO_TEST_CASE( set_bases_long_and_odd_length_vectors ) {
+  auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
+  auto builder = SamBuilder{header, false};
+  const auto all_bases = vector<Base>{ Base::A, Base::C, Base::G, Base::T, Base::N };
+  for (const auto length : {0u, 1u, 31u, 32u, 33u, 63u, 64u, 65u, 151u}) {
+    auto bases = vector<Base>(length);
+    auto ascii = string(length, 'A');
+    for (auto i = 0u; i != length; ++i) {
+      bases[i] = all_bases[(i * 3) % all_bases.size()];
+      ascii[i] = "ACGTN"[(i * 3) % all_bases.size()];
+    }
+    const auto read = builder.set_name("foo").set_bases(bases).build();
+    BOOST_CHECK_EQUAL(read.bases().to_string(), ascii);
+    BOOST_CHECK(read.bases().to_vector() == bases);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( set_fastq ) {
+  auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
+  auto builder = SamBuilder{header};
+
+  const auto read = builder.set_fastq(Fastq{"read1", "comment", "ACGTNRY", "I5+!#&?"}).set_unmapped().build();
+  BOOST_CHECK_EQUAL(read.name(), "read1");
+  BOOST_CHECK(read.unmapped());
+  BOOST_CHECK_EQUAL(read.cigar().size(), 0u);   // unmapped reads don't need a cigar
+  BOOST_CHECK_EQUAL(read.bases().to_string(), "ACGTNRY");
+  BOOST_CHECK_EQUAL(read.base_quals().to_string(), "40 20 10 0 2 5 30");
+
+  // FASTA records have no qualities
+  const auto fasta_read = builder.reset().set_fastq(Fastq{"read2", "", "GATTACA"}).set_unmapped().build();
+  BOOST_CHECK_EQUAL(fasta_read.name(), "read2");
+  BOOST_CHECK_EQUAL(fasta_read.bases().to_string(), "GATTACA");
+  BOOST_CHECK_EQUAL(fasta_read.base_quals().size(), 7u);
+  BOOST_CHECK_EQUAL(fasta_read.base_quals()[0], 0xff);
+
+  // mapped reads still need a cigar
+  BOOST_CHECK_THROW(builder.reset().set_fastq(Fastq{"read3", "", "ACGT", "IIII"}).build(), logic_error);
+  BOOST_CHECK_EQUAL(builder.set_cigar("4M").build().base_quals().to_string(), "40 40 40 40");
+}
+
 BOOST_AUTO_TEST_CASE( build_without_validation ) {
   auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
   auto builder = SamBuilder{header, false}; // disable validation
@@ -468,3 +528,106 @@ BOOST_AUTO_TEST_CASE( builder_starting_read_constructor ) {
   const auto read = builder.build(); // create a read (basically a copy of the original read)
   BOOST_CHECK(!read.unmapped());
 }
+
+BOOST_AUTO_TEST_CASE( set_array_tags ) {
+  const auto original_read = *(SingleSamReader{"testdata/test_simple.bam"}.begin());
+  const auto probabilities = vector<uint8_t>{0, 128, 255};
+  const int16_t depths[] = {-3, 0, 1000, 32767};
+  auto builder = SamBuilder{original_read};
+  const auto read = builder.set_array_tag("ML", probabilities).set_array_tag("ZD", depths, 4).set_array_tag("ZF", {0.5f, -1.25f}).build();
+
+  const auto ml = read.array_tag<uint8_t>("ML");
+  BOOST_REQUIRE(!missing(ml));
+  BOOST_CHECK_EQUAL(read.array_tag_type("ML"), 'C');
+  BOOST_CHECK_EQUAL_COLLECTIONS(ml.value().begin(), ml.value().end(), probabilities.begin(), probabilities.end());
+  const auto zd = read.array_tag<int16_t>("ZD").value();
+  BOOST_CHECK_EQUAL_COLLECTIONS(zd.begin(), zd.end(), begin(depths), end(depths));
+  BOOST_CHECK_EQUAL(zd[2], 1000);
+  BOOST_CHECK_THROW(zd[4], out_of_range);
+  BOOST_CHECK_EQUAL(zd.end() - zd.begin(), 4);
+  BOOST_CHECK(zd.end() > zd.begin() && zd.begin() <= zd.begin() && zd.end() >= zd.begin() + 4);   // random access iterators
+  BOOST_CHECK_EQUAL(*(2 + zd.begin()), 1000);
+  BOOST_CHECK_EQUAL(*lower_bound(zd.begin(), zd.end(), int16_t{1}), 1000);   // sorted values
+  BOOST_CHECK(is_sorted(zd.begin(), zd.end()));
+  const auto zf = read.array_tag<float>("ZF").value();
+  BOOST_CHECK_EQUAL(zf.size(), 2u);
+  BOOST_CHECK_EQUAL(zf[1], -1.25f);
+  BOOST_CHECK(missing(read.array_tag<int8_t>("ML")));           // wrong element type
+  BOOST_CHECK(missing(read.array_tag<uint8_t>("RG")));          // not an array
+  BOOST_CHECK_EQUAL(read.array_tag_type("RG"), '\0');
+  BOOST_CHECK_EQUAL(read.string_tag("RG").value(), "exampleBAM.bam");  // the tags of the original read are still there
+  BOOST_CHECK_EQUAL(read.integer_tag("ZB").value(), 23);
+
+  // copying a tag from another read, and replacing tags
+  auto copy_builder = SamBuilder{original_read};
+  const auto copy = copy_builder.set_array_tag("ZD", read.array_tag<int16_t>("ZD").value()).set_array_tag("ML", vector<uint8_t>{}).set_array_tag("ML", {uint8_t{7}}).build();
+  const auto copied_zd = copy.array_tag<int16_t>("ZD").value();
+  BOOST_CHECK_EQUAL_COLLECTIONS(copied_zd.begin(), copied_zd.end(), begin(depths), end(depths));
+  BOOST_CHECK_EQUAL(copy.array_tag<uint8_t>("ML").value().size(), 1u);
+  BOOST_CHECK_EQUAL(copy.array_tag<uint8_t>("ML").value()[0], 7);
+}
+
+BOOST_AUTO_TEST_CASE( set_and_remove_tags ) {
+  const auto original_read = *(SingleSamReader{"testdata/test_simple.bam"}.begin());
+  auto builder = SamBuilder{original_read};
+  const auto integers = vector<int32_t>{0, 255, 256, 65535, 65536, -1, -128, -129, -32768, -32769, numeric_limits<int32_t>::min(), numeric_limits<int32_t>::max()};
+  for (auto i = 0u; i != integers.size(); ++i)
+    builder.set_integer_tag(string{'X', char('a' + i)}, integers[i]);
+  builder.set_double_tag("ZA", 0.25).set_char_tag("ZC", 'q').set_string_tag("RX", "ACGT-TTGA").set_string_tag("CB", "");
+  const auto read = builder.build();
+  for (auto i = 0u; i != integers.size(); ++i)
+    BOOST_CHECK_EQUAL(read.integer_tag(string{'X', char('a' + i)}).value(), integers[i]);
+  BOOST_CHECK_EQUAL(read.double_tag("ZA").value(), 0.25);      // replaced in place
+  BOOST_CHECK_EQUAL(read.char_tag("ZC").value(), 'q');
+  BOOST_CHECK_EQUAL(read.string_tag("RX").value(), "ACGT-TTGA");
+  BOOST_CHECK(!missing(read.string_tag("CB")));
+  BOOST_CHECK_EQUAL(read.string_tag("CB").value(), "");
+  BOOST_CHECK_EQUAL(read.string_tag("RG").value(), "exampleBAM.bam");
+  BOOST_CHECK_EQUAL(read.integer_tag("ZB").value(), 23);
+
+  const auto removed = builder.remove_tag("RG").remove_tag("Xa").remove_tag("ZZ").set_string_tag("RX", "A").build();
+  BOOST_CHECK(missing(removed.string_tag("RG")));
+  BOOST_CHECK(missing(removed.integer_tag("Xa")));
+  BOOST_CHECK_EQUAL(removed.integer_tag("Xb").value(), 255);
+  BOOST_CHECK_EQUAL(removed.string_tag("RX").value(), "A");
+  BOOST_CHECK_EQUAL(removed.string_tag("PG").value(), "0");
+  BOOST_CHECK_EQUAL(read.string_tag("RX").value(), "ACGT-TTGA");  // reads already built are unaffected
+  BOOST_CHECK_THROW(builder.set_string_tag("RX", string{"A\0B", 3}), invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( build_into_reuses_memory ) {
+  const auto original_read = *(SingleSamReader{"testdata/test_simple.bam"}.begin());
+  auto builder = SamBuilder{original_read};
+  builder.validate();
+  builder.set_validate_on_build(false);
+  auto read = Sam{};
+  auto first_quality = static_cast<const uint8_t*>(nullptr);
+  auto copy = Sam{};
+  for (auto i = 0u; i != 4; ++i) {
+    builder.reset().set_name("read" + to_string(i)).set_chromosome(i).set_cigar({Cigar::make_cigar_element(4, CigarOperator::M)})
+           .set_bases("ACGT").set_base_quals({30, 31, 32, uint8_t(i)}).set_string_tag("RX", "ACGT");
+    builder.build_into(read);
+    BOOST_CHECK_EQUAL(read.name(), "read" + to_string(i));
+    BOOST_CHECK_EQUAL(read.chromosome(), i);
+    BOOST_CHECK_EQUAL(read.cigar().to_string(), "4M");
+    BOOST_CHECK_EQUAL(read.bases().to_string(), "ACGT");
+    BOOST_CHECK_EQUAL(read.base_quals()[3], i);
+    BOOST_CHECK_EQUAL(read.string_tag("RX").value(), "ACGT");
+    BOOST_CHECK(missing(read.string_tag("RG")));               // reset() cleared the tags of the starting read
+    const auto quality = &read.base_quals()[0];
+    if (i == 0)
+      first_quality = quality;
+    else if (i != 3)
+      BOOST_CHECK(quality == first_quality);                   // same record and data buffer
+    if (i == 2)
+      copy = read;                                             // the next build moves on to another record
+  }
+  BOOST_CHECK_EQUAL(copy.name(), "read2");
+  BOOST_CHECK_EQUAL(copy.base_quals()[3], 2);
+  BOOST_CHECK_EQUAL(read.name(), "read3");
+
+  auto invalid_builder = SamBuilder{original_read};
+  invalid_builder.reset().set_name("no_cigar").set_bases("ACGT").set_base_quals({1, 2, 3, 4});
+  BOOST_CHECK_THROW(invalid_builder.build_into(read), logic_error);
+  BOOST_CHECK_EQUAL(read.name(), "read3");
+}
@@ -1,5 +1,7 @@
 #include "sam/sam_reader.h"
 #include "sam/indexed_sam_reader.h"
+#include "sam/name_pair_sam_reader.h"
+#include "sam/sam_sorter.h"
 #include "exceptions.h"
 
 #include "test_utils.h"
@@ -83,3 +85,46 @@ BOOST_AUTO_TEST_CASE( indexed_sam_reader_nonexistent_file ) {
 BOOST_AUTO_TEST_CASE( indexed_sam_reader_nonexistent_index ) {
   BOOST_CHECK_THROW(IndexedSamReader<IndexedSamIterator>("testdata/unindexed/test_unindexed.bam", vector<string>{}), IndexLoadException);
 }
+
+BOOST_AUTO_TEST_CASE( name_pair_sam_reader_coordinate_sorted ) {
+  const auto sorted_filename = string{"name_pair_sam_reader_test.bam"};
+  SamSorter::sort("testdata/test_paired.bam", sorted_filename);
+  for (const auto memory_limit : {uint64_t{1} << 30, uint64_t{1000}}) {
+    auto options = SamPairIteratorOptions{};
+    options.memory_limit = memory_limit;
+    auto read_counter = 0u;
+    auto secondary_alignments = 0u;
+    for (const auto& p : NamePairSamReader{sorted_filename, options}) {
+      if (p.second.empty()) {
+        BOOST_CHECK(p.first.secondary() || p.first.supplementary());
+        ++secondary_alignments;
+      }
+      else {
+        BOOST_CHECK_EQUAL(p.first.name(), p.second.name());
+        BOOST_CHECK(p.first.first() != p.second.first());
+        read_counter += 2;
+      }
+    }
+    BOOST_CHECK_EQUAL(secondary_alignments, 7u);
+    BOOST_CHECK_EQUAL(read_counter, 44u);
+  }
+  remove(sorted_filename.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( name_pair_sam_reader_unmatched_mates ) {
+  auto unmatched = 0u;
+  auto pairs = 0u;
+  for (const auto& p : NamePairSamReader{"testdata/test_simple.bam"}) {
+    if (p.second.empty()) {
+      BOOST_CHECK_EQUAL(p.first.name(), "30PPJAAXX090125:1:60:1109:517#0");  // its mate is not in the file
+      ++unmatched;
+    }
+    else {
+      BOOST_CHECK_EQUAL(p.first.name(), p.second.name());
+      BOOST_CHECK_LE(p.first.alignment_start(), p.second.alignment_start());
+      ++pairs;
+    }
+  }
+  BOOST_CHECK_EQUAL(unmatched, 1u);
+  BOOST_CHECK_EQUAL(pairs, 16u);
+}
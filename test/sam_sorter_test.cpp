@@ -0,0 +1,130 @@
+#include "sam/sam_builder.h"
+#include "sam/sam_reader.h"
+#include "sam/sam_sorter.h"
+#include "sam/sam_writer.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using namespace gamgee;
+
+namespace {
+
+vector<Sam> read_all(const string& filename) {
+  auto records = vector<Sam>{};
+  for (const auto& record : SingleSamReader{filename})
+    records.push_back(record);
+  return records;
+}
+
+vector<Sam> sort_records(const string& input, const SamSorterOptions& options, uint32_t& spilled_runs) {
+  const auto output = string{"sam_sorter_test_output.bam"};
+  auto reader = SingleSamReader{input};
+  {
+    SamSorter sorter {reader.header(), output, options};
+    for (const auto& record : reader)
+      sorter.add_record(record);
+    sorter.finish();
+    spilled_runs = sorter.spilled_runs();
+  }
+  const auto result = read_all(output);
+  remove(output.c_str());
+  return result;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( sam_sorter_queryname )
+{
+  const auto input = read_all("testdata/test_paired.bam");
+  for (const auto memory_limit : {uint64_t{1} << 30, uint64_t{4096}}) {
+    auto options = SamSorterOptions{};
+    options.order = SamSortOrder::queryname;
+    options.memory_limit = memory_limit;
+    options.num_threads = 2;
+    auto spilled_runs = 0u;
+    const auto sorted = sort_records("testdata/test_paired.bam", options, spilled_runs);
+    BOOST_CHECK_EQUAL(spilled_runs > 0, memory_limit == 4096);
+    BOOST_REQUIRE_EQUAL(sorted.size(), input.size());
+    for (auto i = 1u; i < sorted.size(); ++i) {
+      const auto order = strcmp(sorted[i - 1].name().c_str(), sorted[i].name().c_str());
+      BOOST_CHECK_LE(order, 0);
+      if (order == 0)
+        BOOST_CHECK(!(sorted[i - 1].last() && sorted[i].first()));  // first mates come first
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( sam_sorter_coordinate_is_stable )
+{
+  const auto input = read_all("testdata/test_paired.bam");
+  auto options = SamSorterOptions{};
+  auto in_memory_runs = 0u;
+  const auto in_memory = sort_records("testdata/test_paired.bam", options, in_memory_runs);
+  options.memory_limit = 2048;
+  auto spilled_runs = 0u;
+  const auto spilled = sort_records("testdata/test_paired.bam", options, spilled_runs);
+  BOOST_CHECK_EQUAL(in_memory_runs, 0u);
+  BOOST_CHECK_GT(spilled_runs, 1u);
+  BOOST_REQUIRE_EQUAL(in_memory.size(), input.size());
+  BOOST_REQUIRE_EQUAL(spilled.size(), input.size());
+  for (auto i = 0u; i != spilled.size(); ++i) {
+    BOOST_CHECK_EQUAL(spilled[i].name(), in_memory[i].name());  // both are stable, so they agree on ties
+    BOOST_CHECK_EQUAL(spilled[i].first(), in_memory[i].first());
+    if (i > 0 && !spilled[i].unmapped() && !spilled[i - 1].unmapped()) {
+      BOOST_CHECK_LE(spilled[i - 1].chromosome(), spilled[i].chromosome());
+      if (spilled[i - 1].chromosome() == spilled[i].chromosome())
+        BOOST_CHECK_LE(spilled[i - 1].alignment_start(), spilled[i].alignment_start());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( sam_sorter_threads_agree )
+{
+  // enough records to sort each arena in parallel, with names sharing their first 8 characters (all queryname keys tie)
+  const auto input = "sam_sorter_test_threads_input.bam";
+  {
+    auto reader = SingleSamReader{"testdata/test_paired.bam"};
+    const auto templates = read_all("testdata/test_paired.bam");
+    auto writer = SamWriter{reader.header(), input};
+    auto position = 1u;
+    for (auto i = 0u; i != 40000; ++i) {
+      const auto& record = templates[i % templates.size()];
+      position = (position * 48271u) % 2147483647u;
+      auto builder = SamBuilder{record, false};
+      builder.set_name("template" + to_string(position % 5000));
+      auto built = builder.build();
+      if (!record.unmapped())
+        built.set_alignment_start(position % 1000000 + 1);
+      writer.add_record(built);
+    }
+  }
+  for (const auto order : {SamSortOrder::coordinate, SamSortOrder::queryname}) {
+    for (const auto memory_limit : {uint64_t{1} << 30, uint64_t{1} << 20}) {
+      auto options = SamSorterOptions{};
+      options.order = order;
+      options.memory_limit = memory_limit;
+      options.num_threads = 1;
+      auto serial_runs = 0u;
+      const auto serial = sort_records(input, options, serial_runs);
+      options.num_threads = 4;
+      auto parallel_runs = 0u;
+      const auto parallel = sort_records(input, options, parallel_runs);
+      BOOST_CHECK_EQUAL(parallel_runs, serial_runs);
+      BOOST_CHECK_EQUAL(serial_runs > 0, memory_limit == uint64_t{1} << 20);
+      BOOST_REQUIRE_EQUAL(serial.size(), 40000u);
+      BOOST_REQUIRE_EQUAL(parallel.size(), serial.size());
+      for (auto i = 0u; i != serial.size(); ++i) {
+        BOOST_CHECK_EQUAL(parallel[i].name(), serial[i].name());  // both are stable, so they agree on ties
+        BOOST_CHECK_EQUAL(parallel[i].alignment_start(), serial[i].alignment_start());
+        BOOST_CHECK_EQUAL(parallel[i].first(), serial[i].first());
+        if (i > 0 && order == SamSortOrder::queryname)
+          BOOST_CHECK_LE(serial[i - 1].name(), serial[i].name());
+      }
+    }
+  }
+  remove(input);
+}
@@ -4,9 +4,11 @@
 #include "sam/sam_reader.h"
 #include "sam/sam_builder.h"
 #include "missing.h"
+#include "utils/hts_memory.h"
 
 #include "test_utils.h"
 
+#include <algorithm>
 #include <vector>
 
 using namespace std;
@@ -234,6 +236,84 @@ BOOST_AUTO_TEST_CASE( comparing_different_base_quals ) {
   BOOST_CHECK(read1.base_quals() != read2.base_quals());
 }
 
+BOOST_AUTO_TEST_CASE( base_quals_statistics ) {
+  const auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
+  auto builder = SamBuilder{header};
+  for (const auto length : {1u, 15u, 16u, 17u, 40u, 151u}) {
+    auto quals = vector<uint8_t>(length);
+    for (auto i = 0u; i != length; ++i)
+      quals[i] = uint8_t((i * 37 + length) % 42);
+    const auto read = builder.set_name("q").set_bases(string(length, 'A')).set_cigar(to_string(length) + "M").set_base_quals(quals).build();
+    const auto base_quals = read.base_quals();
+    auto sum = uint64_t{0};
+    auto below_20 = 0u;
+    for (const auto q : quals) {
+      sum += q;
+      below_20 += q < 20;
+    }
+    BOOST_CHECK_EQUAL(base_quals.sum(), sum);
+    BOOST_CHECK_CLOSE(base_quals.mean(), double(sum) / length, 1e-9);
+    BOOST_CHECK_EQUAL(base_quals.min(), *min_element(quals.begin(), quals.end()));
+    BOOST_CHECK_EQUAL(base_quals.count_below(20), below_20);
+    BOOST_CHECK_EQUAL(base_quals.count_below(0), 0u);
+    BOOST_CHECK_EQUAL(base_quals.count_below(255), length);
+    BOOST_CHECK(equal(base_quals.begin(), base_quals.end(), quals.begin()));
+    BOOST_CHECK_EQUAL(base_quals.end() - base_quals.begin(), int(length));
+  }
+}
+
+BOOST_AUTO_TEST_CASE( base_quals_sliding_window_trim ) {
+  const auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
+  auto builder = SamBuilder{header};
+  builder.set_name("q").set_bases("ACGTACGTAC").set_cigar("10M");
+  const auto read = builder.set_base_quals({30, 30, 30, 30, 30, 30, 10, 10, 2, 2}).build();
+  BOOST_CHECK_EQUAL(read.base_quals().sliding_window_trim_position(4, 20), 5u);    // 30 30 10 10 is the first window below 20
+  BOOST_CHECK_EQUAL(read.base_quals().sliding_window_trim_position(1, 20), 6u);
+  BOOST_CHECK_EQUAL(read.base_quals().sliding_window_trim_position(4, 1), 10u);    // nothing to trim
+  BOOST_CHECK_EQUAL(read.base_quals().sliding_window_trim_position(20, 30), 0u);   // the whole read is one window
+  BOOST_CHECK_THROW(read.base_quals().sliding_window_trim_position(0, 20), invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( base_quals_phred33_and_to_string ) {
+  const auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
+  auto builder = SamBuilder{header};
+  auto quals = vector<uint8_t>{};
+  for (auto q = 0u; q != 256; ++q)
+    quals.push_back(uint8_t(q));
+  const auto read = builder.set_name("q").set_bases(string(256, 'A')).set_cigar("256M").set_base_quals(quals).build();
+  const auto phred33 = read.base_quals().to_phred33();
+  BOOST_REQUIRE_EQUAL(phred33.size(), 256u);
+  for (auto q = 0u; q != 256; ++q)
+    BOOST_CHECK_EQUAL(phred33[q], char(std::min(q, 93u) + 33));
+  BOOST_CHECK_EQUAL(builder.set_base_quals_phred33(phred33.substr(0, 94)).set_bases(string(94, 'A')).set_cigar("94M").build().base_quals().to_phred33(), phred33.substr(0, 94));
+  const auto text = read.base_quals().to_string();
+  BOOST_CHECK_EQUAL(text.substr(0, 24), "0 1 2 3 4 5 6 7 8 9 10 1");
+  BOOST_CHECK_EQUAL(text.substr(text.size() - 11), "253 254 255");
+  auto empty_read_builder = SamBuilder{header, false};
+  BOOST_CHECK_EQUAL(empty_read_builder.set_name("empty").build().base_quals().to_string(), "");
+}
+
+BOOST_AUTO_TEST_CASE( base_quals_binning ) {
+  const auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
+  auto builder = SamBuilder{header};
+  auto read = builder.set_name("q").set_bases("ACGTACGTA").set_cigar("9M").set_base_quals({0, 2, 9, 10, 21, 27, 33, 38, 41}).build();
+  auto base_quals = read.base_quals();
+  base_quals.bin(QualityBinning::illumina_8_level());
+  BOOST_CHECK_EQUAL(read.base_quals().to_string(), "0 6 6 15 22 27 33 37 40");
+  auto long_quals = vector<uint8_t>(151);   // binned a vector at a time
+  for (auto i = 0u; i != long_quals.size(); ++i)
+    long_quals[i] = uint8_t(i % 46);
+  auto long_read = builder.set_bases(string(151, 'A')).set_cigar("151M").set_base_quals(long_quals).build();
+  long_read.base_quals().bin(QualityBinning::illumina_8_level());
+  for (auto i = 0u; i != long_quals.size(); ++i)
+    BOOST_CHECK_EQUAL(int(long_read.base_quals()[i]), int(QualityBinning::illumina_8_level()(long_quals[i])));
+  const auto two_levels = QualityBinning{{{0, 2}, {20, 30}}};
+  BOOST_CHECK_EQUAL(two_levels(19), 2);
+  BOOST_CHECK_EQUAL(two_levels(20), 30);
+  BOOST_CHECK_EQUAL(two_levels(255), 30);
+  BOOST_CHECK_THROW((QualityBinning{{{20, 30}, {10, 2}}}), invalid_argument);
+}
+
 BOOST_AUTO_TEST_CASE( sam_read_bases_templated_copy_and_move_constructors ) {
   auto it = SingleSamReader{"testdata/test_simple.bam"}.begin();
   auto c0 = (*it).bases();
@@ -349,6 +429,69 @@ BOOST_AUTO_TEST_CASE( sam_read_tags ) {
   BOOST_CHECK(missing(not_a_string_tag));            // this should yield "not a char" which is equal to a missing value
 }
 
+BOOST_AUTO_TEST_CASE( sam_tag_keys ) {
+  constexpr auto key = SamTagKey{"NM"};
+  static_assert(key.code() == ('N' | 'M' << 8), "tag keys are the two bytes of the aux data");
+  BOOST_CHECK(SamTagKey{string{"NM"}} == key);
+  BOOST_CHECK_EQUAL(key.name(), "NM");
+  BOOST_CHECK_THROW(SamTagKey{string{"NMX"}}, invalid_argument);
+  BOOST_CHECK_THROW(SamTagKey{string{"N"}}, invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE( sam_tag_index ) {
+  auto file = utils::make_unique_hts_file(sam_open("testdata/test_simple.bam", "r"));
+  const auto header = utils::make_shared_sam_header(sam_hdr_read(file.get()));
+  const auto body = utils::SamHandle::create();
+  BOOST_REQUIRE_GE(sam_read1(file.get(), header.get(), body.get()), 0);
+  for (auto i = 0; i != 12; ++i) {                         // more tags than the index holds
+    const char name[2] = {'X', char('a' + i)};
+    auto value = int32_t{i * 1000};
+    bam_aux_append(body.get(), name, 'i', sizeof(value), reinterpret_cast<uint8_t*>(&value));
+  }
+  auto record = Sam{header, body};
+  const auto rg = record.string_tag("RG");
+  BOOST_CHECK_EQUAL(rg.value(), "exampleBAM.bam");
+  BOOST_CHECK(record.string_tag("RG").value().data() == rg.value().data());  // points into the record
+  BOOST_CHECK_EQUAL(record.integer_tag("ZB").value(), 23);
+  BOOST_CHECK_CLOSE(record.double_tag("ZA").value(), 2.3, 0.001);
+  for (auto i = 11; i >= 0; --i) {
+    const auto tag = record.integer_tag(string{'X', char('a' + i)});
+    BOOST_CHECK(!missing(tag));
+    BOOST_CHECK_EQUAL(tag.value(), i * 1000);
+  }
+  BOOST_CHECK(missing(record.integer_tag("Xz")));
+  BOOST_CHECK(missing(record.integer_tag("RG")));          // type mismatches are missing values
+  BOOST_CHECK(missing(record.double_tag("ZB")));
+  BOOST_CHECK(missing(record.string_tag("ZC")));
+  record.set_mapping_qual(10);                             // modifications reset the index
+  BOOST_CHECK_EQUAL(record.integer_tag("Xl").value(), 11000);
+}
+
+BOOST_AUTO_TEST_CASE( sam_tags_across_iterations ) {
+  const auto keys = vector<SamTagKey>{"RG", "PG", "SM", "NM", "MD", "AS", "XS", "MC", "ZB"};
+  auto file = utils::make_unique_hts_file(sam_open("testdata/test_paired.bam", "r"));
+  const auto header = utils::make_shared_sam_header(sam_hdr_read(file.get()));
+  const auto body = utils::SamHandle::create();
+  auto records = 0u;
+  for (const auto& record : SingleSamReader{"testdata/test_paired.bam"}) {  // the iterator reads every record into the same buffer
+    BOOST_REQUIRE_GE(sam_read1(file.get(), header.get(), body.get()), 0);
+    for (const auto key : keys) {
+      const auto name = key.name();
+      const auto* aux = bam_aux_get(body.get(), name.c_str());
+      const auto is_string = aux != nullptr && (aux[0] == 'Z' || aux[0] == 'H');
+      const auto is_integer = aux != nullptr && string{"cCsSiI"}.find(char(aux[0])) != string::npos;
+      BOOST_CHECK_EQUAL(missing(record.string_tag(key)), !is_string);
+      BOOST_CHECK_EQUAL(missing(record.integer_tag(key)), !is_integer);
+      if (is_string)
+        BOOST_CHECK_EQUAL(record.string_tag(key).value(), bam_aux2Z(aux));
+      if (is_integer)
+        BOOST_CHECK_EQUAL(record.integer_tag(key).value(), bam_aux2i(aux));
+    }
+    ++records;
+  }
+  BOOST_CHECK_GT(records, 1u);
+}
+
 BOOST_AUTO_TEST_CASE( sam_templated_copy_and_move_constructors ) {
   auto it = SingleSamReader{"testdata/test_simple.bam"}.begin();
   auto c0 = *it;
@@ -371,6 +514,92 @@ BOOST_AUTO_TEST_CASE( sam_templated_copy_and_move_constructors ) {
   BOOST_CHECK_NE(m1.alignment_start(), c2.alignment_start());  // check that modifying the moved doesn't affect the copied
 }
 
+BOOST_AUTO_TEST_CASE( sam_copy_on_write ) {
+  auto& pool = utils::SamRecordPool::thread_local_pool();
+  const auto original = *(SingleSamReader{"testdata/test_simple.bam"}.begin());
+  const auto before = pool.statistics();
+  auto copy = original;
+  auto other = copy;
+  auto assigned = Sam{};
+  assigned = other;
+  const auto after_copies = pool.statistics();
+  BOOST_CHECK_EQUAL(after_copies.record_allocations + after_copies.records_reused, before.record_allocations + before.records_reused);  // nothing was copied yet
+  copy.set_alignment_start(5);                                // makes its own copy first
+  BOOST_CHECK_EQUAL(copy.alignment_start(), 5u);
+  BOOST_CHECK_NE(original.alignment_start(), 5u);
+  BOOST_CHECK_EQUAL(other.alignment_start(), original.alignment_start());
+  other.base_quals()[0] = 2;                                  // so does writing through a view
+  BOOST_CHECK_EQUAL(other.base_quals()[0], 2);
+  BOOST_CHECK_NE(original.base_quals()[0], 2);
+  const auto& const_assigned = assigned;                      // reading doesn't copy
+  BOOST_CHECK_NE(const_assigned.base_quals()[0], 2);
+  BOOST_CHECK_EQUAL(assigned.cigar().to_string(), original.cigar().to_string());
+  BOOST_CHECK_EQUAL(assigned.bases().to_string(), original.bases().to_string());
+  const auto after_writes = pool.statistics();
+  BOOST_CHECK_EQUAL(after_writes.record_allocations + after_writes.records_reused, before.record_allocations + before.records_reused + 2);
+  other.set_duplicate();                                      // nobody shares its copy anymore
+  BOOST_CHECK(other.duplicate());
+  BOOST_CHECK(!original.duplicate());
+  const auto after_last = pool.statistics();
+  BOOST_CHECK_EQUAL(after_last.record_allocations + after_last.records_reused, after_writes.record_allocations + after_writes.records_reused);
+}
+
+BOOST_AUTO_TEST_CASE( sam_views_copy_on_write ) {
+  const auto original = *(SingleSamReader{"testdata/test_simple.bam"}.begin());
+  const auto quality = original.base_quals()[0];
+  const auto element = original.cigar()[0];
+  const auto base = original.bases()[0];
+  auto copy = original;
+  auto quals = copy.base_quals();                             // writing through the views of a copy modifies the copy only
+  quals[0] = 99;
+  auto cigar = copy.cigar();
+  cigar[0] = Cigar::make_cigar_element(7, CigarOperator::S);
+  copy.bases().set_base(0, base == Base::T ? Base::A : Base::T);
+  BOOST_CHECK_EQUAL(copy.base_quals()[0], 99);
+  BOOST_CHECK_EQUAL(copy.cigar()[0], Cigar::make_cigar_element(7, CigarOperator::S));
+  BOOST_CHECK(copy.bases()[0] != base);
+  BOOST_CHECK_EQUAL(original.base_quals()[0], quality);
+  BOOST_CHECK_EQUAL(original.cigar()[0], element);
+  BOOST_CHECK(original.bases()[0] == base);
+  auto later = copy;                                          // a view taken before the record was copied doesn't write to the copy either
+  quals[0] = 98;
+  BOOST_CHECK_EQUAL(copy.base_quals()[0], 98);
+  BOOST_CHECK_EQUAL(later.base_quals()[0], 99);
+  auto const_view = original.base_quals();                    // the views of a const record write to their own copy
+  const_view[0] = 97;
+  BOOST_CHECK_EQUAL(const_view[0], 97);
+  BOOST_CHECK_EQUAL(original.base_quals()[0], quality);
+}
+
+BOOST_AUTO_TEST_CASE( sam_iterator_copies_outlive_iteration ) {
+  auto copies = vector<Sam>{};
+  auto names = vector<string>{};
+  auto mapping_quals = vector<uint8_t>{};
+  for (auto& record : SingleSamReader{"testdata/test_simple.bam"}) {
+    copies.push_back(record);                                 // shares the buffer, so the iterator reads the next record into a new one
+    names.push_back(record.name());
+    mapping_quals.push_back(record.mapping_qual());
+    record.set_mapping_qual(mapping_quals.back() + 1);       // the iterator's own record is modified after being copied
+  }
+  BOOST_REQUIRE_EQUAL(copies.size(), names.size());
+  for (auto i = 0u; i != copies.size(); ++i) {
+    BOOST_CHECK_EQUAL(copies[i].name(), names[i]);
+    BOOST_CHECK_EQUAL(copies[i].mapping_qual(), mapping_quals[i]);
+  }
+  auto pairs = vector<pair<Sam,Sam>>{};
+  names.clear();
+  for (const auto& pair : PairSamReader{"testdata/test_paired.bam"}) {
+    pairs.push_back(pair);
+    names.push_back(pair.first.name());
+  }
+  BOOST_REQUIRE_EQUAL(pairs.size(), names.size());
+  for (auto i = 0u; i != pairs.size(); ++i) {
+    BOOST_CHECK_EQUAL(pairs[i].first.name(), names[i]);
+    if (!pairs[i].second.empty())
+      BOOST_CHECK_EQUAL(pairs[i].second.name(), names[i]);
+  }
+}
+
 void check_read_alignment_starts_and_stops(const Sam& read, const uint32_t astart, const uint32_t astop, const uint32_t ustart, const uint32_t ustop) {
   BOOST_CHECK_EQUAL(read.alignment_start(), astart);
   BOOST_CHECK_EQUAL(read.alignment_stop(), astop);
@@ -421,6 +650,42 @@ BOOST_AUTO_TEST_CASE( sam_mate_operations ) {
   }
 }
 
+BOOST_AUTO_TEST_CASE( sam_mate_coordinates ) {
+  for (const auto& record : SingleSamReader{"testdata/test_simple.sam"}) {
+    const auto tag = record.string_tag("MC");
+    if (missing(tag)) {
+      BOOST_CHECK_THROW(record.mate_coordinates(), invalid_argument);
+      continue;
+    }
+    const auto mate = record.mate_coordinates();
+    BOOST_CHECK_EQUAL(mate.alignment_start, record.mate_alignment_start());
+    BOOST_CHECK_EQUAL(mate.alignment_stop, record.mate_alignment_stop(tag));
+    BOOST_CHECK_EQUAL(mate.unclipped_start, record.mate_unclipped_start(tag));
+    BOOST_CHECK_EQUAL(mate.unclipped_stop, record.mate_unclipped_stop(tag));
+    const auto cached = record.mate_coordinates();
+    BOOST_CHECK_EQUAL(cached.unclipped_stop, mate.unclipped_stop);
+  }
+
+  // the cached coordinates follow changes to the record
+  const auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
+  auto builder = SamBuilder{header};
+  auto record = builder.set_name("TEST").set_bases("A").set_cigar("1M").set_base_quals({20}).set_mate_alignment_start(100).set_string_tag("MC", "5S10M2D3H").build();
+  auto copy = record;
+  BOOST_CHECK_EQUAL(record.mate_coordinates().alignment_stop, 111u);
+  BOOST_CHECK_EQUAL(record.mate_unclipped_start(), 95u);
+  BOOST_CHECK_EQUAL(record.mate_unclipped_stop(), 114u);
+  record.set_mate_alignment_start(200);
+  BOOST_CHECK_EQUAL(record.mate_coordinates().alignment_stop, 211u);
+  BOOST_CHECK_EQUAL(record.mate_unclipped_start(), 195u);
+  BOOST_CHECK_EQUAL(copy.mate_coordinates().alignment_stop, 111u);
+  copy = builder.set_string_tag("MC", "4M").build();
+  BOOST_CHECK_EQUAL(copy.mate_coordinates().alignment_stop, 103u);
+  BOOST_CHECK_EQUAL(copy.mate_unclipped_stop(), 103u);
+
+  const auto bad_mate_cigar = builder.set_string_tag("MC", "4Q").build();
+  BOOST_CHECK_THROW(bad_mate_cigar.mate_coordinates(), invalid_argument);
+}
+
 BOOST_AUTO_TEST_CASE( sam_off_by_one_uber_test ) {
   const auto header = SingleSamReader{"testdata/test_simple.bam"}.header();
   auto builder = SamBuilder{header};
@@ -0,0 +1,40 @@
+#include "utils/thread_pool.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace gamgee::utils;
+
+BOOST_AUTO_TEST_CASE( thread_pool_results_in_submission_order )
+{
+  ThreadPool pool {4};
+  BOOST_CHECK_EQUAL(pool.size(), 4u);
+  auto results = vector<future<uint32_t>>{};
+  for (auto i = 0u; i != 100; ++i)
+    results.push_back(pool.submit([i]{ return i * i; }));
+  for (auto i = 0u; i != 100; ++i)
+    BOOST_CHECK_EQUAL(results[i].get(), i * i);
+}
+
+BOOST_AUTO_TEST_CASE( thread_pool_drains_on_destruction )
+{
+  atomic<uint32_t> counter {0};
+  {
+    ThreadPool pool {2};
+    for (auto i = 0u; i != 50; ++i)
+      pool.submit([&counter]{ ++counter; });
+  }
+  BOOST_CHECK_EQUAL(counter.load(), 50u);
+}
+
+BOOST_AUTO_TEST_CASE( thread_pool_propagates_exceptions )
+{
+  ThreadPool pool {0};  // zero workers is bumped up to one
+  BOOST_CHECK_EQUAL(pool.size(), 1u);
+  auto result = pool.submit([]() -> int { throw runtime_error{"task failed"}; });
+  BOOST_CHECK_THROW(result.get(), runtime_error);
+}
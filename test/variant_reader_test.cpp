@@ -15,6 +15,7 @@
 #include <boost/algorithm/string/join.hpp>
 #include <boost/iterator/zip_iterator.hpp>
 #include <stdexcept>
+#include <thread>
 #include <unordered_set>
 
 using namespace std;
@@ -1025,6 +1026,45 @@ BOOST_AUTO_TEST_CASE( variant_iterator_move_test ) {
     check_all_apis(record, truth_index);
 }
 
+BOOST_AUTO_TEST_CASE( variant_iterator_copies_outlive_iteration ) {
+  for (const auto& filename : {"testdata/test_variants.vcf", "testdata/test_variants.bcf"}) {
+    auto records = vector<Variant>{};
+    for (const auto& record : SingleVariantReader{filename})
+      records.push_back(record);  // copy-on-write: the iterator reads the next record into a new buffer
+    for (auto truth_index = 0u; truth_index != records.size(); ++truth_index)
+      check_all_apis(records[truth_index], truth_index);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( variant_copies_unpack_lazily_from_several_threads ) {
+  const auto summary = [](const Variant& record) {   // reads every part of the record (strings, filters, info and format fields)
+    auto result = record.ref() + " " + boost::algorithm::join(record.alt(), ",") + " " + record.id();
+    for (const auto& filter : record.filters())
+      result += " " + filter;
+    result += " " + to_string(record.boolean_shared_field("DB")) + " " + to_string(record.genotypes().size());
+    for (const auto& genotype : record.genotypes())
+      result += " " + boost::algorithm::join(genotype.allele_strings(), "/");
+    return result;
+  };
+  for (const auto& filename : {"testdata/test_variants.vcf", "testdata/test_variants.bcf"}) {
+    auto records = vector<Variant>{};
+    for (const auto& record : SingleVariantReader{filename})
+      records.push_back(record);
+    auto copies = vector<vector<Variant>>(4, records);  // the copies share the packed bodies of the records
+    auto summaries = vector<vector<string>>(copies.size());
+    auto threads = vector<thread>{};
+    for (auto i = 0u; i != copies.size(); ++i)
+      threads.emplace_back([&, i]{ for (const auto& copy : copies[i]) summaries[i].push_back(summary(copy)); });
+    for (auto& thread : threads)
+      thread.join();
+    for (auto j = 0u; j != records.size(); ++j) {
+      const auto expected = summary(records[j]);
+      for (const auto& thread_summaries : summaries)
+        BOOST_CHECK_EQUAL(thread_summaries[j], expected);
+    }
+  }
+}
+
 const auto gvcf_truth_ref               = vector<string>{"T", "C", "GG"};
 const auto gvcf_truth_chromosome        = vector<uint32_t>{0, 0, 1};
 const auto gvcf_truth_alignment_starts  = vector<uint32_t>{10000000, 20000000, 10001000};